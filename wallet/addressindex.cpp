@@ -0,0 +1,164 @@
+#include "addressindex.h"
+
+#include "base58.h"
+#include "blockindex.h"
+#include "itxdb.h"
+#include "logging/logger.h"
+#include "txindex.h"
+
+bool fAddressIndex = false;
+
+boost::optional<CAddressIndexAddress>
+CAddressIndexAddress::FromBitcoinAddress(const CBitcoinAddress& address)
+{
+    if (!address.IsValid()) {
+        return boost::none;
+    }
+    const CTxDestination dest = address.Get();
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        return CAddressIndexAddress(AddressIndexType::KeyHash, *keyID);
+    }
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        return CAddressIndexAddress(AddressIndexType::ScriptHash, *scriptID);
+    }
+    return boost::none;
+}
+
+CBitcoinAddress CAddressIndexAddress::ToBitcoinAddress() const
+{
+    if (type == static_cast<uint8_t>(AddressIndexType::ScriptHash)) {
+        return CBitcoinAddress(CScriptID(hashBytes));
+    }
+    return CBitcoinAddress(CKeyID(hashBytes));
+}
+
+boost::optional<CAddressIndexAddress> GetIndexedAddress(const ITxDB& txdb, const CScript& scriptPubKey)
+{
+    // cold stake outputs resolve to their owner; multisig and data outputs aren't indexed
+    CTxDestination dest;
+    if (!ExtractDestination(txdb, scriptPubKey, dest)) {
+        return boost::none;
+    }
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        return CAddressIndexAddress(AddressIndexType::KeyHash, *keyID);
+    }
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        return CAddressIndexAddress(AddressIndexType::ScriptHash, *scriptID);
+    }
+    return boost::none;
+}
+
+void AppendAddressIndexChanges(const ITxDB& txdb, const CTransaction& tx, const MapPrevTx& mapInputs,
+                               int nHeight, AddressIndexEntries& historyEntries,
+                               AddressUnspentEntries& unspentEntries)
+{
+    const uint256 txhash = tx.GetHash();
+
+    if (!tx.IsCoinBase()) {
+        for (unsigned i = 0; i < tx.vin.size(); i++) {
+            const COutPoint& prevout = tx.vin[i].prevout;
+            // the inputs were fetched and connected already, so they're all there
+            const auto it = mapInputs.find(prevout.hash);
+            assert(it != mapInputs.cend() && prevout.n < it->second.second.vout.size());
+            const CTxOut& spentOutput = it->second.second.vout[prevout.n];
+
+            const boost::optional<CAddressIndexAddress> address =
+                GetIndexedAddress(txdb, spentOutput.scriptPubKey);
+            if (!address) {
+                continue;
+            }
+            historyEntries.emplace_back(CAddressIndexKey(*address, nHeight, txhash, i, true),
+                                        -spentOutput.nValue);
+            unspentEntries.emplace_back(CAddressUnspentKey(*address, prevout.hash, prevout.n),
+                                        CAddressUnspentValue());
+        }
+    }
+
+    for (unsigned i = 0; i < tx.vout.size(); i++) {
+        const CTxOut& output = tx.vout[i];
+
+        const boost::optional<CAddressIndexAddress> address =
+            GetIndexedAddress(txdb, output.scriptPubKey);
+        if (!address) {
+            continue;
+        }
+        historyEntries.emplace_back(CAddressIndexKey(*address, nHeight, txhash, i, false),
+                                    output.nValue);
+        unspentEntries.emplace_back(CAddressUnspentKey(*address, txhash, i),
+                                    CAddressUnspentValue(output.nValue, output.scriptPubKey, nHeight));
+    }
+}
+
+bool UndoAddressIndexChanges(ITxDB& txdb, const std::vector<CTransaction>& vtx, int nHeight)
+{
+    AddressIndexEntries   historyEntries;
+    AddressUnspentEntries unspentEntries;
+
+    // in reverse order, so that an output created and spent in this block ends up erased
+    for (int t = static_cast<int>(vtx.size()) - 1; t >= 0; t--) {
+        const CTransaction& tx     = vtx[t];
+        const uint256       txhash = tx.GetHash();
+
+        for (unsigned i = 0; i < tx.vout.size(); i++) {
+            const CTxOut& output = tx.vout[i];
+
+            const boost::optional<CAddressIndexAddress> address =
+                GetIndexedAddress(txdb, output.scriptPubKey);
+            if (!address) {
+                continue;
+            }
+            historyEntries.emplace_back(CAddressIndexKey(*address, nHeight, txhash, i, false),
+                                        output.nValue);
+            unspentEntries.emplace_back(CAddressUnspentKey(*address, txhash, i),
+                                        CAddressUnspentValue());
+        }
+
+        if (tx.IsCoinBase()) {
+            continue;
+        }
+
+        for (unsigned i = 0; i < tx.vin.size(); i++) {
+            const COutPoint& prevout = tx.vin[i].prevout;
+
+            CTransaction txPrev;
+            CTxIndex     txindex;
+            if (!txdb.ReadDiskTx(prevout.hash, txPrev, txindex)) {
+                return NLog.error("UndoAddressIndexChanges(): failed to read spent transaction {}",
+                                  prevout.hash.ToString());
+            }
+            if (prevout.n >= txPrev.vout.size()) {
+                return NLog.error("UndoAddressIndexChanges(): prevout.n out of range for {}",
+                                  prevout.ToString());
+            }
+            const CTxOut& spentOutput = txPrev.vout[prevout.n];
+
+            const boost::optional<CAddressIndexAddress> address =
+                GetIndexedAddress(txdb, spentOutput.scriptPubKey);
+            if (!address) {
+                continue;
+            }
+
+            const boost::optional<CBlockIndex> prevBlockIndex =
+                txdb.ReadBlockIndex(txindex.pos.nBlockPos);
+            if (!prevBlockIndex) {
+                return NLog.error("UndoAddressIndexChanges(): failed to read the block index of {}",
+                                  txindex.pos.nBlockPos.ToString());
+            }
+
+            historyEntries.emplace_back(CAddressIndexKey(*address, nHeight, txhash, i, true),
+                                        -spentOutput.nValue);
+            unspentEntries.emplace_back(CAddressUnspentKey(*address, prevout.hash, prevout.n),
+                                        CAddressUnspentValue(spentOutput.nValue,
+                                                             spentOutput.scriptPubKey,
+                                                             prevBlockIndex->nHeight));
+        }
+    }
+
+    if (!txdb.EraseAddressIndex(historyEntries)) {
+        return NLog.error("UndoAddressIndexChanges(): failed to erase address history");
+    }
+    if (!txdb.UpdateAddressUnspentIndex(unspentEntries)) {
+        return NLog.error("UndoAddressIndexChanges(): failed to restore spent outputs");
+    }
+    return true;
+}
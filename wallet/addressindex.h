@@ -0,0 +1,155 @@
+#ifndef ADDRESSINDEX_H
+#define ADDRESSINDEX_H
+
+#include "amount.h"
+#include "script.h"
+#include "serialize.h"
+#include "transaction.h"
+#include "uint256.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class ITxDB;
+class CBitcoinAddress;
+
+/** Set by -addressindex; the address index is maintained while connecting/disconnecting blocks */
+extern bool fAddressIndex;
+
+enum class AddressIndexType : uint8_t
+{
+    KeyHash    = 1,
+    ScriptHash = 2,
+};
+
+/** An address as it's used in the keys of the address index */
+struct CAddressIndexAddress
+{
+    uint8_t type = 0;
+    uint160 hashBytes;
+
+    CAddressIndexAddress() = default;
+    CAddressIndexAddress(AddressIndexType typeIn, const uint160& hashIn)
+        : type(static_cast<uint8_t>(typeIn)), hashBytes(hashIn)
+    {
+    }
+
+    static boost::optional<CAddressIndexAddress> FromBitcoinAddress(const CBitcoinAddress& address);
+    CBitcoinAddress                              ToBitcoinAddress() const;
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+        READWRITE(type);
+        READWRITE(hashBytes);
+    )
+    // clang-format on
+
+    friend bool operator==(const CAddressIndexAddress& a, const CAddressIndexAddress& b)
+    {
+        return a.type == b.type && a.hashBytes == b.hashBytes;
+    }
+};
+
+/**
+ * A key of the address history table: every output paying to an address and every input spending
+ * from it. Keys of an address are sorted by height, which the range queries depend on.
+ */
+struct CAddressIndexKey
+{
+    CAddressIndexAddress address;
+    uint32_t             blockHeight = 0;
+    uint256              txhash;
+    uint32_t             index    = 0;
+    bool                 spending = false;
+
+    CAddressIndexKey() = default;
+    CAddressIndexKey(const CAddressIndexAddress& addressIn, int heightIn, const uint256& txhashIn,
+                     uint32_t indexIn, bool spendingIn)
+        : address(addressIn), blockHeight(static_cast<uint32_t>(heightIn)), txhash(txhashIn),
+          index(indexIn), spending(spendingIn)
+    {
+    }
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+        READWRITE(address);
+        READWRITE(REF(CBigEndian32(REF(blockHeight))));
+        READWRITE(txhash);
+        READWRITE(index);
+        READWRITE(spending);
+    )
+    // clang-format on
+};
+
+/** A key of the unspent outputs table */
+struct CAddressUnspentKey
+{
+    CAddressIndexAddress address;
+    uint256              txhash;
+    uint32_t             index = 0;
+
+    CAddressUnspentKey() = default;
+    CAddressUnspentKey(const CAddressIndexAddress& addressIn, const uint256& txhashIn, uint32_t indexIn)
+        : address(addressIn), txhash(txhashIn), index(indexIn)
+    {
+    }
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+        READWRITE(address);
+        READWRITE(txhash);
+        READWRITE(index);
+    )
+    // clang-format on
+};
+
+struct CAddressUnspentValue
+{
+    CAmount nValue = -1;
+    CScript scriptPubKey;
+    int     blockHeight = 0;
+
+    CAddressUnspentValue() = default;
+    CAddressUnspentValue(CAmount nValueIn, const CScript& scriptIn, int heightIn)
+        : nValue(nValueIn), scriptPubKey(scriptIn), blockHeight(heightIn)
+    {
+    }
+
+    // a null value in an update means that the output was spent
+    bool IsNull() const { return nValue == -1; }
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+        READWRITE(nValue);
+        READWRITE(scriptPubKey);
+        READWRITE(blockHeight);
+    )
+    // clang-format on
+};
+
+using AddressIndexEntries   = std::vector<std::pair<CAddressIndexKey, CAmount>>;
+using AddressUnspentEntries = std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>;
+
+/**
+ * Returns the address under which an output with the given script is indexed, if any. Cold stake
+ * outputs are indexed under their owner, as the coins are the owner's.
+ */
+boost::optional<CAddressIndexAddress> GetIndexedAddress(const ITxDB& txdb, const CScript& scriptPubKey);
+
+/**
+ * Appends the address index changes of connecting tx at the given height. Spending an output erases
+ * it from the unspent table, which is recorded as a null value.
+ */
+void AppendAddressIndexChanges(const ITxDB& txdb, const CTransaction& tx, const MapPrevTx& mapInputs,
+                               int nHeight, AddressIndexEntries& historyEntries,
+                               AddressUnspentEntries& unspentEntries);
+
+/**
+ * Reverts what connecting the transactions of a block at the given height wrote to the address index.
+ * Has to be called before their inputs are disconnected, as the spent outputs are read through the
+ * tx index.
+ */
+bool UndoAddressIndexChanges(ITxDB& txdb, const std::vector<CTransaction>& vtx, int nHeight);
+
+#endif // ADDRESSINDEX_H
@@ -0,0 +1,207 @@
+#include "arith_uint256.h"
+
+#include "uint256.h"
+
+template <unsigned int BITS>
+arith_uint<BITS>& arith_uint<BITS>::operator<<=(unsigned int shift)
+{
+    arith_uint<BITS> a(*this);
+    for (int i = 0; i < WIDTH; i++)
+        pn[i] = 0;
+    const int k = shift / 32;
+    shift       = shift % 32;
+    for (int i = 0; i < WIDTH; i++) {
+        if (i + k + 1 < WIDTH && shift != 0)
+            pn[i + k + 1] |= (a.pn[i] >> (32 - shift));
+        if (i + k < WIDTH)
+            pn[i + k] |= (a.pn[i] << shift);
+    }
+    return *this;
+}
+
+template <unsigned int BITS>
+arith_uint<BITS>& arith_uint<BITS>::operator>>=(unsigned int shift)
+{
+    arith_uint<BITS> a(*this);
+    for (int i = 0; i < WIDTH; i++)
+        pn[i] = 0;
+    const int k = shift / 32;
+    shift       = shift % 32;
+    for (int i = 0; i < WIDTH; i++) {
+        if (i - k - 1 >= 0 && shift != 0)
+            pn[i - k - 1] |= (a.pn[i] << (32 - shift));
+        if (i - k >= 0)
+            pn[i - k] |= (a.pn[i] >> shift);
+    }
+    return *this;
+}
+
+template <unsigned int BITS>
+arith_uint<BITS>& arith_uint<BITS>::operator*=(uint32_t b32)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < WIDTH; i++) {
+        uint64_t n = carry + (uint64_t)b32 * pn[i];
+        pn[i]      = n & 0xffffffff;
+        carry      = n >> 32;
+    }
+    return *this;
+}
+
+template <unsigned int BITS>
+arith_uint<BITS>& arith_uint<BITS>::operator*=(const arith_uint& b)
+{
+    arith_uint<BITS> a;
+    for (int j = 0; j < WIDTH; j++) {
+        uint64_t carry = 0;
+        for (int i = 0; i + j < WIDTH; i++) {
+            uint64_t n    = carry + a.pn[i + j] + (uint64_t)pn[j] * b.pn[i];
+            a.pn[i + j] = n & 0xffffffff;
+            carry         = n >> 32;
+        }
+    }
+    *this = a;
+    return *this;
+}
+
+template <unsigned int BITS>
+arith_uint<BITS>& arith_uint<BITS>::operator/=(const arith_uint& b)
+{
+    arith_uint<BITS> div = b;     // make a copy, so we can shift.
+    arith_uint<BITS> num = *this; // make a copy, so we can subtract.
+    *this                = 0;     // the quotient.
+    const int num_bits   = num.bits();
+    const int div_bits   = div.bits();
+    if (div_bits == 0)
+        throw uint_error("Division by zero");
+    if (div_bits > num_bits) // the result is certainly 0.
+        return *this;
+    int shift = num_bits - div_bits;
+    div <<= shift; // shift so that div and num align.
+    while (shift >= 0) {
+        if (num >= div) {
+            num -= div;
+            pn[shift / 32] |= (1 << (shift & 31)); // set a bit of the result.
+        }
+        div >>= 1; // shift back.
+        shift--;
+    }
+    // num now contains the remainder of the division.
+    return *this;
+}
+
+template <unsigned int BITS>
+int arith_uint<BITS>::CompareTo(const arith_uint<BITS>& b) const
+{
+    for (int i = WIDTH - 1; i >= 0; i--) {
+        if (pn[i] < b.pn[i])
+            return -1;
+        if (pn[i] > b.pn[i])
+            return 1;
+    }
+    return 0;
+}
+
+template <unsigned int BITS>
+bool arith_uint<BITS>::EqualTo(uint64_t b) const
+{
+    for (int i = WIDTH - 1; i >= 2; i--) {
+        if (pn[i])
+            return false;
+    }
+    if (pn[1] != (b >> 32))
+        return false;
+    if (pn[0] != (b & 0xfffffffful))
+        return false;
+    return true;
+}
+
+template <unsigned int BITS>
+std::string arith_uint<BITS>::GetHex() const
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string       result;
+    result.reserve(BITS / 4);
+    for (int i = WIDTH - 1; i >= 0; i--) {
+        for (int shift = 28; shift >= 0; shift -= 4)
+            result.push_back(digits[(pn[i] >> shift) & 0xf]);
+    }
+    return result;
+}
+
+template <unsigned int BITS>
+unsigned int arith_uint<BITS>::bits() const
+{
+    for (int pos = WIDTH - 1; pos >= 0; pos--) {
+        if (pn[pos]) {
+            for (int nbits = 31; nbits > 0; nbits--) {
+                if (pn[pos] & 1U << nbits)
+                    return 32 * pos + nbits + 1;
+            }
+            return 32 * pos + 1;
+        }
+    }
+    return 0;
+}
+
+template <unsigned int BITS>
+arith_uint<BITS>& arith_uint<BITS>::SetCompact(uint32_t nCompact, bool* pfNegative, bool* pfOverflow)
+{
+    const int nSize = nCompact >> 24;
+    uint32_t  nWord = nCompact & 0x007fffff;
+    if (nSize <= 3) {
+        nWord >>= 8 * (3 - nSize);
+        *this = nWord;
+    } else {
+        *this = nWord;
+        *this <<= 8 * (nSize - 3);
+    }
+    if (pfNegative)
+        *pfNegative = nWord != 0 && (nCompact & 0x00800000) != 0;
+    if (pfOverflow) {
+        const int nBytes = BITS / 8;
+        *pfOverflow      = nWord != 0 && ((nSize > nBytes + 2) || (nWord > 0xff && nSize > nBytes + 1) ||
+                                     (nWord > 0xffff && nSize > nBytes));
+    }
+    return *this;
+}
+
+template <unsigned int BITS>
+uint32_t arith_uint<BITS>::GetCompact(bool fNegative) const
+{
+    int      nSize    = (bits() + 7) / 8;
+    uint32_t nCompact = 0;
+    if (nSize <= 3) {
+        nCompact = GetLow64() << 8 * (3 - nSize);
+    } else {
+        arith_uint<BITS> bn = *this >> 8 * (nSize - 3);
+        nCompact            = bn.GetLow64();
+    }
+    // The 0x00800000 bit denotes the sign.
+    // Thus, if it is already set, divide the mantissa by 256 and increase the exponent.
+    if (nCompact & 0x00800000) {
+        nCompact >>= 8;
+        nSize++;
+    }
+    nCompact |= nSize << 24;
+    nCompact |= (fNegative && (nCompact & 0x007fffff) ? 0x00800000 : 0);
+    return nCompact;
+}
+
+template class arith_uint<256>;
+template class arith_uint<512>;
+
+uint256 ArithToUint256(const arith_uint256& a)
+{
+    uint256 result;
+    static_assert(sizeof(result) == sizeof(a), "uint256 and arith_uint256 must have the same layout");
+    std::memcpy(result.begin(), &a, sizeof(a));
+    return result;
+}
+
+arith_uint256 UintToArith256(const uint256& a)
+{
+    arith_uint256 result;
+    std::memcpy(&result, a.begin(), sizeof(result));
+    return result;
+}
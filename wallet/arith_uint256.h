@@ -0,0 +1,181 @@
+#ifndef ARITH_UINT256_H
+#define ARITH_UINT256_H
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+class uint256;
+
+class uint_error : public std::runtime_error
+{
+public:
+    explicit uint_error(const std::string& str) : std::runtime_error(str) {}
+};
+
+/**
+ * Fixed-width unsigned integer with the arithmetic of the consensus code: the targets of nBits, the
+ * chain trust and the retargeting. It replaces CBigNum there, which allocates for every operation.
+ * Overflows wrap around, as with the built-in unsigned types.
+ */
+template <unsigned int BITS>
+class arith_uint
+{
+protected:
+    static constexpr int WIDTH = BITS / 32;
+    static_assert(WIDTH * 32 == BITS, "You cannot have a width that is not a multiple of 32");
+    uint32_t pn[WIDTH];
+
+    template <unsigned int OTHER>
+    friend class arith_uint;
+
+public:
+    arith_uint() { std::memset(pn, 0, sizeof(pn)); }
+
+    arith_uint(uint64_t b)
+    {
+        pn[0] = (unsigned int)b;
+        pn[1] = (unsigned int)(b >> 32);
+        for (int i = 2; i < WIDTH; i++)
+            pn[i] = 0;
+    }
+
+    /** zero-extends or truncates an integer of another width */
+    template <unsigned int OTHER>
+    explicit arith_uint(const arith_uint<OTHER>& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = i < arith_uint<OTHER>::WIDTH ? b.pn[i] : 0;
+    }
+
+    const arith_uint operator~() const
+    {
+        arith_uint ret;
+        for (int i = 0; i < WIDTH; i++)
+            ret.pn[i] = ~pn[i];
+        return ret;
+    }
+
+    const arith_uint operator-() const
+    {
+        arith_uint ret = ~*this;
+        ++ret;
+        return ret;
+    }
+
+    arith_uint& operator^=(const arith_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] ^= b.pn[i];
+        return *this;
+    }
+
+    arith_uint& operator&=(const arith_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] &= b.pn[i];
+        return *this;
+    }
+
+    arith_uint& operator|=(const arith_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] |= b.pn[i];
+        return *this;
+    }
+
+    arith_uint& operator<<=(unsigned int shift);
+    arith_uint& operator>>=(unsigned int shift);
+
+    arith_uint& operator+=(const arith_uint& b)
+    {
+        uint64_t carry = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            uint64_t n = carry + pn[i] + b.pn[i];
+            pn[i]      = n & 0xffffffff;
+            carry      = n >> 32;
+        }
+        return *this;
+    }
+
+    arith_uint& operator-=(const arith_uint& b)
+    {
+        *this += -b;
+        return *this;
+    }
+
+    arith_uint& operator*=(uint32_t b32);
+    arith_uint& operator*=(const arith_uint& b);
+    /** throws uint_error on a division by zero */
+    arith_uint& operator/=(const arith_uint& b);
+
+    arith_uint& operator++()
+    {
+        int i = 0;
+        while (i < WIDTH && ++pn[i] == 0)
+            i++;
+        return *this;
+    }
+
+    arith_uint& operator--()
+    {
+        int i = 0;
+        while (i < WIDTH && --pn[i] == std::numeric_limits<uint32_t>::max())
+            i++;
+        return *this;
+    }
+
+    int  CompareTo(const arith_uint& b) const;
+    bool EqualTo(uint64_t b) const;
+
+    friend inline const arith_uint operator+(const arith_uint& a, const arith_uint& b) { return arith_uint(a) += b; }
+    friend inline const arith_uint operator-(const arith_uint& a, const arith_uint& b) { return arith_uint(a) -= b; }
+    friend inline const arith_uint operator*(const arith_uint& a, const arith_uint& b) { return arith_uint(a) *= b; }
+    friend inline const arith_uint operator/(const arith_uint& a, const arith_uint& b) { return arith_uint(a) /= b; }
+    friend inline const arith_uint operator|(const arith_uint& a, const arith_uint& b) { return arith_uint(a) |= b; }
+    friend inline const arith_uint operator&(const arith_uint& a, const arith_uint& b) { return arith_uint(a) &= b; }
+    friend inline const arith_uint operator^(const arith_uint& a, const arith_uint& b) { return arith_uint(a) ^= b; }
+    friend inline const arith_uint operator>>(const arith_uint& a, int shift) { return arith_uint(a) >>= shift; }
+    friend inline const arith_uint operator<<(const arith_uint& a, int shift) { return arith_uint(a) <<= shift; }
+    friend inline const arith_uint operator*(const arith_uint& a, uint32_t b) { return arith_uint(a) *= b; }
+    friend inline bool operator==(const arith_uint& a, const arith_uint& b) { return a.CompareTo(b) == 0; }
+    friend inline bool operator!=(const arith_uint& a, const arith_uint& b) { return a.CompareTo(b) != 0; }
+    friend inline bool operator>(const arith_uint& a, const arith_uint& b) { return a.CompareTo(b) > 0; }
+    friend inline bool operator<(const arith_uint& a, const arith_uint& b) { return a.CompareTo(b) < 0; }
+    friend inline bool operator>=(const arith_uint& a, const arith_uint& b) { return a.CompareTo(b) >= 0; }
+    friend inline bool operator<=(const arith_uint& a, const arith_uint& b) { return a.CompareTo(b) <= 0; }
+    friend inline bool operator==(const arith_uint& a, uint64_t b) { return a.EqualTo(b); }
+    friend inline bool operator!=(const arith_uint& a, uint64_t b) { return !a.EqualTo(b); }
+
+    std::string GetHex() const;
+    std::string ToString() const { return GetHex(); }
+
+    /** the position of the highest bit set plus one, or zero if the value is zero */
+    unsigned int bits() const;
+
+    uint64_t GetLow64() const { return pn[0] | (uint64_t)pn[1] << 32; }
+
+    /**
+     * The "compact" format is a representation of a whole number N using an unsigned 32bit number
+     * similar to a floating point format. The most significant 8 bits are the unsigned exponent of
+     * base 256. This exponent can be thought of as "number of bytes of N". The lower 23 bits are the
+     * mantissa. Bit number 24 (0x800000) represents the sign of N.
+     * N = (-1^sign) * mantissa * 256^(exponent-3)
+     *
+     * This is the encoding of CBigNum::SetCompact() and GetCompact(), the MPI format of OpenSSL; the
+     * sign and a value too large for the width are reported instead of kept.
+     */
+    arith_uint& SetCompact(uint32_t nCompact, bool* pfNegative = nullptr, bool* pfOverflow = nullptr);
+    uint32_t    GetCompact(bool fNegative = false) const;
+};
+
+typedef arith_uint<256> arith_uint256;
+/** for the products of targets that don't fit in 256 bits, which CBigNum kept exact */
+typedef arith_uint<512> arith_uint512;
+
+uint256       ArithToUint256(const arith_uint256& a);
+arith_uint256 UintToArith256(const uint256& a);
+
+#endif // ARITH_UINT256_H
@@ -0,0 +1,227 @@
+#include "base58.h"
+
+#include "hash.h"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+
+static const char* pszBase58 = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+// the value of every base58 character, and -1 for the others
+static const int8_t mapBase58[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8, -1, -1, -1, -1, -1, -1,
+    -1,  9, 10, 11, 12, 13, 14, 15, 16, -1, 17, 18, 19, 20, 21, -1,
+    22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, -1, -1, -1, -1, -1,
+    -1, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, -1, 44, 45, 46,
+    47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+namespace {
+
+/**
+ * A buffer for the digits of a conversion, on the stack for the sizes of addresses and keys, which
+ * are all that's base58-encoded in practice, and on the heap beyond.
+ */
+class DigitBuffer
+{
+    std::array<unsigned char, 128> stackDigits;
+    std::vector<unsigned char>     heapDigits;
+    unsigned char*                 digits;
+
+public:
+    explicit DigitBuffer(std::size_t nSize)
+    {
+        if (nSize <= stackDigits.size()) {
+            digits = stackDigits.data();
+        } else {
+            heapDigits.resize(nSize);
+            digits = heapDigits.data();
+        }
+        std::memset(digits, 0, nSize);
+    }
+
+    DigitBuffer(const DigitBuffer&) = delete;
+    DigitBuffer& operator=(const DigitBuffer&) = delete;
+
+    unsigned char* data() { return digits; }
+};
+
+/**
+ * Converts a big-endian number, fed in parts, to base58. The digits are kept big-endian at the end
+ * of the buffer, and every byte of the input multiplies them by 256 and adds itself.
+ */
+class Base58Encoder
+{
+    const std::size_t nCapacity;
+    DigitBuffer       buffer;
+    std::size_t       nLength  = 0;
+    std::size_t       nZeroes  = 0;
+    bool              fLeading = true;
+
+public:
+    explicit Base58Encoder(std::size_t nInputSize)
+        : nCapacity(nInputSize * 138 / 100 + 1), // log(256) / log(58), rounded up
+          buffer(nCapacity)
+    {
+    }
+
+    void Write(const unsigned char* pbegin, const unsigned char* pend)
+    {
+        unsigned char* const b58 = buffer.data();
+        for (const unsigned char* p = pbegin; p != pend; p++) {
+            // leading zeroes are encoded as base58 zeroes, each on its own
+            if (fLeading && *p == 0) {
+                nZeroes++;
+                continue;
+            }
+            fLeading = false;
+
+            int         carry = *p;
+            std::size_t i     = 0;
+            for (unsigned char* it = b58 + nCapacity; (carry != 0 || i < nLength) && it != b58;
+                 i++) {
+                --it;
+                carry += 256 * (*it);
+                *it   = carry % 58;
+                carry /= 58;
+            }
+            assert(carry == 0);
+            nLength = i;
+        }
+    }
+
+    std::string Finish()
+    {
+        const unsigned char* const b58 = buffer.data();
+        const unsigned char*       it  = b58 + (nCapacity - nLength);
+        while (it != b58 + nCapacity && *it == 0)
+            it++;
+        std::string str;
+        str.reserve(nZeroes + (b58 + nCapacity - it));
+        str.assign(nZeroes, pszBase58[0]);
+        for (; it != b58 + nCapacity; it++)
+            str += pszBase58[*it];
+        return str;
+    }
+};
+
+} // namespace
+
+std::string EncodeBase58(const unsigned char* pbegin, const unsigned char* pend)
+{
+    Base58Encoder encoder(pend - pbegin);
+    encoder.Write(pbegin, pend);
+    return encoder.Finish();
+}
+
+std::string EncodeBase58(const std::vector<unsigned char>& vch)
+{
+    return EncodeBase58(vch.data(), vch.data() + vch.size());
+}
+
+bool DecodeBase58(const char* psz, std::vector<unsigned char>& vchRet)
+{
+    vchRet.clear();
+    while (isspace(*psz))
+        psz++;
+
+    // Leading base58 zeroes are decoded as zero bytes, each on its own
+    std::size_t nZeroes = 0;
+    while (*psz == pszBase58[0]) {
+        nZeroes++;
+        psz++;
+    }
+
+    // The bytes are kept big-endian at the end of the buffer, and every character multiplies them by
+    // 58 and adds its value
+    const std::size_t nCapacity = std::strlen(psz) * 733 / 1000 + 1; // log(58) / log(256), rounded up
+    DigitBuffer       buffer(nCapacity);
+    unsigned char*    b256    = buffer.data();
+    std::size_t       nLength = 0;
+    for (; *psz && !isspace(*psz); psz++) {
+        int carry = mapBase58[static_cast<uint8_t>(*psz)];
+        if (carry == -1)
+            return false;
+        std::size_t i = 0;
+        for (unsigned char* it = b256 + nCapacity; (carry != 0 || i < nLength) && it != b256; i++) {
+            --it;
+            carry += 58 * (*it);
+            *it   = carry % 256;
+            carry /= 256;
+        }
+        assert(carry == 0);
+        nLength = i;
+    }
+    while (isspace(*psz))
+        psz++;
+    if (*psz != '\0')
+        return false;
+
+    const unsigned char* it = b256 + (nCapacity - nLength);
+    while (it != b256 + nCapacity && *it == 0)
+        it++;
+    vchRet.reserve(nZeroes + (b256 + nCapacity - it));
+    vchRet.assign(nZeroes, 0x00);
+    vchRet.insert(vchRet.end(), it, static_cast<const unsigned char*>(b256 + nCapacity));
+    return true;
+}
+
+bool DecodeBase58(const std::string& str, std::vector<unsigned char>& vchRet)
+{
+    return DecodeBase58(str.c_str(), vchRet);
+}
+
+std::string EncodeBase58Check(const std::vector<unsigned char>& vchIn)
+{
+    // add 4-byte hash check to the end
+    const uint256 hash = Hash(vchIn.begin(), vchIn.end());
+    Base58Encoder encoder(vchIn.size() + 4);
+    encoder.Write(vchIn.data(), vchIn.data() + vchIn.size());
+    encoder.Write(hash.begin(), hash.begin() + 4);
+    return encoder.Finish();
+}
+
+std::string EncodeBase58Check(unsigned char nVersion, const std::vector<unsigned char>& vchIn)
+{
+    const unsigned char* pversion = &nVersion;
+    const uint256 hash = Hash(pversion, pversion + 1, vchIn.data(), vchIn.data() + vchIn.size());
+    Base58Encoder encoder(1 + vchIn.size() + 4);
+    encoder.Write(pversion, pversion + 1);
+    encoder.Write(vchIn.data(), vchIn.data() + vchIn.size());
+    encoder.Write(hash.begin(), hash.begin() + 4);
+    return encoder.Finish();
+}
+
+bool DecodeBase58Check(const char* psz, std::vector<unsigned char>& vchRet)
+{
+    if (!DecodeBase58(psz, vchRet))
+        return false;
+    if (vchRet.size() < 4) {
+        vchRet.clear();
+        return false;
+    }
+    uint256 hash = Hash(vchRet.begin(), vchRet.end() - 4);
+    if (memcmp(&hash, &vchRet.end()[-4], 4) != 0) {
+        vchRet.clear();
+        return false;
+    }
+    vchRet.resize(vchRet.size() - 4);
+    return true;
+}
+
+bool DecodeBase58Check(const std::string& str, std::vector<unsigned char>& vchRet)
+{
+    return DecodeBase58Check(str.c_str(), vchRet);
+}
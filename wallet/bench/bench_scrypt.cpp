@@ -0,0 +1,59 @@
+#include "scrypt.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/**
+ * Measures the scrypt block header hash throughput of every batch kernel the CPU supports, on a
+ * single thread, so the numbers are hashes per second per core.
+ *
+ * usage: bench_scrypt [headers per batch] [seconds per kernel]
+ */
+int main(int argc, char* argv[])
+{
+    const unsigned batchSize = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 2000;
+    const double   seconds   = argc > 2 ? std::atof(argv[2]) : 3.;
+    if (batchSize == 0 || seconds <= 0) {
+        std::fprintf(stderr, "usage: %s [headers per batch] [seconds per kernel]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<unsigned char> headers(batchSize * 80);
+    for (std::size_t i = 0; i < headers.size(); i++) {
+        headers[i] = static_cast<unsigned char>(i * 2654435761u >> 13);
+    }
+    std::vector<const void*> inputs(batchSize);
+    for (unsigned i = 0; i < batchSize; i++) {
+        inputs[i] = &headers[i * 80];
+    }
+    std::vector<uint256> outputs(batchSize);
+
+    std::printf("best kernel: %s\n", scrypt_batch_kernel_name(scrypt_best_batch_kernel()));
+
+    const ScryptBatchKernel kernels[] = {ScryptBatchKernel::Single, ScryptBatchKernel::SSE2,
+                                         ScryptBatchKernel::AVX2};
+    for (ScryptBatchKernel kernel : kernels) {
+        if (!scrypt_batch_kernel_supported(kernel)) {
+            std::printf("%-10s not supported by this CPU\n", scrypt_batch_kernel_name(kernel));
+            continue;
+        }
+
+        // warm up the scratchpad and the caches
+        scrypt_blockhash_batch(kernel, inputs.data(), outputs.data(), std::min(batchSize, 16u));
+
+        const auto start   = std::chrono::steady_clock::now();
+        double     elapsed = 0;
+        uint64_t   nHashes = 0;
+        while (elapsed < seconds) {
+            scrypt_blockhash_batch(kernel, inputs.data(), outputs.data(), batchSize);
+            nHashes += batchSize;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        std::printf("%-10s %10.1f hashes/s\n", scrypt_batch_kernel_name(kernel), nHashes / elapsed);
+    }
+    return 0;
+}
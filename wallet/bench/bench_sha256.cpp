@@ -0,0 +1,88 @@
+#include "sha256.h"
+
+#include <openssl/sha.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+/**
+ * Compares the SHA-256 implementations the CPU supports with OpenSSL, on a single thread: the
+ * streaming hash of a large buffer, and the double hash of 64-byte blobs that makes merkle trees.
+ *
+ * usage: bench_sha256 [seconds per measurement]
+ */
+
+static double Measure(double seconds, const std::function<std::size_t()>& run)
+{
+    const auto  start   = std::chrono::steady_clock::now();
+    double      elapsed = 0;
+    std::size_t units   = 0;
+    while (elapsed < seconds) {
+        units += run();
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return units / elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+    const double seconds = argc > 1 ? std::atof(argv[1]) : 2.;
+    if (seconds <= 0) {
+        std::fprintf(stderr, "usage: %s [seconds per measurement]\n", argv[0]);
+        return 1;
+    }
+
+    const std::size_t          streamSize = 1 << 20;
+    const std::size_t          blobs      = 1024;
+    std::vector<unsigned char> data(streamSize);
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<unsigned char>(i * 2654435761u >> 13);
+    }
+    std::vector<unsigned char> out(32 * blobs);
+
+    std::printf("%-28s %12s %16s\n", "implementation", "stream MB/s", "64-byte dhash/s");
+
+    const double opensslStream = Measure(seconds, [&]() {
+        SHA256(data.data(), streamSize, out.data());
+        return streamSize;
+    });
+    const double opensslD64 = Measure(seconds, [&]() {
+        unsigned char hash1[32];
+        for (std::size_t i = 0; i < blobs; i++) {
+            SHA256(data.data() + 64 * i, 64, hash1);
+            SHA256(hash1, 32, out.data() + 32 * i);
+        }
+        return blobs;
+    });
+    std::printf("%-28s %12.1f %16.0f\n", "openssl SHA256()", opensslStream / 1e6, opensslD64);
+
+    const Sha256Implementation impls[] = {Sha256Implementation::Generic, Sha256Implementation::OpenSSL,
+                                          Sha256Implementation::SSE41, Sha256Implementation::AVX2,
+                                          Sha256Implementation::SHANI};
+    for (Sha256Implementation impl : impls) {
+        if (!SHA256UseImplementation(impl)) {
+            std::printf("%-28s not supported by this CPU\n", Sha256ImplementationName(impl));
+            continue;
+        }
+        const double stream = Measure(seconds, [&]() {
+            CSHA256().Write(data.data(), streamSize).Finalize(out.data());
+            return streamSize;
+        });
+        const double d64 = Measure(seconds, [&]() {
+            SHA256D64(out.data(), data.data(), blobs);
+            return blobs;
+        });
+        std::printf("%-28s %12.1f %16.0f\n", Sha256ImplementationName(impl), stream / 1e6, d64);
+    }
+
+    const std::string autoDetected = SHA256AutoDetect();
+    const double      d64          = Measure(seconds, [&]() {
+        SHA256D64(out.data(), data.data(), blobs);
+        return blobs;
+    });
+    std::printf("%-28s %12s %16.0f\n", autoDetected.c_str(), "", d64);
+    return 0;
+}
@@ -6,8 +6,11 @@
 #include "bitcoinrpc.h"
 #include "base58.h"
 #include "db.h"
+#include "db/lmdb/lmdb.h"
 #include "init.h"
 #include "main.h"
+#include "rpcserver.h"
+#include "runtimeconfig.h"
 #include "sync.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -24,9 +27,17 @@
 #include <boost/foreach.hpp>
 #include <boost/iostreams/concepts.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <boost/scope_exit.hpp>
 #include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <list>
+#include <mutex>
 #include <thread>
 
 using namespace std;
@@ -259,116 +270,125 @@ Value uptime(const Array& params, bool fHelp)
 
 // clang-format off
 static const CRPCCommand vRPCCommands[] =
-{ //  name                         function                    safemd  unlocked
-  //  ------------------------     -----------------------     ------  --------
-    { "help",                      &help,                      true,   true  },
-    { "stop",                      &stop,                      true,   true  },
-    { "uptime",                    &uptime,                    false,  false },
-    { "getbestblockhash",          &getbestblockhash,          true,   false },
-    { "getblockcount",             &getblockcount,             true,   false },
-    { "waitforblockheight",        &waitforblockheight,        true,   false },
-    { "getconnectioncount",        &getconnectioncount,        true,   false },
-    { "addnode",                   &addnode,                   true,   false },
-    { "disconnectnode",            &disconnectnode,            true,   false },
-    { "setmocktime",               &setmocktime,               false,  false },
-    { "getpeerinfo",               &getpeerinfo,               true,   false },
-    { "getdifficulty",             &getdifficulty,             true,   false },
-    { "getinfo",                   &getinfo,                   true,   false },
-    { "getsubsidy",                &getsubsidy,                true,   false },
-    { "getmininginfo",             &getmininginfo,             true,   false },
-    { "getstakinginfo",            &getstakinginfo,            true,   false },
-    { "getnewaddress",             &getnewaddress,             true,   false },
-    { "udtoneblioaddress",         &udtoneblioaddress,         true,   false },
-    { "getnewpubkey",              &getnewpubkey,              true,   false },
-    { "getaccountaddress",         &getaccountaddress,         true,   false },
-    { "delegatestake",             &delegatestake,             true,   false },
-    { "listdelegators",            &listdelegators,            true,   false },
-    { "delegatoradd",              &delegatoradd,              true,   false },
-    { "liststakingaddresses",      &liststakingaddresses,      true,   false },
-    { "delegatorremove",           &delegatorremove,           true,   false },
-    { "rawdelegatestake",          &rawdelegatestake,          true,   false },
-    { "listcoldutxos",             &listcoldutxos,             true,   false },
-    { "setaccount",                &setaccount,                true,   false },
-    { "getaccount",                &getaccount,                false,  false },
-    { "getaddressesbyaccount",     &getaddressesbyaccount,     true,   false },
-    { "sendtoaddress",             &sendtoaddress,             false,  false },
-    { "sendntp1toaddress",         &sendntp1toaddress,         false,  false },
-    { "getreceivedbyaddress",      &getreceivedbyaddress,      false,  false },
-    { "getreceivedbyaccount",      &getreceivedbyaccount,      false,  false },
-    { "listreceivedbyaddress",     &listreceivedbyaddress,     false,  false },
-    { "listreceivedbyaccount",     &listreceivedbyaccount,     false,  false },
-    { "backupwallet",              &backupwallet,              true,   false },
-    { "keypoolrefill",             &keypoolrefill,             true,   false },
-    { "getwalletinfo",             &getwalletinfo,             true,   false },
-    { "getrawchangeaddress",       &getrawchangeaddress,       true,   false },
-    { "walletpassphrase",          &walletpassphrase,          true,   false },
-    { "walletpassphrasechange",    &walletpassphrasechange,    false,  false },
-    { "walletlock",                &walletlock,                true,   false },
-    { "encryptwallet",             &encryptwallet,             false,  false },
-    { "validateaddress",           &validateaddress,           true,   false },
-    { "validatepubkey",            &validatepubkey,            true,   false },
-    { "getbalance",                &getbalance,                false,  false },
-    { "getdelegatedbalance",       &getdelegatedbalance,       false,  false },
-    { "getcoldstakingbalance",     &getcoldstakingbalance,     false,  false },
-    { "getbalance",                &getbalance,                false,  false },
-    { "getunconfirmedbalance",     &getunconfirmedbalance,     false,  false },
-    { "getntp1balances",           &getntp1balances,           false,  false },
-    { "getntp1balance",            &getntp1balance,            false,  false },
-    { "abandontransaction",        &abandontransaction,        false,  false },
-    { "move",                      &movecmd,                   false,  false },
-    { "sendfrom",                  &sendfrom,                  false,  false },
-    { "sendmany",                  &sendmany,                  false,  false },
-    { "addmultisigaddress",        &addmultisigaddress,        false,  false },
-    { "addredeemscript",           &addredeemscript,           false,  false },
-    { "getrawmempool",             &getrawmempool,             true,   false },
-    { "calculateblockhash",        &calculateblockhash,        false,  false },
-    { "gettxout",                  &gettxout,                  false,  false },
-    { "listvotes",                 &listvotes,                 false,  false },
-    { "castvote",                  &castvote,                  false,  false },
-    { "cancelallvotesofproposal",  &cancelallvotesofproposal,  false,  false },
-    { "getblock",                  &getblock,                  false,  false },
-    { "getblockbynumber",          &getblockbynumber,          false,  false },
-    { "getblockhash",              &getblockhash,              false,  false },
-    { "gettransaction",            &gettransaction,            false,  false },
-    { "listtransactions",          &listtransactions,          false,  false },
-    { "listaddressgroupings",      &listaddressgroupings,      false,  false },
-    { "signmessage",               &signmessage,               false,  false },
-    { "verifymessage",             &verifymessage,             false,  false },
-    { "getwork",                   &getwork,                   true,   false },
-    { "getworkex",                 &getworkex,                 true,   false },
-    { "listaccounts",              &listaccounts,              false,  false },
-    { "settxfee",                  &settxfee,                  false,  false },
-    { "getblocktemplate",          &getblocktemplate,          true,   false },
-    { "submitblock",               &submitblock,               false,  false },
-    { "generateblockwithkey",      &generateblockwithkey,      false,  false },
-    { "generatepos",               &generatepos,               false,  false },
-    { "generate",                  &generate,                  false,  false },
-    { "generatetoaddress",         &generatetoaddress,         false,  false },
-    { "listsinceblock",            &listsinceblock,            false,  false },
-    { "dumpprivkey",               &dumpprivkey,               false,  false },
-    { "dumppubkey",                &dumppubkey,                false,  false },
-    { "dumpwallet",                &dumpwallet,                true,   false },
-    { "importwallet",              &importwallet,              false,  false },
-    { "importprivkey",             &importprivkey,             false,  false },
-    { "decodentp1script",          &decodentp1script,          false,  false },
-    { "listunspent",               &listunspent,               false,  false },
-    { "getrawtransaction",         &getrawtransaction,         false,  false },
-    { "createrawtransaction",      &createrawtransaction,      false,  false },
-    { "createrawntp1transaction",  &createrawntp1transaction,  false,  false },
-    { "issuenewntp1token",         &issuenewntp1token,         false,  false },
-    { "decoderawtransaction",      &decoderawtransaction,      false,  false },
-    { "decodescript",              &decodescript,              false,  false },
-    { "getscriptpubkeyfromaddress",&getscriptpubkeyfromaddress,false,  false },
-    { "getscriptpubkeyforp2cs",    &getscriptpubkeyforp2cs,    false,  false },
-    { "signrawtransaction",        &signrawtransaction,        false,  false },
-    { "sendrawtransaction",        &sendrawtransaction,        false,  false },
-    { "reservebalance",            &reservebalance,            false,  true  },
-    { "resendtx",                  &resendtx,                  false,  true  },
-    { "makekeypair",               &makekeypair,               false,  true  },
-    { "exportblockchain",          &exportblockchain,          false,  false },
-    { "getblockchaininfo",         &getblockchaininfo,         false,  false },
-    { "getblockheader",            &getblockheader,            false,  false },
-    { "syncwithvalidationinterfacequeue", &syncwithvalidationinterfacequeue, true, false },
+{ //  name                         function                    safemd  unlocked  streamed  readonly
+  //  ------------------------     -----------------------     ------  --------  --------  --------
+    { "help",                      &help,                      true,   true,     false,    false },
+    { "stop",                      &stop,                      true,   true,     false,    false },
+    { "uptime",                    &uptime,                    false,  false,    false,    false },
+    { "getrpcstats",               &getrpcstats,               true,   true,     false,    false },
+    { "getlockstats",              &getlockstats,              true,   true,     false,    false },
+    { "getbestblockhash",          &getbestblockhash,          true,   false,    false,    true  },
+    { "getblockcount",             &getblockcount,             true,   false,    false,    true  },
+    { "waitforblockheight",        &waitforblockheight,        true,   false,    false,    false },
+    { "getconnectioncount",        &getconnectioncount,        true,   false,    false,    false },
+    { "addnode",                   &addnode,                   true,   false,    false,    false },
+    { "disconnectnode",            &disconnectnode,            true,   false,    false,    false },
+    { "setmocktime",               &setmocktime,               false,  false,    false,    false },
+    { "getpeerinfo",               &getpeerinfo,               true,   false,    false,    false },
+    { "getdifficulty",             &getdifficulty,             true,   false,    false,    true  },
+    { "getinfo",                   &getinfo,                   true,   false,    false,    false },
+    { "getsubsidy",                &getsubsidy,                true,   false,    false,    false },
+    { "getmininginfo",             &getmininginfo,             true,   false,    false,    false },
+    { "getstakinginfo",            &getstakinginfo,            true,   false,    false,    false },
+    { "getnewaddress",             &getnewaddress,             true,   false,    false,    false },
+    { "udtoneblioaddress",         &udtoneblioaddress,         true,   false,    false,    false },
+    { "getnewpubkey",              &getnewpubkey,              true,   false,    false,    false },
+    { "getaccountaddress",         &getaccountaddress,         true,   false,    false,    false },
+    { "delegatestake",             &delegatestake,             true,   false,    false,    false },
+    { "listdelegators",            &listdelegators,            true,   false,    false,    false },
+    { "delegatoradd",              &delegatoradd,              true,   false,    false,    false },
+    { "liststakingaddresses",      &liststakingaddresses,      true,   false,    false,    false },
+    { "delegatorremove",           &delegatorremove,           true,   false,    false,    false },
+    { "rawdelegatestake",          &rawdelegatestake,          true,   false,    false,    false },
+    { "listcoldutxos",             &listcoldutxos,             true,   false,    false,    false },
+    { "setaccount",                &setaccount,                true,   false,    false,    false },
+    { "getaccount",                &getaccount,                false,  false,    false,    false },
+    { "getaddressesbyaccount",     &getaddressesbyaccount,     true,   false,    false,    false },
+    { "sendtoaddress",             &sendtoaddress,             false,  false,    false,    false },
+    { "sendntp1toaddress",         &sendntp1toaddress,         false,  false,    false,    false },
+    { "getreceivedbyaddress",      &getreceivedbyaddress,      false,  false,    false,    false },
+    { "getreceivedbyaccount",      &getreceivedbyaccount,      false,  false,    false,    false },
+    { "listreceivedbyaddress",     &listreceivedbyaddress,     false,  false,    false,    false },
+    { "listreceivedbyaccount",     &listreceivedbyaccount,     false,  false,    false,    false },
+    { "backupwallet",              &backupwallet,              true,   false,    false,    false },
+    { "keypoolrefill",             &keypoolrefill,             true,   false,    false,    false },
+    { "getwalletinfo",             &getwalletinfo,             true,   false,    false,    false },
+    { "getrawchangeaddress",       &getrawchangeaddress,       true,   false,    false,    false },
+    { "walletpassphrase",          &walletpassphrase,          true,   false,    false,    false },
+    { "walletpassphrasechange",    &walletpassphrasechange,    false,  false,    false,    false },
+    { "walletlock",                &walletlock,                true,   false,    false,    false },
+    { "encryptwallet",             &encryptwallet,             false,  false,    false,    false },
+    { "validateaddress",           &validateaddress,           true,   false,    false,    true  },
+    { "validatepubkey",            &validatepubkey,            true,   false,    false,    true  },
+    { "getbalance",                &getbalance,                false,  false,    false,    false },
+    { "getdelegatedbalance",       &getdelegatedbalance,       false,  false,    false,    false },
+    { "getcoldstakingbalance",     &getcoldstakingbalance,     false,  false,    false,    false },
+    { "getbalance",                &getbalance,                false,  false,    false,    false },
+    { "getunconfirmedbalance",     &getunconfirmedbalance,     false,  false,    false,    false },
+    { "getntp1balances",           &getntp1balances,           false,  true,     false,    false },
+    { "getntp1balance",            &getntp1balance,            false,  true,     false,    false },
+    { "abandontransaction",        &abandontransaction,        false,  false,    false,    false },
+    { "move",                      &movecmd,                   false,  false,    false,    false },
+    { "sendfrom",                  &sendfrom,                  false,  false,    false,    false },
+    { "sendmany",                  &sendmany,                  false,  false,    false,    false },
+    { "addmultisigaddress",        &addmultisigaddress,        false,  false,    false,    false },
+    { "addredeemscript",           &addredeemscript,           false,  false,    false,    false },
+    { "getrawmempool",             &getrawmempool,             true,   false,    true,     true  },
+    { "calculateblockhash",        &calculateblockhash,        false,  false,    false,    true  },
+    { "gettxout",                  &gettxout,                  false,  false,    false,    true  },
+    { "listvotes",                 &listvotes,                 false,  false,    false,    false },
+    { "castvote",                  &castvote,                  false,  false,    false,    false },
+    { "cancelallvotesofproposal",  &cancelallvotesofproposal,  false,  false,    false,    false },
+    { "getblock",                  &getblock,                  false,  false,    true,     true  },
+    { "getblockbynumber",          &getblockbynumber,          false,  false,    true,     true  },
+    { "getblockhash",              &getblockhash,              false,  false,    false,    true  },
+    { "gettransaction",            &gettransaction,            false,  false,    false,    false },
+    { "listtransactions",          &listtransactions,          false,  false,    true,     false },
+    { "listaddressgroupings",      &listaddressgroupings,      false,  false,    false,    false },
+    { "signmessage",               &signmessage,               false,  false,    false,    false },
+    { "verifymessage",             &verifymessage,             false,  false,    false,    false },
+    { "getwork",                   &getwork,                   true,   false,    false,    false },
+    { "getworkex",                 &getworkex,                 true,   false,    false,    false },
+    { "listaccounts",              &listaccounts,              false,  false,    false,    false },
+    { "settxfee",                  &settxfee,                  false,  false,    false,    false },
+    { "getblocktemplate",          &getblocktemplate,          true,   false,    false,    false },
+    { "submitblock",               &submitblock,               false,  false,    false,    false },
+    { "generateblockwithkey",      &generateblockwithkey,      false,  false,    false,    false },
+    { "generatepos",               &generatepos,               false,  false,    false,    false },
+    { "generate",                  &generate,                  false,  false,    false,    false },
+    { "generatetoaddress",         &generatetoaddress,         false,  false,    false,    false },
+    { "listsinceblock",            &listsinceblock,            false,  false,    true,     false },
+    { "dumpprivkey",               &dumpprivkey,               false,  false,    false,    false },
+    { "dumppubkey",                &dumppubkey,                false,  false,    false,    false },
+    { "dumpwallet",                &dumpwallet,                true,   false,    false,    false },
+    { "importwallet",              &importwallet,              false,  false,    false,    false },
+    { "importprivkey",             &importprivkey,             false,  false,    false,    false },
+    { "decodentp1script",          &decodentp1script,          false,  false,    false,    true  },
+    { "listunspent",               &listunspent,               false,  false,    true,     false },
+    { "getrawtransaction",         &getrawtransaction,         false,  false,    false,    true  },
+    { "createrawtransaction",      &createrawtransaction,      false,  false,    false,    false },
+    { "createrawntp1transaction",  &createrawntp1transaction,  false,  false,    false,    false },
+    { "issuenewntp1token",         &issuenewntp1token,         false,  false,    false,    false },
+    { "decoderawtransaction",      &decoderawtransaction,      false,  false,    false,    true  },
+    { "decodescript",              &decodescript,              false,  false,    false,    true  },
+    { "getscriptpubkeyfromaddress",&getscriptpubkeyfromaddress,false,  false,    false,    false },
+    { "getscriptpubkeyforp2cs",    &getscriptpubkeyforp2cs,    false,  false,    false,    false },
+    { "signrawtransaction",        &signrawtransaction,        false,  false,    false,    false },
+    { "sendrawtransaction",        &sendrawtransaction,        false,  false,    false,    false },
+    { "reservebalance",            &reservebalance,            false,  true,     false,    false },
+    { "resendtx",                  &resendtx,                  false,  true,     false,    false },
+    { "makekeypair",               &makekeypair,               false,  true,     false,    false },
+    { "exportblockchain",          &exportblockchain,          false,  false,    false,    false },
+    { "getblockchaininfo",         &getblockchaininfo,         false,  false,    false,    false },
+    { "getblockheader",            &getblockheader,            false,  false,    false,    true  },
+    { "getaddresstxids",           &getaddresstxids,           false,  false,    true,     true  },
+    { "getaddressbalance",         &getaddressbalance,         false,  false,    false,    true  },
+    { "getaddressutxos",           &getaddressutxos,           false,  false,    true,     true  },
+    { "getntp1tokenholders",       &getntp1tokenholders,       false,  false,    true,     true  },
+    { "getntp1tokensupply",        &getntp1tokensupply,        false,  false,    false,    true  },
+    { "getntp1tokentransfers",     &getntp1tokentransfers,     false,  false,    true,     true  },
+    { "getntp1cacheinfo",          &getntp1cacheinfo,          true,   false,    false,    true  },
+    { "syncwithvalidationinterfacequeue", &syncwithvalidationinterfacequeue, true, false, false, false },
 };
 // clang-format on
 
@@ -428,6 +448,23 @@ string rfc1123Time()
     return string(buffer);
 }
 
+static const char* HTTPStatusText(int nStatus)
+{
+    if (nStatus == HTTP_OK)
+        return "OK";
+    else if (nStatus == HTTP_BAD_REQUEST)
+        return "Bad Request";
+    else if (nStatus == HTTP_FORBIDDEN)
+        return "Forbidden";
+    else if (nStatus == HTTP_NOT_FOUND)
+        return "Not Found";
+    else if (nStatus == HTTP_INTERNAL_SERVER_ERROR)
+        return "Internal Server Error";
+    else if (nStatus == HTTP_SERVICE_UNAVAILABLE)
+        return "Service Unavailable";
+    return "";
+}
+
 static string HTTPReply(int nStatus, const string& strMsg, bool keepalive)
 {
     if (nStatus == HTTP_UNAUTHORIZED)
@@ -448,19 +485,6 @@ static string HTTPReply(int nStatus, const string& strMsg, bool keepalive)
                            "<BODY><H1>401 Unauthorized.</H1></BODY>\r\n"
                            "</HTML>\r\n",
                            rfc1123Time(), FormatFullVersion());
-    const char* cStatus;
-    if (nStatus == HTTP_OK)
-        cStatus = "OK";
-    else if (nStatus == HTTP_BAD_REQUEST)
-        cStatus = "Bad Request";
-    else if (nStatus == HTTP_FORBIDDEN)
-        cStatus = "Forbidden";
-    else if (nStatus == HTTP_NOT_FOUND)
-        cStatus = "Not Found";
-    else if (nStatus == HTTP_INTERNAL_SERVER_ERROR)
-        cStatus = "Internal Server Error";
-    else
-        cStatus = "";
     return fmt::format("HTTP/1.1 {} {}\r\n"
                        "Date: {}\r\n"
                        "Connection: {}\r\n"
@@ -469,8 +493,85 @@ static string HTTPReply(int nStatus, const string& strMsg, bool keepalive)
                        "Server: neblio-json-rpc/{}\r\n"
                        "\r\n"
                        "{}",
-                       nStatus, cStatus, rfc1123Time(), keepalive ? "keep-alive" : "close",
-                       strMsg.size(), FormatFullVersion(), strMsg);
+                       nStatus, HTTPStatusText(nStatus), rfc1123Time(),
+                       keepalive ? "keep-alive" : "close", strMsg.size(), FormatFullVersion(), strMsg);
+}
+
+/**
+ * Output buffer that frames everything written through it as HTTP/1.1 chunks. Data is collected
+ * until RPC_CHUNK_SIZE bytes are pending, then sent as one chunk; finish() sends the rest and the
+ * terminating zero-length chunk.
+ */
+class ChunkedStreamBuf : public std::streambuf
+{
+    static const std::size_t RPC_CHUNK_SIZE = 64 * 1024;
+
+    std::ostream&     out;
+    std::vector<char> buffer;
+
+    void writeChunk()
+    {
+        const std::ptrdiff_t n = pptr() - pbase();
+        if (n > 0) {
+            out << std::hex << n << std::dec << "\r\n";
+            out.write(pbase(), n);
+            out << "\r\n";
+            pbump(static_cast<int>(-n));
+        }
+    }
+
+protected:
+    int_type overflow(int_type ch) override
+    {
+        writeChunk();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return out ? traits_type::not_eof(ch) : traits_type::eof();
+    }
+
+    int sync() override
+    {
+        writeChunk();
+        out.flush();
+        return out ? 0 : -1;
+    }
+
+public:
+    explicit ChunkedStreamBuf(std::ostream& stream) : out(stream), buffer(RPC_CHUNK_SIZE)
+    {
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+
+    void finish()
+    {
+        writeChunk();
+        out << "0\r\n\r\n" << std::flush;
+    }
+};
+
+void HTTPReplyChunked(std::ostream& stream, const Value& result, const Value& id, bool keepalive)
+{
+    stream << fmt::format("HTTP/1.1 {} {}\r\n"
+                          "Date: {}\r\n"
+                          "Connection: {}\r\n"
+                          "Transfer-Encoding: chunked\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Server: neblio-json-rpc/{}\r\n"
+                          "\r\n",
+                          HTTP_OK, HTTPStatusText(HTTP_OK), rfc1123Time(),
+                          keepalive ? "keep-alive" : "close", FormatFullVersion());
+
+    // same members and order as JSONRPCReplyObj(), without copying the result into a reply object
+    ChunkedStreamBuf chunked(stream);
+    std::ostream     os(&chunked);
+    os << "{\"result\":";
+    write_stream(result, os, false);
+    os << ",\"error\":null,\"id\":";
+    write_stream(id, os, false);
+    os << "}\n";
+    chunked.finish();
 }
 
 int ReadHTTPStatus(std::basic_istream<char>& stream, int& proto)
@@ -511,7 +612,39 @@ int ReadHTTPHeader(std::basic_istream<char>& stream, map<string, string>& mapHea
     return nLen;
 }
 
-int ReadHTTP(std::basic_istream<char>& stream, map<string, string>& mapHeadersRet, string& strMessageRet)
+static bool ReadHTTPChunkedBody(std::basic_istream<char>& stream, string& strMessageRet)
+{
+    while (true) {
+        string strSize;
+        if (!std::getline(stream, strSize))
+            return false;
+        // chunk extensions are allowed after the size and carry nothing we use
+        strSize = strSize.substr(0, strSize.find_first_of(";\r"));
+        boost::trim(strSize);
+        if (strSize.empty() || strSize.size() > 8 ||
+            strSize.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+            return false;
+        const unsigned long nChunk = strtoul(strSize.c_str(), nullptr, 16);
+        if (nChunk == 0)
+            break;
+        if (nChunk > MAX_SIZE - strMessageRet.size())
+            return false;
+
+        const std::size_t nOldSize = strMessageRet.size();
+        strMessageRet.resize(nOldSize + nChunk);
+        if (!stream.read(&strMessageRet[nOldSize], nChunk))
+            return false;
+        string strEnd;
+        std::getline(stream, strEnd);
+    }
+    // trailer headers, terminated by an empty line
+    map<string, string> mapTrailers;
+    ReadHTTPHeader(stream, mapTrailers);
+    return true;
+}
+
+int ReadHTTP(std::basic_istream<char>& stream, map<string, string>& mapHeadersRet, string& strMessageRet,
+             int* pnProtoRet)
 {
     mapHeadersRet.clear();
     strMessageRet = "";
@@ -519,6 +652,8 @@ int ReadHTTP(std::basic_istream<char>& stream, map<string, string>& mapHeadersRe
     // Read status
     int nProto  = 0;
     int nStatus = ReadHTTPStatus(stream, nProto);
+    if (pnProtoRet)
+        *pnProtoRet = nProto;
 
     // Read header
     int nLen = ReadHTTPHeader(stream, mapHeadersRet);
@@ -526,7 +661,10 @@ int ReadHTTP(std::basic_istream<char>& stream, map<string, string>& mapHeadersRe
         return HTTP_INTERNAL_SERVER_ERROR;
 
     // Read message
-    if (nLen > 0) {
+    if (boost::algorithm::icontains(mapHeadersRet["transfer-encoding"], "chunked")) {
+        if (!ReadHTTPChunkedBody(stream, strMessageRet))
+            return HTTP_INTERNAL_SERVER_ERROR;
+    } else if (nLen > 0) {
         vector<char> vch(nLen);
         stream.read(&vch[0], nLen);
         strMessageRet = string(vch.begin(), vch.end());
@@ -648,11 +786,15 @@ public:
         fNeedHandshake = false;
         stream.handshake(role);
     }
+    void setReadDeadline(int64_t nDeadlineMillis) { nReadDeadline = nDeadlineMillis; }
     std::streamsize read(char* s, std::streamsize n)
     {
         handshake(ssl::stream_base::server); // HTTPS servers read first
         if (fUseSSL)
             return stream.read_some(asio::buffer(s, n));
+        // a client that stops sending in the middle of a request is cut off, as if it closed
+        if (nReadDeadline > 0 && !WaitReadable())
+            return -1;
         return stream.next_layer().read_some(asio::buffer(s, n));
     }
     std::streamsize write(const char* s, std::streamsize n)
@@ -691,21 +833,37 @@ public:
     }
 
 private:
+    // returns false if nothing arrived before the read deadline
+    bool WaitReadable()
+    {
+        const SOCKET hSocket = stream.next_layer().native_handle();
+        while (true) {
+            const int64_t nRemaining = nReadDeadline - GetTimeMillis();
+            if (nRemaining <= 0)
+                return false;
+
+            struct timeval timeout;
+            timeout.tv_sec  = nRemaining / 1000;
+            timeout.tv_usec = (nRemaining % 1000) * 1000;
+
+            fd_set fdset;
+            FD_ZERO(&fdset);
+            FD_SET(hSocket, &fdset);
+            const int nRet = select(hSocket + 1, &fdset, NULL, NULL, &timeout);
+            if (nRet == 0)
+                return false;
+            // errors are left to the read that follows
+            if (nRet > 0 || WSAGetLastError() != WSAEINTR)
+                return true;
+        }
+    }
+
     bool                                          fNeedHandshake;
     bool                                          fUseSSL;
+    int64_t                                       nReadDeadline = 0;
     asio::ssl::stream<typename Protocol::socket>& stream;
 };
 
-class AcceptedConnection
-{
-public:
-    virtual ~AcceptedConnection() {}
-
-    virtual std::iostream& stream()                       = 0;
-    virtual std::string    peer_address_to_string() const = 0;
-    virtual void           close()                        = 0;
-};
-
 // Although this "Executor" can be an ExecutionContext, we use this just for backward compatibility with
 // older boost versions
 template <typename Protocol, typename Executor>
@@ -713,7 +871,7 @@ class AcceptedConnectionImpl : public AcceptedConnection
 {
 public:
     AcceptedConnectionImpl(Executor& io_service, ssl::context& context, bool fUseSSL)
-        : sslStream(io_service, context), _d(sslStream, fUseSSL), _stream(_d)
+        : sslStream(io_service, context), idleTimer(io_service), _d(sslStream, fUseSSL), _stream(_d)
     {
     }
 
@@ -723,15 +881,51 @@ public:
 
     virtual void close() { _stream.close(); }
 
+    // the stream works on its own copy of the device
+    virtual void set_read_deadline(int64_t nDeadlineMillis)
+    {
+        _stream->setReadDeadline(nDeadlineMillis);
+    }
+
+    virtual void async_wait_readable(int64_t nTimeoutSeconds, ReadableHandler handler)
+    {
+        // the timer's handler holds on to the connection through the copy of handler, and both
+        // handlers run in the thread of the I/O service; once the client sent something, the socket
+        // may be in use by a worker, so a timer that expired just then must leave it alone
+        fWaitingReadable = true;
+        idleTimer.expires_from_now(boost::posix_time::seconds(nTimeoutSeconds));
+        idleTimer.async_wait([this, handler](const boost::system::error_code& error) {
+            (void)handler;
+            if (!error && fWaitingReadable) {
+                boost::system::error_code ec;
+                sslStream.lowest_layer().cancel(ec);
+            }
+        });
+        ReadableHandler onReadable = [this, handler](const boost::system::error_code& error) {
+            fWaitingReadable = false;
+            boost::system::error_code ec;
+            idleTimer.cancel(ec);
+            handler(error);
+        };
+#if BOOST_VERSION >= 106600
+        sslStream.lowest_layer().async_wait(Protocol::socket::wait_read, onReadable);
+#else
+        sslStream.lowest_layer().async_read_some(asio::null_buffers(),
+                                                 boost::bind(onReadable, asio::placeholders::error));
+#endif
+    }
+
     typename Protocol::endpoint                  peer;
     asio::ssl::stream<typename Protocol::socket> sslStream;
+    asio::deadline_timer                         idleTimer;
 
 private:
+    bool                                           fWaitingReadable = false;
     SSLIOStreamDevice<Protocol>                    _d;
     iostreams::stream<SSLIOStreamDevice<Protocol>> _stream;
 };
 
-static bool InitRPCAuthentication()
+bool InitRPCAuthentication()
 {
     if (GetArg("-rpcpassword", "") == "") {
         NLog.write(b_sev::info, "No rpcpassword set - using random cookie authentication");
@@ -768,7 +962,129 @@ void ThreadRPCServer()
     NLog.write(b_sev::info, "ThreadRPCServer exited");
 }
 
-void ThreadRPCServer3(boost::shared_ptr<AcceptedConnection> conn);
+bool RPCWorkQueue::Enqueue(const boost::shared_ptr<AcceptedConnection>& conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (queue.size() >= nMaxDepth) {
+            nRejected++;
+            return false;
+        }
+        queue.push_back(conn);
+    }
+    cond.notify_one();
+    return true;
+}
+
+bool RPCWorkQueue::Dequeue(boost::shared_ptr<AcceptedConnection>& conn)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (queue.empty() && !fInterrupted && !fShutdown) {
+        cond.wait_for(lock, std::chrono::milliseconds(200));
+    }
+    if (queue.empty()) {
+        return false;
+    }
+    conn = queue.front();
+    queue.pop_front();
+    return true;
+}
+
+void RPCWorkQueue::Interrupt()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fInterrupted = true;
+        queue.clear();
+    }
+    cond.notify_all();
+}
+
+Object RPCWorkQueue::ToJSON() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    Object                      obj;
+    obj.push_back(Pair("queue_depth", static_cast<int64_t>(queue.size())));
+    obj.push_back(Pair("queue_capacity", static_cast<int64_t>(nMaxDepth)));
+    obj.push_back(Pair("rejected", static_cast<int64_t>(nRejected)));
+    return obj;
+}
+
+bool RPCBatchPool::Pop(std::function<void()>& task)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (tasks.empty() && !fInterrupted && !fShutdown) {
+        cond.wait_for(lock, std::chrono::milliseconds(200));
+    }
+    if (tasks.empty()) {
+        return false;
+    }
+    task = std::move(tasks.front());
+    tasks.pop_front();
+    return true;
+}
+
+void RPCBatchPool::Post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        tasks.push_back(std::move(task));
+    }
+    cond.notify_one();
+}
+
+void RPCBatchPool::Interrupt()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fInterrupted = true;
+    }
+    cond.notify_all();
+}
+
+void RPCBatchPool::ThreadRPCBatch(std::shared_ptr<RPCBatchPool> pool)
+{
+    RenameThread("neblio-rpcbatch");
+
+    std::function<void()> task;
+    while (pool->Pop(task)) {
+        task();
+    }
+}
+
+static std::shared_ptr<RPCWorkQueue> rpcWorkQueue;
+static std::shared_ptr<RPCBatchPool> rpcBatchPool;
+static boost::atomic<int>            nRPCWorkers{0};
+static int                           nRPCBatchConcurrency = 1;
+static int64_t                       nRPCServerTimeout    = DEFAULT_RPC_SERVER_TIMEOUT;
+
+void RPCEnqueueConnection(const std::shared_ptr<RPCWorkQueue>&         workQueue,
+                          const boost::shared_ptr<AcceptedConnection>& conn)
+{
+    if (!workQueue || !workQueue->Enqueue(conn)) {
+        NLog.write(b_sev::warn, "RPC work queue is full, rejecting request from {}",
+                   conn->peer_address_to_string());
+        try {
+            conn->stream() << HTTPReply(HTTP_SERVICE_UNAVAILABLE, "", false) << std::flush;
+        } catch (std::exception&) {
+        }
+        conn->close();
+    }
+}
+
+// A worker only gets the connection once there's something to read, so that clients that connect and
+// send nothing don't tie up the workers; the ones that stay silent past the timeout are closed
+static void RPCEnqueueWhenReadable(const std::shared_ptr<RPCWorkQueue>&         workQueue,
+                                   const boost::shared_ptr<AcceptedConnection>& conn)
+{
+    conn->async_wait_readable(nRPCServerTimeout,
+                              [workQueue, conn](const boost::system::error_code& error) {
+                                  if (error || fShutdown)
+                                      conn->close();
+                                  else
+                                      RPCEnqueueConnection(workQueue, conn);
+                              });
+}
 
 // Forward declaration required for RPCListen
 template <typename Protocol>
@@ -843,9 +1159,9 @@ static void RPCAcceptHandler(boost::shared_ptr<basic_socket_acceptor<Protocol>>
             conn->stream() << HTTPReply(HTTP_FORBIDDEN, "", false) << std::flush;
     }
 
-    // start HTTP client thread
-    else if (!NewThread(ThreadRPCServer3, conn)) {
-        NLog.write(b_sev::err, "Failed to create RPC server client thread");
+    // hand the connection to the worker threads once the client sends its request
+    else {
+        RPCEnqueueWhenReadable(rpcWorkQueue, conn);
     }
 
     vnThreadsRunning[THREAD_RPCLISTENER]--;
@@ -862,6 +1178,31 @@ void ThreadRPCServer2()
 
     const bool fUseSSL = false; // SSL disabled
 
+    nRPCServerTimeout = std::max<int64_t>(1, GetArg("-rpcservertimeout", DEFAULT_RPC_SERVER_TIMEOUT));
+
+    std::shared_ptr<RPCWorkQueue> workQueue = std::make_shared<RPCWorkQueue>(
+        std::max<int>(1, GetArg("-rpcworkqueue", DEFAULT_RPC_WORK_QUEUE)));
+    rpcWorkQueue = workQueue;
+    const int nWorkers = std::max<int>(1, GetArg("-rpcthreads", DEFAULT_RPC_THREADS));
+    for (int i = 0; i < nWorkers; i++) {
+        if (!NewThread(ThreadRPCWorker, workQueue)) {
+            NLog.write(b_sev::err, "Failed to create RPC worker thread");
+        }
+    }
+    NLog.write(b_sev::info, "RPC server started {} worker threads", nWorkers);
+
+    // the thread serving a batch is one of the threads executing it
+    nRPCBatchConcurrency = GetArg("-rpcbatchconcurrency", 0);
+    if (nRPCBatchConcurrency <= 0)
+        nRPCBatchConcurrency = std::max<int>(1, std::thread::hardware_concurrency());
+    std::shared_ptr<RPCBatchPool> batchPool = std::make_shared<RPCBatchPool>();
+    rpcBatchPool                            = batchPool;
+    for (int i = 0; i < nRPCBatchConcurrency - 1; i++) {
+        if (!NewThread(RPCBatchPool::ThreadRPCBatch, batchPool)) {
+            NLog.write(b_sev::err, "Failed to create RPC batch thread");
+        }
+    }
+
     // this is made static due to issues of possible race conditions when shutting down
     // the issue is probably caused by trying to clear/read the queue after having deleted the acceptor,
     // where the RPC request is also deleted
@@ -948,6 +1289,8 @@ void ThreadRPCServer2()
     if (!fRpcListening.load()) {
         uiInterface.ThreadSafeMessageBox(strerr, _("Error"),
                                          CClientUIInterface::OK | CClientUIInterface::MODAL);
+        workQueue->Interrupt();
+        batchPool->Interrupt();
         StartShutdown();
         return;
     }
@@ -957,6 +1300,8 @@ void ThreadRPCServer2()
         io_service.run_one();
     }
     vnThreadsRunning[THREAD_RPCLISTENER]++;
+    workQueue->Interrupt();
+    batchPool->Interrupt();
     StopRPCRequests.get()();
 }
 
@@ -1001,7 +1346,7 @@ void JSONRequest::parse(const Value& valRequest)
         throw JSONRPCError(RPC_INVALID_REQUEST, "Params must be an array");
 }
 
-static Object JSONRPCExecOne(const Value& req)
+Object JSONRPCExecOne(const Value& req)
 {
     Object rpc_result;
 
@@ -1020,18 +1365,142 @@ static Object JSONRPCExecOne(const Value& req)
     return rpc_result;
 }
 
-static string JSONRPCExecBatch(const Array& vReq)
+// Whether the element of a batch can run concurrently with the rest of the batch
+static bool IsReadOnlyRequest(const Value& req)
+{
+    if (req.type() != obj_type)
+        return false;
+    const Value& method = find_value(req.get_obj(), "method");
+    if (method.type() != str_type)
+        return false;
+    const CRPCCommand* pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->readonly;
+}
+
+void RPCBatchState::Work()
+{
+    while (true) {
+        const std::size_t i = nNext++;
+        if (i >= vResults.size())
+            return;
+        vResults[i] = JSONRPCExecOne(vReq[i]);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (++nDone == vResults.size())
+            cond.notify_all();
+    }
+}
+
+string JSONRPCExecBatch(const Array& vReq, const std::shared_ptr<RPCBatchPool>& batchPool,
+                        int nConcurrency)
 {
     Array ret;
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
 
+    // Only batches made entirely of read-only commands run in parallel, since later elements of a
+    // batch may rely on the effects of earlier ones
+    const bool fParallel = batchPool && nConcurrency > 1 && vReq.size() > 1 &&
+                           std::all_of(vReq.begin(), vReq.end(), IsReadOnlyRequest);
+    if (!fParallel) {
+        for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
+            ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+        return write_string(Value(ret), false) + "\n";
+    }
+
+    // helpers that get to run only after the batch is done find nothing left and just return, but
+    // they still need the state to be alive
+    std::shared_ptr<RPCBatchState> state    = std::make_shared<RPCBatchState>(vReq);
+    const std::size_t nHelpers = std::min<std::size_t>(nConcurrency, vReq.size()) - 1;
+    for (std::size_t i = 0; i < nHelpers; i++)
+        batchPool->Post([state]() { state->Work(); });
+    state->Work();
+    {
+        std::unique_lock<std::mutex> lock(state->mtx);
+        state->cond.wait(lock, [&state]() { return state->nDone == state->vResults.size(); });
+    }
+
+    ret.reserve(vReq.size());
+    for (Object& result : state->vResults)
+        ret.push_back(std::move(result));
     return write_string(Value(ret), false) + "\n";
 }
 
+bool ServeRPCRequest(AcceptedConnection& conn)
+{
+    map<string, string> mapHeaders;
+    string              strRequest;
+    int                 nProto = 0;
+
+    conn.set_read_deadline(GetTimeMillis() + nRPCServerTimeout * 1000);
+    ReadHTTP(conn.stream(), mapHeaders, strRequest, &nProto);
+    conn.set_read_deadline(0);
+
+    // Check authorization
+    if (mapHeaders.count("authorization") == 0) {
+        // there's nobody to answer if the client just closed a kept-alive connection
+        if (conn.stream().good())
+            conn.stream() << HTTPReply(HTTP_UNAUTHORIZED, "", false) << std::flush;
+        return false;
+    }
+    if (!HTTPAuthorized(mapHeaders)) {
+        NLog.write(b_sev::err, "ThreadRPCServer incorrect password attempt from {}",
+                   conn.peer_address_to_string());
+        /* Deter brute-forcing short passwords.
+           If this results in a DOS the user really
+           shouldn't have their RPC port exposed.*/
+        const std::string rpcPassword = mapArgs.get("-rpcpassword").value_or("");
+        if (rpcPassword.size() < 20)
+            MilliSleep(250);
+
+        conn.stream() << HTTPReply(HTTP_UNAUTHORIZED, "", false) << std::flush;
+        return false;
+    }
+    const bool fKeepAlive = mapHeaders["connection"] != "close" && !fShutdown;
+
+    JSONRequest jreq;
+    try {
+        // Parse request
+        Value valRequest;
+        if (!read_string(strRequest, valRequest))
+            throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
+
+        string strReply;
+
+        // singleton request
+        if (valRequest.type() == obj_type) {
+            jreq.parse(valRequest);
+
+            Value result = tableRPC.execute(jreq.strMethod, jreq.params);
+
+            // Large replies go out as they're serialized, for clients that understand chunks
+            const CRPCCommand* pcmd = tableRPC[jreq.strMethod];
+            if (pcmd && pcmd->streamed && nProto >= 1) {
+                HTTPReplyChunked(conn.stream(), result, jreq.id, fKeepAlive);
+                return fKeepAlive && conn.stream().good();
+            }
+
+            // Send reply
+            strReply = JSONRPCReply(result, Value::null, jreq.id);
+
+            // array of requests
+        } else if (valRequest.type() == array_type)
+            strReply = JSONRPCExecBatch(valRequest.get_array(), rpcBatchPool, nRPCBatchConcurrency);
+        else
+            throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
+
+        conn.stream() << HTTPReply(HTTP_OK, strReply, fKeepAlive) << std::flush;
+    } catch (Object& objError) {
+        ErrorReply(conn.stream(), objError, jreq.id);
+        return false;
+    } catch (std::exception& e) {
+        ErrorReply(conn.stream(), JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
+        return false;
+    }
+    return fKeepAlive && conn.stream().good();
+}
+
 static CCriticalSection cs_THREAD_RPCHANDLER;
 
-void ThreadRPCServer3(boost::shared_ptr<AcceptedConnection> conn)
+void ThreadRPCWorker(std::shared_ptr<RPCWorkQueue> workQueue)
 {
     // Make this thread recognisable as the RPC handler
     RenameThread("neblio-rpchand");
@@ -1040,81 +1509,174 @@ void ThreadRPCServer3(boost::shared_ptr<AcceptedConnection> conn)
         LOCK(cs_THREAD_RPCHANDLER);
         vnThreadsRunning[THREAD_RPCHANDLER]++;
     }
+    nRPCWorkers++;
 
-    bool fRun = true;
-    while (true) {
-        if (fShutdown || !fRun) {
+    boost::shared_ptr<AcceptedConnection> conn;
+    while (workQueue->Dequeue(conn)) {
+        bool fKeepAlive = false;
+        try {
+            fKeepAlive = ServeRPCRequest(*conn);
+        } catch (std::exception& e) {
+            NLog.write(b_sev::err, "RPC connection from {} failed: {}", conn->peer_address_to_string(),
+                       e.what());
+        }
+
+        if (!fKeepAlive || fShutdown) {
             conn->close();
-            {
-                LOCK(cs_THREAD_RPCHANDLER);
-                --vnThreadsRunning[THREAD_RPCHANDLER];
-            }
-            return;
+        } else if (conn->stream().rdbuf()->in_avail() > 0) {
+            // the next request is already buffered
+            RPCEnqueueConnection(workQueue, conn);
+        } else {
+            // wait for the next request without tying up this thread
+            RPCEnqueueWhenReadable(workQueue, conn);
         }
-        map<string, string> mapHeaders;
-        string              strRequest;
+        conn.reset();
+    }
 
-        ReadHTTP(conn->stream(), mapHeaders, strRequest);
+    nRPCWorkers--;
+    {
+        LOCK(cs_THREAD_RPCHANDLER);
+        vnThreadsRunning[THREAD_RPCHANDLER]--;
+    }
+}
 
-        // Check authorization
-        if (mapHeaders.count("authorization") == 0) {
-            conn->stream() << HTTPReply(HTTP_UNAUTHORIZED, "", false) << std::flush;
-            break;
-        }
-        if (!HTTPAuthorized(mapHeaders)) {
-            NLog.write(b_sev::err, "ThreadRPCServer incorrect password attempt from {}",
-                       conn->peer_address_to_string());
-            /* Deter brute-forcing short passwords.
-               If this results in a DOS the user really
-               shouldn't have their RPC port exposed.*/
-            const std::string rpcPassword = mapArgs.get("-rpcpassword").value_or("");
-            if (rpcPassword.size() < 20)
-                MilliSleep(250);
-
-            conn->stream() << HTTPReply(HTTP_UNAUTHORIZED, "", false) << std::flush;
-            break;
-        }
-        if (mapHeaders["connection"] == "close")
-            fRun = false;
+/** Per-method execution time histograms, reported by getrpcstats */
+class RPCLatencyStats
+{
+public:
+    // upper bounds of the histogram buckets, in milliseconds; one more bucket takes anything slower
+    static constexpr std::array<int64_t, 12> BUCKET_BOUNDS_MS{
+        {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000}};
 
-        JSONRequest jreq;
-        try {
-            // Parse request
-            Value valRequest;
-            if (!read_string(strRequest, valRequest))
-                throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
+    void Record(const std::string& strMethod, int64_t nMicros)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        MethodStats&                stats = mapStats[strMethod];
+        stats.nCalls++;
+        stats.nTotalMicros += nMicros;
+        stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+        std::size_t i    = 0;
+        while (i < BUCKET_BOUNDS_MS.size() && nMicros > BUCKET_BOUNDS_MS[i] * 1000)
+            i++;
+        stats.buckets[i]++;
+    }
 
-            string strReply;
+    Object ToJSON()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Object                      result;
+        for (const auto& p : mapStats) {
+            const MethodStats& stats = p.second;
+            Object             obj;
+            obj.push_back(Pair("calls", static_cast<int64_t>(stats.nCalls)));
+            obj.push_back(Pair("avg_ms", static_cast<double>(stats.nTotalMicros) / stats.nCalls / 1000.));
+            obj.push_back(Pair("max_ms", static_cast<double>(stats.nMaxMicros) / 1000.));
+            Object histogram;
+            for (std::size_t i = 0; i < BUCKET_BOUNDS_MS.size(); i++)
+                histogram.push_back(Pair(std::to_string(BUCKET_BOUNDS_MS[i]),
+                                         static_cast<int64_t>(stats.buckets[i])));
+            histogram.push_back(Pair("+Inf", static_cast<int64_t>(stats.buckets.back())));
+            obj.push_back(Pair("histogram_ms", histogram));
+            result.push_back(Pair(p.first, obj));
+        }
+        return result;
+    }
 
-            // singleton request
-            if (valRequest.type() == obj_type) {
-                jreq.parse(valRequest);
+private:
+    struct MethodStats
+    {
+        uint64_t                                        nCalls       = 0;
+        int64_t                                         nTotalMicros = 0;
+        int64_t                                         nMaxMicros   = 0;
+        std::array<uint64_t, BUCKET_BOUNDS_MS.size() + 1> buckets{};
+    };
+
+    std::mutex                         mtx;
+    std::map<std::string, MethodStats> mapStats;
+};
 
-                Value result = tableRPC.execute(jreq.strMethod, jreq.params);
+constexpr std::array<int64_t, 12> RPCLatencyStats::BUCKET_BOUNDS_MS;
 
-                // Send reply
-                strReply = JSONRPCReply(result, Value::null, jreq.id);
+static RPCLatencyStats rpcLatencyStats;
 
-                // array of requests
-            } else if (valRequest.type() == array_type)
-                strReply = JSONRPCExecBatch(valRequest.get_array());
-            else
-                throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
+Value getrpcstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getrpcstats\n"
+            "Returns the state of the RPC server's work queue and, for every method called since\n"
+            "startup, the number of calls and a histogram of execution times. A histogram bucket\n"
+            "counts the calls that took at most that many milliseconds and more than the previous\n"
+            "bucket's bound.\n");
+
+    Object obj;
+    obj.push_back(Pair("workers", nRPCWorkers.load()));
+    std::shared_ptr<RPCWorkQueue> workQueue = rpcWorkQueue;
+    if (workQueue) {
+        for (const Pair& p : workQueue->ToJSON())
+            obj.push_back(p);
+    }
+    obj.push_back(Pair("methods", rpcLatencyStats.ToJSON()));
+    return obj;
+}
 
-            conn->stream() << HTTPReply(HTTP_OK, strReply, fRun) << std::flush;
-        } catch (Object& objError) {
-            ErrorReply(conn->stream(), objError, jreq.id);
-            break;
-        } catch (std::exception& e) {
-            ErrorReply(conn->stream(), JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
-            break;
-        }
+static Object LockStatsHistogramToJSON(const std::vector<uint64_t>& histogram)
+{
+    Object result;
+    for (std::size_t i = 0; i < histogram.size(); i++) {
+        if (histogram[i] == 0)
+            continue;
+        const std::string bound =
+            i + 1 < histogram.size() ? "<" + std::to_string(uint64_t(1) << i) : "+Inf";
+        result.push_back(Pair(bound, static_cast<int64_t>(histogram[i])));
     }
+    return result;
+}
 
-    {
-        LOCK(cs_THREAD_RPCHANDLER);
-        vnThreadsRunning[THREAD_RPCHANDLER]--;
+Value getlockstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw runtime_error(
+            "getlockstats ( count reset )\n"
+            "Returns, when the node runs with -lockprofile, the lock sites of the source with the longest\n"
+            "total wait first: how many times they locked, how many of them had to wait for another\n"
+            "thread, and the wait and hold times in microseconds, with their histograms. A histogram\n"
+            "bucket counts the times below its bound and at least the previous one.\n"
+            "count is the number of sites to return (default: 50), and with reset true the\n"
+            "statistics start over after they're returned.\n");
+
+    const int64_t nCount = params.size() > 0 ? params[0].get_int64() : 50;
+    const bool    fReset = params.size() > 1 && params[1].get_bool();
+    if (nCount < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+
+    const std::vector<CLockSiteStats> stats = GetLockStats();
+    if (fReset)
+        ResetLockStats();
+
+    Array sites;
+    for (std::size_t i = 0; i < stats.size() && i < static_cast<uint64_t>(nCount); i++) {
+        const CLockSiteStats& s = stats[i];
+        Object                obj;
+        obj.push_back(Pair("site", s.file + ":" + std::to_string(s.line)));
+        obj.push_back(Pair("lock", s.name));
+        obj.push_back(Pair("shared", s.fShared));
+        obj.push_back(Pair("acquisitions", static_cast<int64_t>(s.nAcquisitions)));
+        obj.push_back(Pair("contended", static_cast<int64_t>(s.nContended)));
+        obj.push_back(Pair("try_failures", static_cast<int64_t>(s.nTryFailures)));
+        obj.push_back(Pair("wait_us", static_cast<int64_t>(s.nWaitMicros)));
+        obj.push_back(Pair("max_wait_us", static_cast<int64_t>(s.nMaxWaitMicros)));
+        obj.push_back(Pair("hold_us", static_cast<int64_t>(s.nHoldMicros)));
+        obj.push_back(Pair("max_hold_us", static_cast<int64_t>(s.nMaxHoldMicros)));
+        obj.push_back(Pair("wait_histogram_us", LockStatsHistogramToJSON(s.waitHistogram)));
+        obj.push_back(Pair("hold_histogram_us", LockStatsHistogramToJSON(s.holdHistogram)));
+        sites.push_back(obj);
     }
+
+    Object result;
+    result.push_back(Pair("enabled", LockStatsEnabled()));
+    result.push_back(Pair("sites", sites));
+    return result;
 }
 
 json_spirit::Value CRPCTable::execute(const std::string&        strMethod,
@@ -1129,16 +1691,29 @@ json_spirit::Value CRPCTable::execute(const std::string&        strMethod,
 
     // Observe safe mode
     string strWarning = GetWarnings("rpc");
-    if (strWarning != "" && !GetBoolArg("-disablesafemode") && !pcmd->okSafeMode)
+    if (strWarning != "" && !GetRuntimeConfig().fDisableSafeMode && !pcmd->okSafeMode)
         throw JSONRPCError(RPC_FORBIDDEN_BY_SAFE_MODE, string("Safe mode: ") + strWarning);
 
+    const auto start = std::chrono::steady_clock::now();
+    BOOST_SCOPE_EXIT(&strMethod, &start)
+    {
+        rpcLatencyStats.Record(strMethod, std::chrono::duration_cast<std::chrono::microseconds>(
+                                              std::chrono::steady_clock::now() - start)
+                                              .count());
+    }
+    BOOST_SCOPE_EXIT_END
+
     try {
         // Execute
         Value result;
         {
             if (pcmd->unlocked)
                 result = pcmd->actor(params, false);
-            else {
+            else if (pcmd->readonly) {
+                // a consistent view of the chain without blocking, or being blocked by, block connection
+                LMDBReadSnapshot snapshot;
+                result = pcmd->actor(params, false);
+            } else {
                 LOCK2(cs_main, pwalletMain->cs_wallet);
                 result = pcmd->actor(params, false);
             }
@@ -1254,6 +1829,10 @@ Array RPCConvertValues(const std::string& strMethod, const std::vector<std::stri
         ConvertTo<int64_t>(params[1]);
     if (strMethod == "stop" && n > 0)
         ConvertTo<bool>(params[0]);
+    if (strMethod == "getlockstats" && n > 0)
+        ConvertTo<int64_t>(params[0]);
+    if (strMethod == "getlockstats" && n > 1)
+        ConvertTo<bool>(params[1]);
     if (strMethod == "sendtoaddress" && n > 1)
         ConvertTo<double>(params[1]);
     if (strMethod == "sendntp1toaddress" && n > 1)
@@ -1403,6 +1982,32 @@ Array RPCConvertValues(const std::string& strMethod, const std::vector<std::stri
         ConvertTo<int>(params[3]);
     if (strMethod == "cancelallvotesofproposal" && n > 0)
         ConvertTo<int>(params[0]);
+    if (strMethod == "getaddresstxids" && n > 0 && !strParams[0].empty() && strParams[0][0] == '[')
+        ConvertTo<Array>(params[0]);
+    if (strMethod == "getaddresstxids" && n > 1)
+        ConvertTo<int>(params[1]);
+    if (strMethod == "getaddresstxids" && n > 2)
+        ConvertTo<int>(params[2]);
+    if (strMethod == "getaddressbalance" && n > 0 && !strParams[0].empty() && strParams[0][0] == '[')
+        ConvertTo<Array>(params[0]);
+    if (strMethod == "getaddressbalance" && n > 1)
+        ConvertTo<int>(params[1]);
+    if (strMethod == "getaddressbalance" && n > 2)
+        ConvertTo<int>(params[2]);
+    if (strMethod == "getaddressutxos" && n > 0 && !strParams[0].empty() && strParams[0][0] == '[')
+        ConvertTo<Array>(params[0]);
+    if (strMethod == "getaddressutxos" && n > 1)
+        ConvertTo<int>(params[1]);
+    if (strMethod == "getaddressutxos" && n > 2)
+        ConvertTo<int>(params[2]);
+    if (strMethod == "getntp1tokenholders" && n > 1)
+        ConvertTo<int>(params[1]);
+    if (strMethod == "getntp1tokentransfers" && n > 1)
+        ConvertTo<int>(params[1]);
+    if (strMethod == "getntp1tokentransfers" && n > 2)
+        ConvertTo<int>(params[2]);
+    if (strMethod == "getntp1tokentransfers" && n > 3)
+        ConvertTo<int>(params[3]);
 
     return params;
 }
@@ -31,6 +31,7 @@ enum HTTPStatusCode
     HTTP_FORBIDDEN             = 403,
     HTTP_NOT_FOUND             = 404,
     HTTP_INTERNAL_SERVER_ERROR = 500,
+    HTTP_SERVICE_UNAVAILABLE   = 503,
 };
  
 // Bitcoin RPC error codes
@@ -90,8 +91,25 @@ enum RPCErrorCode
 
 extern boost::atomic_bool fRpcListening;
 
+/** Default for -rpcthreads, the number of worker threads serving RPC requests */
+static const int DEFAULT_RPC_THREADS = 4;
+/** Default for -rpcworkqueue, the number of requests that may wait for a worker */
+static const int DEFAULT_RPC_WORK_QUEUE = 16;
+
 json_spirit::Object JSONRPCError(int code, const std::string& message);
 
+/** Reads an HTTP message; bodies sent with chunked transfer encoding are reassembled. */
+int ReadHTTP(std::basic_istream<char>& stream, std::map<std::string, std::string>& mapHeadersRet,
+             std::string& strMessageRet, int* pnProtoRet = nullptr);
+
+/**
+ * Writes a successful JSON-RPC reply as an HTTP/1.1 response with chunked transfer encoding.
+ * The result is serialized straight into the stream, so the reply is never held in memory as
+ * a whole and the client starts receiving it while the rest is still being written.
+ */
+void HTTPReplyChunked(std::ostream& stream, const json_spirit::Value& result,
+                      const json_spirit::Value& id, bool keepalive);
+
 void ThreadRPCServer();
 int  CommandLineRPC(int argc, char* argv[]);
 
@@ -125,6 +143,8 @@ public:
     rpcfn_type  actor;
     bool        okSafeMode;
     bool        unlocked;
+    bool        streamed; // the reply is serialized straight into the connection (chunked encoding)
+    bool        readonly; // only reads chain data, so it runs on a database snapshot without cs_main
 };
 
 /**
@@ -179,6 +199,10 @@ extern uint256                    ParseHashO(const json_spirit::Object& o, std::
 extern std::vector<unsigned char> ParseHexV(const json_spirit::Value& v, std::string strName);
 extern std::vector<unsigned char> ParseHexO(const json_spirit::Object& o, std::string strKey);
 
+// in bitcoinrpc.cpp
+extern json_spirit::Value getrpcstats(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getlockstats(const json_spirit::Array& params, bool fHelp);
+
 // in rpcnet.cpp
 extern json_spirit::Value getconnectioncount(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value addnode(const json_spirit::Array& params, bool fHelp);
@@ -296,6 +320,13 @@ extern json_spirit::Value waitforblockheight(const json_spirit::Array& params, b
 extern json_spirit::Value listvotes(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value castvote(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value cancelallvotesofproposal(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddresstxids(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressbalance(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressutxos(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getntp1tokenholders(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getntp1tokensupply(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getntp1tokentransfers(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getntp1cacheinfo(const json_spirit::Array& params, bool fHelp);
 
 std::vector<NTP1SendTokensOneRecipientData>
      GetNTP1RecipientsVector(const json_spirit::Value& sendTo, boost::shared_ptr<NTP1Wallet> ntp1wallet,
@@ -1,6 +1,8 @@
 #include "block.h"
 
 #include "NetworkForks.h"
+#include "addressindex.h"
+#include "blockencodings.h"
 #include "blockindex.h"
 #include "blockindexlrucache.h"
 #include "blocklocator.h"
@@ -10,6 +12,7 @@
 #include "main.h"
 #include "merkle.h"
 #include "ntp1/ntp1transaction.h"
+#include "ntp1tokenindex.h"
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -128,6 +131,18 @@ int64_t CBlock::GetBlockTime() const { return (int64_t)nTime; }
 
 uint256 CBlock::GetHash() const { return GetPoWHash(); }
 
+std::vector<uint256> CBlock::GetHashes(const std::vector<CBlock>& blocks)
+{
+    std::vector<const void*> inputs;
+    inputs.reserve(blocks.size());
+    for (const CBlock& block : blocks) {
+        inputs.push_back(CVOIDBEGIN(block.nVersion));
+    }
+    std::vector<uint256> result(blocks.size());
+    scrypt_blockhash_batch(inputs.data(), result.data(), inputs.size());
+    return result;
+}
+
 bool CBlock::IsNull() const { return (nBits == 0); }
 
 void CBlock::UpdateTime(const CBlockIndex* /*pindexPrev*/)
@@ -137,6 +152,12 @@ void CBlock::UpdateTime(const CBlockIndex* /*pindexPrev*/)
 
 bool CBlock::DisconnectBlock(CTxDB& txdb, const CBlockIndex& pindex)
 {
+    // this reads the spent outputs through the tx index, so it goes before disconnecting the inputs
+    if (fAddressIndex && !UndoAddressIndexChanges(txdb, vtx, pindex.nHeight))
+        return NLog.error("DisconnectBlock() : UndoAddressIndexChanges failed");
+    if (fNTP1Index && !UndoNTP1TokenIndex(txdb, vtx, pindex.nHeight))
+        return NLog.error("DisconnectBlock() : UndoNTP1TokenIndex failed");
+
     // Disconnect in reverse order
     for (int i = vtx.size() - 1; i >= 0; i--)
         if (!vtx[i].DisconnectInputs(txdb))
@@ -547,6 +568,9 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
     // this is used to prevent duplicate token names
     std::unordered_map<std::string, uint256> issuedTokensSymbolsInThisBlock;
 
+    AddressIndexEntries   addressIndex;
+    AddressUnspentEntries addressUnspentIndex;
+
     for (const CTransaction& tx : vtx) {
         const uint256 hashTx = tx.GetHash();
 
@@ -644,6 +668,10 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
             }
         }
 
+        if (fAddressIndex && !fJustCheck)
+            AppendAddressIndexChanges(txdb, tx, mapInputs, pindex->nHeight, addressIndex,
+                                      addressUnspentIndex);
+
         mapQueuedChanges[hashTx]          = CTxIndex(posThisTx, tx.vout.size());
         mapQueuedNTP1Inputs[tx.GetHash()] = inputsWithNTP1;
     }
@@ -716,6 +744,13 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
             return NLog.error("ConnectBlock() : UpdateTxIndex failed");
     }
 
+    if (fAddressIndex) {
+        if (!txdb.WriteAddressIndex(addressIndex))
+            return NLog.error("ConnectBlock() : WriteAddressIndex failed");
+        if (!txdb.UpdateAddressUnspentIndex(addressUnspentIndex))
+            return NLog.error("ConnectBlock() : UpdateAddressUnspentIndex failed");
+    }
+
     // This scope does NTP1 data writing
     {
         try {
@@ -734,6 +769,11 @@ bool CBlock::ConnectBlock(ITxDB& txdb, const boost::optional<CBlockIndex>& pinde
         }
     }
 
+    // the token index is built from the NTP1 transactions that were just written
+    if (fNTP1Index && Params().PassedFirstValidNTP1Tx(&txdb) &&
+        !WriteNTP1TokenIndex(txdb, vtx, pindex->nHeight))
+        return NLog.error("ConnectBlock() : WriteNTP1TokenIndex failed");
+
     // Update block index on disk without changing it in memory.
     // The memory index structure will be changed after the db commits.
     if (pindex->hashPrev != 0) {
@@ -1431,11 +1471,29 @@ bool CBlock::AcceptBlock(const CBlockIndex& prevBlockIndex, const uint256& block
     // Relay inventory, but don't relay old inventory during initial block download
     int nBlockEstimate = Checkpoints::GetTotalBlocksEstimate();
     if (txdb.GetBestBlockHash() == blockHash) {
+        const CInv inv(MSG_BLOCK, blockHash);
+        // built only if some peer wants new blocks announced with compact blocks
+        boost::optional<CBlockHeaderAndShortTxIDs> cmpctblock;
         LOCK(cs_vNodes);
-        for (CNode* pnode : vNodes)
-            if (txdb.GetBestChainHeight().value_or(0) >
+        for (CNode* pnode : vNodes) {
+            if (txdb.GetBestChainHeight().value_or(0) <=
                 (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
-                pnode->PushInventory(CInv(MSG_BLOCK, blockHash));
+                continue;
+            if (pnode->fAnnounceCompactBlocks && vtx.size() <= MAX_CMPCTBLOCK_TXS) {
+                bool fNew;
+                {
+                    LOCKN(pnode->cs_inventory, lockInv);
+                    fNew = pnode->setInventoryKnown.insert(inv).second;
+                }
+                if (!fNew)
+                    continue;
+                if (!cmpctblock)
+                    cmpctblock = CBlockHeaderAndShortTxIDs(*this);
+                pnode->PushMessage("cmpctblock", *cmpctblock);
+            } else {
+                pnode->PushInventory(inv);
+            }
+        }
     }
 
     return true;
@@ -1771,7 +1829,9 @@ void UpdateWallets(const uint256& prevBestChain, const ITxDB& txdb)
                     continue;
                 }
 
-                // Watch for transactions paying to me
+                // Watch for transactions paying to me; the wallet records of a block are written at
+                // once
+                CWalletsBatchScope walletsBatch;
                 for (CTransaction& tx : block.vtx) {
                     SyncWithWallets(txdb, tx, &block);
                 }
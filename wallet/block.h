@@ -95,6 +95,9 @@ public:
 
     uint256 GetPoWHash() const;
 
+    /** the hashes of many blocks at once, several headers at a time with the SIMD scrypt kernels */
+    static std::vector<uint256> GetHashes(const std::vector<CBlock>& blocks);
+
     int64_t GetBlockTime() const;
 
     void UpdateTime(const CBlockIndex* pindexPrev);
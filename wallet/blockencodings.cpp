@@ -0,0 +1,168 @@
+#include "blockencodings.h"
+
+#include "hash.h"
+#include "logging/logger.h"
+#include "txmempool.h"
+#include "util.h"
+#include "version.h"
+
+#include <openssl/sha.h>
+#include <unordered_map>
+
+CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block)
+    : nonce(GetRand(std::numeric_limits<uint64_t>::max())), header(block.GetBlockHeader())
+{
+    header.vchBlockSig = block.vchBlockSig;
+
+    FillShortTxIDSelector();
+
+    // the coinbase and the coinstake are never in the mempool of the peer
+    const std::size_t nPrefilled = block.IsProofOfStake() ? 2 : 1;
+    for (std::size_t i = 0; i < block.vtx.size(); i++) {
+        if (i < nPrefilled) {
+            PrefilledTransaction p;
+            p.index = static_cast<uint16_t>(i);
+            p.tx    = block.vtx[i];
+            prefilledtxn.push_back(p);
+        } else {
+            shorttxids.push_back(GetShortID(block.vtx[i].GetHash()));
+        }
+    }
+}
+
+void CBlockHeaderAndShortTxIDs::FillShortTxIDSelector() const
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    ::Serialize(stream, header, SER_NETWORK | SER_BLOCKHEADERONLY, PROTOCOL_VERSION);
+    stream << nonce;
+
+    uint256 shorttxidhash;
+    SHA256(reinterpret_cast<const unsigned char*>(&stream.begin()[0]), stream.size(),
+           reinterpret_cast<unsigned char*>(&shorttxidhash));
+    shorttxidk0 = shorttxidhash.Get64(0);
+    shorttxidk1 = shorttxidhash.Get64(1);
+}
+
+uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const
+{
+    static_assert(SHORTTXIDS_LENGTH == 6, "shorttxids calculation assumes 6-byte shorttxids");
+    return SipHashUint256(shorttxidk0, shorttxidk1, txhash) & 0xffffffffffffL;
+}
+
+PartiallyDownloadedBlock::ReadStatus
+PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const uint256& hash,
+                                   const CTxMemPool& pool)
+{
+    if (cmpctblock.header.IsNull() ||
+        (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
+        return ReadStatus::INVALID;
+    if (cmpctblock.BlockTxCount() > MAX_CMPCTBLOCK_TXS)
+        return ReadStatus::INVALID;
+
+    blockHash = hash;
+    header    = cmpctblock.header;
+    txnAvailable.assign(cmpctblock.BlockTxCount(), boost::none);
+    nPrefilled   = 0;
+    nFromMempool = 0;
+
+    for (const PrefilledTransaction& p : cmpctblock.prefilledtxn) {
+        if (p.index >= txnAvailable.size() || p.tx.IsNull())
+            return ReadStatus::INVALID;
+        txnAvailable[p.index] = p.tx;
+        nPrefilled++;
+    }
+
+    // the short ids fill the positions that aren't prefilled, in order
+    std::unordered_map<uint64_t, uint16_t> mapShortIds;
+    mapShortIds.reserve(cmpctblock.shorttxids.size());
+    {
+        std::size_t nIndex = 0;
+        for (uint64_t shortid : cmpctblock.shorttxids) {
+            while (txnAvailable[nIndex])
+                nIndex++;
+            mapShortIds[shortid] = static_cast<uint16_t>(nIndex);
+            nIndex++;
+        }
+    }
+    // two transactions of the block with the same short id; with 48-bit ids, this is practically
+    // only possible on purpose, and we couldn't tell which transaction goes where anyway
+    if (mapShortIds.size() != cmpctblock.shorttxids.size())
+        return ReadStatus::FAILED;
+
+    std::vector<bool> vCollided(txnAvailable.size(), false);
+    {
+        LOCK(pool.cs);
+        for (const auto& p : pool.mapTx) {
+            const auto it = mapShortIds.find(cmpctblock.GetShortID(p.first));
+            if (it == mapShortIds.end())
+                continue;
+            const uint16_t index = it->second;
+            if (vCollided[index])
+                continue;
+            if (!txnAvailable[index]) {
+                txnAvailable[index] = p.second;
+                nFromMempool++;
+            } else {
+                // two mempool transactions with the short id; ask the peer for the right one
+                txnAvailable[index] = boost::none;
+                vCollided[index]    = true;
+                nFromMempool--;
+            }
+            if (nFromMempool == cmpctblock.shorttxids.size())
+                break;
+        }
+    }
+
+    NLog.write(b_sev::debug,
+               "Initialized compact block {} with {} transactions: {} prefilled, {} from the mempool",
+               blockHash.ToString(), txnAvailable.size(), nPrefilled, nFromMempool);
+
+    return ReadStatus::OK;
+}
+
+bool PartiallyDownloadedBlock::IsTxAvailable(std::size_t index) const
+{
+    return index < txnAvailable.size() && txnAvailable[index];
+}
+
+std::vector<uint16_t> PartiallyDownloadedBlock::GetMissingIndexes() const
+{
+    std::vector<uint16_t> result;
+    for (std::size_t i = 0; i < txnAvailable.size(); i++) {
+        if (!txnAvailable[i])
+            result.push_back(static_cast<uint16_t>(i));
+    }
+    return result;
+}
+
+PartiallyDownloadedBlock::ReadStatus
+PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<CTransaction>& vtxMissing) const
+{
+    if (header.IsNull())
+        return ReadStatus::INVALID;
+
+    block = header;
+    block.vtx.clear();
+    block.vtx.reserve(txnAvailable.size());
+
+    std::size_t nMissingUsed = 0;
+    for (const boost::optional<CTransaction>& tx : txnAvailable) {
+        if (tx) {
+            block.vtx.push_back(*tx);
+        } else {
+            if (nMissingUsed >= vtxMissing.size())
+                return ReadStatus::INVALID;
+            block.vtx.push_back(vtxMissing[nMissingUsed++]);
+        }
+    }
+    if (nMissingUsed != vtxMissing.size())
+        return ReadStatus::INVALID;
+
+    // a mismatch can be caused by a short id collision with a mempool transaction, which isn't the
+    // peer's fault; the full block will tell
+    bool fMutated = false;
+    if (block.GetMerkleRoot(&fMutated) != header.hashMerkleRoot || fMutated)
+        return ReadStatus::FAILED;
+
+    return ReadStatus::OK;
+}
@@ -0,0 +1,254 @@
+#ifndef BLOCKENCODINGS_H
+#define BLOCKENCODINGS_H
+
+#include "block.h"
+#include "serialize.h"
+#include "transaction.h"
+#include "uint256.h"
+
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <ios>
+#include <limits>
+#include <vector>
+
+class CTxMemPool;
+
+// the version in "sendcmpct" messages: short ids are made of the transaction hashes
+static const uint64_t CMPCTBLOCKS_VERSION = 1;
+// getdata for a compact block older than this is answered with the full block
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+// getblocktxn for a block older than this is answered with the full block
+static const int MAX_BLOCKTXN_DEPTH = 10;
+// the number of peers we ask to announce new blocks to us with "cmpctblock" right away
+static const unsigned int MAX_CMPCTBLOCK_ANNOUNCERS = 3;
+// transaction indexes are 16-bit, blocks with more transactions are always sent in full
+static const unsigned int MAX_CMPCTBLOCK_TXS = 65536;
+
+/** Default for -compactblocks */
+static const bool DEFAULT_COMPACT_BLOCKS = true;
+
+struct PrefilledTransaction
+{
+    // the index in the block; differentially encoded on the wire
+    uint16_t     index;
+    CTransaction tx;
+};
+
+/**
+ * A block as sent in a "cmpctblock" message: the header and the block signature, the transactions
+ * that the peer can't have in its mempool (the coinbase and, for proof-of-stake blocks, the
+ * coinstake) and 6-byte short ids of all the others. The short ids are SipHash-2-4 of the transaction
+ * hash keyed by the SHA-256 of the header and a random nonce, so that collisions can't be made for
+ * all peers at once.
+ */
+class CBlockHeaderAndShortTxIDs
+{
+    mutable uint64_t shorttxidk0 = 0;
+    mutable uint64_t shorttxidk1 = 0;
+    uint64_t         nonce       = 0;
+
+    void FillShortTxIDSelector() const;
+
+public:
+    static const int SHORTTXIDS_LENGTH = 6;
+
+    // the header fields and vchBlockSig, without the transactions
+    CBlock                            header;
+    std::vector<uint64_t>             shorttxids;
+    std::vector<PrefilledTransaction> prefilledtxn;
+
+    CBlockHeaderAndShortTxIDs() = default;
+    explicit CBlockHeaderAndShortTxIDs(const CBlock& block);
+
+    uint64_t    GetShortID(const uint256& txhash) const;
+    std::size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
+
+    _Pragma(NEBLIO_DIAGNOSTIC_PUSH);
+    _Pragma(NEBLIO_HIDE_SHADOW_WARNING);
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        unsigned int nSize = ::GetSerializeSize(header, nType | SER_BLOCKHEADERONLY, nVersion) +
+                             ::GetSerializeSize(header.vchBlockSig, nType, nVersion) +
+                             sizeof(nonce) + GetSizeOfCompactSize(shorttxids.size()) +
+                             shorttxids.size() * SHORTTXIDS_LENGTH +
+                             GetSizeOfCompactSize(prefilledtxn.size());
+        int lastIndex = -1;
+        for (const PrefilledTransaction& p : prefilledtxn) {
+            nSize += GetSizeOfCompactSize(p.index - lastIndex - 1) +
+                     ::GetSerializeSize(p.tx, nType, nVersion);
+            lastIndex = p.index;
+        }
+        return nSize;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, header, nType | SER_BLOCKHEADERONLY, nVersion);
+        ::Serialize(s, header.vchBlockSig, nType, nVersion);
+        ::Serialize(s, nonce, nType, nVersion);
+        WriteCompactSize(s, shorttxids.size());
+        for (uint64_t shortid : shorttxids) {
+            for (int i = 0; i < SHORTTXIDS_LENGTH; i++) {
+                ::Serialize(s, static_cast<unsigned char>(shortid >> (8 * i)), nType, nVersion);
+            }
+        }
+        WriteCompactSize(s, prefilledtxn.size());
+        int lastIndex = -1;
+        for (const PrefilledTransaction& p : prefilledtxn) {
+            WriteCompactSize(s, p.index - lastIndex - 1);
+            ::Serialize(s, p.tx, nType, nVersion);
+            lastIndex = p.index;
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, header, nType | SER_BLOCKHEADERONLY, nVersion);
+        ::Unserialize(s, header.vchBlockSig, nType, nVersion);
+        ::Unserialize(s, nonce, nType, nVersion);
+
+        const uint64_t nShortIds = ReadCompactSize(s);
+        if (nShortIds > MAX_CMPCTBLOCK_TXS)
+            throw std::ios_base::failure("CBlockHeaderAndShortTxIDs: too many short ids");
+        shorttxids.resize(nShortIds);
+        for (uint64_t& shortid : shorttxids) {
+            shortid = 0;
+            for (int i = 0; i < SHORTTXIDS_LENGTH; i++) {
+                unsigned char c = 0;
+                ::Unserialize(s, c, nType, nVersion);
+                shortid |= static_cast<uint64_t>(c) << (8 * i);
+            }
+        }
+
+        const uint64_t nPrefilled = ReadCompactSize(s);
+        if (nPrefilled > MAX_CMPCTBLOCK_TXS - nShortIds)
+            throw std::ios_base::failure("CBlockHeaderAndShortTxIDs: too many prefilled transactions");
+        prefilledtxn.resize(nPrefilled);
+        uint64_t nextIndex = 0;
+        for (PrefilledTransaction& p : prefilledtxn) {
+            nextIndex += ReadCompactSize(s);
+            if (nextIndex > std::numeric_limits<uint16_t>::max())
+                throw std::ios_base::failure("CBlockHeaderAndShortTxIDs: prefilled index overflow");
+            p.index = static_cast<uint16_t>(nextIndex);
+            ::Unserialize(s, p.tx, nType, nVersion);
+            nextIndex++;
+        }
+
+        FillShortTxIDSelector();
+    }
+    _Pragma(NEBLIO_DIAGNOSTIC_POP);
+};
+
+/** A "getblocktxn" message, asking for the transactions of a block that are missing in a compact block */
+class BlockTransactionsRequest
+{
+public:
+    uint256 blockhash;
+    // the indexes of the transactions in the block, ascending; differentially encoded on the wire
+    std::vector<uint16_t> indexes;
+
+    _Pragma(NEBLIO_DIAGNOSTIC_PUSH);
+    _Pragma(NEBLIO_HIDE_SHADOW_WARNING);
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        unsigned int nSize = ::GetSerializeSize(blockhash, nType, nVersion) +
+                             GetSizeOfCompactSize(indexes.size());
+        int lastIndex = -1;
+        for (uint16_t index : indexes) {
+            nSize += GetSizeOfCompactSize(index - lastIndex - 1);
+            lastIndex = index;
+        }
+        return nSize;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, blockhash, nType, nVersion);
+        WriteCompactSize(s, indexes.size());
+        int lastIndex = -1;
+        for (uint16_t index : indexes) {
+            WriteCompactSize(s, index - lastIndex - 1);
+            lastIndex = index;
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, blockhash, nType, nVersion);
+        const uint64_t nIndexes = ReadCompactSize(s);
+        if (nIndexes > MAX_CMPCTBLOCK_TXS)
+            throw std::ios_base::failure("BlockTransactionsRequest: too many indexes");
+        indexes.resize(nIndexes);
+        uint64_t nextIndex = 0;
+        for (uint16_t& index : indexes) {
+            nextIndex += ReadCompactSize(s);
+            if (nextIndex > std::numeric_limits<uint16_t>::max())
+                throw std::ios_base::failure("BlockTransactionsRequest: index overflow");
+            index = static_cast<uint16_t>(nextIndex);
+            nextIndex++;
+        }
+    }
+    _Pragma(NEBLIO_DIAGNOSTIC_POP);
+};
+
+/** A "blocktxn" message, the answer to a "getblocktxn" */
+class BlockTransactions
+{
+public:
+    uint256                   blockhash;
+    std::vector<CTransaction> txn;
+
+    BlockTransactions() = default;
+    explicit BlockTransactions(const BlockTransactionsRequest& req)
+        : blockhash(req.blockhash), txn(req.indexes.size())
+    {
+    }
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+        READWRITE(blockhash);
+        READWRITE(txn);
+    )
+    // clang-format on
+};
+
+/** A block being reconstructed from a compact block, the mempool and a "blocktxn" message */
+class PartiallyDownloadedBlock
+{
+public:
+    enum class ReadStatus
+    {
+        OK,
+        // the peer sent something invalid
+        INVALID,
+        // the block couldn't be reconstructed (e.g. short id collisions), the full block is needed
+        FAILED,
+    };
+
+private:
+    uint256                                    blockHash;
+    CBlock                                     header;
+    std::vector<boost::optional<CTransaction>> txnAvailable;
+    std::size_t                                nPrefilled   = 0;
+    std::size_t                                nFromMempool = 0;
+
+public:
+    ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const uint256& hash,
+                        const CTxMemPool& pool);
+
+    const uint256&        GetBlockHash() const { return blockHash; }
+    bool                  IsTxAvailable(std::size_t index) const;
+    std::vector<uint16_t> GetMissingIndexes() const;
+    std::size_t           GetPrefilledCount() const { return nPrefilled; }
+    std::size_t           GetMempoolCount() const { return nFromMempool; }
+
+    /** Puts the block together; vtxMissing are the transactions of GetMissingIndexes(), in order */
+    ReadStatus FillBlock(CBlock& block, const std::vector<CTransaction>& vtxMissing) const;
+};
+
+#endif // BLOCKENCODINGS_H
@@ -1,6 +1,6 @@
 ﻿#include "blockindex.h"
 
-#include "bignum.h"
+#include "arith_uint256.h"
 #include "block.h"
 #include "blockindexlrucache.h"
 #include "boost/shared_ptr.hpp"
@@ -105,13 +105,19 @@ boost::optional<CBlockIndex> CBlockIndex::getNext(const ITxDB& txdb) const
 
 uint256 CBlockIndex::GetBlockTrust() const
 {
-    CBigNum bnTarget;
-    bnTarget.SetCompact(nBits);
+    bool          fNegative;
+    bool          fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
 
-    if (bnTarget <= 0)
+    if (fNegative || fOverflow || bnTarget == 0)
         return 0;
 
-    return ((CBigNum(1) << 256) / (bnTarget + 1)).getuint256();
+    // We need to compute 2**256 / (bnTarget+1), but we can't represent 2**256
+    // as it's too large for an arith_uint256. However, as 2**256 is at least as large
+    // as bnTarget+1, it is equal to ((2**256 - bnTarget - 1) / (bnTarget+1)) + 1,
+    // or ~bnTarget / (bnTarget+1) + 1.
+    return ArithToUint256((~bnTarget / (bnTarget + 1)) + 1);
 }
 
 bool CBlockIndex::IsInMainChain(const ITxDB& txdb) const
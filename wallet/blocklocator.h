@@ -48,6 +48,8 @@ public:
     int GetHeight(const ITxDB& txdb);
 
     std::size_t size() const;
+
+    const std::vector<uint256>& GetHashes() const;
 };
 
 #endif // BLOCKLOCATOR_H
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "bloom.h"
 #include "main.h"
@@ -31,59 +32,104 @@ CBloomFilter::CBloomFilter(unsigned int nElements, double nFPRate, unsigned int
 {
 }
 
-inline unsigned int CBloomFilter::Hash(unsigned int                      nHashNum,
-                                       const std::vector<unsigned char>& vDataToHash) const
+// 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values. The seed of
+// the hash function nHashNum is nHashNum * BLOOM_SEED_STEP + nTweak.
+static const uint32_t BLOOM_SEED_STEP = 0xFBA4C795;
+
+// the hash functions are computed this many at a time, so that contains() can stop at the first group
+// with a bit unset
+static const unsigned int BLOOM_HASH_GROUP = 8;
+
+void CBloomFilter::insert(const unsigned char* pKey, size_t nLen)
 {
-    // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
-    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash) % (vData.size() * 8);
+    // Avoid divide-by-zero (CVE-2013-5700)
+    if (vData.empty())
+        return;
+    const uint32_t nBits = vData.size() * 8;
+    uint32_t       hashes[BLOOM_HASH_GROUP];
+    for (unsigned int i = 0; i < nHashFuncs; i += BLOOM_HASH_GROUP) {
+        const unsigned int n = min(BLOOM_HASH_GROUP, nHashFuncs - i);
+        MurmurHash3Seeds(i * BLOOM_SEED_STEP + nTweak, BLOOM_SEED_STEP, pKey, nLen, hashes, n);
+        for (unsigned int j = 0; j < n; j++) {
+            const uint32_t nIndex = hashes[j] % nBits;
+            // Sets bit nIndex of vData
+            vData[nIndex >> 3] |= bit_mask[7 & nIndex];
+        }
+    }
 }
 
-void CBloomFilter::insert(const vector<unsigned char>& vKey)
+void CBloomFilter::insert(const vector<unsigned char>& vKey) { insert(vKey.data(), vKey.size()); }
+
+static const size_t OUTPOINT_KEY_SIZE = 36;
+
+static void WriteLE32(unsigned char* ptr, uint32_t x)
 {
-    for (unsigned int i = 0; i < nHashFuncs; i++) {
-        unsigned int nIndex = Hash(i, vKey);
-        // Sets bit nIndex of vData
-        vData[nIndex >> 3] |= bit_mask[7 & nIndex];
-    }
+    ptr[0] = x & 0xFF;
+    ptr[1] = (x >> 8) & 0xFF;
+    ptr[2] = (x >> 16) & 0xFF;
+    ptr[3] = (x >> 24) & 0xFF;
 }
 
-void CBloomFilter::insert(const COutPoint& outpoint)
+// the serialization of an outpoint, without a CDataStream: the 32 bytes of the hash and then the
+// index as little endian, whatever the byte order of the host
+static void OutPointKey(const COutPoint& outpoint, unsigned char* key)
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    vector<unsigned char> data(stream.begin(), stream.end());
-    insert(data);
+    memcpy(key, outpoint.hash.begin(), 32);
+    WriteLE32(key + 32, outpoint.n);
 }
 
-void CBloomFilter::insert(const uint256& hash)
+void CBloomFilter::insert(const COutPoint& outpoint)
 {
-    vector<unsigned char> data(hash.begin(), hash.end());
-    insert(data);
+    unsigned char key[OUTPOINT_KEY_SIZE];
+    OutPointKey(outpoint, key);
+    insert(key, sizeof(key));
 }
 
-bool CBloomFilter::contains(const vector<unsigned char>& vKey) const
+void CBloomFilter::insert(const uint256& hash) { insert(hash.begin(), hash.size()); }
+
+bool CBloomFilter::contains(const unsigned char* pKey, size_t nLen) const
 {
-    for (unsigned int i = 0; i < nHashFuncs; i++) {
-        unsigned int nIndex = Hash(i, vKey);
-        // Checks bit nIndex of vData
-        if (!(vData[nIndex >> 3] & bit_mask[7 & nIndex]))
-            return false;
+    // Avoid divide-by-zero (CVE-2013-5700)
+    if (vData.empty())
+        return true;
+    const uint32_t nBits = vData.size() * 8;
+    uint32_t       hashes[BLOOM_HASH_GROUP];
+    for (unsigned int i = 0; i < nHashFuncs; i += BLOOM_HASH_GROUP) {
+        const unsigned int n = min(BLOOM_HASH_GROUP, nHashFuncs - i);
+        MurmurHash3Seeds(i * BLOOM_SEED_STEP + nTweak, BLOOM_SEED_STEP, pKey, nLen, hashes, n);
+        for (unsigned int j = 0; j < n; j++) {
+            const uint32_t nIndex = hashes[j] % nBits;
+            // Checks bit nIndex of vData
+            if (!(vData[nIndex >> 3] & bit_mask[7 & nIndex]))
+                return false;
+        }
     }
     return true;
 }
 
+bool CBloomFilter::contains(const vector<unsigned char>& vKey) const
+{
+    return contains(vKey.data(), vKey.size());
+}
+
 bool CBloomFilter::contains(const COutPoint& outpoint) const
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    vector<unsigned char> data(stream.begin(), stream.end());
-    return contains(data);
+    unsigned char key[OUTPOINT_KEY_SIZE];
+    OutPointKey(outpoint, key);
+    return contains(key, sizeof(key));
 }
 
-bool CBloomFilter::contains(const uint256& hash) const
+bool CBloomFilter::contains(const uint256& hash) const { return contains(hash.begin(), hash.size()); }
+
+bool CBloomFilter::AddInsertionsOf(const CBloomFilter& other)
 {
-    vector<unsigned char> data(hash.begin(), hash.end());
-    return contains(data);
+    if (vData.size() != other.vData.size() || nHashFuncs != other.nHashFuncs ||
+        nTweak != other.nTweak || nFlags != other.nFlags)
+        return false;
+    // insertions only set bits
+    for (unsigned int i = 0; i < vData.size(); i++)
+        vData[i] |= other.vData[i];
+    return true;
 }
 
 bool CBloomFilter::IsWithinSizeConstraints() const
@@ -46,7 +46,6 @@ private:
     unsigned int               nTweak;
     unsigned char              nFlags;
 
-    unsigned int Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const;
 
 public:
     // Creates a new bloom filter which will provide the given fp rate when filled with the given number
@@ -71,10 +70,12 @@ public:
     )
     // clang-format on
 
+    void insert(const unsigned char* pKey, size_t nLen);
     void insert(const std::vector<unsigned char>& vKey);
     void insert(const COutPoint& outpoint);
     void insert(const uint256& hash);
 
+    bool contains(const unsigned char* pKey, size_t nLen) const;
     bool contains(const std::vector<unsigned char>& vKey) const;
     bool contains(const COutPoint& outpoint) const;
     bool contains(const uint256& hash) const;
@@ -85,6 +86,19 @@ public:
 
     // Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+
+    // True if IsRelevantAndUpdate() can add outputs to the filter
+    bool IsUpdatedOnMatch() const { return (nFlags & BLOOM_UPDATE_MASK) != BLOOM_UPDATE_NONE; }
+
+    // Adds the elements inserted into other, a copy of this filter, to this filter. Returns false,
+    // changing nothing, if other has different parameters, which means this filter was replaced
+    bool AddInsertionsOf(const CBloomFilter& other);
+
+    bool operator==(const CBloomFilter& other) const
+    {
+        return vData == other.vData && nHashFuncs == other.nHashFuncs && nTweak == other.nTweak &&
+               nFlags == other.nFlags;
+    }
 };
 
 #endif /* BITCOIN_BLOOM_H */
@@ -70,9 +70,9 @@ public:
         strNetworkID = "main";
 
         // Set PoW difficulty to easiest
-        consensus.bnProofOfWorkLimit = CBigNum(~uint256(0) >> 1);
+        consensus.bnProofOfWorkLimit = ~arith_uint256(0) >> 1;
         // Set PoS difficulty to standard
-        consensus.bnProofOfStakeLimit = CBigNum(~uint256(0) >> 20);
+        consensus.bnProofOfStakeLimit = ~arith_uint256(0) >> 20;
 
         consensus.nTargetTimespan       = 2 * 60 * 60;              // two hours
         consensus.nStakeTargetSpacingV1 = 120;                      // 120 seconds block spacing
@@ -252,9 +252,9 @@ public:
         strNetworkID = "test";
 
         // Set PoW difficulty to easiest
-        consensus.bnProofOfWorkLimit = CBigNum(~uint256(0) >> 1);
+        consensus.bnProofOfWorkLimit = ~arith_uint256(0) >> 1;
         // Set PoS difficulty to standard
-        consensus.bnProofOfStakeLimit = CBigNum(~uint256(0) >> 20);
+        consensus.bnProofOfStakeLimit = ~arith_uint256(0) >> 20;
 
         consensus.nTargetTimespan       = 2 * 60 * 60;      // two hours
         consensus.nStakeTargetSpacingV1 = 120;              // 120 seconds block spacing
@@ -413,9 +413,9 @@ public:
         strNetworkID = "regtest";
 
         // Set PoW difficulty to easiest
-        consensus.bnProofOfWorkLimit = CBigNum(~uint256(0) >> 1);
+        consensus.bnProofOfWorkLimit = ~arith_uint256(0) >> 1;
         // Set PoS difficulty to standard
-        consensus.bnProofOfStakeLimit = CBigNum(~uint256(0) >> 20);
+        consensus.bnProofOfStakeLimit = ~arith_uint256(0) >> 20;
 
         consensus.nStakeTargetSpacingV1 = 120; // 120 seconds block spacing
         consensus.nStakeTargetSpacingV2 = 30;  // 30 seconds block spacing
@@ -609,9 +609,9 @@ int CChainParams::CoinbaseMaturity(const ITxDB& txdb) const
     }
 }
 
-const CBigNum& CChainParams::PoWLimit() const { return consensus.bnProofOfWorkLimit; }
+const arith_uint256& CChainParams::PoWLimit() const { return consensus.bnProofOfWorkLimit; }
 
-const CBigNum& CChainParams::PoSLimit() const { return consensus.bnProofOfStakeLimit; }
+const arith_uint256& CChainParams::PoSLimit() const { return consensus.bnProofOfStakeLimit; }
 
 const MapStakeModifierCheckpoints& CChainParams::StakeModifierCheckpoints() const
 {
@@ -91,8 +91,8 @@ public:
 
     int CoinbaseMaturity(const ITxDB& txdb) const;
 
-    const CBigNum& PoWLimit() const;
-    const CBigNum& PoSLimit() const;
+    const arith_uint256& PoWLimit() const;
+    const arith_uint256& PoSLimit() const;
 
     const MapStakeModifierCheckpoints& StakeModifierCheckpoints() const;
 
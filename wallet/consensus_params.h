@@ -7,7 +7,7 @@
 #define BITCOIN_CONSENSUS_PARAMS_H
 
 #include "NetworkForks.h"
-#include <bignum.h>
+#include <arith_uint256.h>
 #include <limits>
 #include <memory>
 #include <string>
@@ -32,8 +32,8 @@ struct Params
     uint256 hashGenesisBlock;
 
     /** peercoin stuff */
-    CBigNum bnProofOfWorkLimit;
-    CBigNum bnProofOfStakeLimit;
+    arith_uint256 bnProofOfWorkLimit;
+    arith_uint256 bnProofOfStakeLimit;
     int64_t nStakeTargetSpacingV2;
     int64_t nStakeTargetSpacingV1;
     int64_t nTargetTimespan;
@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "db.h"
+#include "db/lmdb/lmdbwallet.h"
 #include "main.h"
 #include "net.h"
 #include "ui_interface.h"
@@ -20,6 +21,32 @@ using namespace boost;
 
 boost::atomic<uint32_t> nWalletDBUpdated;
 
+bool fWalletLMDB = false;
+
+boost::filesystem::path GetWalletFilePath(const std::string& strFile)
+{
+    boost::filesystem::path result(strFile);
+    return result.is_absolute() ? result : GetDataDir() / result;
+}
+
+std::shared_ptr<LMDBWalletStorage> GetLMDBWalletStorage(const std::string& strFile)
+{
+    {
+        // the common case, to not look into the file every time
+        LOCK(bitdb.cs_db);
+        std::map<std::string, Db*>::const_iterator it = bitdb.mapDb.find(strFile);
+        if (it != bitdb.mapDb.end() && it->second != nullptr)
+            return nullptr;
+    }
+
+    const boost::filesystem::path filePath = GetWalletFilePath(strFile);
+    if (std::shared_ptr<LMDBWalletStorage> storage = LMDBWalletStorage::GetIfOpen(filePath))
+        return storage;
+    if (boost::filesystem::exists(filePath) ? LMDBWalletStorage::IsLMDBFile(filePath) : fWalletLMDB)
+        return LMDBWalletStorage::Get(filePath);
+    return nullptr;
+}
+
 //
 // CDB
 //
@@ -207,7 +234,8 @@ void CDBEnv::CheckpointLSN(std::string strFile)
     dbenv.lsn_reset(strFile.c_str(), 0);
 }
 
-CDB::CDB(const char* pszFile, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), activeTxn(NULL)
+CDB::CDB(const char* pszFile, const char* pszMode, bool fFlushOnCloseIn)
+    : pdb(NULL), activeTxn(NULL), fLMDBTxn(false)
 {
     int ret;
     if (pszFile == NULL)
@@ -220,6 +248,20 @@ CDB::CDB(const char* pszFile, const char* pszMode, bool fFlushOnCloseIn) : pdb(N
     if (fCreate)
         nFlags |= DB_CREATE;
 
+    if (!bitdb.IsMock()) {
+        plmdb = GetLMDBWalletStorage(pszFile);
+        if (plmdb) {
+            strFile = pszFile;
+            if (fCreate && !Exists(string("version"))) {
+                bool fTmp = fReadOnly;
+                fReadOnly = false;
+                WriteVersion(CLIENT_VERSION);
+                fReadOnly = fTmp;
+            }
+            return;
+        }
+    }
+
     {
         LOCK(bitdb.cs_db);
         if (!bitdb.Open(GetDataDir()))
@@ -271,7 +313,8 @@ CDB::CDB(const char* pszFile, const char* pszMode, bool fFlushOnCloseIn) : pdb(N
 
 void CDB::Flush()
 {
-    if (activeTxn)
+    // LMDB commits are durable except for the last ones, which ThreadFlushWalletDB syncs
+    if (activeTxn || plmdb)
         return;
 
     // Flush database activity from memory pool to disk log
@@ -284,6 +327,13 @@ void CDB::Flush()
 
 void CDB::Close()
 {
+    if (plmdb) {
+        if (fLMDBTxn)
+            plmdb->abortBatch();
+        fLMDBTxn = false;
+        plmdb.reset();
+        return;
+    }
     if (!pdb)
         return;
     if (activeTxn)
@@ -300,6 +350,133 @@ void CDB::Close()
     }
 }
 
+bool CDB::ReadFromLMDB(CDataStream& ssKey, CDataStream& ssValue)
+{
+    std::string strValue;
+    bool        fFound = plmdb->read(std::string(ssKey.begin(), ssKey.end()), strValue);
+    memset(&ssKey[0], 0, ssKey.size());
+    if (!fFound)
+        return false;
+
+    ssValue.write(strValue.data(), strValue.size());
+
+    // Clear memory in case it was a private key
+    memset(&strValue[0], 0, strValue.size());
+    return true;
+}
+
+bool CDB::WriteToLMDB(CDataStream& ssKey, CDataStream& ssValue, bool fOverwrite)
+{
+    std::string strKey(ssKey.begin(), ssKey.end());
+    std::string strValue(ssValue.begin(), ssValue.end());
+    bool        fSuccess = plmdb->write(strKey, strValue, fOverwrite);
+
+    // Clear memory in case it was a private key
+    memset(&ssKey[0], 0, ssKey.size());
+    memset(&ssValue[0], 0, ssValue.size());
+    memset(&strKey[0], 0, strKey.size());
+    memset(&strValue[0], 0, strValue.size());
+    return fSuccess;
+}
+
+bool CDB::EraseFromLMDB(CDataStream& ssKey)
+{
+    bool fSuccess = plmdb->erase(std::string(ssKey.begin(), ssKey.end()));
+    memset(&ssKey[0], 0, ssKey.size());
+    return fSuccess;
+}
+
+bool CDB::ExistsInLMDB(CDataStream& ssKey)
+{
+    bool fFound = plmdb->exists(std::string(ssKey.begin(), ssKey.end()));
+    memset(&ssKey[0], 0, ssKey.size());
+    return fFound;
+}
+
+bool CDB::ForEachRecord(const std::function<bool(CDataStream&, CDataStream&)>& callback,
+                        const CDataStream*                                  pssStartKey)
+{
+    if (plmdb) {
+        const std::string strStartKey =
+            pssStartKey ? std::string(pssStartKey->begin(), pssStartKey->end()) : std::string();
+        return plmdb->forEach(strStartKey, [&](const std::string& key, const std::string& value) {
+            CDataStream ssKey(key.data(), key.data() + key.size(), SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(value.data(), value.data() + value.size(), SER_DISK, CLIENT_VERSION);
+            return callback(ssKey, ssValue);
+        });
+    }
+
+    Dbc* pcursor = GetCursor();
+    if (!pcursor)
+        return false;
+    unsigned int fFlags = (pssStartKey && !pssStartKey->empty()) ? DB_SET_RANGE : DB_NEXT;
+    while (true) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        if (fFlags == DB_SET_RANGE)
+            ssKey = *pssStartKey;
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        int         ret = ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
+        fFlags          = DB_NEXT;
+        if (ret == DB_NOTFOUND)
+            break;
+        else if (ret != 0) {
+            pcursor->close();
+            return false;
+        }
+        if (!callback(ssKey, ssValue))
+            break;
+    }
+    pcursor->close();
+    return true;
+}
+
+bool CDB::TxnBegin()
+{
+    if (plmdb) {
+        if (fLMDBTxn || !plmdb->beginBatch())
+            return false;
+        fLMDBTxn = true;
+        return true;
+    }
+    if (!pdb || activeTxn)
+        return false;
+    DbTxn* ptxn = bitdb.TxnBegin();
+    if (!ptxn)
+        return false;
+    activeTxn = ptxn;
+    return true;
+}
+
+bool CDB::TxnCommit()
+{
+    if (plmdb) {
+        if (!fLMDBTxn)
+            return false;
+        fLMDBTxn = false;
+        return plmdb->commitBatch();
+    }
+    if (!pdb || !activeTxn)
+        return false;
+    int ret   = activeTxn->commit(0);
+    activeTxn = NULL;
+    return (ret == 0);
+}
+
+bool CDB::TxnAbort()
+{
+    if (plmdb) {
+        if (!fLMDBTxn)
+            return false;
+        fLMDBTxn = false;
+        return plmdb->abortBatch();
+    }
+    if (!pdb || !activeTxn)
+        return false;
+    int ret   = activeTxn->abort();
+    activeTxn = NULL;
+    return (ret == 0);
+}
+
 void CDBEnv::CloseDb(const string& strFile)
 {
     {
@@ -323,8 +500,60 @@ bool CDBEnv::RemoveDb(const string& strFile)
     return (rc == 0);
 }
 
+// LMDB reuses the pages of erased records, so after erasing the skipped records the file is replaced
+// with a compacted copy, which leaves nothing of the old data in free pages
+static bool RewriteLMDBWallet(const string& strFile, const char* pszSkip)
+{
+    NLog.write(b_sev::info, "Rewriting {}...", strFile);
+    std::shared_ptr<LMDBWalletStorage> storage = GetLMDBWalletStorage(strFile);
+    if (!storage)
+        return false;
+
+    bool fSuccess = storage->beginBatch();
+    if (fSuccess && pszSkip) {
+        std::vector<std::string> vKeysToErase;
+        fSuccess = storage->forEach(pszSkip, [&](const std::string& key, const std::string&) {
+            if (key.compare(0, strlen(pszSkip), pszSkip) != 0)
+                return false;
+            vKeysToErase.push_back(key);
+            return true;
+        });
+        for (const std::string& key : vKeysToErase)
+            fSuccess = fSuccess && storage->erase(key);
+    }
+    if (fSuccess) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssKey << string("version");
+        ssValue << CLIENT_VERSION;
+        fSuccess = storage->write(std::string(ssKey.begin(), ssKey.end()),
+                                  std::string(ssValue.begin(), ssValue.end()));
+    }
+    fSuccess = (fSuccess ? storage->commitBatch() : (storage->abortBatch(), false));
+
+    const boost::filesystem::path filePath = storage->getFilePath();
+    storage.reset();
+    while (fSuccess) {
+        if (fShutdown) {
+            fSuccess = false;
+        } else if (!LMDBWalletStorage::IsInUse(filePath)) {
+            fSuccess = LMDBWalletStorage::Compact(filePath);
+        } else {
+            MilliSleep(100);
+            continue;
+        }
+        break;
+    }
+    if (!fSuccess)
+        NLog.write(b_sev::err, "Rewriting of {} FAILED!", strFile);
+    return fSuccess;
+}
+
 bool CDB::Rewrite(const string& strFile, const char* pszSkip)
 {
+    if (GetLMDBWalletStorage(strFile))
+        return RewriteLMDBWallet(strFile, pszSkip);
+
     while (!fShutdown) {
         {
             LOCK(bitdb.cs_db);
@@ -7,7 +7,9 @@
 
 #include <boost/atomic.hpp>
 #include <boost/filesystem.hpp>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -23,9 +25,22 @@ class COutPoint;
 class CTxIndex;
 class CWallet;
 class CWalletTx;
+class LMDBWalletStorage;
 
 extern boost::atomic<uint32_t> nWalletDBUpdated;
 
+/** Set by -walletbackend=lmdb; new wallet files are created in LMDB and wallet.dat is migrated to it */
+extern bool fWalletLMDB;
+
+/** The path of a wallet file, which is relative to the data directory unless it's absolute */
+boost::filesystem::path GetWalletFilePath(const std::string& strFile);
+
+/**
+ * The LMDB storage of a wallet file, or nullptr if the file is a BerkeleyDB database. Whatever the
+ * backend option, an existing file is opened in the format it has.
+ */
+std::shared_ptr<LMDBWalletStorage> GetLMDBWalletStorage(const std::string& strFile);
+
 void FlushWalletDB(bool forceLockAndFlush, const std::string& strFile,
                    unsigned int* nLastFlushedPtr = nullptr);
 void ThreadFlushWalletDB(const std::string strFile);
@@ -95,7 +110,7 @@ public:
 
 extern CDBEnv bitdb;
 
-/** RAII class that provides access to a Berkeley database */
+/** RAII class that provides access to a Berkeley database, or to the LMDB storage of a wallet */
 class CDB
 {
 protected:
@@ -105,6 +120,10 @@ protected:
     bool        fReadOnly;
     bool        fFlushOnClose;
 
+    std::shared_ptr<LMDBWalletStorage> plmdb;
+    // the batch of plmdb that this object began with TxnBegin()
+    bool fLMDBTxn;
+
     explicit CDB(const char* pszFile, const char* pszMode = "r+", bool fFlushOnCloseIn = true);
     ~CDB() { Close(); }
 
@@ -116,17 +135,35 @@ private:
     CDB(const CDB&);
     void operator=(const CDB&);
 
+    bool ReadFromLMDB(CDataStream& ssKey, CDataStream& ssValue);
+    bool WriteToLMDB(CDataStream& ssKey, CDataStream& ssValue, bool fOverwrite);
+    bool EraseFromLMDB(CDataStream& ssKey);
+    bool ExistsInLMDB(CDataStream& ssKey);
+
 protected:
     template <typename K, typename T>
     bool Read(const K& key, T& value)
     {
-        if (!pdb)
+        if (!pdb && !plmdb)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plmdb) {
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            if (!ReadFromLMDB(ssKey, ssValue))
+                return false;
+            try {
+                ssValue >> value;
+            } catch (std::exception& e) {
+                return false;
+            }
+            return true;
+        }
+
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Read
@@ -156,7 +193,7 @@ protected:
     template <typename K, typename T>
     bool Write(const K& key, const T& value, bool fOverwrite = true)
     {
-        if (!pdb)
+        if (!pdb && !plmdb)
             return false;
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
@@ -165,12 +202,16 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        Dbt datKey(&ssKey[0], ssKey.size());
 
         // Value
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
+
+        if (plmdb)
+            return WriteToLMDB(ssKey, ssValue, fOverwrite);
+
+        Dbt datKey(&ssKey[0], ssKey.size());
         Dbt datValue(&ssValue[0], ssValue.size());
 
         // Write
@@ -185,7 +226,7 @@ protected:
     template <typename K>
     bool Erase(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plmdb)
             return false;
         if (fReadOnly)
             assert(!"Erase called on database in read-only mode");
@@ -194,6 +235,10 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plmdb)
+            return EraseFromLMDB(ssKey);
+
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Erase
@@ -207,13 +252,17 @@ protected:
     template <typename K>
     bool Exists(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plmdb)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plmdb)
+            return ExistsInLMDB(ssKey);
+
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Exists
@@ -275,34 +324,21 @@ protected:
     }
 
 public:
-    bool TxnBegin()
-    {
-        if (!pdb || activeTxn)
-            return false;
-        DbTxn* ptxn = bitdb.TxnBegin();
-        if (!ptxn)
-            return false;
-        activeTxn = ptxn;
-        return true;
-    }
-
-    bool TxnCommit()
-    {
-        if (!pdb || !activeTxn)
-            return false;
-        int ret   = activeTxn->commit(0);
-        activeTxn = NULL;
-        return (ret == 0);
-    }
+    /**
+     * Calls the callback with every record, in key order, starting from the first key that isn't less
+     * than ssStartKey (or from the first record), until it returns false. Works with both backends.
+     * Returns false if reading the database failed.
+     */
+    bool ForEachRecord(const std::function<bool(CDataStream& ssKey, CDataStream& ssValue)>& callback,
+                       const CDataStream* pssStartKey = nullptr);
 
-    bool TxnAbort()
-    {
-        if (!pdb || !activeTxn)
-            return false;
-        int ret   = activeTxn->abort();
-        activeTxn = NULL;
-        return (ret == 0);
-    }
+    /**
+     * In LMDB, the transaction is a batch of the storage that includes everything this thread writes
+     * to the wallet file until it's committed, also through other CDB objects.
+     */
+    bool TxnBegin();
+    bool TxnCommit();
+    bool TxnAbort();
 
     bool ReadVersion(int& nVersion)
     {
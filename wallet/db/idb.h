@@ -20,7 +20,12 @@ public:
         DB_ADDRSVSPUBKEYS_INDEX = 6,
         DB_BLOCKMETADATA_INDEX  = 7,
         DB_BLOCKHEIGHTS_INDEX   = 8,
-        DB_STAKES_INDEX         = 9
+        DB_STAKES_INDEX         = 9,
+        DB_ORPHANBLOCKS_INDEX   = 10,
+        DB_ADDRESSTX_INDEX      = 11,
+        DB_ADDRESSUNSPENT_INDEX = 12,
+        DB_NTP1TOKENTRANSFERS_INDEX = 13,
+        DB_NTP1TOKENHOLDERS_INDEX   = 14
     };
 
     virtual boost::optional<std::string>
@@ -51,6 +56,18 @@ public:
     virtual boost::optional<std::map<std::string, std::string>>
     readAllUnique(IDB::Index dbindex) const = 0;
 
+    /**
+     * @brief readRange returns the key/value pairs whose keys are in [keyBegin, keyEnd), in key order
+     * @param dbindex
+     * @param keyBegin
+     * @param keyEnd
+     * @param limit the maximum number of pairs to return, 0 for no limit
+     * @return boost::none on error, results otherwise
+     */
+    virtual boost::optional<std::vector<std::pair<std::string, std::string>>>
+    readRange(IDB::Index dbindex, const std::string& keyBegin, const std::string& keyEnd,
+              std::size_t limit = 0) const = 0;
+
     virtual bool write(IDB::Index dbindex, const std::string& key, const std::string& value) = 0;
 
     /**
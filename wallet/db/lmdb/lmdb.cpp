@@ -20,6 +20,11 @@ const std::string LMDB_ADDRSVSPUBKEYSDB = "AddrsVsPubKeysDb";
 const std::string LMDB_BLOCKMETADATADB  = "BlockMetadataDb";
 const std::string LMDB_BLOCKHEIGHTSDB   = "BlockHeightsDB";
 const std::string LMDB_STAKESDB         = "StakesDB";
+const std::string LMDB_ORPHANBLOCKSDB   = "OrphanBlocksDB";
+const std::string LMDB_ADDRESSTXDB      = "AddressTxDB";
+const std::string LMDB_ADDRESSUNSPENTDB = "AddressUnspentDB";
+const std::string LMDB_NTP1TOKENTRANSFERSDB = "Ntp1TokenTransfersDB";
+const std::string LMDB_NTP1TOKENHOLDERSDB   = "Ntp1TokenHoldersDB";
 
 namespace {
 
@@ -293,6 +298,11 @@ void LMDB::openDatabase(const boost::filesystem::path& directory, bool clearDBBe
     glob_lmdb_db_pointers->db_blockMetadata  = DbSmartPtrType(new MDB_dbi, dbDeleter);
     glob_lmdb_db_pointers->db_blockHeights   = DbSmartPtrType(new MDB_dbi, dbDeleter);
     glob_lmdb_db_pointers->db_stakes         = DbSmartPtrType(new MDB_dbi, dbDeleter);
+    glob_lmdb_db_pointers->db_orphanBlocks   = DbSmartPtrType(new MDB_dbi, dbDeleter);
+    glob_lmdb_db_pointers->db_addressTx      = DbSmartPtrType(new MDB_dbi, dbDeleter);
+    glob_lmdb_db_pointers->db_addressUnspent = DbSmartPtrType(new MDB_dbi, dbDeleter);
+    glob_lmdb_db_pointers->db_ntp1TokenTransfers = DbSmartPtrType(new MDB_dbi, dbDeleter);
+    glob_lmdb_db_pointers->db_ntp1TokenHolders   = DbSmartPtrType(new MDB_dbi, dbDeleter);
 
     // MDB_CREATE: Create the named database if it doesn't exist.
     lmdb_db_open(txn, LMDB_MAINDB.c_str(), MDB_CREATE, *glob_lmdb_db_pointers->db_main,
@@ -317,6 +327,26 @@ void LMDB::openDatabase(const boost::filesystem::path& directory, bool clearDBBe
                  "Failed to open db handle for db_blockHeights");
     lmdb_db_open(txn, LMDB_STAKESDB.c_str(), MDB_CREATE, *glob_lmdb_db_pointers->db_stakes,
                  "Failed to open db handle for db_stakes");
+    lmdb_db_open(txn, LMDB_ORPHANBLOCKSDB.c_str(), MDB_CREATE, *glob_lmdb_db_pointers->db_orphanBlocks,
+                 "Failed to open db handle for db_orphanBlocks");
+    lmdb_db_open(txn, LMDB_ADDRESSTXDB.c_str(), MDB_CREATE, *glob_lmdb_db_pointers->db_addressTx,
+                 "Failed to open db handle for db_addressTx");
+    lmdb_db_open(txn, LMDB_ADDRESSUNSPENTDB.c_str(), MDB_CREATE,
+                 *glob_lmdb_db_pointers->db_addressUnspent,
+                 "Failed to open db handle for db_addressUnspent");
+    lmdb_db_open(txn, LMDB_NTP1TOKENTRANSFERSDB.c_str(), MDB_CREATE,
+                 *glob_lmdb_db_pointers->db_ntp1TokenTransfers,
+                 "Failed to open db handle for db_ntp1TokenTransfers");
+    lmdb_db_open(txn, LMDB_NTP1TOKENHOLDERSDB.c_str(), MDB_CREATE,
+                 *glob_lmdb_db_pointers->db_ntp1TokenHolders,
+                 "Failed to open db handle for db_ntp1TokenHolders");
+
+    // orphan blocks spilled to disk don't survive a restart, as the orphans pool is in memory
+    if (auto mdb_res = mdb_drop(txn, *glob_lmdb_db_pointers->db_orphanBlocks, 0)) {
+        throw std::runtime_error("Failed to clear the orphan blocks database: " +
+                                 std::to_string(mdb_res) +
+                                 "; message: " + std::string(mdb_strerror(mdb_res)));
+    }
 
     // commit the transaction
     txn.commit();
@@ -351,6 +381,21 @@ void LMDB::openDatabase(const boost::filesystem::path& directory, bool clearDBBe
     if (!glob_lmdb_db_pointers->db_stakes) {
         throw std::runtime_error("LMDB nullptr after opening the db_stakes database.");
     }
+    if (!glob_lmdb_db_pointers->db_orphanBlocks) {
+        throw std::runtime_error("LMDB nullptr after opening the db_orphanBlocks database.");
+    }
+    if (!glob_lmdb_db_pointers->db_addressTx) {
+        throw std::runtime_error("LMDB nullptr after opening the db_addressTx database.");
+    }
+    if (!glob_lmdb_db_pointers->db_addressUnspent) {
+        throw std::runtime_error("LMDB nullptr after opening the db_addressUnspent database.");
+    }
+    if (!glob_lmdb_db_pointers->db_ntp1TokenTransfers) {
+        throw std::runtime_error("LMDB nullptr after opening the db_ntp1TokenTransfers database.");
+    }
+    if (!glob_lmdb_db_pointers->db_ntp1TokenHolders) {
+        throw std::runtime_error("LMDB nullptr after opening the db_ntp1TokenHolders database.");
+    }
 
     boost::atomic_thread_fence(boost::memory_order_seq_cst);
 
@@ -362,6 +407,9 @@ void LMDB::doResize(uint64_t increase_size)
 {
     NLog.write(b_sev::info, std::string(FUNCTIONSIG));
 
+    // waiting for the active transactions to finish would wait for this thread's own snapshot
+    assert(LMDBReadSnapshot::Current() == nullptr);
+
     if (increase_size != 0 && increase_size < MIN_MAP_SIZE_INCREASE) {
         // protect from having very small incremental changes in the DB size, which is not efficient
         increase_size = MIN_MAP_SIZE_INCREASE;
@@ -438,6 +486,46 @@ LMDB::LMDB(const boost::filesystem::path* const dbdir, bool startNewDatabase) :
     openDB(startNewDatabase);
 }
 
+static thread_local MDB_txn* threadReadSnapshot = nullptr;
+
+LMDBReadSnapshot::LMDBReadSnapshot() : txn(false)
+{
+    if (threadReadSnapshot != nullptr || !dbEnv) {
+        return;
+    }
+    txn = LMDBTransaction();
+    if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, txn)) {
+        // reads will just start their own transactions
+        NLog.write(b_sev::err, "Failed to begin read snapshot transaction with error code " +
+                                   std::to_string(res) +
+                                   "; and error: " + std::string(mdb_strerror(res)));
+        return;
+    }
+    threadReadSnapshot = txn.rawPtr();
+    owner              = true;
+}
+
+LMDBReadSnapshot::~LMDBReadSnapshot()
+{
+    if (owner) {
+        threadReadSnapshot = nullptr;
+        txn.abort();
+    }
+}
+
+MDB_txn* LMDBReadSnapshot::Current() { return threadReadSnapshot; }
+
+MDB_txn* LMDB::readTxn(LMDBTransaction& localTxn) const
+{
+    if (activeBatch) {
+        return activeBatch->rawPtr();
+    }
+    if (localTxn.rawPtr()) {
+        return localTxn.rawPtr();
+    }
+    return LMDBReadSnapshot::Current();
+}
+
 boost::optional<std::string> LMDB::read(IDB::Index dbindex, const std::string& key, std::size_t offset,
                                         const boost::optional<std::size_t>& size) const
 {
@@ -445,7 +533,7 @@ boost::optional<std::string> LMDB::read(IDB::Index dbindex, const std::string& k
 
     // if there's no active transaction, we start one for this read
     LMDBTransaction localTxn(false);
-    if (!activeBatch) {
+    if (!activeBatch && !LMDBReadSnapshot::Current()) {
         localTxn = LMDBTransaction();
         if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
             NLog.write(b_sev::err, "Failed to begin transaction at read with error code " +
@@ -466,7 +554,7 @@ boost::optional<std::string> LMDB::read(IDB::Index dbindex, const std::string& k
 
     MDB_val kS = {key.size(), (void*)(key.c_str())};
     MDB_val vS = {0, nullptr};
-    if (auto ret = mdb_get((!activeBatch ? localTxn : *activeBatch), *dbPtr, &kS, &vS)) {
+    if (auto ret = mdb_get(readTxn(localTxn), *dbPtr, &kS, &vS)) {
         std::string dbgKey = KeyAsString(key, key);
         if (ret == MDB_NOTFOUND) {
             NLog.write(b_sev::debug, "Failed to read lmdb key " + dbgKey + " as it doesn't exist");
@@ -495,7 +583,7 @@ boost::optional<std::vector<std::string>> LMDB::readMultiple(IDB::Index
     const MDB_dbi* dbPtr = getDbByIndex(dbindex);
 
     LMDBTransaction localTxn(false);
-    if (!activeBatch) {
+    if (!activeBatch && !LMDBReadSnapshot::Current()) {
         localTxn = LMDBTransaction();
         if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
             NLog.write(b_sev::err, "readMultiple: Failed to begin transaction at read with error code " +
@@ -519,7 +607,7 @@ boost::optional<std::vector<std::string>> LMDB::readMultiple(IDB::Index
     MDB_val     kS           = {key.size(), (void*)(key.c_str())};
     MDB_val     vS           = {0, nullptr};
     MDB_cursor* cursorRawPtr = nullptr;
-    if (auto rc = mdb_cursor_open((!activeBatch ? localTxn : *activeBatch), *dbPtr, &cursorRawPtr)) {
+    if (auto rc = mdb_cursor_open(readTxn(localTxn), *dbPtr, &cursorRawPtr)) {
         NLog.write(b_sev::err, "readMultiple: Failed to open lmdb cursor with error code " +
                                    std::to_string(rc) + "; and error: " + std::string(mdb_strerror(rc)));
         return boost::none;
@@ -571,7 +659,7 @@ boost::optional<std::map<std::string, std::vector<std::string>>> LMDB::readAll(I
     const MDB_dbi* dbPtr = getDbByIndex(dbindex);
 
     LMDBTransaction localTxn(false);
-    if (!activeBatch) {
+    if (!activeBatch && !LMDBReadSnapshot::Current()) {
         localTxn = LMDBTransaction();
         if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
             NLog.write(b_sev::err,
@@ -593,7 +681,7 @@ boost::optional<std::map<std::string, std::vector<std::string>>> LMDB::readAll(I
     MDB_val     kS           = {0, nullptr};
     MDB_val     vS           = {0, nullptr};
     MDB_cursor* cursorRawPtr = nullptr;
-    if (auto rc = mdb_cursor_open((!activeBatch ? localTxn : *activeBatch), *dbPtr, &cursorRawPtr)) {
+    if (auto rc = mdb_cursor_open(readTxn(localTxn), *dbPtr, &cursorRawPtr)) {
         NLog.write(b_sev::err, "LMDB::readAll: Failed to open lmdb cursor with error code " +
                                    std::to_string(rc) + "; and error: " + std::string(mdb_strerror(rc)));
         return boost::none;
@@ -643,7 +731,7 @@ boost::optional<std::map<std::string, std::string>> LMDB::readAllUnique(IDB::Ind
     const MDB_dbi* dbPtr = getDbByIndex(dbindex);
 
     LMDBTransaction localTxn(false);
-    if (!activeBatch) {
+    if (!activeBatch && !LMDBReadSnapshot::Current()) {
         localTxn = LMDBTransaction();
         if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
             NLog.write(b_sev::err,
@@ -665,7 +753,7 @@ boost::optional<std::map<std::string, std::string>> LMDB::readAllUnique(IDB::Ind
     MDB_val     kS           = {0, nullptr};
     MDB_val     vS           = {0, nullptr};
     MDB_cursor* cursorRawPtr = nullptr;
-    if (auto rc = mdb_cursor_open((!activeBatch ? localTxn : *activeBatch), *dbPtr, &cursorRawPtr)) {
+    if (auto rc = mdb_cursor_open(readTxn(localTxn), *dbPtr, &cursorRawPtr)) {
         NLog.write(b_sev::err, "LMDB::readAll: Failed to open lmdb cursor with error code " +
                                    std::to_string(rc) + "; and error: " + std::string(mdb_strerror(rc)));
         return boost::none;
@@ -710,6 +798,72 @@ boost::optional<std::map<std::string, std::string>> LMDB::readAllUnique(IDB::Ind
     return result;
 }
 
+boost::optional<std::vector<std::pair<std::string, std::string>>>
+LMDB::readRange(IDB::Index dbindex, const std::string& keyBegin, const std::string& keyEnd,
+                std::size_t limit) const
+{
+    const MDB_dbi* dbPtr = getDbByIndex(dbindex);
+
+    LMDBTransaction localTxn(false);
+    if (!activeBatch && !LMDBReadSnapshot::Current()) {
+        localTxn = LMDBTransaction();
+        if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
+            NLog.write(b_sev::err, "readRange: Failed to begin transaction at read with error code " +
+                                       std::to_string(res) +
+                                       "; and error code: " + std::string(mdb_strerror(res)));
+        }
+    }
+    // only one of them should be active
+    assert(localTxn.rawPtr() == nullptr || activeBatch == nullptr);
+
+    BOOST_SCOPE_EXIT(&localTxn)
+    {
+        if (localTxn.rawPtr()) {
+            localTxn.abort();
+        }
+    }
+    BOOST_SCOPE_EXIT_END
+
+    MDB_val     kS           = {keyBegin.size(), (void*)(keyBegin.c_str())};
+    MDB_val     vS           = {0, nullptr};
+    MDB_cursor* cursorRawPtr = nullptr;
+    if (auto rc = mdb_cursor_open(readTxn(localTxn), *dbPtr, &cursorRawPtr)) {
+        NLog.write(b_sev::err, "readRange: Failed to open lmdb cursor with error code " +
+                                   std::to_string(rc) + "; and error: " + std::string(mdb_strerror(rc)));
+        return boost::none;
+    }
+
+    std::unique_ptr<MDB_cursor, void (*)(MDB_cursor*)> cursorPtr(cursorRawPtr, [](MDB_cursor* p) {
+        if (p)
+            mdb_cursor_close(p);
+    });
+
+    // set the pointer to the first key that is not less than keyBegin
+    int itemRes = mdb_cursor_get(cursorPtr.get(), &kS, &vS, MDB_SET_RANGE);
+    if (itemRes != 0 && itemRes != MDB_NOTFOUND) {
+        const std::string dbgKey = KeyAsString(keyBegin, keyBegin);
+        NLog.write(b_sev::err, "readRange: Failed to seek to key " + dbgKey + "; with an error of code " +
+                                   std::to_string(itemRes) +
+                                   "; and error: " + std::string(mdb_strerror(itemRes)));
+        return boost::none;
+    }
+    std::vector<std::pair<std::string, std::string>> result;
+    while (itemRes == 0 && (limit == 0 || result.size() < limit)) {
+        assert(vS.mv_data != nullptr);
+        std::string keyFound(static_cast<const char*>(kS.mv_data), kS.mv_size);
+        if (keyFound >= keyEnd) {
+            break;
+        }
+        std::string value(static_cast<const char*>(vS.mv_data), vS.mv_size);
+        result.emplace_back(std::move(keyFound), std::move(value));
+
+        itemRes = mdb_cursor_get(cursorRawPtr, &kS, &vS, MDB_NEXT);
+    }
+
+    cursorPtr.reset();
+    return boost::make_optional(std::move(result));
+}
+
 bool LMDB::write(IDB::Index dbindex, const std::string& key, const std::string& value)
 {
     const MDB_dbi* dbPtr = getDbByIndex(dbindex);
@@ -880,7 +1034,7 @@ bool LMDB::exists(IDB::Index dbindex, const std::string& key) const
         return false;
 
     LMDBTransaction localTxn(false);
-    if (!activeBatch) {
+    if (!activeBatch && !LMDBReadSnapshot::Current()) {
         localTxn = LMDBTransaction();
         if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
             NLog.write(b_sev::err, "Failed to begin transaction at read with error code " +
@@ -903,7 +1057,7 @@ bool LMDB::exists(IDB::Index dbindex, const std::string& key) const
     MDB_val kS = {key.size(), (void*)(key.c_str())};
     MDB_val vS{0, nullptr};
 
-    if (auto ret = mdb_get((!activeBatch ? localTxn : *activeBatch), *dbPtr, &kS, &vS)) {
+    if (auto ret = mdb_get(readTxn(localTxn), *dbPtr, &kS, &vS)) {
         std::string dbgKey = KeyAsString(key, key);
         if (ret == MDB_NOTFOUND) {
             return false;
@@ -997,6 +1151,11 @@ MDB_dbi* LMDB::getDbByIndex(const IDB::Index index) const
         case IDB::Index::DB_BLOCKMETADATA_INDEX:  return dbPointers->db_blockMetadata.get();
         case IDB::Index::DB_BLOCKHEIGHTS_INDEX:   return dbPointers->db_blockHeights.get();
         case IDB::Index::DB_STAKES_INDEX:         return dbPointers->db_stakes.get();
+        case IDB::Index::DB_ORPHANBLOCKS_INDEX:   return dbPointers->db_orphanBlocks.get();
+        case IDB::Index::DB_ADDRESSTX_INDEX:      return dbPointers->db_addressTx.get();
+        case IDB::Index::DB_ADDRESSUNSPENT_INDEX: return dbPointers->db_addressUnspent.get();
+        case IDB::Index::DB_NTP1TOKENTRANSFERS_INDEX: return dbPointers->db_ntp1TokenTransfers.get();
+        case IDB::Index::DB_NTP1TOKENHOLDERS_INDEX:   return dbPointers->db_ntp1TokenHolders.get();
     }
     // clang-format on
     throw std::runtime_error("Invalid db index provided in getDbByIndex");
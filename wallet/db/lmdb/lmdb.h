@@ -24,13 +24,21 @@ struct __lmdb_db_pointers
     DbSmartPtrType db_blockMetadata;
     DbSmartPtrType db_blockHeights;
     DbSmartPtrType db_stakes;
+    DbSmartPtrType db_orphanBlocks;
+    DbSmartPtrType db_addressTx;
+    DbSmartPtrType db_addressUnspent;
+    DbSmartPtrType db_ntp1TokenTransfers;
+    DbSmartPtrType db_ntp1TokenHolders;
 
     __lmdb_db_pointers()
         : db_main(nullptr, [](MDB_dbi*) {}), db_blockIndex(nullptr, [](MDB_dbi*) {}),
           db_blocks(nullptr, [](MDB_dbi*) {}), db_tx(nullptr, [](MDB_dbi*) {}),
           db_ntp1Tx(nullptr, [](MDB_dbi*) {}), db_ntp1tokenNames(nullptr, [](MDB_dbi*) {}),
           db_addrsVsPubKeys(nullptr, [](MDB_dbi*) {}), db_blockMetadata(nullptr, [](MDB_dbi*) {}),
-          db_blockHeights(nullptr, [](MDB_dbi*) {}), db_stakes(nullptr, [](MDB_dbi*) {})
+          db_blockHeights(nullptr, [](MDB_dbi*) {}), db_stakes(nullptr, [](MDB_dbi*) {}),
+          db_orphanBlocks(nullptr, [](MDB_dbi*) {}), db_addressTx(nullptr, [](MDB_dbi*) {}),
+          db_addressUnspent(nullptr, [](MDB_dbi*) {}), db_ntp1TokenTransfers(nullptr, [](MDB_dbi*) {}),
+          db_ntp1TokenHolders(nullptr, [](MDB_dbi*) {})
     {
     }
 
@@ -46,6 +54,11 @@ struct __lmdb_db_pointers
         db_blockMetadata.reset();
         db_blockHeights.reset();
         db_stakes.reset();
+        db_orphanBlocks.reset();
+        db_addressTx.reset();
+        db_addressUnspent.reset();
+        db_ntp1TokenTransfers.reset();
+        db_ntp1TokenHolders.reset();
     }
 };
 
@@ -57,6 +70,29 @@ class path;
 }
 } // namespace boost
 
+/**
+ * While alive, makes every read from the database in the constructing thread go through one
+ * read-only transaction, so that a series of reads sees a single consistent state of the database
+ * even while blocks are being connected by other threads. An inner snapshot in a thread that
+ * already has one does nothing. Nothing may be written to the database from a thread that holds a
+ * snapshot, and it should be kept only for as long as one request takes, since a map resize has to
+ * wait for it.
+ */
+class LMDBReadSnapshot
+{
+    LMDBTransaction txn;
+    bool            owner = false;
+
+public:
+    LMDBReadSnapshot();
+    ~LMDBReadSnapshot();
+    LMDBReadSnapshot(const LMDBReadSnapshot&) = delete;
+    LMDBReadSnapshot& operator=(const LMDBReadSnapshot&) = delete;
+
+    // the snapshot transaction of the calling thread, or nullptr if there's none
+    static MDB_txn* Current();
+};
+
 class LMDB : public IDB
 {
     const boost::filesystem::path* const dbdir_;
@@ -73,6 +109,9 @@ class LMDB : public IDB
 
     MDB_dbi* getDbByIndex(const Index index) const;
 
+    // the transaction a read should use if it doesn't start its own
+    MDB_txn* readTxn(LMDBTransaction& localTxn) const;
+
     // A batch stores up writes and deletes for atomic application. When this
     // field is non-NULL, writes/deletes go there instead of directly to disk.
     std::unique_ptr<LMDBTransaction> activeBatch;
@@ -89,6 +128,9 @@ public:
     boost::optional<std::map<std::string, std::vector<std::string>>>
                                                         readAll(IDB::Index dbindex) const override;
     boost::optional<std::map<std::string, std::string>> readAllUnique(IDB::Index dbindex) const override;
+    boost::optional<std::vector<std::pair<std::string, std::string>>>
+    readRange(IDB::Index dbindex, const std::string& keyBegin, const std::string& keyEnd,
+              std::size_t limit = 0) const override;
     bool write(IDB::Index dbindex, const std::string& key, const std::string& value) override;
     bool erase(IDB::Index dbindex, const std::string& key) override;
     bool eraseAll(IDB::Index dbindex, const std::string& key) override;
@@ -0,0 +1,469 @@
+#include "lmdbwallet.h"
+
+#include "logging/logger.h"
+#include "stringmanip.h"
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+// the map grows by doubling, starting from this
+const std::size_t WALLET_LMDB_INITIAL_MAPSIZE = 1 << 26;
+// a batch fails if the map fills up in the middle of it, so there has to be this much free space when
+// one begins, which is way more than the records of a block
+const std::size_t WALLET_LMDB_BATCH_HEADROOM = 1 << 24;
+
+std::string LMDBErrorString(int rc) { return std::to_string(rc) + " (" + mdb_strerror(rc) + ")"; }
+
+MDB_val ToMDBVal(const std::string& str)
+{
+    MDB_val result;
+    result.mv_data = const_cast<char*>(str.data());
+    result.mv_size = str.size();
+    return result;
+}
+
+std::string FromMDBVal(const MDB_val& val)
+{
+    return std::string(static_cast<const char*>(val.mv_data), val.mv_size);
+}
+} // namespace
+
+std::mutex                                                LMDBWalletStorage::registryMutex;
+std::map<std::string, std::shared_ptr<LMDBWalletStorage>> LMDBWalletStorage::registry;
+
+LMDBWalletStorage::LMDBWalletStorage(const boost::filesystem::path& filePathIn) : filePath(filePathIn)
+{
+    if (const int rc = mdb_env_create(&env)) {
+        throw std::runtime_error("Error creating the lmdb environment of the wallet: " +
+                                 LMDBErrorString(rc));
+    }
+
+    // no subdirectory, as the wallet is a single file; MDB_NOTLS lets other threads read while a batch
+    // is open in this one
+    const std::string pathStr = PossiblyWideStringToString(filePath.native());
+    if (const int rc = mdb_env_open(env, pathStr.c_str(), MDB_NOSUBDIR | MDB_NOTLS | MDB_NOMETASYNC,
+                                    0600)) {
+        mdb_env_close(env);
+        throw std::runtime_error("Failed to open the wallet database " + pathStr + ": " +
+                                 LMDBErrorString(rc));
+    }
+
+    if (getMapSize() < WALLET_LMDB_INITIAL_MAPSIZE) {
+        mdb_env_set_mapsize(env, WALLET_LMDB_INITIAL_MAPSIZE);
+    }
+    if (needsGrowing(WALLET_LMDB_BATCH_HEADROOM)) {
+        growMap(WALLET_LMDB_BATCH_HEADROOM);
+    }
+
+    MDB_txn* txn = nullptr;
+    int      rc  = mdb_txn_begin(env, nullptr, 0, &txn);
+    if (rc == 0) {
+        rc = mdb_dbi_open(txn, nullptr, 0, &dbi);
+        rc = (rc == 0 ? mdb_txn_commit(txn) : (mdb_txn_abort(txn), rc));
+    }
+    if (rc) {
+        mdb_env_close(env);
+        throw std::runtime_error("Failed to open the wallet database " + pathStr + ": " +
+                                 LMDBErrorString(rc));
+    }
+    NLog.write(b_sev::info, "Opened the LMDB wallet database {}", pathStr);
+}
+
+LMDBWalletStorage::~LMDBWalletStorage()
+{
+    while (!batchTxns.empty()) {
+        mdb_txn_abort(batchTxns.back());
+        batchTxns.pop_back();
+    }
+    batchResizeLock.reset();
+    mdb_env_sync(env, 1);
+    mdb_env_close(env);
+}
+
+std::shared_ptr<LMDBWalletStorage> LMDBWalletStorage::Get(const boost::filesystem::path& filePath)
+{
+    std::lock_guard<std::mutex>         lock(registryMutex);
+    std::shared_ptr<LMDBWalletStorage>& storage = registry[filePath.string()];
+    if (!storage) {
+        storage = std::make_shared<LMDBWalletStorage>(filePath);
+    }
+    return storage;
+}
+
+std::shared_ptr<LMDBWalletStorage> LMDBWalletStorage::GetIfOpen(const boost::filesystem::path& filePath)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto                        it = registry.find(filePath.string());
+    return it == registry.end() ? nullptr : it->second;
+}
+
+void LMDBWalletStorage::Close(const boost::filesystem::path& filePath)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.erase(filePath.string());
+}
+
+void LMDBWalletStorage::CloseAll()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.clear();
+}
+
+bool LMDBWalletStorage::IsInUse(const boost::filesystem::path& filePath)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto                        it = registry.find(filePath.string());
+    return it != registry.end() && it->second.use_count() > 1;
+}
+
+bool LMDBWalletStorage::Compact(const boost::filesystem::path& filePath)
+{
+    // the registry lock keeps anyone from opening the file in the meantime
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto                        it = registry.find(filePath.string());
+    if (it != registry.end() && it->second.use_count() > 1) {
+        NLog.write(b_sev::err, "Can't compact the wallet database {} while it's in use",
+                   filePath.string());
+        return false;
+    }
+
+    std::shared_ptr<LMDBWalletStorage> storage =
+        (it != registry.end() ? it->second : std::make_shared<LMDBWalletStorage>(filePath));
+    if (it != registry.end()) {
+        registry.erase(it);
+    }
+    const boost::filesystem::path compactedPath = filePath.string() + ".compact";
+    if (!storage->backupTo(compactedPath)) {
+        return false;
+    }
+    storage.reset();
+
+    try {
+        boost::filesystem::rename(compactedPath, filePath);
+    } catch (const boost::filesystem::filesystem_error& ex) {
+        NLog.write(b_sev::err, "Failed to replace {} with its compacted copy: {}", filePath.string(),
+                   ex.what());
+        return false;
+    }
+    return true;
+}
+
+bool LMDBWalletStorage::IsLMDBFile(const boost::filesystem::path& filePath)
+{
+    static const uint32_t LMDB_MAGIC = 0xBEEFC0DE;
+
+    // the magic follows the page header, whose size depends on the size of pgno_t
+    unsigned char header[32] = {};
+    FILE*         file       = fopen(PossiblyWideStringToString(filePath.native()).c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    const std::size_t bytesRead = fread(header, 1, sizeof(header), file);
+    fclose(file);
+    for (std::size_t offset : {std::size_t(12), std::size_t(16)}) {
+        uint32_t magic = 0;
+        if (bytesRead >= offset + sizeof(magic)) {
+            memcpy(&magic, header + offset, sizeof(magic));
+            if (magic == LMDB_MAGIC) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+MDB_txn* LMDBWalletStorage::currentBatchTxn() const
+{
+    std::lock_guard<std::mutex> lock(batchOwnerMutex);
+    if (batchTxns.empty() || batchOwner != std::this_thread::get_id()) {
+        return nullptr;
+    }
+    return batchTxns.back();
+}
+
+bool LMDBWalletStorage::isBatchOwnedByThisThread() const { return currentBatchTxn() != nullptr; }
+
+int LMDBWalletStorage::withTxn(bool fReadOnly, const std::function<int(MDB_txn*)>& func)
+{
+    if (MDB_txn* batchTxn = currentBatchTxn()) {
+        return func(batchTxn);
+    }
+
+    int rc = 0;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        {
+            boost::shared_lock<boost::shared_mutex> lock(resizeMutex);
+
+            MDB_txn* txn = nullptr;
+            rc           = mdb_txn_begin(env, nullptr, fReadOnly ? MDB_RDONLY : 0, &txn);
+            if (rc) {
+                return rc;
+            }
+            rc = func(txn);
+            if (rc == 0 && !fReadOnly) {
+                rc = mdb_txn_commit(txn);
+            } else {
+                mdb_txn_abort(txn);
+            }
+        }
+        if (rc != MDB_MAP_FULL) {
+            return rc;
+        }
+        growMap(0);
+    }
+    return rc;
+}
+
+bool LMDBWalletStorage::needsGrowing(std::size_t minFreeBytes) const
+{
+    MDB_envinfo mei;
+    MDB_stat    mst;
+    mdb_env_info(env, &mei);
+    mdb_env_stat(env, &mst);
+    const uint64_t sizeUsed = static_cast<uint64_t>(mst.ms_psize) * (mei.me_last_pgno + 1);
+    return sizeUsed + minFreeBytes > mei.me_mapsize || sizeUsed > mei.me_mapsize / 10 * 9;
+}
+
+void LMDBWalletStorage::growMap(std::size_t minFreeBytes)
+{
+    boost::unique_lock<boost::shared_mutex> lock(resizeMutex);
+
+    // another thread could've grown it while waiting for the lock
+    if (minFreeBytes > 0 && !needsGrowing(minFreeBytes)) {
+        return;
+    }
+    const uint64_t newSize = std::max<uint64_t>(getMapSize() * 2, getMapSize() + minFreeBytes * 2);
+    if (const int rc = mdb_env_set_mapsize(env, newSize)) {
+        NLog.write(b_sev::err, "Failed to resize the wallet database map to {} bytes: {}", newSize,
+                   LMDBErrorString(rc));
+        return;
+    }
+    NLog.write(b_sev::info, "Wallet database map resized to {} bytes", newSize);
+}
+
+uint64_t LMDBWalletStorage::getMapSize() const
+{
+    MDB_envinfo mei;
+    mdb_env_info(env, &mei);
+    return mei.me_mapsize;
+}
+
+bool LMDBWalletStorage::read(const std::string& key, std::string& value)
+{
+    MDB_val k  = ToMDBVal(key);
+    int     rc = withTxn(true, [&](MDB_txn* txn) {
+        MDB_val v;
+        int     res = mdb_get(txn, dbi, &k, &v);
+        if (res == 0) {
+            value = FromMDBVal(v);
+        }
+        return res;
+    });
+    if (rc != 0 && rc != MDB_NOTFOUND) {
+        NLog.write(b_sev::err, "Failed to read from the wallet database: {}", LMDBErrorString(rc));
+    }
+    return rc == 0;
+}
+
+bool LMDBWalletStorage::write(const std::string& key, const std::string& value, bool fOverwrite)
+{
+    MDB_val k  = ToMDBVal(key);
+    MDB_val v  = ToMDBVal(value);
+    int     rc = withTxn(false, [&](MDB_txn* txn) {
+        return mdb_put(txn, dbi, &k, &v, fOverwrite ? 0 : MDB_NOOVERWRITE);
+    });
+    if (rc != 0 && rc != MDB_KEYEXIST) {
+        NLog.write(b_sev::err, "Failed to write to the wallet database: {}", LMDBErrorString(rc));
+    }
+    return rc == 0;
+}
+
+bool LMDBWalletStorage::erase(const std::string& key)
+{
+    MDB_val k  = ToMDBVal(key);
+    int     rc = withTxn(false, [&](MDB_txn* txn) {
+        int res = mdb_del(txn, dbi, &k, nullptr);
+        return res == MDB_NOTFOUND ? 0 : res;
+    });
+    if (rc != 0) {
+        NLog.write(b_sev::err, "Failed to erase from the wallet database: {}", LMDBErrorString(rc));
+    }
+    return rc == 0;
+}
+
+bool LMDBWalletStorage::exists(const std::string& key)
+{
+    MDB_val k = ToMDBVal(key);
+    return withTxn(true, [&](MDB_txn* txn) {
+               MDB_val v;
+               return mdb_get(txn, dbi, &k, &v);
+           }) == 0;
+}
+
+bool LMDBWalletStorage::forEach(const std::string& startKey, const RecordCallback& callback)
+{
+    int rc = withTxn(true, [&](MDB_txn* txn) {
+        MDB_cursor* cursor = nullptr;
+        if (int res = mdb_cursor_open(txn, dbi, &cursor)) {
+            return res;
+        }
+        MDB_val k = ToMDBVal(startKey);
+        MDB_val v;
+        int     res = mdb_cursor_get(cursor, &k, &v, startKey.empty() ? MDB_FIRST : MDB_SET_RANGE);
+        while (res == 0) {
+            if (!callback(FromMDBVal(k), FromMDBVal(v))) {
+                break;
+            }
+            res = mdb_cursor_get(cursor, &k, &v, MDB_NEXT);
+        }
+        mdb_cursor_close(cursor);
+        return res == MDB_NOTFOUND ? 0 : res;
+    });
+    if (rc != 0) {
+        NLog.write(b_sev::err, "Failed to iterate over the wallet database: {}", LMDBErrorString(rc));
+    }
+    return rc == 0;
+}
+
+bool LMDBWalletStorage::beginBatch(std::size_t expectedBytes)
+{
+    if (MDB_txn* parent = currentBatchTxn()) {
+        MDB_txn* txn = nullptr;
+        if (const int rc = mdb_txn_begin(env, parent, 0, &txn)) {
+            NLog.write(b_sev::err, "Failed to begin a nested wallet database batch: {}",
+                       LMDBErrorString(rc));
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(batchOwnerMutex);
+        batchTxns.push_back(txn);
+        return true;
+    }
+
+    const std::size_t headroom = WALLET_LMDB_BATCH_HEADROOM + expectedBytes;
+    if (needsGrowing(headroom)) {
+        growMap(headroom);
+    }
+
+    std::unique_ptr<boost::shared_lock<boost::shared_mutex>> resizeLock(
+        new boost::shared_lock<boost::shared_mutex>(resizeMutex));
+
+    // this waits for the batches and writes of other threads
+    MDB_txn* txn = nullptr;
+    if (const int rc = mdb_txn_begin(env, nullptr, 0, &txn)) {
+        NLog.write(b_sev::err, "Failed to begin a wallet database batch: {}", LMDBErrorString(rc));
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(batchOwnerMutex);
+    batchOwner      = std::this_thread::get_id();
+    batchResizeLock = std::move(resizeLock);
+    batchTxns.push_back(txn);
+    return true;
+}
+
+bool LMDBWalletStorage::commitBatch()
+{
+    MDB_txn* txn = currentBatchTxn();
+    if (!txn) {
+        return false;
+    }
+    const int rc = mdb_txn_commit(txn);
+
+    std::lock_guard<std::mutex> lock(batchOwnerMutex);
+    batchTxns.pop_back();
+    if (batchTxns.empty()) {
+        batchOwner = std::thread::id();
+        batchResizeLock.reset();
+    }
+    if (rc) {
+        NLog.write(b_sev::err, "Failed to commit a wallet database batch: {}", LMDBErrorString(rc));
+    }
+    return rc == 0;
+}
+
+bool LMDBWalletStorage::abortBatch()
+{
+    MDB_txn* txn = currentBatchTxn();
+    if (!txn) {
+        return false;
+    }
+    mdb_txn_abort(txn);
+
+    std::lock_guard<std::mutex> lock(batchOwnerMutex);
+    batchTxns.pop_back();
+    if (batchTxns.empty()) {
+        batchOwner = std::thread::id();
+        batchResizeLock.reset();
+    }
+    return true;
+}
+
+bool LMDBWalletStorage::backupTo(const boost::filesystem::path& destFilePath)
+{
+    // mdb_env_copy2() doesn't overwrite files, so the copy is moved over the destination afterwards
+    const boost::filesystem::path tempPath =
+        destFilePath.parent_path() / boost::filesystem::unique_path(".walletbackup-%%%%-%%%%");
+    const int rc = mdb_env_copy2(env, PossiblyWideStringToString(tempPath.native()).c_str(),
+                                 MDB_CP_COMPACT);
+    if (rc) {
+        NLog.write(b_sev::err, "Failed to copy the wallet database to {}: {}", tempPath.string(),
+                   LMDBErrorString(rc));
+        boost::system::error_code ec;
+        boost::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    try {
+        boost::filesystem::rename(tempPath, destFilePath);
+    } catch (const boost::filesystem::filesystem_error& ex) {
+        NLog.write(b_sev::err, "Failed to move the wallet backup to {}: {}", destFilePath.string(),
+                   ex.what());
+        boost::system::error_code ec;
+        boost::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool LMDBWalletStorage::sync() { return mdb_env_sync(env, 1) == 0; }
+
+uint64_t LMDBWalletStorage::getRecordCount()
+{
+    uint64_t result = 0;
+    withTxn(true, [&](MDB_txn* txn) {
+        MDB_stat st;
+        int      res = mdb_stat(txn, dbi, &st);
+        if (res == 0) {
+            result = st.ms_entries;
+        }
+        return res;
+    });
+    return result;
+}
+
+LMDBWalletBatchScope::LMDBWalletBatchScope(const std::shared_ptr<LMDBWalletStorage>& storageIn)
+    : storage(storageIn)
+{
+    if (storage) {
+        fActive = storage->beginBatch();
+    }
+}
+
+LMDBWalletBatchScope::~LMDBWalletBatchScope() { commit(); }
+
+bool LMDBWalletBatchScope::commit()
+{
+    if (!fActive) {
+        return false;
+    }
+    fActive = false;
+    return storage->commitBatch();
+}
+
+void LMDBWalletBatchScope::abort()
+{
+    if (fActive) {
+        fActive = false;
+        storage->abortBatch();
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef LMDBWALLET_H
+#define LMDBWALLET_H
+
+#include "liblmdb/lmdb.h"
+
+#include <boost/filesystem/path.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Storage of a wallet in its own LMDB environment (a single file, next to where wallet.dat would be).
+ * Keys and values are the serialized records of CWalletDB, in the same byte order as in BerkeleyDB, so
+ * range scans behave the same.
+ *
+ * A batch is a write transaction owned by the thread that began it. Everything that thread writes or
+ * reads goes through the batch until it's committed, no matter which CDB object does it, while other
+ * threads see only committed data and their writes wait for the batch to end. Batches of a thread can
+ * be nested, the inner ones become child transactions.
+ *
+ * Every transaction holds the resize mutex in shared mode, so that the map can be grown when it's full.
+ */
+class LMDBWalletStorage
+{
+public:
+    using RecordCallback = std::function<bool(const std::string& key, const std::string& value)>;
+
+    explicit LMDBWalletStorage(const boost::filesystem::path& filePath);
+    ~LMDBWalletStorage();
+
+    LMDBWalletStorage(const LMDBWalletStorage&) = delete;
+    LMDBWalletStorage& operator=(const LMDBWalletStorage&) = delete;
+
+    /// the storage of the file; environments stay open until Close() or CloseAll()
+    static std::shared_ptr<LMDBWalletStorage> Get(const boost::filesystem::path& filePath);
+    static std::shared_ptr<LMDBWalletStorage> GetIfOpen(const boost::filesystem::path& filePath);
+    static void                               Close(const boost::filesystem::path& filePath);
+    static void                               CloseAll();
+
+    /// whether someone other than the registry holds the storage of the file
+    static bool IsInUse(const boost::filesystem::path& filePath);
+
+    /// replaces the file with a compacted copy of it; fails if the storage is in use
+    static bool Compact(const boost::filesystem::path& filePath);
+
+    /// checks the magic number of the meta page, so that a wallet.dat of BerkeleyDB isn't opened in LMDB
+    static bool IsLMDBFile(const boost::filesystem::path& filePath);
+
+    bool read(const std::string& key, std::string& value);
+    bool write(const std::string& key, const std::string& value, bool fOverwrite = true);
+    bool erase(const std::string& key);
+    bool exists(const std::string& key);
+
+    /**
+     * Calls the callback for every record with a key not less than startKey (all records for an empty
+     * key), in key order, until it returns false. The records are read in a single transaction, and the
+     * callback shouldn't write to the storage. Returns false on database errors.
+     */
+    bool forEach(const std::string& startKey, const RecordCallback& callback);
+
+    /// a batch fails if it doesn't fit in the free space of the map, which is grown to have at least
+    /// expectedBytes (and some headroom) free before it begins
+    bool beginBatch(std::size_t expectedBytes = 0);
+    bool commitBatch();
+    bool abortBatch();
+    bool isBatchOwnedByThisThread() const;
+
+    /// writes a compacted copy of the storage to the file, which is replaced if it exists
+    bool backupTo(const boost::filesystem::path& destFilePath);
+
+    /// commits don't wait for the meta page to reach the disk (like BerkeleyDB's DB_TXN_WRITE_NOSYNC),
+    /// this flushes it; a crash before that can only lose the last commits
+    bool sync();
+
+    uint64_t getRecordCount();
+    uint64_t getMapSize() const;
+
+    const boost::filesystem::path& getFilePath() const { return filePath; }
+
+private:
+    boost::filesystem::path filePath;
+    MDB_env*                env = nullptr;
+    MDB_dbi                 dbi = 0;
+
+    boost::shared_mutex resizeMutex;
+
+    // the batch; only the owner thread touches batchTxns, other threads only compare the owner
+    mutable std::mutex                                       batchOwnerMutex;
+    std::thread::id                                          batchOwner;
+    std::vector<MDB_txn*>                                    batchTxns;
+    std::unique_ptr<boost::shared_lock<boost::shared_mutex>> batchResizeLock;
+
+    MDB_txn* currentBatchTxn() const;
+
+    /// runs func in the batch of this thread or in a new transaction; retries once after growing the
+    /// map if a write outside of a batch fills it
+    int withTxn(bool fReadOnly, const std::function<int(MDB_txn*)>& func);
+
+    void growMap(std::size_t minFreeBytes);
+    bool needsGrowing(std::size_t minFreeBytes) const;
+
+    static std::mutex                                                registryMutex;
+    static std::map<std::string, std::shared_ptr<LMDBWalletStorage>> registry;
+};
+
+/** Begins a batch of the storage in the constructor and commits it in the destructor */
+class LMDBWalletBatchScope
+{
+    std::shared_ptr<LMDBWalletStorage> storage;
+    bool                               fActive = false;
+
+public:
+    explicit LMDBWalletBatchScope(const std::shared_ptr<LMDBWalletStorage>& storageIn);
+    ~LMDBWalletBatchScope();
+
+    LMDBWalletBatchScope(const LMDBWalletBatchScope&) = delete;
+    LMDBWalletBatchScope& operator=(const LMDBWalletBatchScope&) = delete;
+
+    bool commit();
+    void abort();
+};
+
+#endif // LMDBWALLET_H
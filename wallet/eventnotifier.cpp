@@ -0,0 +1,106 @@
+#include "eventnotifier.h"
+
+#include "logging/logger.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/thread.hpp>
+
+#ifdef __linux__
+
+CEventNotifier::CEventNotifier() : eventFD(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    if (eventFD < 0) {
+        NLog.write(b_sev::err, "CEventNotifier: failed to create eventfd, error {}", errno);
+    }
+}
+
+CEventNotifier::~CEventNotifier()
+{
+    if (eventFD >= 0) {
+        close(eventFD);
+    }
+}
+
+void CEventNotifier::notify()
+{
+    if (eventFD < 0) {
+        return;
+    }
+    const uint64_t one = 1;
+    // a failure can only mean that the counter is saturated, which means it's already signaled
+    ssize_t written = write(eventFD, &one, sizeof(one));
+    (void)written;
+}
+
+bool CEventNotifier::wait(int64_t timeoutMillis)
+{
+    if (eventFD < 0) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(timeoutMillis));
+        return false;
+    }
+    struct pollfd pfd;
+    pfd.fd      = eventFD;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    const int r = poll(&pfd, 1, static_cast<int>(timeoutMillis));
+    if (r <= 0) {
+        return false;
+    }
+    reset();
+    return true;
+}
+
+void CEventNotifier::reset()
+{
+    if (eventFD < 0) {
+        return;
+    }
+    uint64_t counter = 0;
+    ssize_t  readRes = read(eventFD, &counter, sizeof(counter));
+    (void)readRes;
+}
+
+int CEventNotifier::GetPollableFD() const { return eventFD; }
+
+#else
+
+CEventNotifier::CEventNotifier() : fNotified(false) {}
+
+CEventNotifier::~CEventNotifier() {}
+
+void CEventNotifier::notify()
+{
+    {
+        boost::lock_guard<boost::mutex> lg(mtx);
+        fNotified = true;
+    }
+    cond.notify_one();
+}
+
+bool CEventNotifier::wait(int64_t timeoutMillis)
+{
+    boost::unique_lock<boost::mutex> lock(mtx);
+    if (!fNotified) {
+        cond.timed_wait(lock, boost::posix_time::milliseconds(timeoutMillis));
+    }
+    const bool result = fNotified;
+    fNotified         = false;
+    return result;
+}
+
+void CEventNotifier::reset()
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    fNotified = false;
+}
+
+int CEventNotifier::GetPollableFD() const { return -1; }
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef EVENTNOTIFIER_H
+#define EVENTNOTIFIER_H
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstdint>
+
+/**
+ * A one-shot wake-up signal between threads. A call to notify() wakes one waiter in wait(), or, if
+ * nobody is waiting, makes the next wait() return immediately. Notifications don't accumulate.
+ *
+ * On Linux this is backed by an eventfd, whose descriptor can be registered in an epoll set
+ * (see GetPollableFD()) so that an epoll_wait() call can be interrupted by notify().
+ */
+class CEventNotifier
+{
+#ifdef __linux__
+    int eventFD;
+#else
+    boost::mutex              mtx;
+    boost::condition_variable cond;
+    bool                      fNotified;
+#endif
+
+public:
+    CEventNotifier();
+    ~CEventNotifier();
+
+    CEventNotifier(const CEventNotifier&) = delete;
+    CEventNotifier& operator=(const CEventNotifier&) = delete;
+
+    void notify();
+
+    /**
+     * Blocks until notify() is called or the timeout elapses
+     * returns true if woken up by a notification, false on timeout
+     */
+    bool wait(int64_t timeoutMillis);
+
+    /** Consumes a pending notification, if any, without blocking */
+    void reset();
+
+    /** The file descriptor that becomes readable on notify(), or -1 if not supported */
+    int GetPollableFD() const;
+};
+
+#endif // EVENTNOTIFIER_H
@@ -22,7 +22,7 @@ extern BestChainState bestChain;
 
 extern CTxMemPool mempool;
 
-extern CCriticalSection cs_main;
+extern CSharedCriticalSection cs_main;
 // extern BlockIndexMapType   mapBlockIndex;
 extern boost::shared_ptr<CBlockIndex> pindexGenesisBlock;
 
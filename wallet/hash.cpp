@@ -1,40 +1,42 @@
 #include "hash.h"
 
-inline uint32_t ROTL32(uint32_t x, int8_t r) { return (x << r) | (x >> (32 - r)); }
-
-unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash)
-{
-    // The following is MurmurHash3 (x86_32), see
-    // http://code.google.com/p/smhasher/source/browse/trunk/MurmurHash3.cpp
-    uint32_t       h1 = nHashSeed;
-    const uint32_t c1 = 0xcc9e2d51;
-    const uint32_t c2 = 0x1b873593;
+#include <algorithm>
+#include <cstring>
 
-    const int nblocks = vDataToHash.size() / 4;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-    //----------
-    // body
-    const uint32_t* blocks = (const uint32_t*)(&vDataToHash[0] + nblocks * 4);
+inline uint32_t ROTL32(uint32_t x, int8_t r) { return (x << r) | (x >> (32 - r)); }
 
-    for (int i = -nblocks; i; i++) {
-        uint32_t k1 = blocks[i];
+// The following is MurmurHash3 (x86_32), see
+// http://code.google.com/p/smhasher/source/browse/trunk/MurmurHash3.cpp
+// The mixing of the blocks of the data doesn't depend on the seed, so it's shared by all the seeds of
+// MurmurHash3Seeds(), which only repeats the updates of the state for each of them.
 
-        k1 *= c1;
-        k1 = ROTL32(k1, 15);
-        k1 *= c2;
+static const uint32_t MURMUR_C1 = 0xcc9e2d51;
+static const uint32_t MURMUR_C2 = 0x1b873593;
 
-        h1 ^= k1;
-        h1 = ROTL32(h1, 13);
-        h1 = h1 * 5 + 0xe6546b64;
-    }
+static inline uint32_t MurmurMixBlock(uint32_t k1)
+{
+    k1 *= MURMUR_C1;
+    k1 = ROTL32(k1, 15);
+    k1 *= MURMUR_C2;
+    return k1;
+}
 
-    //----------
-    // tail
-    const uint8_t* tail = (const uint8_t*)(&vDataToHash[0] + nblocks * 4);
+static inline uint32_t MurmurReadBlock(const unsigned char* p)
+{
+    uint32_t k1;
+    memcpy(&k1, p, 4);
+    return k1;
+}
 
+// the tail of the data, before MurmurMixBlock(); zero if there's none
+static inline uint32_t MurmurReadTail(const unsigned char* tail, size_t nLen)
+{
     uint32_t k1 = 0;
-
-    switch (vDataToHash.size() & 3) {
+    switch (nLen & 3) {
     // fall through comments prevent warnings
     case 3:
         k1 ^= tail[2] << 16; // fall through
@@ -42,24 +44,208 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
         k1 ^= tail[1] << 8; // fall through
     case 1:
         k1 ^= tail[0];
-        k1 *= c1;
-        k1 = ROTL32(k1, 15);
-        k1 *= c2;
-        h1 ^= k1;
     };
+    return k1;
+}
 
-    //----------
-    // finalization
-    h1 ^= vDataToHash.size();
+static inline uint32_t MurmurFinalize(uint32_t h1, size_t nLen)
+{
+    h1 ^= static_cast<uint32_t>(nLen);
     h1 ^= h1 >> 16;
     h1 *= 0x85ebca6b;
     h1 ^= h1 >> 13;
     h1 *= 0xc2b2ae35;
     h1 ^= h1 >> 16;
-
     return h1;
 }
 
+unsigned int MurmurHash3(unsigned int nHashSeed, const unsigned char* pData, size_t nLen)
+{
+    uint32_t     h1      = nHashSeed;
+    const size_t nblocks = nLen / 4;
+
+    //----------
+    // body
+    for (size_t i = 0; i < nblocks; i++) {
+        h1 ^= MurmurMixBlock(MurmurReadBlock(pData + i * 4));
+        h1 = ROTL32(h1, 13);
+        h1 = h1 * 5 + 0xe6546b64;
+    }
+
+    //----------
+    // tail
+    if (nLen & 3)
+        h1 ^= MurmurMixBlock(MurmurReadTail(pData + nblocks * 4, nLen));
+
+    //----------
+    // finalization
+    return MurmurFinalize(h1, nLen);
+}
+
+unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash)
+{
+    return MurmurHash3(nHashSeed, vDataToHash.data(), vDataToHash.size());
+}
+
+// the number of seeds hashed together by MurmurHash3Seeds()
+static const unsigned int MURMUR_LANES = 8;
+
+#if defined(__SSE2__)
+
+static inline __m128i MurmurRotl13(__m128i h)
+{
+    return _mm_or_si128(_mm_slli_epi32(h, 13), _mm_srli_epi32(h, 19));
+}
+
+// the low 32 bits of the products of every lane by b; SSE2 has no _mm_mullo_epi32()
+static inline __m128i MurmurMullo(__m128i a, uint32_t b)
+{
+    const __m128i vb   = _mm_set1_epi32(static_cast<int>(b));
+    const __m128i even = _mm_mul_epu32(a, vb);
+    const __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), vb);
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i MurmurRound(__m128i h, __m128i k1)
+{
+    h = MurmurRotl13(_mm_xor_si128(h, k1));
+    // h * 5 + 0xe6546b64
+    const __m128i h5 = _mm_add_epi32(h, _mm_slli_epi32(h, 2));
+    return _mm_add_epi32(h5, _mm_set1_epi32(static_cast<int>(0xe6546b64)));
+}
+
+static inline __m128i MurmurFinalizeLanes(__m128i h, size_t nLen)
+{
+    h = _mm_xor_si128(h, _mm_set1_epi32(static_cast<int>(nLen)));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    h = MurmurMullo(h, 0x85ebca6b);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+    h = MurmurMullo(h, 0xc2b2ae35);
+    return _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+}
+
+static void MurmurHash3Lanes(const uint32_t* seeds, const unsigned char* pData, size_t nLen,
+                             uint32_t* pHashes)
+{
+    __m128i      h0      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(seeds));
+    __m128i      h1      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(seeds + 4));
+    const size_t nblocks = nLen / 4;
+    for (size_t i = 0; i < nblocks; i++) {
+        const __m128i k1 =
+            _mm_set1_epi32(static_cast<int>(MurmurMixBlock(MurmurReadBlock(pData + i * 4))));
+        h0 = MurmurRound(h0, k1);
+        h1 = MurmurRound(h1, k1);
+    }
+    if (nLen & 3) {
+        const __m128i k1 =
+            _mm_set1_epi32(static_cast<int>(MurmurMixBlock(MurmurReadTail(pData + nblocks * 4, nLen))));
+        h0 = _mm_xor_si128(h0, k1);
+        h1 = _mm_xor_si128(h1, k1);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pHashes), MurmurFinalizeLanes(h0, nLen));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pHashes + 4), MurmurFinalizeLanes(h1, nLen));
+}
+
+#else
+
+static void MurmurHash3Lanes(const uint32_t* seeds, const unsigned char* pData, size_t nLen,
+                             uint32_t* pHashes)
+{
+    uint32_t h[MURMUR_LANES];
+    std::copy(seeds, seeds + MURMUR_LANES, h);
+    const size_t nblocks = nLen / 4;
+    for (size_t i = 0; i < nblocks; i++) {
+        const uint32_t k1 = MurmurMixBlock(MurmurReadBlock(pData + i * 4));
+        for (unsigned int j = 0; j < MURMUR_LANES; j++) {
+            h[j] ^= k1;
+            h[j] = ROTL32(h[j], 13);
+            h[j] = h[j] * 5 + 0xe6546b64;
+        }
+    }
+    if (nLen & 3) {
+        const uint32_t k1 = MurmurMixBlock(MurmurReadTail(pData + nblocks * 4, nLen));
+        for (unsigned int j = 0; j < MURMUR_LANES; j++)
+            h[j] ^= k1;
+    }
+    for (unsigned int j = 0; j < MURMUR_LANES; j++)
+        pHashes[j] = MurmurFinalize(h[j], nLen);
+}
+
+#endif
+
+void MurmurHash3Seeds(uint32_t nSeed, uint32_t nSeedStep, const unsigned char* pData, size_t nLen,
+                      uint32_t* pHashes, unsigned int nHashes)
+{
+    uint32_t seeds[MURMUR_LANES];
+    uint32_t hashes[MURMUR_LANES];
+    for (unsigned int i = 0; i < nHashes; i += MURMUR_LANES) {
+        const unsigned int n = std::min(MURMUR_LANES, nHashes - i);
+        if (n == 1) {
+            pHashes[i] = MurmurHash3(nSeed + i * nSeedStep, pData, nLen);
+            break;
+        }
+        for (unsigned int j = 0; j < MURMUR_LANES; j++)
+            seeds[j] = nSeed + (i + j) * nSeedStep;
+        MurmurHash3Lanes(seeds, pData, nLen, hashes);
+        std::copy(hashes, hashes + n, pHashes + i);
+    }
+}
+
+#define ROTL64(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND                                                                                    \
+    do {                                                                                            \
+        v0 += v1;                                                                                   \
+        v1 = ROTL64(v1, 13);                                                                        \
+        v1 ^= v0;                                                                                   \
+        v0 = ROTL64(v0, 32);                                                                        \
+        v2 += v3;                                                                                   \
+        v3 = ROTL64(v3, 16);                                                                        \
+        v3 ^= v2;                                                                                   \
+        v0 += v3;                                                                                   \
+        v3 = ROTL64(v3, 21);                                                                        \
+        v3 ^= v0;                                                                                   \
+        v2 += v1;                                                                                   \
+        v1 = ROTL64(v1, 17);                                                                        \
+        v1 ^= v2;                                                                                   \
+        v2 = ROTL64(v2, 32);                                                                        \
+    } while (0)
+
+uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val)
+{
+    // SipHash-2-4 of the 32 bytes of val, see https://131002.net/siphash/
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+    for (int i = 0; i < 4; i++) {
+        const uint64_t m = val.Get64(i);
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+
+    // the last block holds the message length, 32, in its most significant byte
+    const uint64_t last = ((uint64_t)32) << 56;
+    v3 ^= last;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= last;
+
+    v2 ^= 0xFF;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+#undef SIPROUND
+#undef ROTL64
+
 void* KDF_SHA256(const void* in, size_t inlen, void* out, size_t* outlen)
 {
 #ifndef OPENSSL_NO_SHA
@@ -0,0 +1,523 @@
+#include "headerssync.h"
+
+#include "arith_uint256.h"
+#include "blocklocator.h"
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "logging/logger.h"
+#include "main.h"
+#include "net.h"
+#include "runtimeconfig.h"
+#include "util.h"
+
+#include <algorithm>
+
+CHeadersSync headersSync;
+
+static uint256 GetHeaderTrust(const CBlock& header)
+{
+    bool          fNegative;
+    bool          fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(header.nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || bnTarget == 0)
+        return 0;
+    // 2**256 / (bnTarget+1), as in CBlockIndex::GetBlockTrust()
+    return ArithToUint256((~bnTarget / (bnTarget + 1)) + 1);
+}
+
+/**
+ * The checks that can be done with the header alone. The proof-of-stake kernel and everything else
+ * is checked by AcceptBlock() once the block arrives.
+ * @param fValidPoW set to true if the header satisfies the proof-of-work, so its trust is real
+ */
+static bool CheckHeader(const CBlock& header, const uint256& hash, int nHeight, int64_t nPrevTime,
+                        unsigned int nPrevBits, bool& fValidPoW, int& nDoS)
+{
+    nDoS = 0;
+
+    bool          fNegative;
+    bool          fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(header.nBits, &fNegative, &fOverflow);
+    // a header of the proof-of-work part of the chain that doesn't satisfy the proof-of-work must be
+    // proof-of-stake, which we can't verify here beyond its target limit; GetNextTargetRequired()
+    // gives proof-of-stake blocks the proof-of-work limit where blocks are mined on demand
+    const arith_uint256& bnPoSLimit =
+        Params().MineBlocksOnDemand() ? Params().PoWLimit() : Params().PoSLimit();
+    fValidPoW = nHeight <= Params().LastPoWBlock() && CheckProofOfWork(hash, header.nBits, true);
+    if (!fValidPoW && (fNegative || fOverflow || bnTarget == 0 || bnTarget > bnPoSLimit)) {
+        nDoS = 100;
+        return NLog.error("CheckHeader(): header {} at height {} has invalid difficulty bits",
+                          hash.ToString(), nHeight);
+    }
+
+    // Past the proof-of-work blocks, the parent is a proof-of-stake block too, and the retargeting of
+    // GetNextTargetRequired() limits how much harder the target gets per block. A header much harder
+    // than its parent is made up. The 255/256 leaves room for the rounding of the compact targets.
+    const int nHeightLast = nHeight - 1;
+    if (!fValidPoW && !Params().MineBlocksOnDemand() && nHeightLast > Params().LastPoWBlock() &&
+        nHeightLast >= RETARGET_V2_START_HEIGHT) {
+        int64_t nNumerator;
+        int64_t nDenominator;
+        GetMinTargetScale(nHeightLast, nNumerator, nDenominator);
+        arith_uint256 bnPrevTarget;
+        bnPrevTarget.SetCompact(nPrevBits, &fNegative, &fOverflow);
+        if (!fNegative && !fOverflow &&
+            arith_uint512(bnTarget) * static_cast<uint32_t>(256 * nDenominator) <
+                arith_uint512(bnPrevTarget) * static_cast<uint32_t>(255 * nNumerator)) {
+            nDoS = 100;
+            return NLog.error("CheckHeader(): header {} at height {} has a target harder than the "
+                              "retargeting allows",
+                              hash.ToString(), nHeight);
+        }
+    }
+
+    // too far in the future can be our clock, so the peer isn't punished for it
+    if (header.GetBlockTime() > FutureDrift(GetAdjustedTime()))
+        return NLog.error("CheckHeader(): header {} has a timestamp too far in the future",
+                          hash.ToString());
+
+    if (FutureDrift(header.GetBlockTime()) < nPrevTime)
+        return NLog.error("CheckHeader(): header {} has a timestamp too early", hash.ToString());
+
+    if (!Checkpoints::CheckHardened(nHeight, hash)) {
+        nDoS = 100;
+        return NLog.error("CheckHeader(): header {} rejected by hardened checkpoint at height {}",
+                          hash.ToString(), nHeight);
+    }
+
+    return true;
+}
+
+bool CHeadersSync::IsEnabled() { return GetRuntimeConfig().fHeadersFirst; }
+
+CHeadersSync::AcceptHeadersResult CHeadersSync::AcceptHeaders(const std::vector<CBlock>& vHeaders,
+                                                              const ITxDB& txdb)
+{
+    AcceptHeadersResult result;
+
+    const int nOurHeight = txdb.GetBestChainHeight().value_or(0);
+
+    // hashing is the bulk of the work here, so it's done in batches and before taking the lock
+    const std::vector<uint256> vHashes = CBlock::GetHashes(vHeaders);
+
+    LOCK(cs);
+    for (unsigned i = 0; i < vHeaders.size(); i++) {
+        const CBlock&  header = vHeaders[i];
+        const uint256& hash   = vHashes[i];
+
+        if (mapHeaders.count(hash) || txdb.ReadBlockIndex(hash)) {
+            result.lastHash = hash;
+            continue;
+        }
+
+        int          nPrevHeight;
+        int64_t      nPrevTime;
+        unsigned int nPrevBits;
+        uint256      nPrevTrust;
+        uint256      nTrustCap;
+        const auto   prevIt = mapHeaders.find(header.hashPrevBlock);
+        if (prevIt != mapHeaders.end()) {
+            nPrevHeight = prevIt->second.nHeight;
+            nPrevTime   = prevIt->second.header.GetBlockTime();
+            nPrevBits   = prevIt->second.header.nBits;
+            nPrevTrust  = prevIt->second.nChainTrust;
+            nTrustCap   = prevIt->second.nTrustCap;
+        } else if (const boost::optional<CBlockIndex> prevIndex =
+                       txdb.ReadBlockIndex(header.hashPrevBlock)) {
+            nPrevHeight = prevIndex->nHeight;
+            nPrevTime   = prevIndex->GetBlockTime();
+            nPrevBits   = prevIndex->nBits;
+            nPrevTrust  = prevIndex->nChainTrust;
+            // a validated block, so its difficulty is a real one
+            nTrustCap = prevIndex->GetBlockTrust();
+        } else {
+            // the first header may not connect if the peer switched to another chain meanwhile, but
+            // the rest of the message must be a chain
+            if (i > 0)
+                result.nDoS = 20;
+            NLog.write(b_sev::info, "AcceptHeaders(): header {} doesn't connect to any known block",
+                       hash.ToString());
+            break;
+        }
+
+        const int nHeight = nPrevHeight + 1;
+        if (nHeight > nOurHeight + MAX_HEADERS_AHEAD) {
+            // we'll come back for the rest when we've downloaded some blocks
+            break;
+        }
+
+        bool fValidPoW;
+        if (!CheckHeader(header, hash, nHeight, nPrevTime, nPrevBits, fValidPoW, result.nDoS))
+            break;
+
+        // nothing backs the target of a proof-of-stake header until its block is validated, so it
+        // can't be worth more than the blocks we have
+        uint256 nTrust = GetHeaderTrust(header);
+        if (!fValidPoW && nTrust > nTrustCap)
+            nTrust = nTrustCap;
+
+        HeaderEntry entry;
+        entry.header      = header.GetBlockHeader();
+        entry.nHeight     = nHeight;
+        entry.nChainTrust = nPrevTrust + nTrust;
+        entry.nTrustCap   = nTrustCap;
+        if (entry.nChainTrust > nBestHeaderTrust) {
+            hashBestHeader    = hash;
+            nBestHeaderHeight = nHeight;
+            nBestHeaderTrust  = entry.nChainTrust;
+            fBestChainDirty   = true;
+        }
+        mapHeaders.insert(std::make_pair(hash, std::move(entry)));
+        mapHeadersByPrev.insert(std::make_pair(header.hashPrevBlock, hash));
+
+        result.nNew++;
+        result.lastHash = hash;
+    }
+
+    return result;
+}
+
+void CHeadersSync::UpdateBestChain_unsafe()
+{
+    if (!fBestChainDirty)
+        return;
+    fBestChainDirty = false;
+
+    vBestChain.clear();
+    auto it = mapHeaders.find(hashBestHeader);
+    while (it != mapHeaders.end()) {
+        vBestChain.push_back(it->first);
+        it = mapHeaders.find(it->second.header.hashPrevBlock);
+    }
+    std::reverse(vBestChain.begin(), vBestChain.end());
+}
+
+void CHeadersSync::RemoveHeaderAndDescendants_unsafe(const uint256& hash)
+{
+    std::vector<uint256> vToRemove{hash};
+    for (unsigned i = 0; i < vToRemove.size(); i++) {
+        const uint256 h = vToRemove[i];
+        const auto    it = mapHeaders.find(h);
+        if (it == mapHeaders.end())
+            continue;
+
+        const auto children = mapHeadersByPrev.equal_range(h);
+        for (auto c = children.first; c != children.second; ++c)
+            vToRemove.push_back(c->second);
+        mapHeadersByPrev.erase(h);
+
+        const auto siblings = mapHeadersByPrev.equal_range(it->second.header.hashPrevBlock);
+        for (auto s = siblings.first; s != siblings.second; ++s) {
+            if (s->second == h) {
+                mapHeadersByPrev.erase(s);
+                break;
+            }
+        }
+
+        const auto inFlightIt = mapBlocksInFlight.find(h);
+        if (inFlightIt != mapBlocksInFlight.end()) {
+            mapPeerBlocksInFlight[inFlightIt->second.nodeId]--;
+            mapBlocksInFlight.erase(inFlightIt);
+        }
+        mapDownloadFailures.erase(h);
+        mapHeaders.erase(it);
+    }
+
+    if (!mapHeaders.count(hashBestHeader)) {
+        hashBestHeader    = 0;
+        nBestHeaderHeight = -1;
+        nBestHeaderTrust  = 0;
+        for (const auto& p : mapHeaders) {
+            if (p.second.nChainTrust > nBestHeaderTrust) {
+                hashBestHeader    = p.first;
+                nBestHeaderHeight = p.second.nHeight;
+                nBestHeaderTrust  = p.second.nChainTrust;
+            }
+        }
+    }
+    fBestChainDirty = true;
+}
+
+void CHeadersSync::PruneConnected_unsafe(const ITxDB& txdb, int64_t nNow)
+{
+    // connected blocks are removed from the front of the best chain; the headers that follow become
+    // the roots of the header tree, which are the ones whose parent is not in mapHeaders
+    UpdateBestChain_unsafe();
+    unsigned nConnected = 0;
+    while (nConnected < vBestChain.size() && txdb.ReadBlockIndex(vBestChain[nConnected]))
+        nConnected++;
+    if (nConnected == 0)
+        return;
+    nLastConnectedTime = nNow;
+
+    const int nConnectedHeight = mapHeaders.at(vBestChain[nConnected - 1]).nHeight;
+    for (unsigned i = 0; i < nConnected; i++) {
+        const uint256 hash = vBestChain[i];
+        const auto    it   = mapHeaders.find(hash);
+        const auto    siblings = mapHeadersByPrev.equal_range(it->second.header.hashPrevBlock);
+        for (auto s = siblings.first; s != siblings.second; ++s) {
+            if (s->second == hash) {
+                mapHeadersByPrev.erase(s);
+                break;
+            }
+        }
+        mapDownloadFailures.erase(hash);
+        mapHeaders.erase(it);
+    }
+
+    // forks that branched off below the connected part are of no use anymore
+    if (mapHeaders.size() > vBestChain.size() - nConnected) {
+        std::vector<uint256> vStale;
+        for (const auto& p : mapHeaders)
+            if (p.second.nHeight <= nConnectedHeight)
+                vStale.push_back(p.first);
+        for (const uint256& hash : vStale)
+            RemoveHeaderAndDescendants_unsafe(hash);
+    }
+
+    if (!mapHeaders.count(hashBestHeader)) {
+        hashBestHeader    = 0;
+        nBestHeaderHeight = -1;
+        nBestHeaderTrust  = 0;
+    }
+    fBestChainDirty = true;
+    UpdateBestChain_unsafe();
+}
+
+void CHeadersSync::ExpireRequests_unsafe(int64_t nNow)
+{
+    std::vector<uint256> vExpired;
+    for (const auto& p : mapBlocksInFlight)
+        if (nNow - p.second.nRequestTime > BLOCK_DOWNLOAD_TIMEOUT)
+            vExpired.push_back(p.first);
+
+    for (const uint256& hash : vExpired) {
+        // may be gone with the header of an ancestor that was dropped in this loop
+        const auto it = mapBlocksInFlight.find(hash);
+        if (it == mapBlocksInFlight.end())
+            continue;
+        const int64_t nodeId = it->second.nodeId;
+        NLog.write(b_sev::info, "Headers sync: request of block {} from peer {} timed out",
+                   hash.ToString(), nodeId);
+        mapPeerBlocksInFlight[nodeId]--;
+        mapPeerTimeouts[nodeId]++;
+        mapBlocksInFlight.erase(it);
+        std::set<int64_t>& failedPeers = mapDownloadFailures[hash];
+        failedPeers.insert(nodeId);
+        if (failedPeers.size() >= static_cast<std::size_t>(MAX_BLOCK_DOWNLOAD_FAILURES)) {
+            NLog.write(b_sev::warn, "Headers sync: nobody could provide block {}, dropping its header",
+                       hash.ToString());
+            RemoveHeaderAndDescendants_unsafe(hash);
+        }
+    }
+}
+
+int CHeadersSync::MaxBlocksInFlight_unsafe(int64_t nodeId) const
+{
+    const auto it = mapPeerTimeouts.find(nodeId);
+    if (it == mapPeerTimeouts.end())
+        return MAX_BLOCKS_IN_FLIGHT_PER_PEER;
+    // halved with every timeout, down to a single block
+    return std::max(1, MAX_BLOCKS_IN_FLIGHT_PER_PEER >> std::min(it->second, 4));
+}
+
+std::vector<CInv> CHeadersSync::GetBlocksToDownload(int64_t nodeId, int nPeerHeight,
+                                                    const ITxDB& txdb, const IsOrphanFunc& isOrphan,
+                                                    int64_t nNow)
+{
+    std::vector<CInv> result;
+
+    LOCK(cs);
+    ExpireRequests_unsafe(nNow);
+    PruneConnected_unsafe(txdb, nNow);
+
+    if (vBestChain.empty() || nBestHeaderTrust <= txdb.GetBestChainTrust().value_or(0))
+        return result;
+
+    int&      nInFlight    = mapPeerBlocksInFlight[nodeId];
+    const int nMaxInFlight = MaxBlocksInFlight_unsafe(nodeId);
+    const int nWindowEnd   = mapHeaders.at(vBestChain.front()).nHeight + BLOCK_DOWNLOAD_WINDOW;
+    for (const uint256& hash : vBestChain) {
+        if (nInFlight >= nMaxInFlight)
+            break;
+        const int nHeight = mapHeaders.at(hash).nHeight;
+        if (nHeight >= nWindowEnd || nHeight > nPeerHeight)
+            break;
+        if (mapBlocksInFlight.count(hash) || isOrphan(hash) || txdb.ReadBlockIndex(hash))
+            continue;
+        const auto failuresIt = mapDownloadFailures.find(hash);
+        if (failuresIt != mapDownloadFailures.end() && failuresIt->second.count(nodeId))
+            continue;
+
+        BlockInFlight inFlight;
+        inFlight.nodeId       = nodeId;
+        inFlight.nRequestTime = nNow;
+        mapBlocksInFlight[hash] = inFlight;
+        nInFlight++;
+        result.push_back(CInv(MSG_BLOCK, hash));
+    }
+    return result;
+}
+
+static void PushGetHeaders(CNode* pto, const boost::optional<uint256>& hashFrom, const ITxDB& txdb)
+{
+    const boost::optional<CBlockIndex> bestIndex = txdb.GetBestBlockIndex();
+    std::vector<uint256>               vHave;
+    if (hashFrom)
+        vHave.push_back(*hashFrom);
+    if (bestIndex) {
+        const std::vector<uint256>& vChain = CBlockLocator(&*bestIndex, txdb).GetHashes();
+        vHave.insert(vHave.end(), vChain.cbegin(), vChain.cend());
+    }
+    pto->PushMessage("getheaders", CBlockLocator(vHave), uint256(0));
+}
+
+void CHeadersSync::ProcessHeadersMessage(CNode* pfrom, const std::vector<CBlock>& vHeaders,
+                                         const ITxDB& txdb)
+{
+    if (vHeaders.size() > MAX_HEADERS_RESULTS) {
+        pfrom->Misbehaving(20);
+        NLog.write(b_sev::err, "message headers size() = {}", vHeaders.size());
+        return;
+    }
+
+    const AcceptHeadersResult result = AcceptHeaders(vHeaders, txdb);
+    if (result.nDoS > 0)
+        pfrom->Misbehaving(result.nDoS);
+
+    const int  nOurHeight = txdb.GetBestChainHeight().value_or(0);
+    bool       fContinue  = false;
+    {
+        LOCK(cs);
+        if (nHeadersPeer != pfrom->nodeid)
+            return;
+
+        // a full message means that the peer has more
+        fContinue = vHeaders.size() == MAX_HEADERS_RESULTS && result.lastHash && result.nDoS == 0 &&
+                    nBestHeaderHeight < nOurHeight + MAX_HEADERS_AHEAD;
+        if (fContinue) {
+            nHeadersRequestTime = GetTime();
+        } else {
+            nHeadersPeer = -1;
+            NLog.write(b_sev::info, "Headers sync with peer {} done, best header height: {}",
+                       pfrom->addr.ToString(), nBestHeaderHeight);
+        }
+    }
+
+    if (fContinue)
+        PushGetHeaders(pfrom, result.lastHash, txdb);
+}
+
+void CHeadersSync::SendRequests(CNode* pto, const ITxDB& txdb, const IsOrphanFunc& isOrphan)
+{
+    if (!IsEnabled() || pto->fClient || pto->fOneShot || pto->fDisconnect ||
+        !pto->fSuccessfullyConnected)
+        return;
+
+    const int64_t nNow       = GetTime();
+    const int     nOurHeight = txdb.GetBestChainHeight().value_or(0);
+
+    boost::optional<uint256> hashHeadersFrom;
+    bool                     fRequestHeaders = false;
+    {
+        LOCK(cs);
+        if (nHeadersPeer != -1 && nNow - nHeadersRequestTime > HEADERS_RESPONSE_TIMEOUT) {
+            NLog.write(b_sev::info, "Headers sync: peer {} didn't respond in time", nHeadersPeer);
+            nHeadersPeer = -1;
+        }
+
+        const int  nKnownHeight = std::max(nOurHeight, nBestHeaderHeight);
+        const bool fBehind      = nBestHeaderHeight > nOurHeight ||
+                             pto->nStartingHeight > nOurHeight + HEADERS_SYNC_MIN_LAG;
+        if (nHeadersPeer == -1 && fBehind && pto->nStartingHeight > nKnownHeight &&
+            nKnownHeight < nOurHeight + MAX_HEADERS_AHEAD &&
+            nNow - pto->nLastHeadersRequest > HEADERS_RESPONSE_TIMEOUT) {
+            nHeadersPeer             = pto->nodeid;
+            nHeadersRequestTime      = nNow;
+            pto->nLastHeadersRequest = nNow;
+            fRequestHeaders          = true;
+            if (nBestHeaderHeight > nOurHeight)
+                hashHeadersFrom = hashBestHeader;
+            NLog.write(b_sev::info, "Headers sync: requesting headers from peer {} (height {})",
+                       pto->addr.ToString(), pto->nStartingHeight);
+        }
+    }
+    if (fRequestHeaders)
+        PushGetHeaders(pto, hashHeadersFrom, txdb);
+
+    const std::vector<CInv> vGetData =
+        GetBlocksToDownload(pto->nodeid, pto->nStartingHeight, txdb, isOrphan, nNow);
+    if (!vGetData.empty()) {
+        if (fDebugNet)
+            NLog.write(b_sev::debug, "Headers sync: requesting {} blocks from peer {}",
+                       vGetData.size(), pto->addr.ToString());
+        pto->PushMessage("getdata", vGetData);
+    }
+}
+
+void CHeadersSync::BlockReceived(const uint256& hash, int64_t nodeId)
+{
+    LOCK(cs);
+    const auto it = mapBlocksInFlight.find(hash);
+    if (it != mapBlocksInFlight.end()) {
+        mapPeerBlocksInFlight[it->second.nodeId]--;
+        mapBlocksInFlight.erase(it);
+    }
+    // the peer delivers again, so it gets back some of the blocks it lost to its timeouts
+    const auto timeoutsIt = mapPeerTimeouts.find(nodeId);
+    if (timeoutsIt != mapPeerTimeouts.end() && --timeoutsIt->second <= 0)
+        mapPeerTimeouts.erase(timeoutsIt);
+    mapDownloadFailures.erase(hash);
+}
+
+void CHeadersSync::BlockInvalid(const uint256& hash)
+{
+    LOCK(cs);
+    if (mapHeaders.count(hash)) {
+        NLog.write(b_sev::warn, "Headers sync: block {} is invalid, dropping its header chain",
+                   hash.ToString());
+        RemoveHeaderAndDescendants_unsafe(hash);
+    }
+}
+
+void CHeadersSync::PeerDisconnected(int64_t nodeId)
+{
+    LOCK(cs);
+    for (auto it = mapBlocksInFlight.begin(); it != mapBlocksInFlight.end();) {
+        if (it->second.nodeId == nodeId)
+            it = mapBlocksInFlight.erase(it);
+        else
+            ++it;
+    }
+    mapPeerBlocksInFlight.erase(nodeId);
+    mapPeerTimeouts.erase(nodeId);
+    if (nHeadersPeer == nodeId)
+        nHeadersPeer = -1;
+}
+
+bool CHeadersSync::IsKnownHeader(const uint256& hash) const
+{
+    LOCK(cs);
+    return mapHeaders.count(hash) > 0;
+}
+
+bool CHeadersSync::IsSyncing(const ITxDB& txdb, int64_t nNow) const
+{
+    const int nOurHeight = txdb.GetBestChainHeight().value_or(0);
+    LOCK(cs);
+    return nBestHeaderHeight > nOurHeight && nNow - nLastConnectedTime <= HEADERS_SYNC_STALL_TIMEOUT;
+}
+
+int CHeadersSync::GetBestHeaderHeight() const
+{
+    LOCK(cs);
+    return nBestHeaderHeight;
+}
+
+std::size_t CHeadersSync::GetBlocksInFlightCount() const
+{
+    LOCK(cs);
+    return mapBlocksInFlight.size();
+}
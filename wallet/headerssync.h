@@ -0,0 +1,161 @@
+#ifndef HEADERSSYNC_H
+#define HEADERSSYNC_H
+
+#include "block.h"
+#include "itxdb.h"
+#include "protocol.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+class CNode;
+
+// the maximum number of headers in a "headers" message
+static const unsigned int MAX_HEADERS_RESULTS = 2000;
+// how far ahead of our best block we download headers
+static const int MAX_HEADERS_AHEAD = 20000;
+// blocks are only requested this far ahead of the first block we're missing, which keeps the blocks
+// that arrive out of order within the orphan blocks limit
+static const int BLOCK_DOWNLOAD_WINDOW = 512;
+static const int MAX_BLOCKS_IN_FLIGHT_PER_PEER = 16;
+// seconds before a block request is given to another peer
+static const int64_t BLOCK_DOWNLOAD_TIMEOUT = 60;
+// seconds before another peer is asked for headers
+static const int64_t HEADERS_RESPONSE_TIMEOUT = 60;
+// the number of peers whose request for a block timed out after which its header is dropped
+static const int MAX_BLOCK_DOWNLOAD_FAILURES = 4;
+// a peer has to be this many blocks ahead of us to start a headers-first sync with it
+static const int HEADERS_SYNC_MIN_LAG = 144;
+// seconds without a block of the header chain getting connected after which the getblocks sync runs
+// again, beside the headers-first one
+static const int64_t HEADERS_SYNC_STALL_TIMEOUT = 2 * BLOCK_DOWNLOAD_TIMEOUT;
+
+/**
+ * Headers-first synchronization. Headers are downloaded from one peer at a time and validated as far
+ * as possible without the block body (difficulty limits, timestamps, hardened checkpoints and, for the
+ * proof-of-work part of the chain, the scrypt proof-of-work). The blocks of the best header chain are
+ * then requested from all peers that have them in a window that moves as blocks get connected.
+ * Blocks that arrive out of order wait in the orphan blocks pool, and ProcessBlock() connects them in
+ * order.
+ *
+ * Only headers beyond our best block are stored here; they're forgotten as the blocks get connected.
+ *
+ * A block request that times out goes to another peer, and the peer that was too slow gets fewer
+ * blocks at once until it delivers again; a slow link is no reason to punish a peer. Only headers that
+ * are provably invalid are.
+ *
+ * Proof-of-stake headers can't be verified before their blocks arrive, so they're cheap to make up.
+ * Their trust is capped at the trust of the block their chain starts from, the getblocks sync keeps
+ * running until blocks of the header chain get connected, and the headers whose blocks nobody could
+ * provide are dropped.
+ */
+class CHeadersSync
+{
+public:
+    struct HeaderEntry
+    {
+        CBlock  header;
+        int     nHeight;
+        uint256 nChainTrust;
+        // the most trust a proof-of-stake header of this chain is counted for
+        uint256 nTrustCap;
+    };
+
+    struct AcceptHeadersResult
+    {
+        // the misbehavior score of the peer that sent the headers, 0 if all is good
+        int          nDoS = 0;
+        unsigned int nNew = 0;
+        // the last header of the message, if it was accepted or already known
+        boost::optional<uint256> lastHash;
+    };
+
+    // returns true if the block is already in the orphans pool
+    using IsOrphanFunc = std::function<bool(const uint256&)>;
+
+private:
+    mutable CCriticalSection cs;
+
+    std::unordered_map<uint256, HeaderEntry> mapHeaders;
+    std::multimap<uint256, uint256>          mapHeadersByPrev;
+
+    uint256 hashBestHeader;
+    int     nBestHeaderHeight = -1;
+    uint256 nBestHeaderTrust;
+    // the chain from the first header after our best block to the best header
+    std::vector<uint256> vBestChain;
+    bool                 fBestChainDirty = false;
+
+    struct BlockInFlight
+    {
+        int64_t nodeId;
+        int64_t nRequestTime;
+    };
+    std::unordered_map<uint256, BlockInFlight> mapBlocksInFlight;
+    std::map<int64_t, int>                     mapPeerBlocksInFlight;
+
+    // the peers whose request for the block timed out; it's not asked from them again
+    std::unordered_map<uint256, std::set<int64_t>> mapDownloadFailures;
+    // the requests of the peer that timed out, less the blocks it delivered since
+    std::map<int64_t, int> mapPeerTimeouts;
+
+    int64_t nHeadersPeer        = -1;
+    int64_t nHeadersRequestTime = 0;
+    // when a block of the header chain was last connected
+    int64_t nLastConnectedTime = 0;
+
+    void RemoveHeaderAndDescendants_unsafe(const uint256& hash);
+    void UpdateBestChain_unsafe();
+    void PruneConnected_unsafe(const ITxDB& txdb, int64_t nNow);
+    void ExpireRequests_unsafe(int64_t nNow);
+    // fewer blocks at once for a peer whose requests timed out
+    int MaxBlocksInFlight_unsafe(int64_t nodeId) const;
+
+public:
+    CHeadersSync() = default;
+
+    CHeadersSync(const CHeadersSync&) = delete;
+    CHeadersSync& operator=(const CHeadersSync&) = delete;
+
+    static bool IsEnabled();
+
+    /** Validates headers received from a peer and stores the new ones */
+    AcceptHeadersResult AcceptHeaders(const std::vector<CBlock>& vHeaders, const ITxDB& txdb);
+
+    /**
+     * Picks the blocks the peer should be asked for and marks them as in flight
+     * @param nPeerHeight only blocks up to this height are requested from the peer
+     */
+    std::vector<CInv> GetBlocksToDownload(int64_t nodeId, int nPeerHeight, const ITxDB& txdb,
+                                          const IsOrphanFunc& isOrphan, int64_t nNow);
+
+    /** Handles a "headers" message; requires cs_main */
+    void ProcessHeadersMessage(CNode* pfrom, const std::vector<CBlock>& vHeaders, const ITxDB& txdb);
+
+    /** Asks for headers and blocks from the peer, called from SendMessages(); requires cs_main */
+    void SendRequests(CNode* pto, const ITxDB& txdb, const IsOrphanFunc& isOrphan);
+
+    /** the block arrived from the peer */
+    void BlockReceived(const uint256& hash, int64_t nodeId);
+    void BlockInvalid(const uint256& hash);
+    void PeerDisconnected(int64_t nodeId);
+
+    bool IsKnownHeader(const uint256& hash) const;
+    /**
+     * true while the best known header is ahead of our best block and the blocks of its chain are
+     * getting connected; the getblocks sync isn't needed then
+     */
+    bool IsSyncing(const ITxDB& txdb, int64_t nNow) const;
+    int  GetBestHeaderHeight() const;
+    std::size_t GetBlocksInFlightCount() const;
+};
+
+extern CHeadersSync headersSync;
+
+#endif // HEADERSSYNC_H
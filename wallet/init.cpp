@@ -3,12 +3,18 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #include "init.h"
+#include "addressindex.h"
 #include "bitcoinrpc.h"
 #include "checkpoints.h"
+#include "db/lmdb/lmdbwallet.h"
 #include "globals.h"
 #include "logging/defaultlogger.h"
 #include "main.h"
 #include "net.h"
+#include "ntp1tokenindex.h"
+#include "orphanblockpool.h"
+#include "runtimeconfig.h"
+#include "sha256.h"
 #include "stringmanip.h"
 #include "txdb.h"
 #include "ui_interface.h"
@@ -129,6 +135,9 @@ void Shutdown()
         // fixes it
         StopRPCRequests.get().disconnect_all_slots();
 
+        if (LockStatsEnabled())
+            LogLockStats(50);
+
         NewThread(ExitTimeout);
         MilliSleep(50);
         NLog.write(b_sev::info, "neblio exited\n\n\n\n\n\n\n\n\n");
@@ -320,9 +329,15 @@ std::string HelpMessage()
         "  -pid=<file>            " + _("Specify pid file (default: nebliod.pid)") + "\n" +
         "  -datadir=<dir>         " + _("Specify data directory") + "\n" +
         "  -wallet=<dir>          " + _("Specify wallet file (within data directory)") + "\n" +
+        "  -walletbackend=<name>  " + _("Store the wallet in <name>: bdb or lmdb; with lmdb, a BerkeleyDB wallet.dat is migrated on startup (default: bdb)") + "\n" +
         "  -dbcache=<n>           " + _("Set database cache size in megabytes (default: 25)") + "\n" +
         "  -maxorphanblocks=<n>   " + _("Keep at most <n> unconnectable blocks in memory (default: 750)") + "\n" +
+        "  -maxorphanblocksmb=<n> " + _("Keep at most <n> MB of unconnectable blocks (default: 100)") + "\n" +
+        "  -orphanblockspill      " + _("Move unconnectable blocks beyond -maxorphanblocksmemmb from memory to disk (default: 0)") + "\n" +
+        "  -maxorphanblocksmemmb=<n> " + _("Keep at most <n> MB of unconnectable blocks in memory when -orphanblockspill is set (default: 20)") + "\n" +
         "  -maxorphantx=<n>       " + _("Keep at most <n> unconnectable transactions in memory (default: 100)") + "\n" +
+        "  -addressindex          " + _("Maintain an index of the transactions and unspent outputs of every address, used by the getaddress* RPC calls; enabling it resyncs the blockchain (default: 0)") + "\n" +
+        "  -ntp1index             " + _("Maintain an index of the holders and transfers of every NTP1 token, used by the getntp1token* RPC calls; enabling it resyncs the blockchain (default: 0)") + "\n" +
         "  -dblogsize=<n>         " + _("Set database disk log size in megabytes (default: 100)") + "\n" +
         "  -timeout=<n>           " + _("Specify connection timeout in milliseconds (default: 5000)") + "\n" +
         "  -proxy=<ip:port>       " + _("Connect through socks proxy") + "\n" +
@@ -347,6 +362,13 @@ std::string HelpMessage()
         "  -bantime=<n>           " + _("Number of seconds to keep misbehaving peers from reconnecting (default: 86400)") + "\n" +
         "  -maxreceivebuffer=<n>  " + _("Maximum per-connection receive buffer, <n>*1000 bytes (default: 5000)") + "\n" +
         "  -maxsendbuffer=<n>     " + _("Maximum per-connection send buffer, <n>*1000 bytes (default: 1000)") + "\n" +
+#ifdef __linux__
+        "  -socketevents=<mode>   " + _("Socket events mode, which must be one of: 'epoll', 'select' (default: epoll)") + "\n" +
+#endif
+        "  -msghandlerthreads=<n> " + _("Number of threads that process peer messages (default: 4)") + "\n" +
+        "  -txvalidationthreads=<n> " + _("Number of threads that validate relayed transactions before they take the main lock, 0 to validate them with the main lock held (default: 4)") + "\n" +
+        "  -headersfirst          " + _("Download block headers first and then the blocks from several peers in parallel (default: 1)") + "\n" +
+        "  -compactblocks         " + _("Relay new blocks as compact blocks to and from peers that support them (default: 1)") + "\n" +
         "  -noquicksync           " + _("Whether QuickSync should be used to quickly sync with the network") + "\n" +
         "  -coldstaking           " + _("Enable cold-staking for this node (default: true)") + "\n" +
 #ifdef USE_UPNP
@@ -370,6 +392,7 @@ std::string HelpMessage()
         "  -debug                 " + _("Output extra debugging information. Implies all other -debug* options") + "\n" +
         "  -debugnet              " + _("Output extra network debugging information") + "\n" +
         "  -logtimestamps         " + _("Prepend debug output with timestamp") + "\n" +
+        "  -lockprofile           " + _("Record the wait and hold times of every lock site, reported by getlockstats and logged on shutdown (default: 0)") + "\n" +
         "  -maxlogfiles           " + _("Max number of log files resulting from log files rotation; default: 2 for normal; 10 for debug mode") + "\n" +
         "  -maxlogfilesize        " + _("Max size of a single rotated log file; default: 1 GB") + "\n" +
         "  -rotatelogfile         " + _("Rotate the current log file on startup; default: false") + "\n" +
@@ -384,6 +407,10 @@ std::string HelpMessage()
         "  -rpcport=<port>        " + _("Listen for JSON-RPC connections on <port> (default: 6326 or testnet: 16326 or regtest: 26326)") + "\n" +
         "  -rpcallowip=<ip>       " + _("Allow JSON-RPC connections from specified IP address") + "\n" +
         "  -rpcconnect=<ip>       " + _("Send commands to node running on <ip> (default: 127.0.0.1)") + "\n" +
+        "  -rpcthreads=<n>        " + _("Set the number of threads to service RPC calls (default: 4)") + "\n" +
+        "  -rpcworkqueue=<n>      " + _("Set the depth of the work queue to service RPC calls (default: 16)") + "\n" +
+        "  -rpcservertimeout=<n>  " + _("Close RPC connections that stay idle or take longer than <n> seconds to send a request (default: 30)") + "\n" +
+        "  -rpcbatchconcurrency=<n> " + _("Set the number of threads executing the elements of a read-only batch RPC request (default: number of cores)") + "\n" +
         "  -blocknotify=<cmd>     " + _("Execute command when the best block changes (%s in cmd is replaced by block hash)") + "\n" +
         "  -walletnotify=<cmd>    " + _("Execute command when a wallet transaction changes (%s in cmd is replaced by TxID)") + "\n" +
         "  -confchange            " + _("Require a confirmations for change (default: 0)") + "\n" +
@@ -552,6 +579,7 @@ bool AppInit2()
     fPrintToConsole  = GetBoolArg("-printtoconsole");
     fPrintToDebugger = GetBoolArg("-printtodebugger");
     fLogTimestamps   = GetBoolArg("-logtimestamps", true);
+    EnableLockStats(GetBoolArg("-lockprofile", false));
 
     if (mapArgs.exists("-timeout")) {
         int nNewTimeout = GetArg("-timeout", 5000);
@@ -570,6 +598,17 @@ bool AppInit2()
 
     fConfChange       = GetBoolArg("-confchange", false);
     fEnforceCanonical = GetBoolArg("-enforcecanonical", true);
+    fAddressIndex     = GetBoolArg("-addressindex", false);
+    fNTP1Index        = GetBoolArg("-ntp1index", false);
+
+    const std::string walletBackend = GetArg("-walletbackend", "bdb");
+    if (walletBackend != "bdb" && walletBackend != "lmdb")
+        return InitError(fmt::format(_("Unknown -walletbackend: '{}'"), walletBackend));
+    fWalletLMDB = (walletBackend == "lmdb");
+
+    orphanBlockPool.SetLimits(COrphanBlockPool::LimitsFromArgs());
+
+    ReloadRuntimeConfig();
 
     boost::optional<std::string> mininpVal = mapArgs.get("-mininput");
     if (mininpVal) {
@@ -595,6 +634,7 @@ bool AppInit2()
 
     // ********************************************************* Step 4: application initialization: dir
     // lock, daemonize, pidfile, debug log Sanity check
+    const std::string sha256Algo = SHA256AutoDetect();
     if (!InitSanityCheck())
         return InitError(_("Initialization sanity check failed. neblio is shutting down."));
 
@@ -641,6 +681,7 @@ bool AppInit2()
 
     NLog.write(b_sev::info, "neblio version {} ({})", FormatFullVersion(), CLIENT_DATE);
     NLog.write(b_sev::info, "Using OpenSSL version {}", SSLeay_version(SSLEAY_VERSION));
+    NLog.write(b_sev::info, "Using the SHA256 implementation: {}", sha256Algo);
     if (!fLogTimestamps)
         NLog.write(b_sev::info, "Startup time: {}", DateTimeStrFormat("%x %H:%M:%S", GetTime()));
     NLog.write(b_sev::info, "Default data directory {}", GetDefaultDataDir().string());
@@ -664,13 +705,16 @@ bool AppInit2()
         return InitError(msg);
     }
 
-    if (GetBoolArg("-salvagewallet")) {
+    // LMDB wallets have nothing to verify or salvage in BerkeleyDB
+    const bool fWalletFileIsLMDB = LMDBWalletStorage::IsLMDBFile(GetWalletFilePath(strWalletFileName));
+
+    if (GetBoolArg("-salvagewallet") && !fWalletFileIsLMDB) {
         // Recover readable keypairs:
         if (!CWalletDB::Recover(bitdb, strWalletFileName, true))
             return false;
     }
 
-    if (filesystem::exists(GetDataDir() / strWalletFileName)) {
+    if (filesystem::exists(GetDataDir() / strWalletFileName) && !fWalletFileIsLMDB) {
         CDBEnv::VerifyResult r = VerifyDBWalletTransient(strWalletFileName);
         if (r == CDBEnv::RECOVER_OK) {
             const string msg =
@@ -686,6 +730,12 @@ bool AppInit2()
         }
         if (r == CDBEnv::RECOVER_FAIL)
             return InitError(_("wallet.dat corrupt, salvage failed"));
+
+        if (fWalletLMDB) {
+            uiInterface.InitMessage(_("Migrating the wallet to LMDB..."), 0);
+            if (!CWalletDB::MigrateToLMDB(strWalletFileName))
+                return InitError(_("Failed to migrate the wallet to LMDB; check the log"));
+        }
     }
 
     // ********************************************************* Step 6: network initialization
@@ -16,6 +16,14 @@ class COutPoint;
 class CBlock;
 class CBigNum;
 class CBlockIndex;
+struct CAddressIndexAddress;
+struct CAddressIndexKey;
+struct CAddressUnspentKey;
+struct CAddressUnspentValue;
+struct CNTP1TokenTransferKey;
+struct CNTP1TokenTransferValue;
+struct CNTP1TokenHolderKey;
+struct CNTP1TokenHolderValue;
 
 class ITxDB
 {
@@ -59,6 +67,32 @@ public:
     virtual bool WriteStakeSeen(const std::pair<COutPoint, unsigned int>& stake)                    = 0;
     virtual boost::optional<bool>
                                  WasStakeSeen(const std::pair<COutPoint, unsigned int>& stake) const = 0;
+    virtual bool
+    WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& entries) = 0;
+    virtual bool
+    EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& entries) = 0;
+    virtual bool UpdateAddressUnspentIndex(
+        const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& entries) = 0;
+    virtual bool ReadAddressIndex(const CAddressIndexAddress& address, int startHeight, int endHeight,
+                                  std::vector<std::pair<CAddressIndexKey, CAmount>>& entries) const = 0;
+    virtual bool ReadAddressUnspentIndex(
+        const CAddressIndexAddress&                                       address,
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& entries) const = 0;
+    virtual bool WriteNTP1TokenTransfers(
+        const std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries) = 0;
+    virtual bool EraseNTP1TokenTransfers(
+        const std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries) = 0;
+    virtual bool ReadNTP1TokenTransfers(
+        const CNTP1TokenTransferKey& keyBegin, const CNTP1TokenTransferKey& keyEnd, std::size_t limit,
+        std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries) const = 0;
+    virtual bool UpdateNTP1TokenHolderBalances(
+        const std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>>& deltas) = 0;
+    virtual bool ReadNTP1TokenHolders(
+        const std::string& tokenId, const std::string& addressBegin, std::size_t limit,
+        std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>>& entries) const = 0;
+    virtual bool WriteOrphanBlock(const uint256& hash, const CBlock& blk)                           = 0;
+    virtual bool ReadOrphanBlock(const uint256& hashPrev, const uint256& hash, CBlock& blk) const    = 0;
+    virtual bool EraseOrphanBlock(const uint256& hashPrev, const uint256& hash)                     = 0;
     virtual bool                 LoadBlockIndex()                                                    = 0;
     virtual boost::optional<int> GetBestChainHeight() const                                          = 0;
     virtual boost::optional<uint256>     GetBestChainTrust() const                                   = 0;
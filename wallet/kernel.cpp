@@ -6,6 +6,7 @@
 #include "block.h"
 #include "chainparams.h"
 #include "main.h"
+#include "runtimeconfig.h"
 #include "txdb.h"
 
 using namespace std;
@@ -20,6 +21,41 @@ int64_t GetWeight(const ITxDB& txdb, int64_t nIntervalBeginning, int64_t nInterv
     return min(nIntervalEnd - nIntervalBeginning - nSMA, Params().StakeMaxAge());
 }
 
+static uint64_t Abs64(int64_t n) { return n < 0 ? 0 - static_cast<uint64_t>(n) : static_cast<uint64_t>(n); }
+
+CStakeKernelTarget::CStakeKernelTarget(unsigned int nBits, int64_t nValueIn, int64_t nTimeWeight)
+{
+    // nValueIn * nTimeWeight / COIN / (24 * 60 * 60), rounded towards zero; the product has at most
+    // 126 bits
+    bnCoinDayWeight = arith_uint256(Abs64(nValueIn)) * arith_uint256(Abs64(nTimeWeight));
+    bnCoinDayWeight /= arith_uint256(COIN);
+    bnCoinDayWeight /= arith_uint256(24 * 60 * 60);
+    fWeightNegative = bnCoinDayWeight != 0 && ((nValueIn < 0) != (nTimeWeight < 0));
+
+    bnTargetPerCoinDay.SetCompact(nBits, &fTargetNegative, &fTargetOverflow);
+}
+
+uint256 CStakeKernelTarget::GetTruncated() const
+{
+    // SetCompact() already dropped the bits of the target beyond 256, which can't affect the low 256
+    // bits of the product
+    return ArithToUint256(bnCoinDayWeight * bnTargetPerCoinDay);
+}
+
+bool CStakeKernelTarget::IsMetBy(const uint256& hashProofOfStake) const
+{
+    const bool fTargetZero = !fTargetOverflow && bnTargetPerCoinDay == 0;
+    if (bnCoinDayWeight == 0 || fTargetZero)
+        return hashProofOfStake == 0;
+    if (fWeightNegative != fTargetNegative)
+        return false; // a negative target is below any hash
+    if (fTargetOverflow)
+        return true; // a target beyond 256 bits is above any hash
+    // both factors are below 2^256, so the product fits
+    return arith_uint512(UintToArith256(hashProofOfStake)) <=
+           arith_uint512(bnCoinDayWeight) * arith_uint512(bnTargetPerCoinDay);
+}
+
 // Get the last stake modifier and its generation time from a given block
 static bool GetLastStakeModifier(const ITxDB& txdb, const CBlockIndex* pindex, uint64_t& nStakeModifier,
                                  int64_t& nModifierTime)
@@ -106,7 +142,7 @@ SelectBlockFromCandidates(const ITxDB& txdb, const vector<pair<int64_t, uint256>
             pindexSelected = index;
         }
     }
-    if (fDebug && GetBoolArg("-printstakemodifier"))
+    if (fDebug && GetRuntimeConfig().fPrintStakeModifier)
         NLog.write(b_sev::info, "SelectBlockFromCandidates: selection hash={}", hashBest.ToString());
     return fSelected;
 }
@@ -183,7 +219,7 @@ bool ComputeNextStakeModifier(const ITxDB& txdb, const CBlockIndex* const pindex
         nStakeModifierNew |= (((uint64_t)index->GetStakeEntropyBit()) << nRound);
         // add the selected block from candidates to selected list
         mapSelectedBlocks.insert(make_pair(index->GetBlockHash(), index));
-        if (fDebug && GetBoolArg("-printstakemodifier"))
+        if (fDebug && GetRuntimeConfig().fPrintStakeModifier)
             NLog.write(b_sev::info,
                        "ComputeNextStakeModifier: selected round {} stop={} height={} bit={}", nRound,
                        DateTimeStrFormat(nSelectionIntervalStop), index->nHeight,
@@ -305,15 +341,11 @@ bool CheckStakeKernelHash(const ITxDB& txdb, unsigned int nBits, const CBlock& b
     if (nTimeBlockFrom + nSMA > nTimeTx) // Min age requirement
         return NLog.error("CheckStakeKernelHash() : min age violation");
 
-    CBigNum bnTargetPerCoinDay;
-    bnTargetPerCoinDay.SetCompact(nBits);
-    int64_t nValueIn = txPrev.vout[prevout.n].nValue;
-
-    CBigNum bnCoinDayWeight = CBigNum(nValueIn) *
-                              GetWeight(txdb, (int64_t)txPrev.nTime, (int64_t)nTimeTx) / COIN /
-                              (24 * 60 * 60);
+    const int64_t            nValueIn = txPrev.vout[prevout.n].nValue;
+    const CStakeKernelTarget target(nBits, nValueIn,
+                                    GetWeight(txdb, (int64_t)txPrev.nTime, (int64_t)nTimeTx));
 
-    targetProofOfStake = (bnCoinDayWeight * bnTargetPerCoinDay).getuint256();
+    targetProofOfStake = target.GetTruncated();
 
     // Calculate hash
     CDataStream ss(SER_GETHASH, 0);
@@ -344,7 +376,7 @@ bool CheckStakeKernelHash(const ITxDB& txdb, unsigned int nBits, const CBlock& b
     }
 
     // Now check if proof-of-stake hash meets target protocol
-    if (CBigNum(hashProofOfStake) > bnCoinDayWeight * bnTargetPerCoinDay) {
+    if (!target.IsMetBy(hashProofOfStake)) {
         return false;
     }
 
@@ -4,6 +4,7 @@
 #ifndef PPCOIN_KERNEL_H
 #define PPCOIN_KERNEL_H
 
+#include "arith_uint256.h"
 #include "transaction.h"
 #include <cstdint>
 
@@ -18,6 +19,27 @@ static const int MODIFIER_INTERVAL_RATIO = 3;
 bool ComputeNextStakeModifier(const ITxDB& txdb, const CBlockIndex* const pindexPrev,
                               uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 
+// The hash target of a stake kernel: the coin-day weight of the stake times the target per coin-day
+// of nBits. As when it was computed with CBigNum, the weight can be negative and the target per
+// coin-day negative or beyond 256 bits.
+class CStakeKernelTarget
+{
+    arith_uint256 bnCoinDayWeight;
+    bool          fWeightNegative;
+    arith_uint256 bnTargetPerCoinDay;
+    bool          fTargetNegative;
+    bool          fTargetOverflow;
+
+public:
+    CStakeKernelTarget(unsigned int nBits, int64_t nValueIn, int64_t nTimeWeight);
+
+    // The absolute value of the target, truncated to 256 bits
+    uint256 GetTruncated() const;
+
+    // Whether the kernel hash is at most the target
+    bool IsMetBy(const uint256& hashProofOfStake) const;
+};
+
 // Check whether stake kernel meets hash target
 // Sets hashProofOfStake on success return
 bool CheckStakeKernelHash(const ITxDB& txdb, unsigned int nBits, const CBlock& blockFrom,
@@ -5,23 +5,31 @@
 
 #include "main.h"
 #include "block.h"
+#include "blockencodings.h"
 #include "blockindexlrucache.h"
 #include "checkpoints.h"
 #include "db.h"
+#include "db/lmdb/lmdbwallet.h"
 #include "disktxpos.h"
+#include "headerssync.h"
 #include "init.h"
 #include "kernel.h"
 #include "merkletx.h"
 #include "net.h"
+#include "ntp1/ntp1metadatacache.h"
 #include "ntp1/ntp1script.h"
 #include "ntp1/ntp1script_burn.h"
 #include "ntp1/ntp1script_issuance.h"
 #include "ntp1/ntp1script_transfer.h"
 #include "ntp1/ntp1transaction.h"
+#include "ntp1tokenindex.h"
+#include "orphanblockpool.h"
 #include "outpoint.h"
+#include "runtimeconfig.h"
 #include "txdb.h"
 #include "txindex.h"
 #include "txmempool.h"
+#include "txprevalidator.h"
 #include "ui_interface.h"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -41,15 +49,12 @@ using namespace boost;
 CCriticalSection              cs_setpwalletRegistered;
 set<std::shared_ptr<CWallet>> setpwalletRegistered;
 
-CCriticalSection cs_main;
+CSharedCriticalSection cs_main;
 
 boost::atomic<bool> fImporting{false};
 
 CMedianFilter<int> cPeerBlockCounts(5, 0);
 
-std::unordered_map<uint256, CBlock*> mapOrphanBlocks;
-multimap<uint256, CBlock*>           mapOrphanBlocksByPrev;
-set<pair<COutPoint, unsigned int>>   setStakeSeenOrphan;
 
 map<uint256, CTransaction> mapOrphanTransactions;
 map<uint256, set<uint256>> mapOrphanTransactionsByPrev;
@@ -126,6 +131,26 @@ void SyncWithWallets(const ITxDB& txdb, const CTransaction& tx, const CBlock* pb
         pwallet->SyncTransaction(txdb, tx, pblock);
 }
 
+CWalletsBatchScope::CWalletsBatchScope()
+{
+    for (const std::shared_ptr<CWallet>& pwallet : setpwalletRegistered) {
+        if (!pwallet->fFileBacked)
+            continue;
+        std::shared_ptr<LMDBWalletStorage> storage = GetLMDBWalletStorage(pwallet->strWalletFile);
+        if (!storage)
+            continue;
+        walletLocks.emplace_back(new boost::unique_lock<CCriticalSection>(pwallet->cs_wallet));
+        batches.emplace_back(new LMDBWalletBatchScope(storage));
+    }
+}
+
+CWalletsBatchScope::~CWalletsBatchScope()
+{
+    // the batches are committed before the wallets are unlocked
+    batches.clear();
+    walletLocks.clear();
+}
+
 // notify wallets about a new best chain
 void SetBestChain(const CBlockLocator& loc)
 {
@@ -150,6 +175,8 @@ void static PrintWallets(const CBlock& block)
 // notify wallets about an incoming inventory (for request counts)
 void static Inventory(const uint256& hash)
 {
+    // called from getdata, which is processed without cs_main
+    LOCK(cs_setpwalletRegistered);
     for (const std::shared_ptr<CWallet>& pwallet : setpwalletRegistered)
         pwallet->Inventory(hash);
 }
@@ -388,25 +415,10 @@ void AssertNTP1TokenNameIsNotAlreadyInMainChain(const NTP1Transaction& ntp1tx, c
     }
 }
 
-Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTransaction& tx,
-                                                   const ITxDB* txdbPtr)
+// The checks of a loose transaction that depend neither on its inputs nor on the mempool
+static Result<void, TxValidationState> CheckLooseTransaction(const CTransaction& tx, const ITxDB& txdb)
 {
-    AssertLockHeld(cs_main);
-
-    /**
-     * Using a pointer from the outside is important because a new instance of the database does not
-     * discover the changes in the database until it's flushed. We want to have the option to use a
-     * previous CTxDB instance
-     */
-    const ITxDB*                 txdb = txdbPtr;
-    std::unique_ptr<const CTxDB> txdbUniquePtr;
-    if (!txdb) {
-        txdbUniquePtr = MakeUnique<const CTxDB>();
-        txdb          = txdbUniquePtr.get();
-    }
-    assert(txdb);
-
-    TRYV(tx.CheckTransaction(*txdb));
+    TRYV(tx.CheckTransaction(txdb));
 
     // Coinbase is only valid in a block, not as a loose transaction
     if (tx.IsCoinBase()) {
@@ -422,9 +434,83 @@ Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTran
 
     // Rather not work on nonstandard transactions (unless -testnet)
     string reason;
-    if (Params().NetType() == NetworkType::Mainnet && !IsStandardTx(*txdb, tx, reason))
+    if (Params().NetType() == NetworkType::Mainnet && !IsStandardTx(txdb, tx, reason))
         return Err(MakeInvalidTxState(TxValidationResult::TX_NOT_STANDARD, reason, "non-standard-tx"));
 
+    return Ok();
+}
+
+static Result<void, TxValidationState> FetchLooseTransactionInputs(const CTransaction& tx,
+                                                                   const ITxDB&        txdb,
+                                                                   MapPrevTx&          mapInputs)
+{
+    map<uint256, CTxIndex> mapUnused;
+    bool                   fInvalid = false;
+    if (!tx.FetchInputs(txdb, mapUnused, false, false, mapInputs, fInvalid)) {
+        if (fInvalid) {
+            return Err(MakeInvalidTxState(
+                TxValidationResult::TX_INVALID_INPUTS, "bad-txns-inputs-invalid",
+                fmt::format("AcceptToMemoryPool : FetchInputs found invalid tx {}",
+                            tx.GetHash().ToString().substr(0, 10))));
+        }
+        return Err(MakeInvalidTxState(TxValidationResult::TX_MISSING_INPUTS,
+                                      "bad-txns-inputs-missingorspent"));
+    }
+
+    // Check for non-standard pay-to-script-hash in inputs
+    if (!tx.AreInputsStandard(mapInputs) && Params().NetType() == NetworkType::Mainnet) {
+        return Err(
+            MakeInvalidTxState(TxValidationResult::TX_NOT_STANDARD, "bad-txns-nonstandard-inputs"));
+    }
+
+    return Ok();
+}
+
+Result<void, TxValidationState> PreValidateTransaction(const CTransaction& tx, const ITxDB& txdb)
+{
+    TRYV(CheckLooseTransaction(tx, txdb));
+
+    const uint256 hash = tx.GetHash();
+    if (mempool.exists(hash))
+        return Err(MakeInvalidTxState(TxValidationResult::TX_CONFLICT, "txn-already-in-mempool"));
+    if (txdb.ContainsTx(hash))
+        return Err(MakeInvalidTxState(TxValidationResult::TX_CONFLICT, "txn-already-known"));
+
+    MapPrevTx mapInputs;
+    TRYV(FetchLooseTransactionInputs(tx, txdb, mapInputs));
+
+    const boost::optional<CBlockIndex> bestBlockIndex = txdb.GetBestBlockIndex();
+    if (!bestBlockIndex)
+        return Err(MakeInvalidTxState(TxValidationResult::TX_MISSING_INPUTS,
+                                      "bad-txns-inputs-missingorspent"));
+
+    // the expensive part: the script checks
+    map<uint256, CTxIndex> mapUnused;
+    TRYV(tx.ConnectInputs(txdb, mapInputs, mapUnused, CDiskTxPos(1, 1), bestBlockIndex, false, false));
+
+    return Ok();
+}
+
+Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTransaction& tx,
+                                                   const ITxDB* txdbPtr, bool fScriptsChecked)
+{
+    AssertLockHeld(cs_main);
+
+    /**
+     * Using a pointer from the outside is important because a new instance of the database does not
+     * discover the changes in the database until it's flushed. We want to have the option to use a
+     * previous CTxDB instance
+     */
+    const ITxDB*                 txdb = txdbPtr;
+    std::unique_ptr<const CTxDB> txdbUniquePtr;
+    if (!txdb) {
+        txdbUniquePtr = MakeUnique<const CTxDB>();
+        txdb          = txdbUniquePtr.get();
+    }
+    assert(txdb);
+
+    TRYV(CheckLooseTransaction(tx, *txdb));
+
     // is it already in the memory pool?
     uint256 hash = tx.GetHash();
     if (pool.exists(hash))
@@ -474,23 +560,7 @@ Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTran
         MapPrevTx                                                           mapInputs;
         map<uint256, CTxIndex>                                              mapUnused;
         map<uint256, std::vector<std::pair<CTransaction, NTP1Transaction>>> mapUnused2;
-        bool                                                                fInvalid = false;
-        if (!tx.FetchInputs(*txdb, mapUnused, false, false, mapInputs, fInvalid)) {
-            if (fInvalid) {
-                return Err(MakeInvalidTxState(
-                    TxValidationResult::TX_INVALID_INPUTS, "bad-txns-inputs-invalid",
-                    fmt::format("AcceptToMemoryPool : FetchInputs found invalid tx {}",
-                                hash.ToString().substr(0, 10))));
-            }
-            return Err(MakeInvalidTxState(TxValidationResult::TX_MISSING_INPUTS,
-                                          "bad-txns-inputs-missingorspent"));
-        }
-
-        // Check for non-standard pay-to-script-hash in inputs
-        if (!tx.AreInputsStandard(mapInputs) && Params().NetType() == NetworkType::Mainnet) {
-            return Err(
-                MakeInvalidTxState(TxValidationResult::TX_NOT_STANDARD, "bad-txns-nonstandard-inputs"));
-        }
+        TRYV(FetchLooseTransactionInputs(tx, *txdb, mapInputs));
 
         // Note: if you modify this code to accept non-standard transactions, then
         // you should add code here to check that the transaction does a
@@ -523,7 +593,7 @@ Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTran
                 nLastTime = nNow;
                 // -limitfreerelay unit is thousand-bytes-per-minute
                 // At default rate it would take over a month to fill 1GB
-                if (dFreeCount > GetArg("-limitfreerelay", 15) * 10 * 1000 && !IsFromMe(tx))
+                if (dFreeCount > GetRuntimeConfig().nLimitFreeRelay * 10 * 1000 && !IsFromMe(tx))
                     return Err(MakeInvalidTxState(TxValidationResult::TX_MEMPOOL_POLICY,
                                                   "fee-rejected-by-rate-limiter"));
 
@@ -537,7 +607,7 @@ Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTran
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         TRYV(tx.ConnectInputs(*txdb, mapInputs, mapUnused, CDiskTxPos(1, 1), *txdb->GetBestBlockIndex(),
-                              false, false));
+                              false, false, nullptr, fScriptsChecked));
 
         if (Params().PassedFirstValidNTP1Tx(txdb) &&
             Params().GetNetForks().isForkActivated(NetworkFork::NETFORK__3_TACHYON, *txdb)) {
@@ -614,41 +684,44 @@ bool GetTransaction(const uint256& hash, CTransaction& tx, uint256& hashBlock)
 // CBlock and CBlockIndex
 //
 
-uint256 static GetOrphanRoot(const CBlock* pblock)
-{
-    // Work back to the first block in the orphan chain
-    while (mapOrphanBlocks.count(pblock->hashPrevBlock))
-        pblock = mapOrphanBlocks[pblock->hashPrevBlock];
-    return pblock->GetHash();
-}
-
-// ppcoin: find block wanted by given orphan block
-uint256 WantedByOrphan(const CBlock* pblockOrphan)
-{
-    // Work back to the first block in the orphan chain
-    while (mapOrphanBlocks.count(pblockOrphan->hashPrevBlock))
-        pblockOrphan = mapOrphanBlocks[pblockOrphan->hashPrevBlock];
-    return pblockOrphan->hashPrevBlock;
-}
-
 //
 // maximum nBits value could possible be required nTime after
 //
-unsigned int ComputeMaxBits(CBigNum bnTargetLimit, unsigned int nBase, int64_t nTime)
-{
-    CBigNum bnResult;
-    bnResult.SetCompact(nBase);
+unsigned int ComputeMaxBits(const arith_uint256& bnTargetLimit, unsigned int nBase, int64_t nTime)
+{
+    // nBase is the nBits of a block on the chain, which is never negative; a target beyond 512 bits
+    // is above any limit, like one beyond 256
+    bool          fNegative;
+    bool          fOverflow;
+    arith_uint512 bnResult;
+    bnResult.SetCompact(nBase, &fNegative, &fOverflow);
+    const arith_uint512 bnLimit(bnTargetLimit);
+    if (fNegative || fOverflow)
+        return bnTargetLimit.GetCompact();
     bnResult *= 2;
-    while (nTime > 0 && bnResult < bnTargetLimit) {
+    while (nTime > 0 && bnResult < bnLimit) {
         // Maximum 200% adjustment per day...
         bnResult *= 2;
         nTime -= 24 * 60 * 60;
     }
-    if (bnResult > bnTargetLimit)
-        bnResult = bnTargetLimit;
+    if (bnResult > bnLimit)
+        bnResult = bnLimit;
     return bnResult.GetCompact();
 }
 
+arith_uint512 ScaleCompactTarget(unsigned int nBits, int64_t nMul, int64_t nDiv, bool& fNegative,
+                                 bool& fOverflow)
+{
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
+    // a target of 256 bits times a factor of 64 bits can't wrap around in 512 bits
+    arith_uint512 bnResult(bnTarget);
+    bnResult *= arith_uint512(nMul < 0 ? 0 - static_cast<uint64_t>(nMul) : static_cast<uint64_t>(nMul));
+    bnResult /= arith_uint512(nDiv < 0 ? 0 - static_cast<uint64_t>(nDiv) : static_cast<uint64_t>(nDiv));
+    fNegative = bnResult != 0 && (fNegative != ((nMul < 0) != (nDiv < 0)));
+    return bnResult;
+}
+
 //
 // minimum amount of work that could possibly be required nTime after
 // minimum proof-of-work required was nBase
@@ -702,7 +775,7 @@ static unsigned int GetNextTargetRequiredV1(const CBlockIndex* pindexLast, bool
 {
     const CTxDB txdb;
 
-    CBigNum bnTargetLimit = fProofOfStake ? Params().PoSLimit() : Params().PoWLimit();
+    const arith_uint256& bnTargetLimit = fProofOfStake ? Params().PoSLimit() : Params().PoWLimit();
 
     if (pindexLast == nullptr)
         return bnTargetLimit.GetCompact(); // genesis block
@@ -724,17 +797,19 @@ static unsigned int GetNextTargetRequiredV1(const CBlockIndex* pindexLast, bool
 
     // ppcoin: target change every block
     // ppcoin: retarget with exponential moving toward target spacing
-    CBigNum bnNew;
-    bnNew.SetCompact(pindexPrev.nBits);
-    unsigned int nTS       = Params().TargetSpacing(CTxDB());
-    int64_t      nInterval = Params().TargetTimeSpan() / nTS;
-    bnNew *= ((nInterval - 1) * nTS + nActualSpacing + nActualSpacing);
-    bnNew /= ((nInterval + 1) * nTS);
+    unsigned int  nTS       = Params().TargetSpacing(CTxDB());
+    int64_t       nInterval = Params().TargetTimeSpan() / nTS;
+    bool          fNegative;
+    bool          fOverflow;
+    arith_uint512 bnNew =
+        ScaleCompactTarget(pindexPrev.nBits, (nInterval - 1) * nTS + nActualSpacing + nActualSpacing,
+                           (nInterval + 1) * nTS, fNegative, fOverflow);
 
-    if (bnNew > bnTargetLimit)
-        bnNew = bnTargetLimit;
+    // a negative target is kept, as it always was
+    if (!fNegative && (fOverflow || bnNew > arith_uint512(bnTargetLimit)))
+        return bnTargetLimit.GetCompact();
 
-    return bnNew.GetCompact();
+    return bnNew.GetCompact(fNegative);
 }
 
 /**
@@ -803,7 +878,7 @@ int64_t CalculateActualBlockSpacingForV3(const ITxDB& txdb, const CBlockIndex* p
 static unsigned int GetNextTargetRequiredV2(const ITxDB& txdb, const CBlockIndex* pindexLast,
                                             bool fProofOfStake)
 {
-    CBigNum bnTargetLimit = fProofOfStake ? Params().PoSLimit() : Params().PoWLimit();
+    const arith_uint256& bnTargetLimit = fProofOfStake ? Params().PoSLimit() : Params().PoWLimit();
 
     if (pindexLast == nullptr)
         return bnTargetLimit.GetCompact(); // genesis block
@@ -826,22 +901,28 @@ static unsigned int GetNextTargetRequiredV2(const ITxDB& txdb, const CBlockIndex
 
     // ppcoin: target change every block
     // ppcoin: retarget with exponential moving toward target spacing
-    CBigNum bnNew;
-    bnNew.SetCompact(pindexPrev.nBits);
-    int64_t nInterval = Params().TargetTimeSpan() / nTS;
-    bnNew *= ((nInterval - 1) * nTS + nActualSpacing + nActualSpacing);
-    bnNew /= ((nInterval + 1) * nTS);
+    int64_t       nInterval = Params().TargetTimeSpan() / nTS;
+    bool          fNegative;
+    bool          fOverflow;
+    arith_uint512 bnNew =
+        ScaleCompactTarget(pindexPrev.nBits, (nInterval - 1) * nTS + nActualSpacing + nActualSpacing,
+                           (nInterval + 1) * nTS, fNegative, fOverflow);
 
-    if (bnNew <= 0 || bnNew > bnTargetLimit)
-        bnNew = bnTargetLimit;
+    if (fNegative || fOverflow || bnNew == 0 || bnNew > arith_uint512(bnTargetLimit))
+        return bnTargetLimit.GetCompact();
 
     return bnNew.GetCompact();
 }
 
+// the tuning of GetNextTargetRequiredV3(), see there
+static constexpr const int RETARGET_V3_K = 15;
+static constexpr const int RETARGET_V3_L = 7;
+static constexpr const int RETARGET_V3_M = 90;
+
 static unsigned int GetNextTargetRequiredV3(const ITxDB& txdb, const CBlockIndex* pindexLast,
                                             bool fProofOfStake, BlockTimeCacheType& blockTimeCache)
 {
-    CBigNum bnTargetLimit = fProofOfStake ? Params().PoSLimit() : Params().PoWLimit();
+    const arith_uint256& bnTargetLimit = fProofOfStake ? Params().PoSLimit() : Params().PoWLimit();
 
     if (pindexLast == nullptr)
         return bnTargetLimit.GetCompact(); // genesis block
@@ -880,18 +961,20 @@ static unsigned int GetNextTargetRequiredV3(const ITxDB& txdb, const CBlockIndex
 
     // ppcoin: target change every block
     // ppcoin: retarget with exponential moving toward target spacing
-    CBigNum newTarget;
-    newTarget.SetCompact(pindexPrev.nBits); // target from previous block
     int64_t nInterval = Params().TargetTimeSpan() / nTS;
 
-    static constexpr const int k = 15;
-    static constexpr const int l = 7;
-    static constexpr const int m = 90;
-    newTarget *= (nInterval - l + k) * nTS + (m + l) * nActualSpacing;
-    newTarget /= (nInterval + k) * nTS + m * nActualSpacing;
+    const int k = RETARGET_V3_K;
+    const int l = RETARGET_V3_L;
+    const int m = RETARGET_V3_M;
+    bool      fNegative;
+    bool      fOverflow;
+    // target from previous block
+    const arith_uint512 newTarget = ScaleCompactTarget(
+        pindexPrev.nBits, (nInterval - l + k) * nTS + (m + l) * nActualSpacing,
+        (nInterval + k) * nTS + m * nActualSpacing, fNegative, fOverflow);
 
-    if (newTarget <= 0 || newTarget > bnTargetLimit)
-        newTarget = bnTargetLimit;
+    if (fNegative || fOverflow || newTarget == 0 || newTarget > arith_uint512(bnTargetLimit))
+        return bnTargetLimit.GetCompact();
 
     return newTarget.GetCompact();
 }
@@ -908,7 +991,7 @@ unsigned int GetNextTargetRequired(const ITxDB& txdb, const CBlockIndex* pindexL
 
     static thread_local BlockTimeCacheType blockIndexBlockTimeCache(500, extractorFunc);
 
-    if (pindexLast->nHeight < 2000)
+    if (pindexLast->nHeight < RETARGET_V2_START_HEIGHT)
         return GetNextTargetRequiredV1(pindexLast, fProofOfStake);
     else if (Params().GetNetForks().isForkActivated(NetworkFork::NETFORK__4_RETARGET_CORRECTION,
                                                     pindexLast->nHeight))
@@ -917,13 +1000,30 @@ unsigned int GetNextTargetRequired(const ITxDB& txdb, const CBlockIndex* pindexL
         return GetNextTargetRequiredV2(txdb, pindexLast, fProofOfStake);
 }
 
+void GetMinTargetScale(int nHeightLast, int64_t& nNumerator, int64_t& nDenominator)
+{
+    // the spacing between blocks can't be negative in V2 and V3, and the scale grows with it
+    const int64_t nTS       = Params().TargetSpacing(nHeightLast);
+    const int64_t nInterval = Params().TargetTimeSpan() / nTS;
+    if (Params().GetNetForks().isForkActivated(NetworkFork::NETFORK__4_RETARGET_CORRECTION,
+                                               nHeightLast)) {
+        nNumerator   = (nInterval - RETARGET_V3_L + RETARGET_V3_K) * nTS;
+        nDenominator = (nInterval + RETARGET_V3_K) * nTS;
+    } else {
+        nNumerator   = (nInterval - 1) * nTS;
+        nDenominator = (nInterval + 1) * nTS;
+    }
+}
+
 bool CheckProofOfWork(const uint256& hash, unsigned int nBits, bool silent)
 {
-    CBigNum bnTarget;
-    bnTarget.SetCompact(nBits);
+    bool          fNegative;
+    bool          fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
 
     // Check range
-    if (bnTarget <= 0 || bnTarget > Params().PoWLimit()) {
+    if (fNegative || fOverflow || bnTarget == 0 || bnTarget > Params().PoWLimit()) {
         if (silent) {
             return false;
         } else {
@@ -932,7 +1032,7 @@ bool CheckProofOfWork(const uint256& hash, unsigned int nBits, bool silent)
     }
 
     // Check proof of work matches claimed amount
-    if (hash > bnTarget.getuint256()) {
+    if (UintToArith256(hash) > bnTarget) {
         if (silent) {
             return false;
         } else {
@@ -961,23 +1061,30 @@ bool IsInitialBlockDownload(const ITxDB& txdb)
         return true;
     if (fImporting)
         return true;
-    static int64_t                      nLastUpdate;
-    static boost::optional<CBlockIndex> pindexLastBest;
-    const boost::optional<CBlockIndex>  pindexBestPtr = txdb.GetBestBlockIndex();
+    // the readers of the net and the wallet call this at once with cs_main shared
+    static CCriticalSection            cs_lastBest;
+    static int64_t                     nLastUpdate;
+    static boost::optional<uint256>    hashLastBest;
+    const boost::optional<CBlockIndex> pindexBestPtr = txdb.GetBestBlockIndex();
     if (!pindexBestPtr) {
         NLog.write(b_sev::critical, "CRITICAL ERROR: Best block index return none!");
         return false;
     }
 
-    if (!pindexLastBest || pindexBestPtr->GetBlockHash() != pindexLastBest->GetBlockHash()) {
-        pindexLastBest = pindexBestPtr;
-        nLastUpdate    = GetTime();
+    int64_t lastUpdate;
+    {
+        LOCK(cs_lastBest);
+        if (!hashLastBest || pindexBestPtr->GetBlockHash() != *hashLastBest) {
+            hashLastBest = pindexBestPtr->GetBlockHash();
+            nLastUpdate  = GetTime();
+        }
+        lastUpdate = nLastUpdate;
     }
 
     const int64_t timeNow       = GetTime();
     const int64_t bestBlockTime = pindexBestPtr->GetBlockTime();
 
-    const bool lastTwoBlocksCameMuchFasterThanBlockTime = timeNow - nLastUpdate < 15;
+    const bool lastTwoBlocksCameMuchFasterThanBlockTime = timeNow - lastUpdate < 15;
     const bool lastBlockIsTooOld                        = bestBlockTime < timeNow - 8 * 60 * 60;
 
     const bool tooNew = (!lastTwoBlocksCameMuchFasterThanBlockTime && !lastBlockIsTooOld);
@@ -1056,6 +1163,11 @@ void WriteNTP1TxToDiskFromRawTx(const CTransaction& tx, ITxDB& txdb)
         ntp1tx.readNTP1DataFromTx(txdb, tx, inputsWithNTP1);
 
         WriteNTP1TxToDbAndDisk(ntp1tx, txdb);
+
+        // metadata is decoded while the issuance is at hand, so that looking it up needs no tx fetch
+        if (ntp1tx.getTxType() == NTP1TxType_ISSUANCE) {
+            ntp1MetadataCache.storeIssuance(tx, ntp1tx);
+        }
     }
 }
 
@@ -1092,38 +1204,6 @@ void AssertIssuanceUniquenessInBlock(
     }
 }
 
-void static PruneOrphanBlocks()
-{
-    static const size_t MAX_SIZE_P =
-        (size_t)std::max(INT64_C(0), GetArg("-maxorphanblocks", DEFAULT_MAX_ORPHAN_BLOCKS));
-    if (mapOrphanBlocksByPrev.size() <= MAX_SIZE_P)
-        return;
-
-    // Pick a random orphan block.
-    int                                       pos = insecure_rand() % mapOrphanBlocksByPrev.size();
-    std::multimap<uint256, CBlock*>::iterator it  = mapOrphanBlocksByPrev.begin();
-    std::advance(it, pos);
-
-    // As long as this block has other orphans depending on it, move to one of those successors.
-    do {
-        std::multimap<uint256, CBlock*>::iterator it2 =
-            mapOrphanBlocksByPrev.find(it->second->GetHash());
-        if (it2 == mapOrphanBlocksByPrev.end())
-            break;
-        it = it2;
-    } while (true);
-
-    NLog.write(
-        b_sev::info,
-        "Removing block {} from orphans map as the size of the orphans has exceeded the maximum {}; "
-        "current size: {}",
-        it->second->GetHash().ToString(), MAX_SIZE_P, mapOrphanBlocksByPrev.size());
-    uint256 hash = it->second->GetHash();
-    delete it->second;
-    mapOrphanBlocksByPrev.erase(it);
-    mapOrphanBlocks.erase(hash);
-}
-
 void WriteNTP1BlockTransactionsToDisk(const std::vector<CTransaction>& vtx, ITxDB& txdb)
 {
     if (Params().PassedFirstValidNTP1Tx(&txdb)) {
@@ -1138,19 +1218,19 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
     AssertLockHeld(cs_main);
     const uint256 hash = pblock->GetHash();
     {
-        const CTxDB txdb;
+        CTxDB txdb;
 
         // Check for duplicate
         if (auto v = txdb.ReadBlockIndex(hash))
             return NLog.error("ProcessBlock() : already have block {} {}", v->nHeight, hash.ToString());
-        if (mapOrphanBlocks.count(hash))
+        if (orphanBlockPool.Touch(hash))
             return NLog.error("ProcessBlock() : already have block (orphan) {}", hash.ToString());
 
         // ppcoin: check proof-of-stake
         // Limited duplicity on stake: prevents block flood attack
         // Duplicate stake allowed only when there is orphan child block
         if (pblock->IsProofOfStake() && txdb.WasStakeSeen(pblock->GetProofOfStake()).value_or(false) &&
-            !mapOrphanBlocksByPrev.count(hash)) {
+            !orphanBlockPool.HasChildren(hash)) {
             return NLog.error("ProcessBlock() : duplicate proof-of-stake ({}, {}) for block {}",
                               pblock->GetProofOfStake().first.ToString(),
                               pblock->GetProofOfStake().second, hash.ToString());
@@ -1164,9 +1244,11 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
         if (checkpoint && pblock->hashPrevBlock != txdb.GetBestBlockHash()) {
             // Extra checks to prevent "fill up memory by spamming with bogus blocks"
             int64_t deltaTime = pblock->GetBlockTime() - checkpoint->nTime;
-            CBigNum bnNewBlock;
-            bnNewBlock.SetCompact(pblock->nBits);
-            CBigNum bnRequired;
+            bool          fNegative;
+            bool          fOverflow;
+            arith_uint256 bnNewBlock;
+            bnNewBlock.SetCompact(pblock->nBits, &fNegative, &fOverflow);
+            arith_uint256 bnRequired;
 
             if (pblock->IsProofOfStake()) {
                 const CBlockIndex& bi = GetLastBlockIndex(*checkpoint, true, txdb);
@@ -1176,7 +1258,7 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
                 bnRequired.SetCompact(ComputeMinWork(bi.nBits, deltaTime));
             }
 
-            if (bnNewBlock > bnRequired) {
+            if (!fNegative && (fOverflow || bnNewBlock > bnRequired)) {
                 if (pfrom)
                     pfrom->Misbehaving(100);
                 return NLog.error("ProcessBlock() : block with too little {}",
@@ -1194,28 +1276,25 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
             if (pblock->IsProofOfStake()) {
                 // Limited duplicity on stake: prevents block flood attack
                 // Duplicate stake allowed only when there is orphan child block
-                if (setStakeSeenOrphan.count(pblock->GetProofOfStake()) &&
-                    !mapOrphanBlocksByPrev.count(hash))
+                if (orphanBlockPool.IsStakeSeen(pblock->GetProofOfStake()) &&
+                    !orphanBlockPool.HasChildren(hash))
                     return NLog.error(
                         "ProcessBlock() : duplicate proof-of-stake ({}, {}) for orphan block {}",
                         pblock->GetProofOfStake().first.ToString(), pblock->GetProofOfStake().second,
                         hash.ToString());
-                else
-                    setStakeSeenOrphan.insert(pblock->GetProofOfStake());
             }
-            PruneOrphanBlocks();
-            CBlock* pblock2 = new CBlock(*pblock);
-            mapOrphanBlocks.insert(make_pair(hash, pblock2));
-            mapOrphanBlocksByPrev.insert(make_pair(pblock2->hashPrevBlock, pblock2));
+            if (!orphanBlockPool.Add(*pblock, hash, pfrom ? pfrom->nodeid : COrphanBlockPool::NO_PEER,
+                                     txdb))
+                return false;
 
-            // Ask this guy to fill in what we're missing
-            if (pfrom) {
+            // Ask this guy to fill in what we're missing, unless the headers-first sync is on it
+            if (pfrom && !headersSync.IsSyncing(txdb, GetTime())) {
                 const boost::optional<CBlockIndex> bestBlockIndex = txdb.GetBestBlockIndex();
-                pfrom->PushGetBlocks(&*bestBlockIndex, GetOrphanRoot(pblock2));
+                pfrom->PushGetBlocks(&*bestBlockIndex, orphanBlockPool.GetRoot(hash));
                 // ppcoin: getblocks may not obtain the ancestor block rejected
                 // earlier by duplicate-stake check so we ask for it again directly
                 if (!IsInitialBlockDownload(txdb))
-                    pfrom->AskFor(CInv(MSG_BLOCK, WantedByOrphan(pblock2)));
+                    pfrom->AskFor(CInv(MSG_BLOCK, orphanBlockPool.GetWantedBlock(hash)));
             }
             return true;
         }
@@ -1228,33 +1307,29 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
     }
 
     // Recursively process any orphan blocks that depended on this one
+    // CTxDB reads the database directly, so a single instance sees the blocks accepted in the loop
+    CTxDB           txdb;
     vector<uint256> vWorkQueue;
     vWorkQueue.push_back(hash);
     for (unsigned int i = 0; i < vWorkQueue.size(); i++) {
-        uint256 hashPrev = vWorkQueue[i];
-        for (multimap<uint256, CBlock*>::iterator mi = mapOrphanBlocksByPrev.lower_bound(hashPrev);
-             mi != mapOrphanBlocksByPrev.upper_bound(hashPrev); ++mi) {
-            CBlock* pblockOrphan = (*mi).second;
-
-            // we use a new instance of CTxDB to ensure that newly added blocks are included
-            const CTxDB txdbNew;
-
-            const boost::optional<CBlockIndex> prevBlockIdx = txdbNew.ReadBlockIndex(hashPrev);
-            if (!prevBlockIdx) {
-                NLog.write(b_sev::critical,
-                           "CRITICAL ERROR: A prev block was not found after having been "
-                           "added! This should NEVER happen.");
-                continue;
-            }
+        const uint256 hashPrev = vWorkQueue[i];
 
-            if (pblockOrphan->AcceptBlock(*prevBlockIdx, pblockOrphan->GetHash()))
-                vWorkQueue.push_back(pblockOrphan->GetHash());
+        const std::vector<COrphanBlockPool::OrphanBlock> children =
+            orphanBlockPool.TakeChildren(hashPrev, txdb);
+        if (children.empty())
+            continue;
 
-            mapOrphanBlocks.erase(pblockOrphan->GetHash());
-            setStakeSeenOrphan.erase(pblockOrphan->GetProofOfStake());
-            delete pblockOrphan;
+        const boost::optional<CBlockIndex> prevBlockIdx = txdb.ReadBlockIndex(hashPrev);
+        if (!prevBlockIdx) {
+            NLog.write(b_sev::critical, "CRITICAL ERROR: A prev block was not found after having been "
+                                        "added! This should NEVER happen.");
+            continue;
+        }
+
+        for (const COrphanBlockPool::OrphanBlock& orphan : children) {
+            if (orphan.block->AcceptBlock(*prevBlockIdx, orphan.hash))
+                vWorkQueue.push_back(orphan.hash);
         }
-        mapOrphanBlocksByPrev.erase(hashPrev);
     }
 
     NLog.write(b_sev::info, "ProcessBlock: ACCEPTED");
@@ -1678,7 +1753,7 @@ string GetWarnings(string strFor)
     string strStatusBar;
     string strRPC;
 
-    if (GetBoolArg("-testsafemode"))
+    if (GetRuntimeConfig().fTestSafeMode)
         strRPC = "test";
 
     // Misc warnings like out of disk space and clock is wrong
@@ -1710,12 +1785,214 @@ bool static AlreadyHave(const CTxDB& txdb, const CInv& inv)
     }
 
     case MSG_BLOCK:
-        return txdb.ReadBlockIndex(inv.hash) || mapOrphanBlocks.count(inv.hash);
+    case MSG_CMPCT_BLOCK:
+        return txdb.ReadBlockIndex(inv.hash) || orphanBlockPool.Contains(inv.hash);
     }
     // Don't know what it is, just say we already got one
     return true;
 }
 
+// the peers that announce new blocks to us with "cmpctblock" right away; guarded by cs_main
+static std::deque<int64_t> dequeCompactBlockAnnouncers;
+
+// Peers that deliver new blocks first are asked to send the next ones as compact blocks without
+// waiting for a getdata, which saves a round trip. Only the last MAX_CMPCTBLOCK_ANNOUNCERS are kept.
+static void UseAsCompactBlockAnnouncer(CNode* pfrom)
+{
+    AssertLockHeld(cs_main);
+    if (std::find(dequeCompactBlockAnnouncers.begin(), dequeCompactBlockAnnouncers.end(),
+                  pfrom->nodeid) != dequeCompactBlockAnnouncers.end())
+        return;
+
+    pfrom->PushMessage("sendcmpct", true, CMPCTBLOCKS_VERSION);
+    dequeCompactBlockAnnouncers.push_back(pfrom->nodeid);
+    if (dequeCompactBlockAnnouncers.size() <= MAX_CMPCTBLOCK_ANNOUNCERS)
+        return;
+
+    const int64_t oldestId = dequeCompactBlockAnnouncers.front();
+    dequeCompactBlockAnnouncers.pop_front();
+    LOCK(cs_vNodes);
+    for (CNode* pnode : vNodes) {
+        if (pnode->nodeid == oldestId) {
+            pnode->PushMessage("sendcmpct", false, CMPCTBLOCKS_VERSION);
+            break;
+        }
+    }
+}
+
+static void ProcessReceivedBlock(CNode* pfrom, CBlock& block, const uint256& hashBlock,
+                                 bool fCompact)
+{
+    NLog.write(b_sev::info, "received block {}{}", hashBlock.ToString(), fCompact ? " (compact)" : "");
+
+    CInv inv(MSG_BLOCK, hashBlock);
+    pfrom->AddInventoryKnown(inv);
+
+    headersSync.BlockReceived(hashBlock, pfrom->nodeid);
+
+    if (ProcessBlock(pfrom, &block)) {
+        mapAlreadyAskedFor.erase(inv);
+        mapAlreadyAskedFor.erase(CInv(MSG_CMPCT_BLOCK, hashBlock));
+        if (fCompact && CTxDB().GetBestBlockHash() == hashBlock)
+            UseAsCompactBlockAnnouncer(pfrom);
+    } else if (block.reject) {
+        pfrom->PushMessage("reject", std::string("block"), block.reject->chRejectCode,
+                           block.reject->strRejectReason, block.reject->hashBlock);
+    }
+
+    if (block.nDoS) {
+        pfrom->Misbehaving(block.nDoS);
+        headersSync.BlockInvalid(hashBlock);
+    }
+}
+
+static void RequestFullBlock(CNode* pfrom, const uint256& hashBlock)
+{
+    pfrom->PushMessage("getdata", std::vector<CInv>(1, CInv(MSG_BLOCK, hashBlock)));
+}
+
+static void FinishCompactBlock(CNode* pfrom, const PartiallyDownloadedBlock& partialBlock,
+                               const std::vector<CTransaction>& vtxMissing)
+{
+    CBlock block;
+    switch (partialBlock.FillBlock(block, vtxMissing)) {
+    case PartiallyDownloadedBlock::ReadStatus::INVALID:
+        pfrom->Misbehaving(100);
+        NLog.write(b_sev::warn, "Peer {} sent invalid transactions for the compact block {}",
+                   pfrom->addr.ToString(), partialBlock.GetBlockHash().ToString());
+        return;
+    case PartiallyDownloadedBlock::ReadStatus::FAILED:
+        RequestFullBlock(pfrom, partialBlock.GetBlockHash());
+        return;
+    case PartiallyDownloadedBlock::ReadStatus::OK:
+        break;
+    }
+    ProcessReceivedBlock(pfrom, block, partialBlock.GetBlockHash(), true);
+}
+
+static void ProcessCompactBlock(CNode* pfrom, const CBlockHeaderAndShortTxIDs& cmpctblock)
+{
+    AssertLockHeld(cs_main);
+
+    const uint256 hashBlock = cmpctblock.header.GetHash();
+    pfrom->AddInventoryKnown(CInv(MSG_BLOCK, hashBlock));
+
+    const CTxDB txdb;
+    if (AlreadyHave(txdb, CInv(MSG_BLOCK, hashBlock))) {
+        mapAlreadyAskedFor.erase(CInv(MSG_CMPCT_BLOCK, hashBlock));
+        return;
+    }
+
+    // blocks that don't connect to our chain go through the orphans pool, which needs them whole
+    if (!txdb.ReadBlockIndex(cmpctblock.header.hashPrevBlock)) {
+        RequestFullBlock(pfrom, hashBlock);
+        return;
+    }
+
+    std::shared_ptr<PartiallyDownloadedBlock> partialBlock =
+        std::make_shared<PartiallyDownloadedBlock>();
+    switch (partialBlock->InitData(cmpctblock, hashBlock, mempool)) {
+    case PartiallyDownloadedBlock::ReadStatus::INVALID:
+        pfrom->Misbehaving(100);
+        NLog.write(b_sev::warn, "Peer {} sent an invalid compact block {}", pfrom->addr.ToString(),
+                   hashBlock.ToString());
+        return;
+    case PartiallyDownloadedBlock::ReadStatus::FAILED:
+        RequestFullBlock(pfrom, hashBlock);
+        return;
+    case PartiallyDownloadedBlock::ReadStatus::OK:
+        break;
+    }
+
+    BlockTransactionsRequest req;
+    req.blockhash = hashBlock;
+    req.indexes   = partialBlock->GetMissingIndexes();
+    if (req.indexes.empty()) {
+        FinishCompactBlock(pfrom, *partialBlock, std::vector<CTransaction>());
+        return;
+    }
+
+    NLog.write(b_sev::debug, "Compact block {} is missing {} transactions, asking peer {}",
+               hashBlock.ToString(), req.indexes.size(), pfrom->addr.ToString());
+    pfrom->pPartialBlock = partialBlock;
+    pfrom->PushMessage("getblocktxn", req);
+}
+
+void ProcessRelayedTransaction(CNode* pfrom, const CTransaction& tx,
+                               const boost::optional<Result<void, TxValidationState>>& preValidationRes)
+{
+    AssertLockHeld(cs_main);
+
+    vector<uint256> vWorkQueue;
+    vector<uint256> vEraseQueue;
+    const CInv      inv(MSG_TX, tx.GetHash());
+
+    const CTxDB txdb;
+
+    // Missing inputs may have reached the mempool since the pre-validation, other failures are final
+    const bool fPreValidationFailed =
+        preValidationRes && preValidationRes->isErr() &&
+        preValidationRes->unwrapErr(RESULT_PRE).GetResult() != TxValidationResult::TX_MISSING_INPUTS;
+    const Result<void, TxValidationState> mempoolRes =
+        fPreValidationFailed
+            ? *preValidationRes
+            : AcceptToMemoryPool(mempool, tx, nullptr, preValidationRes && preValidationRes->isOk());
+    if (mempoolRes.isOk()) {
+        SyncWithWallets(txdb, tx, nullptr);
+        RelayTransaction(tx);
+        mapAlreadyAskedFor.erase(inv);
+        vWorkQueue.push_back(inv.hash);
+        vEraseQueue.push_back(inv.hash);
+
+        // Recursively process any orphan transactions that depended on this one
+        for (unsigned int i = 0; i < vWorkQueue.size(); i++) {
+            uint256 hashPrev = vWorkQueue[i];
+            for (set<uint256>::iterator mi = mapOrphanTransactionsByPrev[hashPrev].begin();
+                 mi != mapOrphanTransactionsByPrev[hashPrev].end(); ++mi) {
+                const uint256&      orphanTxHash = *mi;
+                const CTransaction& orphanTx     = mapOrphanTransactions[orphanTxHash];
+
+                const Result<void, TxValidationState> mempoolOrphanRes =
+                    AcceptToMemoryPool(mempool, orphanTx);
+                if (mempoolOrphanRes.isOk()) {
+                    NLog.write(b_sev::info, "   accepted orphan tx {}", orphanTxHash.ToString());
+                    SyncWithWallets(txdb, orphanTx, nullptr);
+                    RelayTransaction(orphanTx);
+                    mapAlreadyAskedFor.erase(CInv(MSG_TX, orphanTxHash));
+                    vWorkQueue.push_back(orphanTxHash);
+                    vEraseQueue.push_back(orphanTxHash);
+                } else if (mempoolOrphanRes.unwrapErr(RESULT_PRE).GetResult() !=
+                           TxValidationResult::TX_MISSING_INPUTS) {
+                    // invalid orphan
+                    vEraseQueue.push_back(orphanTxHash);
+                    NLog.write(b_sev::info, "   removed invalid orphan tx {}", orphanTxHash.ToString());
+                }
+            }
+        }
+
+        for (uint256 hash : vEraseQueue)
+            EraseOrphanTx(hash);
+    } else if (mempoolRes.unwrapErr(RESULT_PRE).GetResult() == TxValidationResult::TX_MISSING_INPUTS) {
+        AddOrphanTx(tx);
+
+        // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+        unsigned int nMaxOrphanTx =
+            (unsigned int)std::max(INT64_C(0), GetRuntimeConfig().nMaxOrphanTx);
+        unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+        if (nEvicted > 0)
+            NLog.write(b_sev::warn, "mapOrphan overflow, removed {} tx", nEvicted);
+    }
+
+    if (tx.reject) {
+        pfrom->PushMessage("reject", std::string("tx"), tx.reject->chRejectCode,
+                           tx.reject->strRejectReason.substr(0, MAX_REJECT_MESSAGE_LENGTH),
+                           tx.reject->hashTx);
+    }
+    if (tx.nDoS) {
+        pfrom->Misbehaving(tx.nDoS);
+    }
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
 {
     static map<CService, CPubKey> mapReuseKey;
@@ -1784,13 +2061,18 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
 
         pfrom->fClient = !(pfrom->nServices & NODE_NETWORK);
 
-        if (GetBoolArg("-synctime", true))
+        if (GetRuntimeConfig().fSyncTime)
             AddTimeData(pfrom->addr, nTime);
 
         // Change version
         pfrom->PushMessage("verack");
         pfrom->ssSend.SetVersion(min(pfrom->nVersion, PROTOCOL_VERSION));
 
+        // We understand compact blocks; the peer is asked to announce new blocks with them only once
+        // it turns out to be among the first to relay new blocks to us
+        if (pfrom->nVersion >= COMPACT_BLOCKS_VERSION && GetRuntimeConfig().fCompactBlocks)
+            pfrom->PushMessage("sendcmpct", false, CMPCTBLOCKS_VERSION);
+
         if (!pfrom->fInbound) {
             // Advertise our address
             if (!fNoListen && !IsInitialBlockDownload(CTxDB())) {
@@ -1819,7 +2101,13 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         // split and reconnect the network
         CTxDB      txdb;
         static int nAskedForBlocks = 0;
-        if ((!pfrom->fClient && !pfrom->fOneShot && !fImporting) &&
+        // With headers-first sync, peers that are far ahead are synced from in SendMessages(), once
+        // the blocks of the header chain are getting connected
+        const bool fHeadersFirst =
+            CHeadersSync::IsEnabled() &&
+            pfrom->nStartingHeight > txdb.GetBestChainHeight().value_or(0) + HEADERS_SYNC_MIN_LAG &&
+            headersSync.IsSyncing(txdb, GetTime());
+        if ((!pfrom->fClient && !pfrom->fOneShot && !fImporting && !fHeadersFirst) &&
             (((pfrom->nStartingHeight > (txdb.GetBestChainHeight().value_or(0) - 144)) &&
               (pfrom->nVersion < NOBLKS_VERSION_START || pfrom->nVersion >= NOBLKS_VERSION_END) &&
               (nAskedForBlocks < 1 || vNodes.size() <= 1)) ||
@@ -1930,6 +2218,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
             }
         }
         const CTxDB txdb;
+        const bool  fHeadersSyncing = headersSync.IsSyncing(txdb, GetTime());
+        const bool  fCompactBlocks  = pfrom->fSupportsCompactBlocks &&
+                                    GetRuntimeConfig().fCompactBlocks && !IsInitialBlockDownload(txdb);
         for (unsigned int nInv = 0; nInv < vInv.size(); nInv++) {
             const CInv& inv = vInv[nInv];
 
@@ -1944,11 +2235,19 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                                fAlreadyHave ? "have" : "new");
 
                 if (!fAlreadyHave) {
-                    if (!fImporting)
+                    // blocks of the known header chain are requested by the headers-first sync
+                    const bool fRequest =
+                        !fImporting && !(inv.type == MSG_BLOCK && headersSync.IsKnownHeader(inv.hash));
+                    if (fRequest && inv.type == MSG_BLOCK && fCompactBlocks)
+                        // a new block at the tip, whose transactions we most likely have already
+                        pfrom->AskFor(CInv(MSG_CMPCT_BLOCK, inv.hash));
+                    else if (fRequest)
                         pfrom->AskFor(inv);
-                } else if (inv.type == MSG_BLOCK && mapOrphanBlocks.count(inv.hash)) {
+                } else if (fHeadersSyncing) {
+                    // the headers-first sync takes care of getting the rest of the chain
+                } else if (inv.type == MSG_BLOCK && orphanBlockPool.Contains(inv.hash)) {
                     const boost::optional<CBlockIndex> best = txdb.GetBestBlockIndex();
-                    pfrom->PushGetBlocks(&*best, GetOrphanRoot(mapOrphanBlocks[inv.hash]));
+                    pfrom->PushGetBlocks(&*best, orphanBlockPool.GetRoot(inv.hash));
                 } else if (nInv == nLastBlock) {
                     // In case we are on a very long side-chain, it is possible that we already have
                     // the last block in an inv bundle sent in response to getblocks. Try to detect
@@ -1988,19 +2287,42 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
             if (fDebugNet || (vInv.size() == 1))
                 NLog.write(b_sev::debug, "received getdata for: {}", inv.ToString());
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK ||
+                inv.type == MSG_CMPCT_BLOCK) {
                 // Send block from disk
                 auto mi = txdb.ReadBlockIndex(inv.hash);
                 if (mi) {
                     CBlock block;
                     block.ReadFromDisk(&*mi, txdb);
-                    if (inv.type == MSG_BLOCK)
+                    if (inv.type == MSG_CMPCT_BLOCK) {
+                        // the peer is unlikely to have the transactions of older blocks in its mempool
+                        if (mi->nHeight >=
+                                txdb.GetBestChainHeight().value_or(0) - MAX_CMPCTBLOCK_DEPTH &&
+                            block.vtx.size() <= MAX_CMPCTBLOCK_TXS)
+                            pfrom->PushMessage("cmpctblock", CBlockHeaderAndShortTxIDs(block));
+                        else
+                            pfrom->PushMessage("block", block);
+                    } else if (inv.type == MSG_BLOCK)
                         pfrom->PushMessage("block", block);
                     else // MSG_FILTERED_BLOCK)
                     {
-                        LOCK(pfrom->cs_filter);
-                        if (pfrom->pfilter) {
-                            CMerkleBlock merkleBlock(block, *pfrom->pfilter);
+                        // The block is matched against a copy of the filter, so that cs_filter, which
+                        // the relay of every transaction to the peer takes, isn't held while every
+                        // transaction is hashed. The outputs the matches added are then added to the
+                        // filter of the peer, unless a filterload replaced it in the meantime
+                        boost::optional<CBloomFilter> filter;
+                        {
+                            LOCK(pfrom->cs_filter);
+                            if (pfrom->pfilter)
+                                filter = *pfrom->pfilter;
+                        }
+                        if (filter) {
+                            CMerkleBlock merkleBlock(block, *filter);
+                            if (!merkleBlock.vMatchedTxn.empty() && filter->IsUpdatedOnMatch()) {
+                                LOCK(pfrom->cs_filter);
+                                if (pfrom->pfilter)
+                                    pfrom->pfilter->AddInsertionsOf(*filter);
+                            }
                             // CMerkleBlock just contains hashes, so also push any transactions in the
                             // block the client did not see This avoids hurting performance by
                             // pointlessly requiring a round-trip Note that there is currently no way for
@@ -2009,9 +2331,15 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                             // spec specified allows for us to provide duplicate txn here, however we
                             // MUST always provide at least what the remote peer needs
                             typedef std::pair<unsigned int, uint256> PairType;
-                            for (PairType& pair : merkleBlock.vMatchedTxn)
-                                if (!pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
+                            for (PairType& pair : merkleBlock.vMatchedTxn) {
+                                bool fKnown;
+                                {
+                                    LOCKN(pfrom->cs_inventory, lockInv);
+                                    fKnown = pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second));
+                                }
+                                if (!fKnown)
                                     pfrom->PushMessage("tx", block.vtx[pair.first]);
+                            }
                             pfrom->PushMessage("merkleblock", merkleBlock);
                         }
                         // else
@@ -2137,7 +2465,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         }
 
         vector<CBlock> vHeaders;
-        int            nLimit = 2000;
+        int            nLimit = MAX_HEADERS_RESULTS;
         NLog.write(b_sev::info, "getheaders {} to {}", (pindex ? pindex->nHeight : -1),
                    hashStop.ToString());
         while (pindex) {
@@ -2149,96 +2477,101 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         pfrom->PushMessage("headers", vHeaders);
     }
 
+    else if (strCommand == "headers") {
+        vector<CBlock> vHeaders;
+        vRecv >> vHeaders;
+
+        const CTxDB txdb;
+        headersSync.ProcessHeadersMessage(pfrom, vHeaders, txdb);
+    }
+
     else if (strCommand == "tx") {
-        vector<uint256> vWorkQueue;
-        vector<uint256> vEraseQueue;
-        CTransaction    tx;
+        CTransaction tx;
         vRecv >> tx;
 
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        const CTxDB txdb;
+        // without cs_main; the validation queue takes it only for adding the tx to the mempool
+        if (!txPreValidationQueue.push(pfrom, tx)) {
+            LOCK(cs_main);
+            ProcessRelayedTransaction(pfrom, tx, boost::none);
+        }
+    }
 
-        const Result<void, TxValidationState> mempoolRes = AcceptToMemoryPool(mempool, tx);
-        if (mempoolRes.isOk()) {
-            SyncWithWallets(txdb, tx, nullptr);
-            RelayTransaction(tx);
-            mapAlreadyAskedFor.erase(inv);
-            vWorkQueue.push_back(inv.hash);
-            vEraseQueue.push_back(inv.hash);
-
-            // Recursively process any orphan transactions that depended on this one
-            for (unsigned int i = 0; i < vWorkQueue.size(); i++) {
-                uint256 hashPrev = vWorkQueue[i];
-                for (set<uint256>::iterator mi = mapOrphanTransactionsByPrev[hashPrev].begin();
-                     mi != mapOrphanTransactionsByPrev[hashPrev].end(); ++mi) {
-                    const uint256&      orphanTxHash = *mi;
-                    const CTransaction& orphanTx     = mapOrphanTransactions[orphanTxHash];
-
-                    const Result<void, TxValidationState> mempoolOrphanRes =
-                        AcceptToMemoryPool(mempool, orphanTx);
-                    if (mempoolOrphanRes.isOk()) {
-                        NLog.write(b_sev::info, "   accepted orphan tx {}", orphanTxHash.ToString());
-                        SyncWithWallets(txdb, tx, nullptr);
-                        RelayTransaction(orphanTx);
-                        mapAlreadyAskedFor.erase(CInv(MSG_TX, orphanTxHash));
-                        vWorkQueue.push_back(orphanTxHash);
-                        vEraseQueue.push_back(orphanTxHash);
-                    } else if (mempoolOrphanRes.unwrapErr(RESULT_PRE).GetResult() !=
-                               TxValidationResult::TX_MISSING_INPUTS) {
-                        // invalid orphan
-                        vEraseQueue.push_back(orphanTxHash);
-                        NLog.write(b_sev::info, "   removed invalid orphan tx {}",
-                                   orphanTxHash.ToString());
-                    }
-                }
-            }
+    else if (strCommand == "block") {
+        CBlock block;
+        vRecv >> block;
+        const uint256 hashBlock = block.GetHash();
 
-            for (uint256 hash : vEraseQueue)
-                EraseOrphanTx(hash);
-        } else if (mempoolRes.unwrapErr(RESULT_PRE).GetResult() ==
-                   TxValidationResult::TX_MISSING_INPUTS) {
-            AddOrphanTx(tx);
+        // a full block answers the compact block we may be waiting for, too
+        if (pfrom->pPartialBlock && pfrom->pPartialBlock->GetBlockHash() == hashBlock)
+            pfrom->pPartialBlock.reset();
 
-            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
-            unsigned int nMaxOrphanTx = (unsigned int)std::max(
-                INT64_C(0), GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
-            if (nEvicted > 0)
-                NLog.write(b_sev::warn, "mapOrphan overflow, removed {} tx", nEvicted);
-        }
+        ProcessReceivedBlock(pfrom, block, hashBlock, false);
+    }
 
-        if (tx.reject) {
-            pfrom->PushMessage("reject", std::string("tx"), tx.reject->chRejectCode,
-                               tx.reject->strRejectReason.substr(0, MAX_REJECT_MESSAGE_LENGTH),
-                               tx.reject->hashTx);
-        }
-        if (tx.nDoS) {
-            pfrom->Misbehaving(tx.nDoS);
+    else if (strCommand == "sendcmpct") {
+        bool     fAnnounce     = false;
+        uint64_t nCmpctVersion = 0;
+        vRecv >> fAnnounce >> nCmpctVersion;
+        if (nCmpctVersion == CMPCTBLOCKS_VERSION) {
+            pfrom->fSupportsCompactBlocks = true;
+            pfrom->fAnnounceCompactBlocks = fAnnounce;
         }
     }
 
-    else if (strCommand == "block") {
-        CBlock block;
-        vRecv >> block;
-        uint256 hashBlock = block.GetHash();
+    else if (strCommand == "cmpctblock") {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+        ProcessCompactBlock(pfrom, cmpctblock);
+    }
 
-        NLog.write(b_sev::info, "received block {}", hashBlock.ToString());
+    else if (strCommand == "blocktxn") {
+        BlockTransactions resp;
+        vRecv >> resp;
 
-        CInv inv(MSG_BLOCK, hashBlock);
-        pfrom->AddInventoryKnown(inv);
+        const std::shared_ptr<PartiallyDownloadedBlock> partialBlock = pfrom->pPartialBlock;
+        if (!partialBlock || partialBlock->GetBlockHash() != resp.blockhash) {
+            NLog.write(b_sev::debug, "Peer {} sent unrequested blocktxn for {}", pfrom->addr.ToString(),
+                       resp.blockhash.ToString());
+            return true;
+        }
+        pfrom->pPartialBlock.reset();
+        FinishCompactBlock(pfrom, *partialBlock, resp.txn);
+    }
+
+    else if (strCommand == "getblocktxn") {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        const CTxDB                        txdb;
+        const boost::optional<CBlockIndex> bi = txdb.ReadBlockIndex(req.blockhash);
+        if (!bi) {
+            NLog.write(b_sev::debug, "Peer {} asked for transactions of the unknown block {}",
+                       pfrom->addr.ToString(), req.blockhash.ToString());
+            return true;
+        }
+        CBlock block;
+        if (!block.ReadFromDisk(&*bi, txdb))
+            return NLog.error("getblocktxn: failed to read block {} from disk", req.blockhash.ToString());
 
-        if (ProcessBlock(pfrom, &block)) {
-            mapAlreadyAskedFor.erase(inv);
-        } else if (block.reject) {
-            pfrom->PushMessage("reject", std::string("block"), block.reject->chRejectCode,
-                               block.reject->strRejectReason, block.reject->hashBlock);
+        // only recent blocks are worth the trouble, the full block is cheaper to find for older ones
+        if (bi->nHeight < txdb.GetBestChainHeight().value_or(0) - MAX_BLOCKTXN_DEPTH) {
+            pfrom->PushMessage("block", block);
+            return true;
         }
 
-        if (block.nDoS) {
-            pfrom->Misbehaving(block.nDoS);
+        BlockTransactions resp(req);
+        for (unsigned int i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                pfrom->Misbehaving(100);
+                return NLog.error("Peer {} asked for an out-of-bounds transaction index {} of block {}",
+                                  pfrom->addr.ToString(), req.indexes[i], req.blockhash.ToString());
+            }
+            resp.txn[i] = block.vtx[req.indexes[i]];
         }
+        pfrom->PushMessage("blocktxn", resp);
     }
 
     else if (strCommand == "getaddr") {
@@ -2342,8 +2675,20 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
     return true;
 }
 
+// Messages that only read from the database/mempool or reply to the peer don't need cs_main. This
+// lets a peer that requests lots of blocks be served without stalling everyone else's relay.
+static bool MessageRequiresMainLock(const std::string& strCommand)
+{
+    return !(strCommand == "getdata" || strCommand == "getblocktxn" || strCommand == "ping" ||
+             strCommand == "verack" || strCommand == "mempool" || strCommand == "tx");
+}
+
+// An inv only looks the announced items up in the chain, the mempool and the orphans, so the invs of
+// several peers are processed together with cs_main shared.
+static bool MessageOnlyReadsMainState(const std::string& strCommand) { return strCommand == "inv"; }
+
 // requires LOCK(cs_vRecvMsg)
-bool ProcessMessages(CNode* pfrom)
+bool ProcessMessages(CNode* pfrom, unsigned int nMaxMessages)
 {
     if (fDebug)
         NLog.write(b_sev::debug, "ProcessMessages({} messages)", pfrom->vRecvMsg.size());
@@ -2358,8 +2703,14 @@ bool ProcessMessages(CNode* pfrom)
     //
     bool fOk = true;
 
+    unsigned int nProcessed = 0;
+
     std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.begin();
     while (!pfrom->fDisconnect && it != pfrom->vRecvMsg.end()) {
+        // Give other peers a turn; the caller will come back for the rest
+        if (nProcessed >= nMaxMessages)
+            break;
+
         // Don't bother if send buffer is too full to respond anyway
         if (pfrom->nSendSize >= SendBufferSize())
             break;
@@ -2377,6 +2728,7 @@ bool ProcessMessages(CNode* pfrom)
 
         // at this point, any failure means we can delete the current message
         it++;
+        nProcessed++;
 
         // Scan for message start
         if (memcmp(msg.hdr.pchMessageStart, Params().MessageStart(),
@@ -2413,9 +2765,14 @@ bool ProcessMessages(CNode* pfrom)
         // Process message
         bool fRet = false;
         try {
-            {
+            if (MessageOnlyReadsMainState(strCommand)) {
+                LOCK_SHARED(cs_main);
+                fRet = ProcessMessage(pfrom, strCommand, vRecv);
+            } else if (MessageRequiresMainLock(strCommand)) {
                 LOCK(cs_main);
                 fRet = ProcessMessage(pfrom, strCommand, vRecv);
+            } else {
+                fRet = ProcessMessage(pfrom, strCommand, vRecv);
             }
             if (fShutdown)
                 break;
@@ -2454,142 +2811,162 @@ bool ProcessMessages(CNode* pfrom)
 
 bool SendMessages(CNode* pto, bool fSendTrickle)
 {
-    TRY_LOCK(cs_main, lockMain);
-    if (lockMain) {
-        // Don't send anything until we get their version message
-        if (pto->nVersion == 0)
-            return true;
-
-        // Keep-alive ping. We send a nonce of zero because we don't use it anywhere
-        // right now.
-        if (pto->nLastSend && GetTime() - pto->nLastSend > 30 * 60 && pto->vSendMsg.empty()) {
-            uint64_t nonce = 0;
-            if (pto->nVersion > BIP0031_VERSION)
-                pto->PushMessage("ping", nonce);
-            else
-                pto->PushMessage("ping");
-        }
+    // Don't send anything until we get their version message
+    if (pto->nVersion == 0)
+        return false;
 
-        // Resend wallet transactions that haven't gotten in a block yet
-        ResendWalletTransactions();
+    // Keep-alive ping. We send a nonce of zero because we don't use it anywhere
+    // right now.
+    if (pto->nLastSend && GetTime() - pto->nLastSend > 30 * 60 && pto->vSendMsg.empty()) {
+        uint64_t nonce = 0;
+        if (pto->nVersion > BIP0031_VERSION)
+            pto->PushMessage("ping", nonce);
+        else
+            pto->PushMessage("ping");
+    }
 
-        // Address refresh broadcast
-        static int64_t nLastRebroadcast;
-        if (!IsInitialBlockDownload(CTxDB()) && (GetTime() - nLastRebroadcast > 24 * 60 * 60)) {
-            {
-                LOCK(cs_vNodes);
-                for (CNode* pnode : vNodes) {
-                    // Periodically clear setAddrKnown to allow refresh broadcasts
-                    if (nLastRebroadcast)
-                        pnode->setAddrKnown.clear();
-
-                    // Rebroadcast our address
-                    if (!fNoListen) {
-                        CAddress addr = GetLocalAddress(&pnode->addr);
-                        if (addr.IsRoutable())
-                            pnode->PushAddress(addr);
-                    }
-                }
+    //
+    // Message: inventory
+    //
+    // this only needs the inventory of the peer, so the relay of transactions and blocks doesn't wait
+    // for cs_main. The wallets are asked without holding cs_inventory, since the wallet relays its
+    // transactions with cs_wallet held.
+    vector<CInv> vInvToSend;
+    {
+        LOCK(pto->cs_inventory);
+        vInvToSend.swap(pto->vInventoryToSend);
+    }
+    vector<bool> vfTrickleWait(vInvToSend.size(), false);
+    for (std::size_t i = 0; i < vInvToSend.size(); i++) {
+        const CInv& inv = vInvToSend[i];
+        // trickle out tx inv to protect privacy
+        if (inv.type == MSG_TX && !fSendTrickle) {
+            // 1/4 of tx invs blast to all immediately
+            static const uint256 hashSalt = GetRandHash();
+            uint256              hashRand = inv.hash ^ hashSalt;
+            hashRand                      = Hash(BEGIN(hashRand), END(hashRand));
+            bool fTrickleWait             = ((hashRand & 3) != 0);
+
+            // always trickle our own transactions
+            if (!fTrickleWait) {
+                CWalletTx wtx;
+                if (GetTransaction(inv.hash, wtx))
+                    if (wtx.fFromMe)
+                        fTrickleWait = true;
             }
-            nLastRebroadcast = GetTime();
+            vfTrickleWait[i] = fTrickleWait;
         }
+    }
+    vector<CInv> vInv;
+    {
+        LOCK(pto->cs_inventory);
+        vector<CInv> vInvWait;
+        vInv.reserve(vInvToSend.size());
+        vInvWait.reserve(vInvToSend.size() + pto->vInventoryToSend.size());
+        for (std::size_t i = 0; i < vInvToSend.size(); i++) {
+            const CInv& inv = vInvToSend[i];
+            if (pto->setInventoryKnown.count(inv))
+                continue;
 
-        //
-        // Message: addr
-        //
-        if (fSendTrickle) {
-            vector<CAddress> vAddr;
-            vAddr.reserve(pto->vAddrToSend.size());
-            for (const CAddress& addr : pto->vAddrToSend) {
-                // returns true if wasn't already contained in the set
-                if (pto->setAddrKnown.insert(addr).second) {
-                    vAddr.push_back(addr);
-                    // receiver rejects addr messages larger than 1000
-                    if (vAddr.size() >= 1000) {
-                        pto->PushMessage("addr", vAddr);
-                        vAddr.clear();
-                    }
+            if (vfTrickleWait[i]) {
+                vInvWait.push_back(inv);
+                continue;
+            }
+
+            // returns true if wasn't already contained in the set
+            if (pto->setInventoryKnown.insert(inv).second) {
+                vInv.push_back(inv);
+                if (vInv.size() >= 1000) {
+                    pto->PushMessage("inv", vInv);
+                    vInv.clear();
                 }
             }
-            pto->vAddrToSend.clear();
-            if (!vAddr.empty())
-                pto->PushMessage("addr", vAddr);
         }
+        // what was queued in the meantime goes after what waited already
+        vInvWait.insert(vInvWait.end(), pto->vInventoryToSend.begin(), pto->vInventoryToSend.end());
+        pto->vInventoryToSend.swap(vInvWait);
+    }
+    if (!vInv.empty())
+        pto->PushMessage("inv", vInv);
 
-        //
-        // Message: inventory
-        //
-        vector<CInv> vInv;
-        vector<CInv> vInvWait;
-        {
-            LOCK(pto->cs_inventory);
-            vInv.reserve(pto->vInventoryToSend.size());
-            vInvWait.reserve(pto->vInventoryToSend.size());
-            for (const CInv& inv : pto->vInventoryToSend) {
-                if (pto->setInventoryKnown.count(inv))
-                    continue;
-
-                // trickle out tx inv to protect privacy
-                if (inv.type == MSG_TX && !fSendTrickle) {
-                    // 1/4 of tx invs blast to all immediately
-                    static uint256 hashSalt;
-                    if (hashSalt == 0)
-                        hashSalt = GetRandHash();
-                    uint256 hashRand  = inv.hash ^ hashSalt;
-                    hashRand          = Hash(BEGIN(hashRand), END(hashRand));
-                    bool fTrickleWait = ((hashRand & 3) != 0);
-
-                    // always trickle our own transactions
-                    if (!fTrickleWait) {
-                        CWalletTx wtx;
-                        if (GetTransaction(inv.hash, wtx))
-                            if (wtx.fFromMe)
-                                fTrickleWait = true;
-                    }
+    // the rest reads the chain, and the address lists of the peers are filled by the handlers of
+    // other peers, under cs_main
+    LOCKN(cs_main, lockMain);
 
-                    if (fTrickleWait) {
-                        vInvWait.push_back(inv);
-                        continue;
-                    }
-                }
+    // Resend wallet transactions that haven't gotten in a block yet
+    ResendWalletTransactions();
 
-                // returns true if wasn't already contained in the set
-                if (pto->setInventoryKnown.insert(inv).second) {
-                    vInv.push_back(inv);
-                    if (vInv.size() >= 1000) {
-                        pto->PushMessage("inv", vInv);
-                        vInv.clear();
-                    }
+    // Address refresh broadcast
+    static int64_t nLastRebroadcast;
+    if (!IsInitialBlockDownload(CTxDB()) && (GetTime() - nLastRebroadcast > 24 * 60 * 60)) {
+        {
+            LOCK(cs_vNodes);
+            for (CNode* pnode : vNodes) {
+                // Periodically clear setAddrKnown to allow refresh broadcasts
+                if (nLastRebroadcast)
+                    pnode->setAddrKnown.clear();
+
+                // Rebroadcast our address
+                if (!fNoListen) {
+                    CAddress addr = GetLocalAddress(&pnode->addr);
+                    if (addr.IsRoutable())
+                        pnode->PushAddress(addr);
                 }
             }
-            pto->vInventoryToSend = vInvWait;
         }
-        if (!vInv.empty())
-            pto->PushMessage("inv", vInv);
+        nLastRebroadcast = GetTime();
+    }
 
-        //
-        // Message: getdata
-        //
-        vector<CInv> vGetData;
-        int64_t      nNow = GetTime() * 1000000;
-        const CTxDB  txdb;
-        while (!pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow) {
-            const CInv& inv = (*pto->mapAskFor.begin()).second;
-            if (!AlreadyHave(txdb, inv)) {
-                if (fDebugNet)
-                    NLog.write(b_sev::debug, "sending getdata: {}", inv.ToString());
-                vGetData.push_back(inv);
-                if (vGetData.size() >= 1000) {
-                    pto->PushMessage("getdata", vGetData);
-                    vGetData.clear();
+    //
+    // Message: addr
+    //
+    if (fSendTrickle) {
+        vector<CAddress> vAddr;
+        vAddr.reserve(pto->vAddrToSend.size());
+        for (const CAddress& addr : pto->vAddrToSend) {
+            // returns true if wasn't already contained in the set
+            if (pto->setAddrKnown.insert(addr).second) {
+                vAddr.push_back(addr);
+                // receiver rejects addr messages larger than 1000
+                if (vAddr.size() >= 1000) {
+                    pto->PushMessage("addr", vAddr);
+                    vAddr.clear();
                 }
-                mapAlreadyAskedFor.set(inv, nNow);
             }
-            pto->mapAskFor.erase(pto->mapAskFor.begin());
         }
-        if (!vGetData.empty())
-            pto->PushMessage("getdata", vGetData);
+        pto->vAddrToSend.clear();
+        if (!vAddr.empty())
+            pto->PushMessage("addr", vAddr);
     }
+
+    //
+    // Message: getdata
+    //
+    vector<CInv> vGetData;
+    int64_t      nNow = GetTime() * 1000000;
+    const CTxDB  txdb;
+    while (!pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow) {
+        const CInv& inv = (*pto->mapAskFor.begin()).second;
+        if (!AlreadyHave(txdb, inv)) {
+            if (fDebugNet)
+                NLog.write(b_sev::debug, "sending getdata: {}", inv.ToString());
+            vGetData.push_back(inv);
+            if (vGetData.size() >= 1000) {
+                pto->PushMessage("getdata", vGetData);
+                vGetData.clear();
+            }
+            mapAlreadyAskedFor.set(inv, nNow);
+        }
+        pto->mapAskFor.erase(pto->mapAskFor.begin());
+    }
+    if (!vGetData.empty())
+        pto->PushMessage("getdata", vGetData);
+
+    //
+    // Message: getheaders and getdata of the headers-first sync
+    //
+    headersSync.SendRequests(pto, txdb,
+                             [](const uint256& hash) { return orphanBlockPool.Contains(hash); });
     return true;
 }
 
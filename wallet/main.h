@@ -5,6 +5,7 @@
 #ifndef BITCOIN_MAIN_H
 #define BITCOIN_MAIN_H
 
+#include "arith_uint256.h"
 #include "bignum.h"
 #include "block.h"
 #include "blockindex.h"
@@ -22,6 +23,7 @@
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/shared_ptr.hpp>
+#include <limits>
 #include <list>
 #include <unordered_map>
 #include <unordered_set>
@@ -62,6 +64,8 @@ inline int64_t FutureDrift(int64_t nTime) { return nTime + 10 * 60; } // up to 1
 
 extern CScript                              COINBASE_FLAGS;
 static constexpr const int64_t              TARGET_AVERAGE_BLOCK_COUNT = 100;
+// GetNextTargetRequired() retargets with the V1 rules below this height
+static constexpr const int                  RETARGET_V2_START_HEIGHT = 2000;
 extern unsigned int                         nNodeLifespan;
 extern uint64_t                             nLastBlockTx;
 extern uint64_t                             nLastBlockSize;
@@ -70,7 +74,6 @@ extern const std::string                    strMessageMagic;
 extern boost::atomic_int64_t                nTimeBestReceived;
 extern CCriticalSection                     cs_setpwalletRegistered;
 extern std::set<std::shared_ptr<CWallet>>   setpwalletRegistered;
-extern std::unordered_map<uint256, CBlock*> mapOrphanBlocks;
 extern boost::atomic<bool>                  fImporting;
 
 // Amount of blocks that other nodes claim to have
@@ -93,6 +96,26 @@ class CReserveKey;
 class CTxDB;
 class CTxIndex;
 
+class LMDBWalletBatchScope;
+
+/**
+ * While it lives, the database writes of every registered wallet that's stored in LMDB are grouped in
+ * one transaction, which is used to write the wallet records of a block at once. The wallets are locked
+ * for its lifetime, so that no thread holding a wallet lock can end up waiting for the batch.
+ */
+class CWalletsBatchScope
+{
+    std::vector<std::unique_ptr<boost::unique_lock<CCriticalSection>>> walletLocks;
+    std::vector<std::unique_ptr<LMDBWalletBatchScope>>                 batches;
+
+public:
+    CWalletsBatchScope();
+    ~CWalletsBatchScope();
+
+    CWalletsBatchScope(const CWalletsBatchScope&) = delete;
+    CWalletsBatchScope& operator=(const CWalletsBatchScope&) = delete;
+};
+
 void         RegisterWallet(std::shared_ptr<CWallet> pwalletIn);
 void         UnregisterWallet(std::shared_ptr<CWallet> pwalletIn);
 void         SyncWithWallets(const ITxDB& txdb, const CTransaction& tx, const CBlock* pblock = NULL);
@@ -100,18 +123,26 @@ bool         ProcessBlock(CNode* pfrom, CBlock* pblock);
 bool         CheckDiskSpace(uintmax_t nAdditionalBytes = 0);
 bool         LoadBlockIndex(bool fAllowNew = true);
 void         PrintBlockTree();
-bool         ProcessMessages(CNode* pfrom);
+bool ProcessMessages(CNode* pfrom, unsigned int nMaxMessages = std::numeric_limits<unsigned int>::max());
 bool         SendMessages(CNode* pto, bool fSendTrickle);
 void         ThreadImport(std::vector<boost::filesystem::path> vFiles);
 bool         CheckProofOfWork(const uint256& hash, unsigned int nBits, bool silent = false);
 unsigned int GetNextTargetRequired(const ITxDB& txdb, const CBlockIndex* pindexLast, bool fProofOfStake);
+/// The smallest factor, nNumerator / nDenominator, by which GetNextTargetRequired() can scale the
+/// target of a proof-of-stake block to get the target of the next one, when the last block is at
+/// nHeightLast >= RETARGET_V2_START_HEIGHT
+void GetMinTargetScale(int nHeightLast, int64_t& nNumerator, int64_t& nDenominator);
 unsigned int ComputeMinWork(unsigned int nBase, int64_t nTime);
 unsigned int ComputeMinStake(unsigned int nBase, int64_t nTime, unsigned int nBlockTime);
+/// The target of nBits times nMul divided by nDiv, rounded towards zero, with the sign in fNegative, as
+/// the retargeting computed it with CBigNum. fOverflow is set, and the result is meaningless, if the
+/// target of nBits doesn't fit in 256 bits; no block on the chain has such a target.
+arith_uint512 ScaleCompactTarget(unsigned int nBits, int64_t nMul, int64_t nDiv, bool& fNegative,
+                                 bool& fOverflow);
 int          GetNumBlocksOfPeers();
 bool         IsInitialBlockDownload(const ITxDB& txdb);
 std::string  GetWarnings(std::string strFor);
 bool         GetTransaction(const uint256& hash, CTransaction& tx, uint256& hashBlock);
-uint256      WantedByOrphan(const CBlock* pblockOrphan);
 /// Given a block index object, find the last block that matches the consensus type (PoW/PoS)
 CBlockIndex GetLastBlockIndex(CBlockIndex pindex, bool fProofOfStake, const ITxDB& txdb);
 void        StakeMiner(std::shared_ptr<CWallet> pwallet);
@@ -154,9 +185,21 @@ CTransaction PopLeafTransaction(std::vector<CTransaction>& vtx);
 /** True if the transaction is in the main chain (can throw) */
 bool IsTxInMainChain(const ITxDB& txdb, const uint256& txHash);
 
-/** (try to) add transaction to memory pool **/
+/** (try to) add transaction to memory pool; fScriptsChecked skips the script checks, for transactions
+ * that passed PreValidateTransaction() **/
 Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTransaction& tx,
-                                                   const ITxDB* txdbPtr = nullptr);
+                                                   const ITxDB* txdbPtr = nullptr,
+                                                   bool         fScriptsChecked = false);
+
+/** the checks of AcceptToMemoryPool() that don't need cs_main, the script checks included; meant to
+ * run against a read snapshot of the chain **/
+Result<void, TxValidationState> PreValidateTransaction(const CTransaction& tx, const ITxDB& txdb);
+
+/** adds a transaction that the peer relayed to the mempool, along with the orphans that depended on it,
+ * and reports a rejection to the peer; preValidationRes is what PreValidateTransaction() returned, if
+ * it ran. Requires cs_main **/
+void ProcessRelayedTransaction(CNode* pfrom, const CTransaction& tx,
+                               const boost::optional<Result<void, TxValidationState>>& preValidationRes);
 
 bool EnableEnforceUniqueTokenSymbols(const ITxDB& txdb);
 
@@ -5,9 +5,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "miner.h"
+#include "arith_uint256.h"
 #include "block.h"
 #include "kernel.h"
 #include "main.h"
+#include "runtimeconfig.h"
+#include "sha256.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "work.h"
@@ -41,20 +44,18 @@ static const unsigned int pSHA256InitState[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef
 
 void SHA256Transform(void* pstate, void* pinput, const void* pinit)
 {
-    SHA256_CTX    ctx;
+    uint32_t      state[8];
     unsigned char data[64];
 
-    SHA256_Init(&ctx);
-
     for (int i = 0; i < 16; i++)
         ((uint32_t*)data)[i] = ByteReverse(((uint32_t*)pinput)[i]);
 
     for (int i = 0; i < 8; i++)
-        ctx.h[i] = ((uint32_t*)pinit)[i];
+        state[i] = ((uint32_t*)pinit)[i];
 
-    SHA256_Update(&ctx, data, sizeof(data));
+    SHA256TransformBlocks(state, data, 1);
     for (int i = 0; i < 8; i++)
-        ((uint32_t*)pstate)[i] = ctx.h[i];
+        ((uint32_t*)pstate)[i] = state[i];
 }
 
 // Some explaining would be appreciated
@@ -116,7 +117,8 @@ std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int
     if (!pblock)
         return nullptr;
 
-    const CTxDB txdb;
+    const CTxDB           txdb;
+    const CRuntimeConfig& config = GetRuntimeConfig();
 
     boost::optional<CBlockIndex> pindexPrev = txdb.GetBestBlockIndex();
 
@@ -150,7 +152,7 @@ std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int
     // -regtest only: allow overriding block.nVersion with
     // -blockversion=N to test forking scenarios
     if (Params().MineBlocksOnDemand())
-        pblock->nVersion = GetArg("-blockversion", pblock->nVersion);
+        pblock->nVersion = config.nBlockVersion.value_or(pblock->nVersion);
 
     // Add our coinbase tx as first transaction
     pblock->vtx.push_back(coinbaseTx);
@@ -158,19 +160,19 @@ std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int
     unsigned int nSizeLimit = MaxBlockSize(txdb);
 
     // Largest block you're willing to create:
-    unsigned int nBlockMaxSize = GetArg("-blockmaxsize", nSizeLimit);
+    unsigned int nBlockMaxSize = config.nBlockMaxSize.value_or(nSizeLimit);
     // Limit to betweeen 1K and nSizeLimit-1K for sanity:
     nBlockMaxSize =
         std::max(1000u, std::min(static_cast<unsigned int>(nSizeLimit - 1000), nBlockMaxSize));
 
     // How much of the block should be dedicated to high-priority transactions,
     // included regardless of the fees they pay
-    unsigned int nBlockPrioritySize = GetArg("-blockprioritysize", 27000);
+    unsigned int nBlockPrioritySize = config.nBlockPrioritySize;
     nBlockPrioritySize              = std::min(nBlockMaxSize, nBlockPrioritySize);
 
     // Minimum block size you want to create; block will be filled with free transactions
     // until there are no more or the block reaches this size:
-    unsigned int nBlockMinSize = GetArg("-blockminsize", 0);
+    unsigned int nBlockMinSize = config.nBlockMinSize;
     nBlockMinSize              = std::min(nBlockMaxSize, nBlockMinSize);
 
     // Fee-per-kilobyte amount considered the same as "free"
@@ -513,7 +515,7 @@ void FormatHashBuffers(CBlock* pblock, char* pmidstate, char* pdata, char* phash
 bool CheckWork(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
 {
     uint256 hashBlock  = pblock->GetHash();
-    uint256 hashTarget = CBigNum().SetCompact(pblock->nBits).getuint256();
+    uint256 hashTarget = ArithToUint256(arith_uint256().SetCompact(pblock->nBits));
 
     if (!pblock->IsProofOfWork())
         return NLog.error("CheckWork() : {} is not a proof-of-work block", hashBlock.GetHex());
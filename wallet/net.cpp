@@ -7,8 +7,11 @@
 #include "addrman.h"
 #include "db.h"
 #include "globals.h"
+#include "headerssync.h"
 #include "init.h"
 #include "main.h"
+#include "runtimeconfig.h"
+#include "txprevalidator.h"
 #include "ui_interface.h"
 
 #include <chrono>
@@ -18,6 +21,11 @@
 #include <string.h>
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -30,7 +38,14 @@ using namespace boost;
 
 static const int MAX_OUTBOUND_CONNECTIONS = 16;
 
+// the number of worker threads that process peer messages
+static const int DEFAULT_MSGHANDLER_THREADS = 4;
+static const int MAX_MSGHANDLER_THREADS     = 16;
+// how many messages a worker processes from one peer before giving other peers a turn
+static const unsigned int MSGHANDLER_MESSAGES_PER_TURN = 16;
+
 void ThreadMessageHandler2();
+void ThreadMessageHandlerWorker(int workerIndex);
 void ThreadSocketHandler2();
 void ThreadOpenConnections2();
 void ThreadOpenAddedConnections2();
@@ -69,6 +84,8 @@ map<CInv, CDataStream>              mapRelay;
 deque<pair<int64_t, CInv>>          vRelayExpiration;
 CCriticalSection                    cs_mapRelay;
 ThreadSafeHashMap<CInv, int64_t>    mapAlreadyAskedFor;
+CEventNotifier                      msgHandlerNotifier;
+CEventNotifier                      socketHandlerNotifier;
 
 static deque<string> vOneShots;
 CCriticalSection     cs_vOneShots;
@@ -550,8 +567,9 @@ bool CNode::Misbehaving(int howmuch)
     }
 
     nMisbehavior += howmuch;
-    if (nMisbehavior >= GetArg("-banscore", 100)) {
-        int64_t banTime = GetTime() + GetArg("-bantime", 60 * 60 * 24); // Default 24-hour ban
+    const CRuntimeConfig& config = GetRuntimeConfig();
+    if (nMisbehavior >= config.nBanScore) {
+        int64_t banTime = GetTime() + config.nBanTime; // Default 24-hour ban
         NLog.write(b_sev::warn, "Misbehaving: {} ({} -> {}) DISCONNECTING", addr.ToString(),
                    nMisbehavior - howmuch, nMisbehavior);
         {
@@ -721,68 +739,219 @@ void ThreadSocketHandler()
     NLog.write(b_sev::info, "ThreadSocketHandler exited");
 }
 
-void ThreadSocketHandler2()
+// hold unused nodes in vNodesDisconnected until all references to them are released, then delete them
+static void DisconnectUnusedNodes(list<CNode*>& vNodesDisconnected)
 {
-    NLog.write(b_sev::info, "ThreadSocketHandler started");
-    list<CNode*> vNodesDisconnected;
-    unsigned int nPrevNodeCount = 0;
+    LOCK(cs_vNodes);
+    // Disconnect unused nodes
+    vector<CNode*> vNodesCopy = vNodes;
+    BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+        if (pnode->fDisconnect || (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() &&
+                                   pnode->nSendSize == 0 && pnode->ssSend.empty())) {
+            // remove from vNodes
+            vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
 
-    while (true) {
-        //
-        // Disconnect nodes
-        //
-        {
-            LOCK(cs_vNodes);
-            // Disconnect unused nodes
-            vector<CNode*> vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy) {
-                if (pnode->fDisconnect || (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() &&
-                                           pnode->nSendSize == 0 && pnode->ssSend.empty())) {
-                    // remove from vNodes
-                    vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
-
-                    // release outbound grant (if any)
-                    pnode->grantOutbound.Release();
-
-                    // close socket and cleanup
-                    pnode->CloseSocketDisconnect();
+            // release outbound grant (if any)
+            pnode->grantOutbound.Release();
 
-                    // hold in disconnected pool until all refs are released
-                    if (pnode->fNetworkNode || pnode->fInbound)
-                        pnode->Release();
-                    vNodesDisconnected.push_back(pnode);
-                }
-            }
+            // close socket and cleanup
+            pnode->CloseSocketDisconnect();
 
-            // Delete disconnected nodes
-            list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
-            BOOST_FOREACH (CNode* pnode, vNodesDisconnectedCopy) {
-                // wait until threads are done using it
-                if (pnode->GetRefCount() <= 0) {
-                    bool fDelete = false;
-                    {
-                        TRY_LOCK4(pnode->cs_vSend, pnode->cs_vRecvMsg, pnode->cs_mapRequests,
-                                  pnode->cs_inventory, lock);
-                        if (lock) {
-                            fDelete = true;
-                        }
-                    }
-                    if (fDelete) {
-                        vNodesDisconnected.remove(pnode);
-                        delete pnode;
-                    }
+            // let other peers download the blocks this one was asked for
+            headersSync.PeerDisconnected(pnode->nodeid);
+
+            // hold in disconnected pool until all refs are released
+            if (pnode->fNetworkNode || pnode->fInbound)
+                pnode->Release();
+            vNodesDisconnected.push_back(pnode);
+        }
+    }
+
+    // Delete disconnected nodes
+    list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
+    BOOST_FOREACH (CNode* pnode, vNodesDisconnectedCopy) {
+        // wait until threads are done using it
+        if (pnode->GetRefCount() <= 0) {
+            bool fDelete = false;
+            {
+                TRY_LOCK4(pnode->cs_vSend, pnode->cs_vRecvMsg, pnode->cs_mapRequests,
+                          pnode->cs_inventory, lock);
+                if (lock) {
+                    fDelete = true;
                 }
             }
+            if (fDelete) {
+                vNodesDisconnected.remove(pnode);
+                delete pnode;
+            }
         }
-        std::size_t vNodesSize = 0;
+    }
+}
+
+static void NotifyNumConnectionsIfChanged(unsigned int& nPrevNodeCount)
+{
+    std::size_t vNodesSize = 0;
+    {
+        LOCK(cs_vNodes);
+        vNodesSize = vNodes.size();
+    }
+    if (vNodesSize != nPrevNodeCount) {
+        nPrevNodeCount = vNodesSize;
+        uiInterface.NotifyNumConnectionsChanged(vNodesSize);
+    }
+}
+
+// returns false if there was no connection to accept
+static bool AcceptConnection(SOCKET hListenSocket)
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t               len      = sizeof(sockaddr);
+    SOCKET                  hSocket  = accept(hListenSocket, (struct sockaddr*)&sockaddr, &len);
+    CAddress                addr;
+    int                     nInbound = 0;
+
+    if (hSocket != INVALID_SOCKET)
+        if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
+            NLog.write(b_sev::warn, "Warning: Unknown socket family");
+
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes)
+            if (pnode->fInbound)
+                nInbound++;
+    }
+
+    if (hSocket == INVALID_SOCKET) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK)
+            NLog.write(b_sev::err, "socket error accept failed: {}", nErr);
+        return false;
+    } else if (nInbound >= GetRuntimeConfig().nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
+        closesocket(hSocket);
+    } else if (CNode::IsBanned(addr)) {
+        NLog.write(b_sev::warn, "connection from {} dropped (banned)", addr.ToString());
+        closesocket(hSocket);
+    } else {
+        NLog.write(b_sev::info, "accepted connection {}", addr.ToString());
+        CNode* pnode = new CNode(NodeIDCounter++, hSocket, addr, "", true);
+        pnode->AddRef();
         {
             LOCK(cs_vNodes);
-            vNodesSize = vNodes.size();
+            vNodes.push_back(pnode);
         }
-        if (vNodesSize != nPrevNodeCount) {
-            nPrevNodeCount = vNodesSize;
-            uiInterface.NotifyNumConnectionsChanged(vNodesSize);
+    }
+    return true;
+}
+
+enum class SocketRecvResult
+{
+    Received,
+    WouldBlock,
+    Busy, // the receive buffer is locked by another thread
+    Disconnected,
+};
+
+// does a single recv() on the socket of the node
+static SocketRecvResult ReceiveFromNode(CNode* pnode)
+{
+    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+    if (!lockRecv) {
+        return SocketRecvResult::Busy;
+    }
+    if (pnode->GetTotalRecvSize() > ReceiveFloodSize()) {
+        if (!pnode->fDisconnect)
+            NLog.write(b_sev::warn, "socket recv flood control disconnect ({} bytes)",
+                       pnode->GetTotalRecvSize());
+        pnode->CloseSocketDisconnect();
+        return SocketRecvResult::Disconnected;
+    }
+
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    int  nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    if (nBytes > 0) {
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes)) {
+            pnode->CloseSocketDisconnect();
+            return SocketRecvResult::Disconnected;
+        }
+        pnode->nLastRecv = GetTime();
+        if (!pnode->vRecvMsg.empty() && pnode->vRecvMsg.front().complete())
+            msgHandlerNotifier.notify();
+        return SocketRecvResult::Received;
+    } else if (nBytes == 0) {
+        // socket closed gracefully
+        if (!pnode->fDisconnect)
+            NLog.write(b_sev::info, "socket closed");
+        pnode->CloseSocketDisconnect();
+        return SocketRecvResult::Disconnected;
+    } else {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR &&
+            nErr != WSAEINPROGRESS) {
+            if (!pnode->fDisconnect)
+                NLog.write(b_sev::err, "socket recv error {}", nErr);
+            pnode->CloseSocketDisconnect();
+            return SocketRecvResult::Disconnected;
         }
+        return SocketRecvResult::WouldBlock;
+    }
+}
+
+static void CheckNodeInactivity(CNode* pnode)
+{
+    {
+        LOCK(pnode->cs_vSend);
+        if (pnode->vSendMsg.empty())
+            pnode->nLastSendEmpty = GetTime();
+    }
+    if (GetTime() - pnode->nTimeConnected > 60) {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
+            NLog.write(b_sev::warn, "socket no message in first 60 seconds, {} {}",
+                       pnode->nLastRecv != 0, pnode->nLastSend != 0);
+            pnode->fDisconnect = true;
+        } else if (GetTime() - pnode->nLastSend > 90 * 60 &&
+                   GetTime() - pnode->nLastSendEmpty > 90 * 60) {
+            NLog.write(b_sev::warn, "socket not sending");
+            pnode->fDisconnect = true;
+        } else if (GetTime() - pnode->nLastRecv > 90 * 60) {
+            NLog.write(b_sev::err, "socket inactivity timeout");
+            pnode->fDisconnect = true;
+        }
+    }
+}
+
+static vector<CNode*> CopyAndRefNodes()
+{
+    vector<CNode*> vNodesCopy;
+    {
+        LOCK(cs_vNodes);
+        vNodesCopy = vNodes;
+        BOOST_FOREACH (CNode* pnode, vNodesCopy)
+            pnode->AddRef();
+    }
+    return vNodesCopy;
+}
+
+static void ReleaseNodes(const vector<CNode*>& vNodesCopy)
+{
+    LOCK(cs_vNodes);
+    for (CNode* pnode : vNodesCopy)
+        pnode->Release();
+}
+
+static void ThreadSocketHandlerSelect()
+{
+    NLog.write(b_sev::info, "ThreadSocketHandler started (select)");
+    list<CNode*> vNodesDisconnected;
+    unsigned int nPrevNodeCount = 0;
+
+    while (true) {
+        //
+        // Disconnect nodes
+        //
+        DisconnectUnusedNodes(vNodesDisconnected);
+        NotifyNumConnectionsIfChanged(nPrevNodeCount);
 
         //
         // Find which sockets have data to receive
@@ -848,54 +1017,13 @@ void ThreadSocketHandler2()
         // Accept new connections
         //
         for (SOCKET hListenSocket : vhListenSocket)
-            if (hListenSocket != INVALID_SOCKET && FD_ISSET(hListenSocket, &fdsetRecv)) {
-                struct sockaddr_storage sockaddr;
-                socklen_t               len = sizeof(sockaddr);
-                SOCKET   hSocket            = accept(hListenSocket, (struct sockaddr*)&sockaddr, &len);
-                CAddress addr;
-                int      nInbound = 0;
-
-                if (hSocket != INVALID_SOCKET)
-                    if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
-                        NLog.write(b_sev::warn, "Warning: Unknown socket family");
-
-                {
-                    LOCK(cs_vNodes);
-                    BOOST_FOREACH (CNode* pnode, vNodes)
-                        if (pnode->fInbound)
-                            nInbound++;
-                }
-
-                if (hSocket == INVALID_SOCKET) {
-                    int nErr = WSAGetLastError();
-                    if (nErr != WSAEWOULDBLOCK)
-                        NLog.write(b_sev::err, "socket error accept failed: {}", nErr);
-                } else if (nInbound >= GetArg("-maxconnections", 125) - MAX_OUTBOUND_CONNECTIONS) {
-                    closesocket(hSocket);
-                } else if (CNode::IsBanned(addr)) {
-                    NLog.write(b_sev::warn, "connection from {} dropped (banned)", addr.ToString());
-                    closesocket(hSocket);
-                } else {
-                    NLog.write(b_sev::info, "accepted connection {}", addr.ToString());
-                    CNode* pnode = new CNode(NodeIDCounter++, hSocket, addr, "", true);
-                    pnode->AddRef();
-                    {
-                        LOCK(cs_vNodes);
-                        vNodes.push_back(pnode);
-                    }
-                }
-            }
+            if (hListenSocket != INVALID_SOCKET && FD_ISSET(hListenSocket, &fdsetRecv))
+                AcceptConnection(hListenSocket);
 
         //
         // Service each socket
         //
-        vector<CNode*> vNodesCopy;
-        {
-            LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy)
-                pnode->AddRef();
-        }
+        vector<CNode*> vNodesCopy = CopyAndRefNodes();
         BOOST_FOREACH (CNode* pnode, vNodesCopy) {
             if (fShutdown)
                 return;
@@ -905,40 +1033,8 @@ void ThreadSocketHandler2()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
-                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv) {
-                    if (pnode->GetTotalRecvSize() > ReceiveFloodSize()) {
-                        if (!pnode->fDisconnect)
-                            NLog.write(b_sev::warn, "socket recv flood control disconnect ({} bytes)",
-                                       pnode->GetTotalRecvSize());
-                        pnode->CloseSocketDisconnect();
-                    } else {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int  nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0) {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pnode->CloseSocketDisconnect();
-                            pnode->nLastRecv = GetTime();
-                        } else if (nBytes == 0) {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                NLog.write(b_sev::info, "socket closed");
-                            pnode->CloseSocketDisconnect();
-                        } else if (nBytes < 0) {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR &&
-                                nErr != WSAEINPROGRESS) {
-                                if (!pnode->fDisconnect)
-                                    NLog.write(b_sev::err, "socket recv error {}", nErr);
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
-            }
+            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError))
+                ReceiveFromNode(pnode);
 
             //
             // Send
@@ -954,34 +1050,208 @@ void ThreadSocketHandler2()
             //
             // Inactivity checking
             //
+            CheckNodeInactivity(pnode);
+        }
+        ReleaseNodes(vNodesCopy);
+
+        MilliSleep(10);
+    }
+}
+
+#ifdef __linux__
+// Edge-triggered epoll event loop. Sockets are registered once and only the sockets that reported
+// readiness are serviced, so the cost of a wake-up doesn't grow with the number of peers and there's
+// no FD_SETSIZE limit. Since readiness is only reported on edges, every node remembers the readiness
+// it was given until it's been acted upon (fSocketRecvReady/fSocketSendReady).
+static void ThreadSocketHandlerEpoll(int epollFD)
+{
+    NLog.write(b_sev::info, "ThreadSocketHandler started (epoll)");
+    list<CNode*> vNodesDisconnected;
+    unsigned int nPrevNodeCount = 0;
+
+    // maximum number of recv() calls on a single socket per loop iteration, for fairness
+    static const int MAX_RECV_PER_ITERATION = 8;
+    // how often we wake up, even with no events, to disconnect and check inactivity of nodes
+    static const int HOUSEKEEPING_INTERVAL_MS = 100;
+    // when a socket couldn't be serviced due to lock contention, retry it after this
+    static const int RETRY_INTERVAL_MS = 10;
+
+    // listening sockets are registered with a null pointer as data; nodes with their CNode pointer,
+    // which is safe because nodes are only deleted by this thread, after their sockets are closed
+    // (which removes them from the epoll set)
+    for (SOCKET hListenSocket : vhListenSocket) {
+        struct epoll_event ev;
+        ev.events   = EPOLLIN | EPOLLET;
+        ev.data.ptr = nullptr;
+        if (epoll_ctl(epollFD, EPOLL_CTL_ADD, hListenSocket, &ev) != 0)
+            NLog.write(b_sev::err, "epoll_ctl failed to register listening socket, error {}", errno);
+    }
+    if (socketHandlerNotifier.GetPollableFD() >= 0) {
+        struct epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.ptr = &socketHandlerNotifier;
+        if (epoll_ctl(epollFD, EPOLL_CTL_ADD, socketHandlerNotifier.GetPollableFD(), &ev) != 0)
+            NLog.write(b_sev::err, "epoll_ctl failed to register wake-up event, error {}", errno);
+    }
+
+    std::vector<struct epoll_event> events(256);
+    bool                            fRetryPending          = false;
+    int64_t                         nLastInactivityCheckMs = 0;
+
+    while (true) {
+        //
+        // Disconnect nodes
+        //
+        DisconnectUnusedNodes(vNodesDisconnected);
+        NotifyNumConnectionsIfChanged(nPrevNodeCount);
+
+        //
+        // Register new sockets
+        //
+        vector<CNode*> vNodesCopy = CopyAndRefNodes();
+        for (CNode* pnode : vNodesCopy) {
+            if (pnode->fSocketRegistered || pnode->hSocket == INVALID_SOCKET)
+                continue;
+            struct epoll_event ev;
+            ev.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.ptr = pnode;
+            if (epoll_ctl(epollFD, EPOLL_CTL_ADD, pnode->hSocket, &ev) != 0 && errno != EEXIST) {
+                NLog.write(b_sev::err, "epoll_ctl failed to register socket of peer {}, error {}",
+                           pnode->addr.ToString(), errno);
+                pnode->CloseSocketDisconnect();
+                continue;
+            }
+            pnode->fSocketRegistered = true;
+        }
+
+        //
+        // Wait for events
+        //
+        vnThreadsRunning[THREAD_SOCKETHANDLER]--;
+        int nEvents = epoll_wait(epollFD, events.data(), static_cast<int>(events.size()),
+                                 fRetryPending ? RETRY_INTERVAL_MS : HOUSEKEEPING_INTERVAL_MS);
+        vnThreadsRunning[THREAD_SOCKETHANDLER]++;
+        if (fShutdown) {
+            ReleaseNodes(vNodesCopy);
+            return;
+        }
+        if (nEvents < 0) {
+            if (errno != EINTR) {
+                NLog.write(b_sev::err, "socket epoll_wait error {}", errno);
+                MilliSleep(RETRY_INTERVAL_MS);
+            }
+            nEvents = 0;
+        }
+
+        bool fAcceptPending = false;
+        for (int i = 0; i < nEvents; i++) {
+            const struct epoll_event& ev = events[i];
+            if (ev.data.ptr == nullptr) {
+                fAcceptPending = true;
+            } else if (ev.data.ptr == &socketHandlerNotifier) {
+                socketHandlerNotifier.reset();
+            } else {
+                CNode* pnode = static_cast<CNode*>(ev.data.ptr);
+                if (ev.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                    pnode->fSocketRecvReady = true;
+                if (ev.events & EPOLLOUT)
+                    pnode->fSocketSendReady = true;
+            }
+        }
+
+        //
+        // Accept new connections; with edge-triggering, we have to accept until there's nothing left
+        //
+        if (fAcceptPending)
+            for (SOCKET hListenSocket : vhListenSocket)
+                if (hListenSocket != INVALID_SOCKET)
+                    while (AcceptConnection(hListenSocket)) {
+                    }
+
+        //
+        // Service sockets that reported readiness
+        //
+        fRetryPending = false;
+        for (CNode* pnode : vNodesCopy) {
+            if (fShutdown) {
+                ReleaseNodes(vNodesCopy);
+                return;
+            }
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            //
+            // Send
+            //
+            bool fSendQueueEmpty = false;
             {
-                LOCK(pnode->cs_vSend);
-                if (pnode->vSendMsg.empty())
-                    pnode->nLastSendEmpty = GetTime();
+                TRY_LOCK(pnode->cs_vSend, lockSend);
+                if (lockSend) {
+                    if (pnode->fSocketSendReady) {
+                        pnode->fSocketSendReady = false;
+                        if (!pnode->vSendMsg.empty())
+                            SocketSendData(pnode);
+                    }
+                    fSendQueueEmpty = pnode->vSendMsg.empty();
+                } else if (pnode->fSocketSendReady) {
+                    fRetryPending = true;
+                }
             }
-            if (GetTime() - pnode->nTimeConnected > 60) {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
-                    NLog.write(b_sev::warn, "socket no message in first 60 seconds, {} {}",
-                               pnode->nLastRecv != 0, pnode->nLastSend != 0);
-                    pnode->fDisconnect = true;
-                } else if (GetTime() - pnode->nLastSend > 90 * 60 &&
-                           GetTime() - pnode->nLastSendEmpty > 90 * 60) {
-                    NLog.write(b_sev::warn, "socket not sending");
-                    pnode->fDisconnect = true;
-                } else if (GetTime() - pnode->nLastRecv > 90 * 60) {
-                    NLog.write(b_sev::err, "socket inactivity timeout");
-                    pnode->fDisconnect = true;
+
+            //
+            // Receive
+            //
+            // do not read, if draining write queue; an EPOLLOUT edge will wake us when it's possible
+            // to send again
+            if (!pnode->fSocketRecvReady || !fSendQueueEmpty)
+                continue;
+            for (int n = 0; n < MAX_RECV_PER_ITERATION && pnode->fSocketRecvReady; n++) {
+                SocketRecvResult res = ReceiveFromNode(pnode);
+                if (res == SocketRecvResult::WouldBlock || res == SocketRecvResult::Disconnected) {
+                    pnode->fSocketRecvReady = false;
+                } else if (res == SocketRecvResult::Busy) {
+                    break;
                 }
             }
+            if (pnode->fSocketRecvReady)
+                fRetryPending = true;
         }
-        {
-            LOCK(cs_vNodes);
+
+        //
+        // Inactivity checking
+        //
+        if (GetTimeMillis() - nLastInactivityCheckMs >= 1000) {
+            nLastInactivityCheckMs = GetTimeMillis();
             for (CNode* pnode : vNodesCopy)
-                pnode->Release();
+                if (pnode->hSocket != INVALID_SOCKET)
+                    CheckNodeInactivity(pnode);
         }
 
-        MilliSleep(10);
+        ReleaseNodes(vNodesCopy);
+    }
+}
+#endif
+
+void ThreadSocketHandler2()
+{
+#ifdef __linux__
+    if (GetArg("-socketevents", "epoll") == "epoll") {
+        const int epollFD = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFD >= 0) {
+            try {
+                ThreadSocketHandlerEpoll(epollFD);
+            } catch (...) {
+                close(epollFD);
+                throw;
+            }
+            close(epollFD);
+            return;
+        }
+        NLog.write(b_sev::err, "Failed to create epoll instance (error {}); falling back to select()",
+                   errno);
     }
+#endif
+    ThreadSocketHandlerSelect();
 }
 
 #ifdef USE_UPNP
@@ -1588,64 +1858,188 @@ void ThreadMessageHandler()
     NLog.write(b_sev::info, "ThreadMessageHandler exited");
 }
 
+bool CMessageHandlerQueue::push(CNode* pnode)
+{
+    if (pnode->fMsgHandlerQueued.exchange(true))
+        return false;
+    {
+        LOCK(cs_vNodes);
+        pnode->AddRef();
+    }
+    {
+        boost::lock_guard<boost::mutex> lg(mtx);
+        queue.push_back(pnode);
+    }
+    cond.notify_one();
+    return true;
+}
+
+CNode* CMessageHandlerQueue::pop(int64_t timeoutMillis)
+{
+    boost::unique_lock<boost::mutex> lock(mtx);
+    if (queue.empty() && !fShutdown)
+        cond.timed_wait(lock, boost::posix_time::milliseconds(timeoutMillis));
+    if (queue.empty() || fShutdown)
+        return nullptr;
+    CNode* pnode = queue.front();
+    queue.pop_front();
+    return pnode;
+}
+
+void CMessageHandlerQueue::clear()
+{
+    std::deque<CNode*> queueCopy;
+    {
+        boost::lock_guard<boost::mutex> lg(mtx);
+        queueCopy.swap(queue);
+    }
+    cond.notify_all();
+    LOCK(cs_vNodes);
+    for (CNode* pnode : queueCopy) {
+        pnode->fMsgHandlerQueued = false;
+        pnode->Release();
+    }
+}
+
+std::size_t CMessageHandlerQueue::size()
+{
+    boost::lock_guard<boost::mutex> lg(mtx);
+    return queue.size();
+}
+
+static CMessageHandlerQueue msgHandlerQueue;
+
+static bool HasCompleteMessage(CNode* pnode)
+{
+    // requires LOCK(cs_vRecvMsg)
+    return !pnode->vRecvMsg.empty() && pnode->vRecvMsg.front().complete();
+}
+
+/** processes the messages of one node, then sends what it has for the peer */
+static void HandleNodeMessages(CNode* pnode)
+{
+    bool fMoreWork = false;
+    if (!pnode->fDisconnect) {
+        // Receive messages
+        {
+            LOCK(pnode->cs_vRecvMsg);
+            if (!ProcessMessages(pnode, MSGHANDLER_MESSAGES_PER_TURN))
+                pnode->CloseSocketDisconnect();
+            // if the send buffer is full, the next round of the dispatcher will come back to it
+            fMoreWork = !pnode->fDisconnect && HasCompleteMessage(pnode) &&
+                        pnode->nSendSize < SendBufferSize();
+        }
+
+        // Send messages; cs_vSend isn't held around it, since SendMessages() waits for cs_main,
+        // which is always taken before cs_vSend
+        if (!fShutdown) {
+            const bool fTrickle = pnode->fMsgHandlerTrickle.exchange(false);
+            // if nothing could be sent, the trickle is left for the next round
+            if (!SendMessages(pnode, fTrickle) && fTrickle)
+                pnode->fMsgHandlerTrickle = true;
+        }
+    }
+
+    pnode->fMsgHandlerQueued = false;
+    // put the node at the back of the queue, so that other peers get their turn first
+    if (fMoreWork && !fShutdown)
+        msgHandlerQueue.push(pnode);
+
+    LOCK(cs_vNodes);
+    pnode->Release();
+}
+
+void ThreadMessageHandlerWorker(int workerIndex)
+{
+    RenameThread(("neblio-msgwork" + std::to_string(workerIndex)).c_str());
+
+    vnThreadsRunning[THREAD_MESSAGEHANDLER]++;
+    try {
+        SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
+        while (!fShutdown) {
+            // Reduce vnThreadsRunning so StopNode has permission to exit while
+            // we're waiting, but we must always check fShutdown after doing this.
+            vnThreadsRunning[THREAD_MESSAGEHANDLER]--;
+            CNode* pnode = msgHandlerQueue.pop(100);
+            vnThreadsRunning[THREAD_MESSAGEHANDLER]++;
+            if (pnode == nullptr)
+                continue;
+            if (fShutdown) {
+                pnode->fMsgHandlerQueued = false;
+                LOCK(cs_vNodes);
+                pnode->Release();
+                break;
+            }
+            HandleNodeMessages(pnode);
+        }
+    } catch (std::exception& e) {
+        PrintException(&e, "ThreadMessageHandlerWorker()");
+    } catch (...) {
+        PrintException(nullptr, "ThreadMessageHandlerWorker()");
+    }
+    vnThreadsRunning[THREAD_MESSAGEHANDLER]--;
+}
+
 void ThreadMessageHandler2()
 {
     NLog.write(b_sev::info, "ThreadMessageHandler started");
     SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
+
+    const int nWorkers = static_cast<int>(std::max<int64_t>(
+        1, std::min<int64_t>(GetArg("-msghandlerthreads", DEFAULT_MSGHANDLER_THREADS),
+                             MAX_MSGHANDLER_THREADS)));
+    for (int i = 0; i < nWorkers; i++) {
+        if (!NewThread(ThreadMessageHandlerWorker, i))
+            NLog.write(b_sev::err, "Error: NewThread(ThreadMessageHandlerWorker) failed");
+    }
+    NLog.write(b_sev::info, "Processing peer messages with {} worker threads", nWorkers);
+
+    txPreValidationQueue.start(
+        static_cast<int>(GetArg("-txvalidationthreads", DEFAULT_TXVALIDATION_THREADS)));
+
+    // The dispatcher queues nodes with complete messages as soon as the socket handler notifies us.
+    // Every 100 ms all nodes are queued, so that SendMessages() runs for them.
+    int64_t nLastSendRound = 0;
     while (!fShutdown) {
-        vector<CNode*> vNodesCopy;
-        {
-            LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            for (CNode* pnode : vNodesCopy)
-                pnode->AddRef();
-        }
+        const bool fSendRound = GetTimeMillis() - nLastSendRound >= 100;
+        if (fSendRound)
+            nLastSendRound = GetTimeMillis();
+
+        vector<CNode*> vNodesCopy = CopyAndRefNodes();
+
+        if (fSendRound && !vNodesCopy.empty())
+            vNodesCopy[GetRand(vNodesCopy.size())]->fMsgHandlerTrickle = true;
 
-        // Poll the connected nodes for messages
-        CNode* pnodeTrickle = nullptr;
-        if (!vNodesCopy.empty())
-            pnodeTrickle = vNodesCopy[GetRand(vNodesCopy.size())];
         for (CNode* pnode : vNodesCopy) {
             if (pnode->fDisconnect)
                 continue;
 
-            // Receive messages
+            bool fHasMessages = false;
             {
+                // if the lock is taken, a worker is on it already or the socket handler will
+                // notify us when it's done receiving
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv)
-                    if (!ProcessMessages(pnode))
-                        pnode->CloseSocketDisconnect();
+                    fHasMessages = HasCompleteMessage(pnode);
             }
-            if (fShutdown)
-                return;
-
-            // Send messages
-            {
-                TRY_LOCK(pnode->cs_vSend, lockSend);
-                if (lockSend)
-                    SendMessages(pnode, pnode == pnodeTrickle);
-            }
-            if (fShutdown)
-                return;
+            if (fSendRound || fHasMessages)
+                msgHandlerQueue.push(pnode);
         }
 
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodesCopy)
-                pnode->Release();
-        }
+        ReleaseNodes(vNodesCopy);
 
         // Wait and allow messages to bunch up.
         // Reduce vnThreadsRunning so StopNode has permission to exit while
         // we're sleeping, but we must always check fShutdown after doing this.
         vnThreadsRunning[THREAD_MESSAGEHANDLER]--;
-        MilliSleep(100);
+        const int64_t nUntilSendRound = nLastSendRound + 100 - GetTimeMillis();
+        msgHandlerNotifier.wait(std::max<int64_t>(1, nUntilSendRound));
         if (fRequestShutdown)
             StartShutdown();
         vnThreadsRunning[THREAD_MESSAGEHANDLER]++;
-        if (fShutdown)
-            return;
     }
+
+    msgHandlerQueue.clear();
 }
 
 bool BindListenPort(const CService& addrBind, string& strError)
@@ -1870,6 +2264,9 @@ bool StopNode()
     NLog.write(b_sev::debug, "StopNode()");
     fShutdown = true;
     nTransactionsUpdated++;
+    msgHandlerNotifier.notify();
+    socketHandlerNotifier.notify();
+    txPreValidationQueue.clear();
     int64_t nStart = GetTime();
     if (semOutbound)
         for (int i = 0; i < MAX_OUTBOUND_CONNECTIONS; i++)
@@ -1906,6 +2303,8 @@ bool StopNode()
         NLog.write(b_sev::warn, "ThreadDumpAddresses still running");
     if (vnThreadsRunning[THREAD_STAKE_MINER] > 0)
         NLog.write(b_sev::warn, "ThreadStakeMiner still running");
+    if (vnThreadsRunning[THREAD_TXPREVALIDATION] > 0)
+        NLog.write(b_sev::warn, "ThreadTxPreValidation still running");
     while (vnThreadsRunning[THREAD_MESSAGEHANDLER] > 0 || vnThreadsRunning[THREAD_RPCHANDLER] > 0)
         MilliSleep(20);
 
@@ -8,8 +8,11 @@
 #include <boost/array.hpp>
 #include <boost/atomic.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <chainparams.h>
 #include <deque>
+#include <memory>
 #include <openssl/rand.h>
 
 #ifndef WIN32
@@ -19,20 +22,23 @@
 #include "ThreadSafeHashMap.h"
 #include "addrman.h"
 #include "bloom.h"
+#include "eventnotifier.h"
 #include "hash.h"
 #include "mruset.h"
 #include "netbase.h"
 #include "protocol.h"
+#include "runtimeconfig.h"
 
 class CRequestTracker;
 class CNode;
 class CBlockIndex;
+class PartiallyDownloadedBlock;
 
 /** The maximum number of entries in a locator */
 static const unsigned int MAX_LOCATOR_SZ = 101;
 
-inline unsigned int ReceiveFloodSize() { return 1000 * GetArg("-maxreceivebuffer", 5 * 1000); }
-inline unsigned int SendBufferSize() { return 1000 * GetArg("-maxsendbuffer", 1 * 1000); }
+inline unsigned int ReceiveFloodSize() { return 1000 * GetRuntimeConfig().nMaxReceiveBuffer; }
+inline unsigned int SendBufferSize() { return 1000 * GetRuntimeConfig().nMaxSendBuffer; }
 
 void           AddOneShot(std::string strDest);
 bool           RecvLine(SOCKET hSocket, std::string& strLine);
@@ -117,6 +123,7 @@ enum threadId
     THREAD_RPCHANDLER,
     THREAD_STAKE_MINER,
     THREAD_IMPORT,
+    THREAD_TXPREVALIDATION,
 
     THREAD_MAX
 };
@@ -136,6 +143,10 @@ extern std::map<CInv, CDataStream>          mapRelay;
 extern std::deque<std::pair<int64_t, CInv>> vRelayExpiration;
 extern CCriticalSection                     cs_mapRelay;
 extern ThreadSafeHashMap<CInv, int64_t>     mapAlreadyAskedFor;
+// wakes up the message handler when complete messages are received
+extern CEventNotifier msgHandlerNotifier;
+// wakes up the socket handler when it's waiting for socket events
+extern CEventNotifier socketHandlerNotifier;
 
 class CNodeStats
 {
@@ -209,6 +220,27 @@ public:
     CCriticalSection        cs_vRecvMsg;
     int                     nRecvVersion;
 
+    // readiness state of the epoll socket handler; only accessed by the socket handler thread
+    bool fSocketRegistered;
+    bool fSocketRecvReady;
+    bool fSocketSendReady;
+
+    // set while the node waits in, or is being served from, the message handler work queue; this
+    // guarantees that only one worker at a time processes this node's messages
+    boost::atomic<bool> fMsgHandlerQueued;
+    // whether the next SendMessages() call for this node should trickle
+    boost::atomic<bool> fMsgHandlerTrickle;
+
+    // when we last asked this peer for headers in a headers-first sync; guarded by headersSync
+    int64_t nLastHeadersRequest;
+
+    // the peer sent us "sendcmpct", so it understands compact blocks, and whether it wants new blocks
+    // announced with "cmpctblock" right away instead of "inv"
+    boost::atomic<bool> fSupportsCompactBlocks;
+    boost::atomic<bool> fAnnounceCompactBlocks;
+    // the compact block from this peer that waits for its missing transactions; guarded by cs_main
+    std::shared_ptr<PartiallyDownloadedBlock> pPartialBlock;
+
     boost::atomic<int64_t> nLastSend;
     boost::atomic<int64_t> nLastRecv;
     boost::atomic<int64_t> nLastSendEmpty;
@@ -269,6 +301,14 @@ public:
         nServices                = 0;
         hSocket                  = hSocketIn;
         nRecvVersion             = INIT_PROTO_VERSION;
+        fSocketRegistered        = false;
+        fSocketRecvReady         = false;
+        fSocketSendReady         = false;
+        fMsgHandlerQueued        = false;
+        fMsgHandlerTrickle       = false;
+        nLastHeadersRequest      = 0;
+        fSupportsCompactBlocks   = false;
+        fAnnounceCompactBlocks   = false;
         nLastSend                = 0;
         nLastRecv                = 0;
         nLastSendEmpty           = GetTime();
@@ -391,12 +431,14 @@ public:
             NLog.write(b_sev::debug, "askfor {}   {} ({})", inv.ToString(), nRequestTime,
                        DateTimeStrFormat("%H:%M:%S", nRequestTime / 1000000));
 
-        // Make sure not to reuse time indexes to keep things in the same order
-        int64_t        nNow = (GetTime() - 1) * 1000000;
-        static int64_t nLastTime;
-        ++nLastTime;
-        nNow      = std::max(nNow, nLastTime);
-        nLastTime = nNow;
+        // Make sure not to reuse time indexes to keep things in the same order; the inv of several
+        // peers is processed at once with cs_main shared
+        static boost::atomic<int64_t> nLastTime(0);
+        int64_t                       nLast = nLastTime.load();
+        int64_t                       nNow;
+        do {
+            nNow = std::max((GetTime() - 1) * 1000000, nLast + 1);
+        } while (!nLastTime.compare_exchange_weak(nLast, nNow));
 
         // Each retry is 2 minutes after the last
         nRequestTime = std::max(nRequestTime + 2 * 60 * 1000000, nNow);
@@ -680,6 +722,31 @@ class CTransaction;
 void RelayTransaction(const CTransaction& tx);
 void RelayTransaction(const CTransaction& tx, const CDataStream& ss);
 
+/**
+ * FIFO of nodes that have work for the message handler workers. A node is in the queue (or being
+ * processed by a worker) at most once, which is tracked by CNode::fMsgHandlerQueued. This keeps the
+ * messages of every peer processed in order while different peers are served in parallel.
+ * The queue holds a reference to every node in it.
+ */
+class CMessageHandlerQueue
+{
+    boost::mutex              mtx;
+    boost::condition_variable cond;
+    std::deque<CNode*>        queue;
+
+public:
+    /** returns false if the node is already queued */
+    bool push(CNode* pnode);
+
+    /** returns nullptr on timeout or shutdown */
+    CNode* pop(int64_t timeoutMillis);
+
+    /** wakes up all waiting workers and drops the references of the queued nodes */
+    void clear();
+
+    std::size_t size();
+};
+
 bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant* grantOutbound = nullptr,
                            const char* strDest = nullptr, bool fOneShot = false);
 
@@ -0,0 +1,172 @@
+#include "ntp1/ntp1metadatacache.h"
+
+#include "hash.h"
+#include "logging/logger.h"
+#include "ntp1/ntp1tools.h"
+#include "ntp1/ntp1transaction.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+NTP1MetadataCache ntp1MetadataCache;
+
+NTP1MetadataCache::NTP1MetadataCache(const boost::filesystem::path& cacheDirIn) : cacheDir(cacheDirIn)
+{
+}
+
+boost::filesystem::path NTP1MetadataCache::getCacheDir() const
+{
+    return cacheDir ? *cacheDir : GetDataDir() / "ntp1cache";
+}
+
+boost::filesystem::path NTP1MetadataCache::metadataFilePath(const uint256& issuanceTxid) const
+{
+    return getCacheDir() / "metadata" / (issuanceTxid.GetHex() + ".json");
+}
+
+boost::filesystem::path NTP1MetadataCache::iconRefFilePath(const uint256& issuanceTxid) const
+{
+    return getCacheDir() / "icons" / (issuanceTxid.GetHex() + ".json");
+}
+
+boost::filesystem::path NTP1MetadataCache::iconDataFilePath(const std::string& contentHashHex) const
+{
+    return getCacheDir() / "icons" / contentHashHex;
+}
+
+static bool ReadJsonFile(const boost::filesystem::path& path, json_spirit::Value& result)
+{
+    try {
+        if (!boost::filesystem::exists(path)) {
+            return false;
+        }
+        std::string data;
+        boost::filesystem::load_string_file(path, data);
+        return json_spirit::read(data, result) && result.type() == json_spirit::obj_type;
+    } catch (std::exception& ex) {
+        NLog.write(b_sev::warn, "Failed to read NTP1 cache file {}: {}", path.string(), ex.what());
+        return false;
+    }
+}
+
+bool NTP1MetadataCache::writeFile(const boost::filesystem::path& path, const std::string& data)
+{
+    try {
+        boost::filesystem::create_directories(path.parent_path());
+        const boost::filesystem::path tempPath =
+            path.parent_path() / boost::filesystem::unique_path(".tmp-%%%%-%%%%-%%%%");
+        boost::filesystem::save_string_file(tempPath, data);
+        boost::filesystem::rename(tempPath, path);
+        writes++;
+        return true;
+    } catch (std::exception& ex) {
+        NLog.write(b_sev::warn, "Failed to write NTP1 cache file {}: {}", path.string(), ex.what());
+        writeFailures++;
+        return false;
+    }
+}
+
+bool NTP1MetadataCache::readMetadata(const uint256& issuanceTxid, NTP1TokenMetaData& metadata,
+                                     json_spirit::Value& issuanceMetadataNode)
+{
+    json_spirit::Value root;
+    if (!ReadJsonFile(metadataFilePath(issuanceTxid), root)) {
+        metadataMisses++;
+        return false;
+    }
+    try {
+        metadata.importDatabaseJsonData(NTP1Tools::GetObjectField(root.get_obj(), "metadata"));
+        issuanceMetadataNode = json_spirit::find_value(root.get_obj(), "issuanceMetadata");
+    } catch (std::exception& ex) {
+        NLog.write(b_sev::warn, "Invalid NTP1 metadata cache entry of {}: {}", issuanceTxid.ToString(),
+                   ex.what());
+        metadataMisses++;
+        return false;
+    }
+    metadataHits++;
+    return true;
+}
+
+void NTP1MetadataCache::writeMetadata(const uint256& issuanceTxid, const NTP1TokenMetaData& metadata,
+                                      const json_spirit::Value& issuanceMetadataNode)
+{
+    json_spirit::Object root;
+    root.push_back(json_spirit::Pair("metadata", metadata.exportDatabaseJsonData()));
+    root.push_back(json_spirit::Pair("issuanceMetadata", issuanceMetadataNode));
+    writeFile(metadataFilePath(issuanceTxid), json_spirit::write(root));
+}
+
+boost::optional<std::string> NTP1MetadataCache::readIcon(const uint256&     issuanceTxid,
+                                                         const std::string& iconURL)
+{
+    json_spirit::Value ref;
+    if (!ReadJsonFile(iconRefFilePath(issuanceTxid), ref)) {
+        iconMisses++;
+        return boost::none;
+    }
+    try {
+        // the icon of an older URL isn't the icon anymore
+        if (NTP1Tools::GetStrField(ref.get_obj(), "url") != iconURL) {
+            iconMisses++;
+            return boost::none;
+        }
+        const boost::filesystem::path dataPath =
+            iconDataFilePath(NTP1Tools::GetStrField(ref.get_obj(), "hash"));
+        std::string iconData;
+        boost::filesystem::load_string_file(dataPath, iconData);
+        iconHits++;
+        return iconData;
+    } catch (std::exception& ex) {
+        NLog.write(b_sev::warn, "Invalid NTP1 icon cache entry of {}: {}", issuanceTxid.ToString(),
+                   ex.what());
+        iconMisses++;
+        return boost::none;
+    }
+}
+
+void NTP1MetadataCache::writeIcon(const uint256& issuanceTxid, const std::string& iconURL,
+                                  const std::string& iconData)
+{
+    // icons are stored by their content, so that tokens with the same icon share the file
+    const std::string             contentHash = Hash(iconData.cbegin(), iconData.cend()).GetHex();
+    const boost::filesystem::path dataPath    = iconDataFilePath(contentHash);
+    if (!boost::filesystem::exists(dataPath) && !writeFile(dataPath, iconData)) {
+        return;
+    }
+
+    json_spirit::Object ref;
+    ref.push_back(json_spirit::Pair("url", iconURL));
+    ref.push_back(json_spirit::Pair("hash", contentHash));
+    writeFile(iconRefFilePath(issuanceTxid), json_spirit::write(ref));
+}
+
+void NTP1MetadataCache::storeIssuance(const CTransaction&    issuanceTx,
+                                      const NTP1Transaction& ntp1IssuanceTx)
+{
+    const uint256 issuanceTxid = issuanceTx.GetHash();
+    try {
+        if (boost::filesystem::exists(metadataFilePath(issuanceTxid))) {
+            return;
+        }
+        const NTP1TokenMetaData metadata =
+            NTP1Transaction::GetFullNTP1IssuanceMetadata(issuanceTx, ntp1IssuanceTx);
+        writeMetadata(issuanceTxid, metadata,
+                      NTP1Transaction::GetNTP1IssuanceMetadata(issuanceTx, ntp1IssuanceTx));
+    } catch (std::exception& ex) {
+        NLog.write(b_sev::debug, "Not caching the NTP1 metadata of {}: {}", issuanceTxid.ToString(),
+                   ex.what());
+    }
+}
+
+NTP1MetadataCache::Stats NTP1MetadataCache::getStats() const
+{
+    Stats result;
+    result.metadataHits   = metadataHits.load();
+    result.metadataMisses = metadataMisses.load();
+    result.iconHits       = iconHits.load();
+    result.iconMisses     = iconMisses.load();
+    result.writes         = writes.load();
+    result.writeFailures  = writeFailures.load();
+    return result;
+}
@@ -0,0 +1,77 @@
+#ifndef NTP1METADATACACHE_H
+#define NTP1METADATACACHE_H
+
+#include "json_spirit.h"
+#include "ntp1/ntp1tokenmetadata.h"
+#include "uint256.h"
+
+#include <atomic>
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <string>
+
+class CTransaction;
+class NTP1Transaction;
+
+/**
+ * A persistent cache of the metadata and icons of NTP1 tokens, in flat files in the data directory,
+ * keyed by the txid of the issuance transaction. Issuance metadata never changes, so entries are never
+ * invalidated. Icons are stored once per content hash, and an icon entry of an issuance is only used
+ * while the metadata points to the same URL.
+ *
+ * Files are written to a temporary name and then renamed, so concurrent readers and writers see either
+ * a whole entry or none.
+ */
+class NTP1MetadataCache
+{
+public:
+    struct Stats
+    {
+        uint64_t metadataHits   = 0;
+        uint64_t metadataMisses = 0;
+        uint64_t iconHits       = 0;
+        uint64_t iconMisses     = 0;
+        uint64_t writes         = 0;
+        uint64_t writeFailures  = 0;
+    };
+
+    /// uses the ntp1cache directory in the data directory
+    NTP1MetadataCache() = default;
+    explicit NTP1MetadataCache(const boost::filesystem::path& cacheDirIn);
+
+    /// the metadata of the issuance and the metadata node that was decoded from its script
+    bool readMetadata(const uint256& issuanceTxid, NTP1TokenMetaData& metadata,
+                      json_spirit::Value& issuanceMetadataNode);
+    void writeMetadata(const uint256& issuanceTxid, const NTP1TokenMetaData& metadata,
+                       const json_spirit::Value& issuanceMetadataNode);
+
+    boost::optional<std::string> readIcon(const uint256& issuanceTxid, const std::string& iconURL);
+    void writeIcon(const uint256& issuanceTxid, const std::string& iconURL, const std::string& iconData);
+
+    /// decodes the metadata of an issuance transaction and caches it; doesn't throw
+    void storeIssuance(const CTransaction& issuanceTx, const NTP1Transaction& ntp1IssuanceTx);
+
+    Stats getStats() const;
+
+    boost::filesystem::path getCacheDir() const;
+
+private:
+    boost::optional<boost::filesystem::path> cacheDir;
+
+    boost::filesystem::path metadataFilePath(const uint256& issuanceTxid) const;
+    boost::filesystem::path iconRefFilePath(const uint256& issuanceTxid) const;
+    boost::filesystem::path iconDataFilePath(const std::string& contentHashHex) const;
+
+    bool writeFile(const boost::filesystem::path& path, const std::string& data);
+
+    std::atomic<uint64_t> metadataHits{0};
+    std::atomic<uint64_t> metadataMisses{0};
+    std::atomic<uint64_t> iconHits{0};
+    std::atomic<uint64_t> iconMisses{0};
+    std::atomic<uint64_t> writes{0};
+    std::atomic<uint64_t> writeFailures{0};
+};
+
+extern NTP1MetadataCache ntp1MetadataCache;
+
+#endif // NTP1METADATACACHE_H
@@ -116,6 +116,9 @@ void NTP1TokenMetaData::importDatabaseJsonData(const json_spirit::Value& data)
     tokenIssuer       = NTP1Tools::GetStrField(data.get_obj(), "tokenIssuer");
     iconURL           = NTP1Tools::GetStrField(data.get_obj(), "iconURL");
     iconImageType     = NTP1Tools::GetStrField(data.get_obj(), "iconImageType");
+    // older exports don't have these
+    userData = json_spirit::find_value(data.get_obj(), "userData");
+    urls     = json_spirit::find_value(data.get_obj(), "urls");
 }
 
 void NTP1TokenMetaData::readSomeDataFromStandardJsonFormat(const json_spirit::Value& data)
@@ -2,6 +2,7 @@
 
 #include "base58.h"
 #include "main.h"
+#include "ntp1/ntp1metadatacache.h"
 #include "ntp1/ntp1script.h"
 #include "ntp1/ntp1script_burn.h"
 #include "ntp1/ntp1script_issuance.h"
@@ -747,12 +748,9 @@ void NTP1Transaction::readNTP1DataFromTx(
     }
 }
 
-json_spirit::Value NTP1Transaction::GetNTP1IssuanceMetadata(const ITxDB&   txdb,
-                                                            const uint256& issuanceTxid)
+json_spirit::Value NTP1Transaction::GetNTP1IssuanceMetadata(const CTransaction&    tx,
+                                                            const NTP1Transaction& ntp1tx)
 {
-    CTransaction    tx = CTransaction::FetchTxFromDisk(issuanceTxid);
-    NTP1Transaction ntp1tx;
-    ntp1tx.readNTP1DataFromTx_minimal(txdb, tx);
     std::string opRet;
     bool        isNTP1 = IsTxNTP1(&tx, &opRet);
     if (!isNTP1) {
@@ -782,6 +780,22 @@ json_spirit::Value NTP1Transaction::GetNTP1IssuanceMetadata(const ITxDB&   txdb,
     }
 }
 
+json_spirit::Value NTP1Transaction::GetNTP1IssuanceMetadata(const ITxDB&   txdb,
+                                                            const uint256& issuanceTxid)
+{
+    NTP1TokenMetaData  cachedMetadata;
+    json_spirit::Value cachedNode;
+    if (ntp1MetadataCache.readMetadata(issuanceTxid, cachedMetadata, cachedNode)) {
+        return cachedNode;
+    }
+
+    CTransaction    tx = CTransaction::FetchTxFromDisk(issuanceTxid);
+    NTP1Transaction ntp1tx;
+    ntp1tx.readNTP1DataFromTx_minimal(txdb, tx);
+    ntp1MetadataCache.storeIssuance(tx, ntp1tx);
+    return GetNTP1IssuanceMetadata(tx, ntp1tx);
+}
+
 NTP1TokenMetaData NTP1Transaction::GetFullNTP1IssuanceMetadata(const CTransaction&    issuanceTx,
                                                                const NTP1Transaction& ntp1IssuanceTx)
 {
@@ -838,12 +852,18 @@ NTP1TokenMetaData NTP1Transaction::GetFullNTP1IssuanceMetadata(const CTransactio
 NTP1TokenMetaData NTP1Transaction::GetFullNTP1IssuanceMetadata(const ITxDB&   txdb,
                                                                const uint256& issuanceTxid)
 {
+    NTP1TokenMetaData  cachedMetadata;
+    json_spirit::Value cachedNode;
+    if (ntp1MetadataCache.readMetadata(issuanceTxid, cachedMetadata, cachedNode)) {
+        return cachedMetadata;
+    }
+
     CTransaction    tx = CTransaction::FetchTxFromDisk(issuanceTxid);
     NTP1Transaction ntp1tx;
     ntp1tx.readNTP1DataFromTx_minimal(txdb, tx);
-    CDataStream ds1(SER_NETWORK, PROTOCOL_VERSION);
-    CDataStream ds2(SER_NETWORK, PROTOCOL_VERSION);
-    return GetFullNTP1IssuanceMetadata(tx, ntp1tx);
+    const NTP1TokenMetaData result = GetFullNTP1IssuanceMetadata(tx, ntp1tx);
+    ntp1MetadataCache.writeMetadata(issuanceTxid, result, GetNTP1IssuanceMetadata(tx, ntp1tx));
+    return result;
 }
 
 bool NTP1Transaction::TxContainsOpReturn(const CTransaction* tx, std::string* opReturnArg)
@@ -100,6 +100,8 @@ public:
     static std::unordered_map<std::string, TokenMinimalData>
     CalculateTotalOutputTokens(const NTP1Transaction& ntp1tx);
 
+    static json_spirit::Value GetNTP1IssuanceMetadata(const CTransaction&    issuanceTx,
+                                                      const NTP1Transaction& ntp1IssuanceTx);
     static json_spirit::Value GetNTP1IssuanceMetadata(const ITxDB& txdb, const uint256& issuanceTxid);
     static NTP1TokenMetaData  GetFullNTP1IssuanceMetadata(const CTransaction&    issuanceTx,
                                                           const NTP1Transaction& ntp1IssuanceTx);
@@ -3,6 +3,7 @@
 // the following is a necessary include for pwalletMain and CWalletTx objects
 #include "init.h"
 #include "main.h"
+#include "ntp1/ntp1metadatacache.h"
 #include "txmempool.h"
 
 #include <boost/algorithm/hex.hpp>
@@ -128,11 +129,14 @@ void NTP1Wallet::__getOutputs()
         if (removeOutputIfSpent(output, neblTx, bestBlockHash, txdb))
             continue;
 
+        // confirmed transactions have their NTP1 data in the blockchain database already
         NTP1Transaction ntp1tx;
         try {
-            std::vector<std::pair<CTransaction, NTP1Transaction>> prevTxs =
-                NTP1Transaction::GetAllNTP1InputsOfTx(neblTx, txdb, true);
-            ntp1tx.readNTP1DataFromTx(txdb, neblTx, prevTxs);
+            if (!txdb.ReadNTP1Tx(txHash, ntp1tx)) {
+                std::vector<std::pair<CTransaction, NTP1Transaction>> prevTxs =
+                    NTP1Transaction::GetAllNTP1InputsOfTx(neblTx, txdb, true);
+                ntp1tx.readNTP1DataFromTx(txdb, neblTx, prevTxs);
+            }
         } catch (std::exception& ex) {
             NLog.write(b_sev::err, "Unable to download transaction information. Error says: {}",
                        ex.what());
@@ -163,10 +167,12 @@ void NTP1Wallet::__getOutputs()
                         }
                     }
 
-                    std::vector<std::pair<CTransaction, NTP1Transaction>> issueTxInputs =
-                        NTP1Transaction::GetAllNTP1InputsOfTx(issueTx, txdb, true);
                     NTP1Transaction issueNTP1Tx;
-                    issueNTP1Tx.readNTP1DataFromTx(txdb, issueTx, issueTxInputs);
+                    if (!txdb.ReadNTP1Tx(issueTxid, issueNTP1Tx)) {
+                        std::vector<std::pair<CTransaction, NTP1Transaction>> issueTxInputs =
+                            NTP1Transaction::GetAllNTP1InputsOfTx(issueTx, txdb, true);
+                        issueNTP1Tx.readNTP1DataFromTx(txdb, issueTx, issueTxInputs);
+                    }
 
                     // find the correct output in the issuance transaction that has the token in question
                     // issued
@@ -414,9 +420,13 @@ std::string NTP1Wallet::__downloadIcon(const std::string& IconURL)
 }
 
 void NTP1Wallet::__asyncDownloadAndSetIcon(std::string IconURL, std::string tokenId,
-                                           NTP1WalletPtr wallet)
+                                           uint256 issuanceTxid, NTP1WalletPtr wallet)
 {
-    wallet->setTokenIcon(tokenId, __downloadIcon(IconURL));
+    const std::string icon = __downloadIcon(IconURL);
+    if (!icon.empty() && icon != ICON_ERROR_CONTENT) {
+        ntp1MetadataCache.writeIcon(issuanceTxid, IconURL, icon);
+    }
+    wallet->setTokenIcon(tokenId, icon);
 }
 
 std::string NTP1Wallet::getAndCacheTokenIcon(int index)
@@ -436,8 +446,15 @@ std::string NTP1Wallet::getAndCacheTokenIcon(int index)
             tokenIcons.set(tokenId, "");
             return "";
         }
-        boost::thread IconDownloadThread(
-            boost::bind(__asyncDownloadAndSetIcon, IconURL, tokenId, shared_from_this()));
+        const uint256                      issuanceTxid = itToken->second.getIssuanceTxId();
+        const boost::optional<std::string> cachedIcon =
+            ntp1MetadataCache.readIcon(issuanceTxid, IconURL);
+        if (cachedIcon) {
+            tokenIcons.set(tokenId, *cachedIcon);
+            return *cachedIcon;
+        }
+        boost::thread IconDownloadThread(boost::bind(__asyncDownloadAndSetIcon, IconURL, tokenId,
+                                                     issuanceTxid, shared_from_this()));
         IconDownloadThread.detach();
         return "";
     } else {
@@ -447,7 +464,8 @@ std::string NTP1Wallet::getAndCacheTokenIcon(int index)
         if (icon == ICON_ERROR_CONTENT || (icon == "" && !itToken->second.getIconURL().empty())) {
             const std::string& IconURL = itToken->second.getIconURL();
             boost::thread      IconDownloadThread(
-                boost::bind(__asyncDownloadAndSetIcon, IconURL, tokenId, shared_from_this()));
+                boost::bind(__asyncDownloadAndSetIcon, IconURL, tokenId,
+                            itToken->second.getIssuanceTxId(), shared_from_this()));
             IconDownloadThread.detach();
         }
 
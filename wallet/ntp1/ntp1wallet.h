@@ -40,7 +40,7 @@ class NTP1Wallet : public INTP1Wallet
     // if the shared_ptr's content gets deleted before the thread gets executed, it will lead to a
     // segfault passing a shared_ptr guarantees that the object will survive until the end
     static void __asyncDownloadAndSetIcon(std::string IconURL, std::string tokenId,
-                                          NTP1WalletPtr wallet);
+                                          uint256 issuanceTxid, NTP1WalletPtr wallet);
 
     static std::string __downloadIcon(const std::string& IconURL);
     static void        AddOutputToWalletBalance(const NTP1Transaction& tx, int outputIndex,
@@ -0,0 +1,147 @@
+#include "ntp1tokenindex.h"
+
+#include "itxdb.h"
+#include "logging/logger.h"
+#include "ntp1/ntp1transaction.h"
+#include "transaction.h"
+#include "util.h"
+
+bool fNTP1Index = false;
+
+std::atomic<bool> fNTP1IndexNeedsResync{false};
+
+static void AppendTokensOfOutput(const std::string& address, const NTP1TxOut& output,
+                                 const CNTP1TokenTransferKey& keyTemplate, bool fSpending,
+                                 NTP1TokenTransferEntries&                    transfers,
+                                 std::map<CNTP1TokenHolderKey, NTP1Int>&      deltas)
+{
+    for (unsigned long i = 0; i < output.tokenCount(); i++) {
+        const NTP1TokenTxData& token = output.getToken(i);
+
+        CNTP1TokenTransferKey key = keyTemplate;
+        key.tokenId               = token.getTokenId();
+        transfers.emplace_back(key, CNTP1TokenTransferValue(address, token.getAmount()));
+
+        NTP1Int& delta = deltas[CNTP1TokenHolderKey(key.tokenId, address)];
+        delta += fSpending ? NTP1Int(-token.getAmount()) : token.getAmount();
+    }
+}
+
+void CollectNTP1TokenIndexChanges(const ITxDB& txdb, const std::vector<CTransaction>& vtx, int nHeight,
+                                  NTP1TokenTransferEntries& transfers, NTP1TokenHolderEntries& deltas)
+{
+    std::map<CNTP1TokenHolderKey, NTP1Int> deltasMap;
+
+    for (const CTransaction& tx : vtx) {
+        const uint256 txhash = tx.GetHash();
+
+        // tokens leave the outputs that are spent, even by transactions that aren't NTP1, which burns
+        // them
+        if (!tx.IsCoinBase()) {
+            for (unsigned i = 0; i < tx.vin.size(); i++) {
+                const COutPoint& prevout = tx.vin[i].prevout;
+                if (!txdb.ContainsNTP1Tx(prevout.hash)) {
+                    continue;
+                }
+                NTP1Transaction prevNtp1tx;
+                if (!txdb.ReadNTP1Tx(prevout.hash, prevNtp1tx)) {
+                    throw std::runtime_error("Failed to read the NTP1 transaction " +
+                                             prevout.hash.ToString() + " spent by " +
+                                             txhash.ToString());
+                }
+                if (prevout.n >= prevNtp1tx.getTxOutCount()) {
+                    continue;
+                }
+                const NTP1TxOut& spentOutput = prevNtp1tx.getTxOut(prevout.n);
+                AppendTokensOfOutput(spentOutput.getAddress(), spentOutput,
+                                     CNTP1TokenTransferKey("", nHeight, txhash, i, true), true,
+                                     transfers, deltasMap);
+            }
+        }
+
+        if (!txdb.ContainsNTP1Tx(txhash)) {
+            continue;
+        }
+        NTP1Transaction ntp1tx;
+        if (!txdb.ReadNTP1Tx(txhash, ntp1tx)) {
+            throw std::runtime_error("Failed to read the NTP1 transaction " + txhash.ToString());
+        }
+        for (unsigned i = 0; i < ntp1tx.getTxOutCount(); i++) {
+            const NTP1TxOut& output = ntp1tx.getTxOut(i);
+            AppendTokensOfOutput(output.getAddress(), output,
+                                 CNTP1TokenTransferKey("", nHeight, txhash, i, false), false,
+                                 transfers, deltasMap);
+        }
+    }
+
+    for (const auto& d : deltasMap) {
+        if (d.second != 0) {
+            deltas.emplace_back(d.first, CNTP1TokenHolderValue(d.second));
+        }
+    }
+}
+
+bool WriteNTP1TokenIndex(ITxDB& txdb, const std::vector<CTransaction>& vtx, int nHeight)
+{
+    if (fNTP1IndexNeedsResync) {
+        return true;
+    }
+
+    // everything is computed before anything is written, so that a block is either indexed entirely
+    // or not at all
+    NTP1TokenTransferEntries transfers;
+    NTP1TokenHolderEntries   deltas;
+    try {
+        CollectNTP1TokenIndexChanges(txdb, vtx, nHeight, transfers, deltas);
+    } catch (std::exception& ex) {
+        // the holders of the following blocks can't be right without this block, so the index is
+        // left alone until it's built again
+        NLog.write(b_sev::err,
+                   "Failed to index the NTP1 tokens of the block at height {}, the NTP1 token index "
+                   "will be rebuilt on restart: {}",
+                   nHeight, ex.what());
+        fNTP1IndexNeedsResync = true;
+        SC_CreateScheduledOperationOnRestart(SC_SCHEDULE_ON_RESTART_OPNAME__RESYNC);
+        return true;
+    }
+
+    // these are written in the transaction of the block, which is aborted if any of them fails
+    if (!txdb.WriteNTP1TokenTransfers(transfers)) {
+        return NLog.error("WriteNTP1TokenIndex(): failed to write the token transfers of the block at "
+                          "height {}",
+                          nHeight);
+    }
+    if (!txdb.UpdateNTP1TokenHolderBalances(deltas)) {
+        return NLog.error("WriteNTP1TokenIndex(): failed to update the token holders of the block at "
+                          "height {}",
+                          nHeight);
+    }
+    return true;
+}
+
+bool UndoNTP1TokenIndex(ITxDB& txdb, const std::vector<CTransaction>& vtx, int nHeight)
+{
+    if (fNTP1IndexNeedsResync) {
+        return true;
+    }
+
+    NTP1TokenTransferEntries transfers;
+    NTP1TokenHolderEntries   deltas;
+    try {
+        CollectNTP1TokenIndexChanges(txdb, vtx, nHeight, transfers, deltas);
+    } catch (std::exception& ex) {
+        return NLog.error("UndoNTP1TokenIndex(): {}", ex.what());
+    }
+
+    for (auto& d : deltas) {
+        d.second.balance = -d.second.balance;
+    }
+
+    if (!txdb.EraseNTP1TokenTransfers(transfers)) {
+        return NLog.error("UndoNTP1TokenIndex(): failed to erase the token transfers");
+    }
+    if (!txdb.UpdateNTP1TokenHolderBalances(deltas)) {
+        return NLog.error("UndoNTP1TokenIndex(): failed to restore the token holders");
+    }
+    return true;
+}
@@ -0,0 +1,134 @@
+#ifndef NTP1TOKENINDEX_H
+#define NTP1TOKENINDEX_H
+
+#include "ntp1/ntp1script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+class ITxDB;
+class CTransaction;
+
+/** Set by -ntp1index; the NTP1 token index is maintained while connecting/disconnecting blocks */
+extern bool fNTP1Index;
+
+/** Set when a block couldn't be indexed; the index isn't updated anymore and is rebuilt on restart */
+extern std::atomic<bool> fNTP1IndexNeedsResync;
+
+/**
+ * A key of the token transfers table: every output that received some token and every input that
+ * spent it (the spent marker of that output). Keys of a token are sorted by height.
+ */
+struct CNTP1TokenTransferKey
+{
+    std::string tokenId;
+    uint32_t    blockHeight = 0;
+    uint256     txhash;
+    uint32_t    index    = 0;
+    bool        spending = false;
+
+    CNTP1TokenTransferKey() = default;
+    CNTP1TokenTransferKey(const std::string& tokenIdIn, int heightIn, const uint256& txhashIn,
+                          uint32_t indexIn, bool spendingIn)
+        : tokenId(tokenIdIn), blockHeight(static_cast<uint32_t>(heightIn)), txhash(txhashIn),
+          index(indexIn), spending(spendingIn)
+    {
+    }
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+        READWRITE(tokenId);
+        READWRITE(REF(CBigEndian32(REF(blockHeight))));
+        READWRITE(txhash);
+        READWRITE(index);
+        READWRITE(spending);
+    )
+    // clang-format on
+};
+
+struct CNTP1TokenTransferValue
+{
+    std::string address;
+    NTP1Int     amount;
+
+    CNTP1TokenTransferValue() = default;
+    CNTP1TokenTransferValue(const std::string& addressIn, const NTP1Int& amountIn)
+        : address(addressIn), amount(amountIn)
+    {
+    }
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+        READWRITE(address);
+        READWRITE(amount);
+    )
+    // clang-format on
+};
+
+/** A key of the token holders table, which has the balance of every address holding a token */
+struct CNTP1TokenHolderKey
+{
+    std::string tokenId;
+    std::string address;
+
+    CNTP1TokenHolderKey() = default;
+    CNTP1TokenHolderKey(const std::string& tokenIdIn, const std::string& addressIn)
+        : tokenId(tokenIdIn), address(addressIn)
+    {
+    }
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+        READWRITE(tokenId);
+        READWRITE(address);
+    )
+    // clang-format on
+
+    friend bool operator<(const CNTP1TokenHolderKey& a, const CNTP1TokenHolderKey& b)
+    {
+        return std::tie(a.tokenId, a.address) < std::tie(b.tokenId, b.address);
+    }
+};
+
+/** A balance in the holders table, or a change of it when updating the table */
+struct CNTP1TokenHolderValue
+{
+    NTP1Int balance;
+
+    CNTP1TokenHolderValue() = default;
+    explicit CNTP1TokenHolderValue(const NTP1Int& balanceIn) : balance(balanceIn) {}
+
+    // clang-format off
+    IMPLEMENT_SERIALIZE(
+        READWRITE(balance);
+    )
+    // clang-format on
+};
+
+using NTP1TokenTransferEntries = std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>;
+using NTP1TokenHolderEntries   = std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>>;
+
+/**
+ * Collects the token transfers of the transactions of a block at the given height and the changes
+ * they make to the balances of the holders. The NTP1 data of the transactions and of the outputs they
+ * spend is read from the database, so the NTP1 transactions of the block have to be written first.
+ */
+void CollectNTP1TokenIndexChanges(const ITxDB& txdb, const std::vector<CTransaction>& vtx, int nHeight,
+                                  NTP1TokenTransferEntries& transfers, NTP1TokenHolderEntries& deltas);
+
+/**
+ * Adds the token transfers of a block at the given height to the index. If they can't be collected,
+ * nothing is written and the index is marked for a rebuild; returns false if writing them failed.
+ */
+bool WriteNTP1TokenIndex(ITxDB& txdb, const std::vector<CTransaction>& vtx, int nHeight);
+
+/** Reverts what WriteNTP1TokenIndex() did for the same block */
+bool UndoNTP1TokenIndex(ITxDB& txdb, const std::vector<CTransaction>& vtx, int nHeight);
+
+#endif // NTP1TOKENINDEX_H
@@ -0,0 +1,336 @@
+#include "orphanblockpool.h"
+
+#include "globals.h"
+#include "logging/logger.h"
+#include "util.h"
+#include "version.h"
+
+#include <algorithm>
+
+COrphanBlockPool orphanBlockPool;
+
+COrphanBlockPool::COrphanBlockPool()
+{
+    limits.nMaxBlocks       = DEFAULT_MAX_ORPHAN_BLOCKS;
+    limits.nMaxBytes        = static_cast<std::size_t>(DEFAULT_MAX_ORPHAN_BLOCKS_MB) * 1000000;
+    limits.nMaxBytesPerPeer = limits.nMaxBytes / ORPHAN_BLOCKS_PEER_SHARE;
+    limits.nMaxMemoryBytes  = static_cast<std::size_t>(DEFAULT_MAX_ORPHAN_BLOCKS_MEMORY_MB) * 1000000;
+    limits.fSpillToDisk     = DEFAULT_ORPHAN_BLOCK_SPILL;
+}
+
+COrphanBlockPool::Limits COrphanBlockPool::LimitsFromArgs()
+{
+    Limits result;
+    result.nMaxBlocks = static_cast<std::size_t>(
+        std::max(INT64_C(0), GetArg("-maxorphanblocks", DEFAULT_MAX_ORPHAN_BLOCKS)));
+    result.nMaxBytes = static_cast<std::size_t>(std::max(
+                           INT64_C(0), GetArg("-maxorphanblocksmb", DEFAULT_MAX_ORPHAN_BLOCKS_MB))) *
+                       1000000;
+    result.nMaxBytesPerPeer = result.nMaxBytes / ORPHAN_BLOCKS_PEER_SHARE;
+    result.nMaxMemoryBytes =
+        static_cast<std::size_t>(std::max(
+            INT64_C(0), GetArg("-maxorphanblocksmemmb", DEFAULT_MAX_ORPHAN_BLOCKS_MEMORY_MB))) *
+        1000000;
+    result.fSpillToDisk = GetBoolArg("-orphanblockspill", DEFAULT_ORPHAN_BLOCK_SPILL);
+    return result;
+}
+
+void COrphanBlockPool::SetLimits(const Limits& newLimits)
+{
+    LOCK(cs);
+    // the pool shrinks to the new limits as new orphans arrive
+    limits = newLimits;
+}
+
+std::size_t COrphanBlockPool::GetPeerBytes_unsafe(int64_t nodeId) const
+{
+    const auto it = mapPeerBytes.find(nodeId);
+    return it == mapPeerBytes.cend() ? 0 : it->second;
+}
+
+void COrphanBlockPool::Erase_unsafe(OrphansContainer::index<HashTag>::type::iterator it,
+                                    ITxDB&                                           txdb)
+{
+    nTotalBytes -= it->nSize;
+    if (it->block) {
+        nMemoryBytes -= it->nSize;
+    } else {
+        if (!txdb.EraseOrphanBlock(it->hashPrev, it->hash)) {
+            NLog.write(b_sev::err, "Failed to erase the spilled orphan block {} from the database",
+                       it->hash.ToString());
+        }
+        nSpilledCount--;
+    }
+
+    const auto peerIt = mapPeerBytes.find(it->nodeId);
+    if (peerIt != mapPeerBytes.end()) {
+        peerIt->second -= std::min(peerIt->second, it->nSize);
+        if (peerIt->second == 0) {
+            mapPeerBytes.erase(peerIt);
+        }
+    }
+
+    if (it->stake) {
+        const auto stakeIt = mapStakesSeen.find(*it->stake);
+        if (stakeIt != mapStakesSeen.end() && --stakeIt->second <= 0) {
+            mapStakesSeen.erase(stakeIt);
+        }
+    }
+
+    orphans.get<HashTag>().erase(it);
+}
+
+COrphanBlockPool::OrphansContainer::index<COrphanBlockPool::HashTag>::type::const_iterator
+COrphanBlockPool::FindRoot_unsafe(const uint256& hash) const
+{
+    const auto& byHash = orphans.get<HashTag>();
+    auto        it     = byHash.find(hash);
+    if (it == byHash.end()) {
+        return it;
+    }
+    // Work back to the first block in the orphan chain
+    while (true) {
+        const auto prevIt = byHash.find(it->hashPrev);
+        if (prevIt == byHash.end()) {
+            break;
+        }
+        it = prevIt;
+    }
+    return it;
+}
+
+uint256 COrphanBlockPool::FindLeaf_unsafe(const uint256&                  hash,
+                                          const boost::optional<int64_t>& nodeId) const
+{
+    const auto& byPrev = orphans.get<PrevTag>();
+    uint256     result = hash;
+    // As long as this block has other orphans depending on it, move to one of those successors
+    while (true) {
+        const auto range = byPrev.equal_range(result);
+        const auto child = std::find_if(range.first, range.second, [&nodeId](const Entry& e) {
+            return !nodeId || e.nodeId == *nodeId;
+        });
+        if (child == range.second) {
+            break;
+        }
+        result = child->hash;
+    }
+    return result;
+}
+
+bool COrphanBlockPool::EvictOne_unsafe(const boost::optional<int64_t>& fromPeer, ITxDB& txdb)
+{
+    uint256 start;
+    if (fromPeer) {
+        const auto& byPeer = orphans.get<PeerTag>();
+        const auto  it     = byPeer.lower_bound(boost::make_tuple(*fromPeer));
+        if (it == byPeer.end() || it->nodeId != *fromPeer) {
+            return false;
+        }
+        start = it->hash;
+    } else {
+        const auto& byOrder = orphans.get<OrderTag>();
+        if (byOrder.empty()) {
+            return false;
+        }
+        start = byOrder.begin()->hash;
+    }
+
+    auto&      byHash = orphans.get<HashTag>();
+    const auto it     = byHash.find(FindLeaf_unsafe(start, fromPeer));
+    assert(it != byHash.end());
+
+    NLog.write(b_sev::info,
+               "Removing block {} from the orphans pool as it has exceeded its limits; current "
+               "size: {} blocks, {} bytes",
+               it->hash.ToString(), orphans.size(), nTotalBytes);
+    Erase_unsafe(it, txdb);
+    return true;
+}
+
+void COrphanBlockPool::Spill_unsafe(ITxDB& txdb)
+{
+    auto& byOrder = orphans.get<OrderTag>();
+    for (auto it = byOrder.begin(); it != byOrder.end() && nMemoryBytes > limits.nMaxMemoryBytes;
+         ++it) {
+        if (!it->block) {
+            continue;
+        }
+        if (!txdb.WriteOrphanBlock(it->hash, *it->block)) {
+            NLog.write(b_sev::err, "Failed to spill the orphan block {} to the database",
+                       it->hash.ToString());
+            return;
+        }
+        it->block.reset();
+        nMemoryBytes -= it->nSize;
+        nSpilledCount++;
+    }
+}
+
+bool COrphanBlockPool::Add(const CBlock& block, const uint256& hash, int64_t nodeId, ITxDB& txdb)
+{
+    LOCK(cs);
+
+    if (orphans.get<HashTag>().count(hash)) {
+        return false;
+    }
+
+    const std::size_t nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    if (limits.nMaxBlocks == 0 || nSize > limits.nMaxBytes ||
+        (nodeId != NO_PEER && nSize > limits.nMaxBytesPerPeer)) {
+        NLog.write(b_sev::info, "Orphan block {} of size {} doesn't fit in the orphans pool",
+                   hash.ToString(), nSize);
+        return false;
+    }
+
+    // a peer that has filled its share of the pool makes room among its own orphans
+    if (nodeId != NO_PEER) {
+        while (GetPeerBytes_unsafe(nodeId) + nSize > limits.nMaxBytesPerPeer) {
+            if (!EvictOne_unsafe(boost::make_optional(nodeId), txdb)) {
+                break;
+            }
+        }
+    }
+
+    while (orphans.size() >= limits.nMaxBlocks || nTotalBytes + nSize > limits.nMaxBytes) {
+        if (!EvictOne_unsafe(boost::none, txdb)) {
+            break;
+        }
+    }
+
+    Entry entry;
+    entry.hash     = hash;
+    entry.hashPrev = block.hashPrevBlock;
+    entry.nodeId   = nodeId;
+    entry.nSize    = nSize;
+    entry.order    = counter++;
+    entry.block    = std::make_shared<CBlock>(block);
+    if (block.IsProofOfStake()) {
+        entry.stake = block.GetProofOfStake();
+        mapStakesSeen[*entry.stake]++;
+    }
+    orphans.insert(std::move(entry));
+
+    nTotalBytes += nSize;
+    nMemoryBytes += nSize;
+    mapPeerBytes[nodeId] += nSize;
+
+    if (limits.fSpillToDisk) {
+        Spill_unsafe(txdb);
+    }
+
+    return true;
+}
+
+bool COrphanBlockPool::Contains(const uint256& hash) const
+{
+    LOCK(cs);
+    return orphans.get<HashTag>().count(hash) > 0;
+}
+
+bool COrphanBlockPool::HasChildren(const uint256& hashPrev) const
+{
+    LOCK(cs);
+    return orphans.get<PrevTag>().count(hashPrev) > 0;
+}
+
+bool COrphanBlockPool::IsStakeSeen(const std::pair<COutPoint, unsigned int>& stake) const
+{
+    LOCK(cs);
+    return mapStakesSeen.count(stake) > 0;
+}
+
+bool COrphanBlockPool::Touch(const uint256& hash)
+{
+    LOCK(cs);
+    auto&      byHash = orphans.get<HashTag>();
+    const auto it     = byHash.find(hash);
+    if (it == byHash.end()) {
+        return false;
+    }
+    byHash.modify(it, [this](Entry& e) { e.order = counter++; });
+    return true;
+}
+
+uint256 COrphanBlockPool::GetRoot(const uint256& hash) const
+{
+    LOCK(cs);
+    const auto it = FindRoot_unsafe(hash);
+    return it == orphans.get<HashTag>().end() ? hash : it->hash;
+}
+
+uint256 COrphanBlockPool::GetWantedBlock(const uint256& hash) const
+{
+    LOCK(cs);
+    const auto it = FindRoot_unsafe(hash);
+    return it == orphans.get<HashTag>().end() ? uint256(0) : it->hashPrev;
+}
+
+std::vector<COrphanBlockPool::OrphanBlock> COrphanBlockPool::TakeChildren(const uint256& hashPrev,
+                                                                          ITxDB&         txdb)
+{
+    LOCK(cs);
+
+    std::vector<uint256> hashes;
+    {
+        const auto range = orphans.get<PrevTag>().equal_range(hashPrev);
+        for (auto it = range.first; it != range.second; ++it) {
+            hashes.push_back(it->hash);
+        }
+    }
+
+    std::vector<OrphanBlock> result;
+    result.reserve(hashes.size());
+    auto& byHash = orphans.get<HashTag>();
+    for (const uint256& h : hashes) {
+        const auto it = byHash.find(h);
+
+        OrphanBlock orphan;
+        orphan.hash  = h;
+        orphan.block = it->block;
+        if (!orphan.block) {
+            orphan.block = std::make_shared<CBlock>();
+            if (!txdb.ReadOrphanBlock(hashPrev, h, *orphan.block)) {
+                NLog.write(b_sev::err, "Failed to read the spilled orphan block {} from the database",
+                           h.ToString());
+                orphan.block.reset();
+            }
+        }
+
+        Erase_unsafe(it, txdb);
+        if (orphan.block) {
+            result.push_back(std::move(orphan));
+        }
+    }
+    return result;
+}
+
+std::size_t COrphanBlockPool::Size() const
+{
+    LOCK(cs);
+    return orphans.size();
+}
+
+std::size_t COrphanBlockPool::Bytes() const
+{
+    LOCK(cs);
+    return nTotalBytes;
+}
+
+std::size_t COrphanBlockPool::MemoryBytes() const
+{
+    LOCK(cs);
+    return nMemoryBytes;
+}
+
+std::size_t COrphanBlockPool::SpilledCount() const
+{
+    LOCK(cs);
+    return nSpilledCount;
+}
+
+std::size_t COrphanBlockPool::PeerBytes(int64_t nodeId) const
+{
+    LOCK(cs);
+    return GetPeerBytes_unsafe(nodeId);
+}
@@ -0,0 +1,171 @@
+#ifndef ORPHANBLOCKPOOL_H
+#define ORPHANBLOCKPOOL_H
+
+#include "block.h"
+#include "itxdb.h"
+#include "sync.h"
+#include "transaction.h"
+#include "uint256.h"
+
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+/** Default for -maxorphanblocksmb, the total serialized size of the orphan blocks we keep */
+static const unsigned int DEFAULT_MAX_ORPHAN_BLOCKS_MB = 100;
+/** Default for -maxorphanblocksmemmb, the size of the orphan blocks kept in memory when spilling */
+static const unsigned int DEFAULT_MAX_ORPHAN_BLOCKS_MEMORY_MB = 20;
+/** Default for -orphanblockspill */
+static const bool DEFAULT_ORPHAN_BLOCK_SPILL = false;
+/** A single peer can fill at most this fraction of the orphans pool, 1/n */
+static const unsigned int ORPHAN_BLOCKS_PEER_SHARE = 4;
+
+/**
+ * The blocks whose previous block we don't have yet, waiting to be connected by ProcessBlock().
+ *
+ * The pool is bounded both by the number of blocks and by their total serialized size. When it's
+ * full, orphans are evicted in least-recently-used order. A peer can only fill its share of the
+ * pool; beyond that, its own orphans make room for its new ones. Instead of the orphan itself, the
+ * last descendant of it in the pool is evicted, so that chains of orphans are kept whole as long as
+ * possible.
+ *
+ * Optionally, when the blocks kept in memory exceed a budget, the bodies of the least recently
+ * used orphans are moved to a temporary database table, keyed by (previous block hash, block hash),
+ * and read back when their previous block arrives.
+ */
+class COrphanBlockPool
+{
+public:
+    struct Limits
+    {
+        std::size_t nMaxBlocks;
+        std::size_t nMaxBytes;
+        std::size_t nMaxBytesPerPeer;
+        std::size_t nMaxMemoryBytes;
+        bool        fSpillToDisk;
+    };
+
+    struct OrphanBlock
+    {
+        uint256                 hash;
+        std::shared_ptr<CBlock> block;
+    };
+
+    // the id used for blocks that didn't come from a peer
+    static const int64_t NO_PEER = -1;
+
+private:
+    struct HashTag
+    {
+    };
+
+    struct PrevTag
+    {
+    };
+
+    struct OrderTag
+    {
+    };
+
+    struct PeerTag
+    {
+    };
+
+    struct Entry
+    {
+        uint256                                             hash;
+        uint256                                             hashPrev;
+        int64_t                                             nodeId;
+        std::size_t                                         nSize;
+        std::uint64_t                                       order;
+        boost::optional<std::pair<COutPoint, unsigned int>> stake;
+        // nullptr when the block was spilled to disk
+        mutable std::shared_ptr<CBlock> block;
+    };
+
+    using OrphansContainer = boost::multi_index_container<
+        Entry,
+        boost::multi_index::indexed_by<
+            // clang-format off
+            boost::multi_index::ordered_unique<boost::multi_index::tag<HashTag>,
+                                               BOOST_MULTI_INDEX_MEMBER(Entry, uint256, hash)>,
+            boost::multi_index::ordered_non_unique<boost::multi_index::tag<PrevTag>,
+                                                   BOOST_MULTI_INDEX_MEMBER(Entry, uint256, hashPrev)>,
+            boost::multi_index::ordered_unique<boost::multi_index::tag<OrderTag>,
+                                               BOOST_MULTI_INDEX_MEMBER(Entry, std::uint64_t, order)>,
+            boost::multi_index::ordered_unique<boost::multi_index::tag<PeerTag>,
+                                               boost::multi_index::composite_key<
+                                                   Entry,
+                                                   BOOST_MULTI_INDEX_MEMBER(Entry, int64_t, nodeId),
+                                                   BOOST_MULTI_INDEX_MEMBER(Entry, std::uint64_t, order)>>
+            // clang-format on
+            >>;
+
+    mutable CCriticalSection cs;
+
+    OrphansContainer orphans;
+    Limits           limits;
+    std::uint64_t    counter       = 0;
+    std::size_t      nTotalBytes   = 0;
+    std::size_t      nMemoryBytes  = 0;
+    std::size_t      nSpilledCount = 0;
+
+    std::map<int64_t, std::size_t>                    mapPeerBytes;
+    std::map<std::pair<COutPoint, unsigned int>, int> mapStakesSeen;
+
+    void        Erase_unsafe(OrphansContainer::index<HashTag>::type::iterator it, ITxDB& txdb);
+    OrphansContainer::index<HashTag>::type::const_iterator FindRoot_unsafe(const uint256& hash) const;
+    uint256     FindLeaf_unsafe(const uint256& hash, const boost::optional<int64_t>& nodeId) const;
+    bool        EvictOne_unsafe(const boost::optional<int64_t>& fromPeer, ITxDB& txdb);
+    void        Spill_unsafe(ITxDB& txdb);
+    std::size_t GetPeerBytes_unsafe(int64_t nodeId) const;
+
+public:
+    COrphanBlockPool();
+
+    COrphanBlockPool(const COrphanBlockPool&) = delete;
+    COrphanBlockPool& operator=(const COrphanBlockPool&) = delete;
+
+    static Limits LimitsFromArgs();
+    void          SetLimits(const Limits& newLimits);
+
+    /**
+     * Adds an orphan received from the given peer, evicting older orphans as necessary
+     * returns false if the block is already in the pool or can't fit in it at all
+     */
+    bool Add(const CBlock& block, const uint256& hash, int64_t nodeId, ITxDB& txdb);
+
+    bool Contains(const uint256& hash) const;
+    /** true if there are orphans that have the given block as their previous block */
+    bool HasChildren(const uint256& hashPrev) const;
+    bool IsStakeSeen(const std::pair<COutPoint, unsigned int>& stake) const;
+    /** Marks the orphan as recently used, returns false if it's not in the pool */
+    bool Touch(const uint256& hash);
+
+    /** The first block of the chain of orphans that ends with the given orphan */
+    uint256 GetRoot(const uint256& hash) const;
+    /** The block the chain of orphans that ends with the given orphan is waiting for */
+    uint256 GetWantedBlock(const uint256& hash) const;
+
+    /**
+     * Removes the orphans that have the given block as their previous block from the pool and
+     * returns them, reading the ones that were spilled to disk back
+     */
+    std::vector<OrphanBlock> TakeChildren(const uint256& hashPrev, ITxDB& txdb);
+
+    std::size_t Size() const;
+    std::size_t Bytes() const;
+    std::size_t MemoryBytes() const;
+    std::size_t SpilledCount() const;
+    std::size_t PeerBytes(int64_t nodeId) const;
+};
+
+extern COrphanBlockPool orphanBlockPool;
+
+#endif // ORPHANBLOCKPOOL_H
@@ -14,7 +14,7 @@
 
 namespace fs = boost::filesystem;
 
-static const char* ppszTypeName[] = {"ERROR", "tx", "block", "filtered block"};
+static const char* ppszTypeName[] = {"ERROR", "tx", "block", "filtered block", "compact block"};
 
 /** Username used when cookie authentication is in use (arbitrary, only for
  * recognizability in debugging/logging purposes)
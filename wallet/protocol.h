@@ -133,6 +133,8 @@ enum
     // Nodes may always request a MSG_FILTERED_BLOCK in a getdata, however,
     // MSG_FILTERED_BLOCK should not appear in any invs except as a part of getdata.
     MSG_FILTERED_BLOCK,
+    // Only used in getdata, to ask for a "cmpctblock" message instead of a full block
+    MSG_CMPCT_BLOCK,
 };
 
 /** Generate a new RPC authentication cookie and write it to disk */
@@ -29,7 +29,7 @@ const QString NTP1Summary::viewIssuanceMetadataText = "Show issuance metadata";
 void NTP1Summary::GetAlreadyIssuedNTP1Tokens(boost::promise<std::unordered_set<std::string>>& promise)
 {
     try {
-        LOCK(cs_main);
+        LOCK_SHARED(cs_main);
         std::unordered_set<std::string> result;
         const CTxDB                     txdb;
         std::vector<uint256>            txs;
@@ -3,16 +3,22 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "addressindex.h"
 #include "amount.h"
 #include "bitcoinrpc.h"
 #include "blockmetadata.h"
+#include "headerssync.h"
 #include "main.h"
 #include "merkletx.h"
+#include "ntp1/ntp1metadatacache.h"
+#include "ntp1tokenindex.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <limits>
+#include <set>
 #include <thread>
 
 using namespace json_spirit;
@@ -523,7 +529,8 @@ Value getblockchaininfo(const Array& params, bool fHelp)
     Object obj;
     obj.push_back(Pair("chain", Params().NetworkIDString()));
     obj.push_back(Pair("blocks", CTxDB().GetBestChainHeight().value_or(0)));
-    obj.push_back(Pair("headers", bestBlockIndex ? bestBlockIndex->nHeight : -1));
+    obj.push_back(Pair("headers", std::max(bestBlockIndex ? bestBlockIndex->nHeight : -1,
+                                           headersSync.GetBestHeaderHeight())));
     obj.push_back(Pair("bestblockhash", bestBlockIndex->blockHash.GetHex()));
     obj.push_back(Pair("difficulty", (double)GetDifficulty()));
     obj.push_back(Pair("mediantime", (int64_t)bestBlockIndex->GetMedianTimePast(txdb)));
@@ -537,10 +544,9 @@ Value getblockchaininfo(const Array& params, bool fHelp)
     return obj;
 }
 
+// reads the chain through CTxDB only, so it runs on the snapshot of a readonly command without cs_main
 Value blockheaderToJSON(const CBlockIndex* blockindex)
 {
-    AssertLockHeld(cs_main);
-
     const CTxDB txdb;
 
     Object result;
@@ -609,8 +615,6 @@ Value getblockheader(const Array& params, bool fHelp)
             "\nExamples:\n"
             "getblockheader 00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"");
 
-    LOCK(cs_main);
-
     std::string strHash = params[0].get_str();
     uint256     hash(strHash);
 
@@ -674,8 +678,6 @@ Value gettxout(const Array& params, bool fHelp)
             "\nAs a json rpc call\n"
             "gettxout \"txid\" 1");
 
-    LOCK(cs_main);
-
     json_spirit::Object ret;
 
     std::string strHash = params[0].get_str();
@@ -815,3 +817,486 @@ Value cancelallvotesofproposal(const Array& params, bool fHelp)
     blockVotes.writeAllVotesAsJsonToDataDir();
     return Value();
 }
+
+// the addresses of the address index calls are either one address or an array of addresses
+static std::vector<CAddressIndexAddress> AddressIndexAddressesFromParam(const Value& param)
+{
+    std::vector<std::string> addressStrs;
+    if (param.type() == Value_type::str_type) {
+        addressStrs.push_back(param.get_str());
+    } else if (param.type() == Value_type::array_type) {
+        for (const Value& v : param.get_array()) {
+            addressStrs.push_back(v.get_str());
+        }
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an address or an array of addresses");
+    }
+
+    std::vector<CAddressIndexAddress> result;
+    for (const std::string& addressStr : addressStrs) {
+        const boost::optional<CAddressIndexAddress> address =
+            CAddressIndexAddress::FromBitcoinAddress(CBitcoinAddress(addressStr));
+        if (!address) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + addressStr);
+        }
+        if (std::find(result.cbegin(), result.cend(), *address) == result.cend()) {
+            result.push_back(*address);
+        }
+    }
+    return result;
+}
+
+static std::pair<int, int> AddressIndexHeightRangeFromParams(const Array& params)
+{
+    int startHeight = 0;
+    int endHeight   = std::numeric_limits<int>::max();
+    if (params.size() > 1 && params[1].type() != Value_type::null_type) {
+        startHeight = params[1].get_int();
+    }
+    if (params.size() > 2 && params[2].type() != Value_type::null_type) {
+        endHeight = params[2].get_int();
+    }
+    if (startHeight < 0 || endHeight < startHeight) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+    }
+    return std::make_pair(startHeight, endHeight);
+}
+
+static void EnsureAddressIndexEnabled()
+{
+    if (!fAddressIndex) {
+        throw JSONRPCError(RPC_MISC_ERROR,
+                           "The address index is not enabled; restart with -addressindex to build it");
+    }
+}
+
+Value getaddresstxids(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw std::runtime_error(
+            "getaddresstxids <address or [addresses]> ( startheight endheight )\n"
+            "\nReturns the ids of the transactions that pay to or spend from the given addresses,\n"
+            "ordered by height. Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. address        (string or array, required) An address or an array of addresses\n"
+            "2. startheight    (numeric, optional) The lowest block height to include (default: 0)\n"
+            "3. endheight      (numeric, optional) The highest block height to include (default: the "
+            "tip)\n"
+            "\nResult:\n"
+            "[\n"
+            "  \"txid\"         (string) The transaction id\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            "getaddresstxids \"NRVBLhdjvbh6SuA4y6vWVoGCqVPRzPNfWb\" 100000 110000\n");
+
+    EnsureAddressIndexEnabled();
+
+    const std::vector<CAddressIndexAddress> addresses = AddressIndexAddressesFromParam(params[0]);
+    const std::pair<int, int>               range     = AddressIndexHeightRangeFromParams(params);
+
+    const CTxDB txdb;
+
+    // (height, txid), so that the transactions of all addresses are ordered by height
+    std::set<std::pair<uint32_t, uint256>> txids;
+    for (const CAddressIndexAddress& address : addresses) {
+        std::vector<std::pair<CAddressIndexKey, CAmount>> entries;
+        if (!txdb.ReadAddressIndex(address, range.first, range.second, entries)) {
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the address index");
+        }
+        for (const auto& entry : entries) {
+            txids.insert(std::make_pair(entry.first.blockHeight, entry.first.txhash));
+        }
+    }
+
+    Array result;
+    for (const auto& heightAndTxid : txids) {
+        result.push_back(heightAndTxid.second.GetHex());
+    }
+    return result;
+}
+
+Value getaddressbalance(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw std::runtime_error(
+            "getaddressbalance <address or [addresses]> ( startheight endheight )\n"
+            "\nReturns the change of the balance of the given addresses in a height range, which is the\n"
+            "balance when the whole chain is included. Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. address        (string or array, required) An address or an array of addresses\n"
+            "2. startheight    (numeric, optional) The lowest block height to include (default: 0)\n"
+            "3. endheight      (numeric, optional) The highest block height to include (default: the "
+            "tip)\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\" : x.xxx,     (numeric) The balance change in " +
+            CURRENCY_UNIT +
+            "\n"
+            "  \"received\" : x.xxx     (numeric) The total of the outputs paid to the addresses in " +
+            CURRENCY_UNIT +
+            ",\n"
+            "                           change outputs included\n"
+            "}\n"
+            "\nExamples:\n"
+            "getaddressbalance \"NRVBLhdjvbh6SuA4y6vWVoGCqVPRzPNfWb\"\n");
+
+    EnsureAddressIndexEnabled();
+
+    const std::vector<CAddressIndexAddress> addresses = AddressIndexAddressesFromParam(params[0]);
+    const std::pair<int, int>               range     = AddressIndexHeightRangeFromParams(params);
+
+    const CTxDB txdb;
+
+    CAmount balance  = 0;
+    CAmount received = 0;
+    for (const CAddressIndexAddress& address : addresses) {
+        std::vector<std::pair<CAddressIndexKey, CAmount>> entries;
+        if (!txdb.ReadAddressIndex(address, range.first, range.second, entries)) {
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the address index");
+        }
+        for (const auto& entry : entries) {
+            balance += entry.second;
+            if (entry.second > 0) {
+                received += entry.second;
+            }
+        }
+    }
+
+    Object result;
+    result.push_back(Pair("balance", ValueFromAmount(balance)));
+    result.push_back(Pair("received", ValueFromAmount(received)));
+    return result;
+}
+
+Value getaddressutxos(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw std::runtime_error(
+            "getaddressutxos <address or [addresses]> ( startheight endheight )\n"
+            "\nReturns the unspent outputs of the given addresses that were created in a height range,\n"
+            "ordered by height. Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. address        (string or array, required) An address or an array of addresses\n"
+            "2. startheight    (numeric, optional) The lowest block height to include (default: 0)\n"
+            "3. endheight      (numeric, optional) The highest block height to include (default: the "
+            "tip)\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\" : \"address\",  (string) The address\n"
+            "    \"txid\" : \"txid\",        (string) The transaction id\n"
+            "    \"vout\" : n,             (numeric) The output index\n"
+            "    \"scriptPubKey\" : \"hex\", (string) The script of the output\n"
+            "    \"amount\" : x.xxx,       (numeric) The value of the output in " +
+            CURRENCY_UNIT +
+            "\n"
+            "    \"height\" : n            (numeric) The height of the block of the output\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            "getaddressutxos \"NRVBLhdjvbh6SuA4y6vWVoGCqVPRzPNfWb\"\n");
+
+    EnsureAddressIndexEnabled();
+
+    const std::vector<CAddressIndexAddress> addresses = AddressIndexAddressesFromParam(params[0]);
+    const std::pair<int, int>               range     = AddressIndexHeightRangeFromParams(params);
+
+    const CTxDB txdb;
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> utxos;
+    for (const CAddressIndexAddress& address : addresses) {
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> entries;
+        if (!txdb.ReadAddressUnspentIndex(address, entries)) {
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the address index");
+        }
+        for (auto& entry : entries) {
+            if (entry.second.blockHeight >= range.first && entry.second.blockHeight <= range.second) {
+                utxos.push_back(std::move(entry));
+            }
+        }
+    }
+    std::stable_sort(utxos.begin(), utxos.end(),
+                     [](const std::pair<CAddressUnspentKey, CAddressUnspentValue>& a,
+                        const std::pair<CAddressUnspentKey, CAddressUnspentValue>& b) {
+                         return a.second.blockHeight < b.second.blockHeight;
+                     });
+
+    Array result;
+    for (const auto& utxo : utxos) {
+        Object entry;
+        entry.push_back(Pair("address", utxo.first.address.ToBitcoinAddress().ToString()));
+        entry.push_back(Pair("txid", utxo.first.txhash.GetHex()));
+        entry.push_back(Pair("vout", static_cast<int64_t>(utxo.first.index)));
+        entry.push_back(Pair("scriptPubKey", HexStr(utxo.second.scriptPubKey.begin(),
+                                                    utxo.second.scriptPubKey.end())));
+        entry.push_back(Pair("amount", ValueFromAmount(utxo.second.nValue)));
+        entry.push_back(Pair("height", utxo.second.blockHeight));
+        result.push_back(entry);
+    }
+    return result;
+}
+
+static void EnsureNTP1IndexEnabled()
+{
+    if (!fNTP1Index) {
+        throw JSONRPCError(RPC_MISC_ERROR,
+                           "The NTP1 token index is not enabled; restart with -ntp1index to build it");
+    }
+    if (fNTP1IndexNeedsResync) {
+        throw JSONRPCError(RPC_MISC_ERROR,
+                           "The NTP1 token index is out of date; restart to rebuild it");
+    }
+}
+
+static std::size_t NTP1IndexCountFromParam(const Array& params, std::size_t index)
+{
+    static const int DEFAULT_COUNT = 100;
+    static const int MAX_COUNT     = 10000;
+
+    int count = DEFAULT_COUNT;
+    if (params.size() > index && params[index].type() != Value_type::null_type) {
+        count = params[index].get_int();
+    }
+    if (count <= 0 || count > MAX_COUNT) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           "The count must be between 1 and " + std::to_string(MAX_COUNT));
+    }
+    return static_cast<std::size_t>(count);
+}
+
+Value getntp1tokenholders(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw std::runtime_error(
+            "getntp1tokenholders <tokenid> ( count cursor )\n"
+            "\nReturns the addresses that hold the given NTP1 token and their balances, ordered by\n"
+            "address. Requires -ntp1index.\n"
+            "\nArguments:\n"
+            "1. tokenid        (string, required) The id of the token\n"
+            "2. count          (numeric, optional) The maximum number of holders to return (default: "
+            "100)\n"
+            "3. cursor         (string, optional) The \"next\" value of the previous call, to continue "
+            "from\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"holders\" : [\n"
+            "    {\n"
+            "      \"address\" : \"address\", (string) The address\n"
+            "      \"balance\" : \"n\"        (string) The amount of the token held by the address\n"
+            "    }\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"next\" : \"cursor\"        (string) The cursor of the next page; absent on the last "
+            "page\n"
+            "}\n"
+            "\nExamples:\n"
+            "getntp1tokenholders \"La77KcJTUj991FnvxNKhrCD1ER8S81T3LgECS6\" 50\n");
+
+    EnsureNTP1IndexEnabled();
+
+    const std::string tokenId = params[0].get_str();
+    const std::size_t count   = NTP1IndexCountFromParam(params, 1);
+    std::string       cursor;
+    if (params.size() > 2 && params[2].type() != Value_type::null_type) {
+        cursor = params[2].get_str();
+    }
+
+    const CTxDB txdb;
+
+    // one more than requested, whose address is where the next page starts
+    std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>> entries;
+    if (!txdb.ReadNTP1TokenHolders(tokenId, cursor, count + 1, entries)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the NTP1 token index");
+    }
+
+    Array holders;
+    for (std::size_t i = 0; i < entries.size() && i < count; i++) {
+        Object holder;
+        holder.push_back(Pair("address", entries[i].first.address));
+        holder.push_back(Pair("balance", entries[i].second.balance.convert_to<std::string>()));
+        holders.push_back(holder);
+    }
+
+    Object result;
+    result.push_back(Pair("holders", holders));
+    if (entries.size() > count) {
+        result.push_back(Pair("next", entries.back().first.address));
+    }
+    return result;
+}
+
+Value getntp1tokensupply(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getntp1tokensupply <tokenid>\n"
+            "\nReturns the circulating supply of the given NTP1 token, which is what the holders have\n"
+            "after the burns. Requires -ntp1index.\n"
+            "\nArguments:\n"
+            "1. tokenid        (string, required) The id of the token\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"tokenid\" : \"id\",  (string) The id of the token\n"
+            "  \"supply\" : \"n\",    (string) The sum of the balances of all holders\n"
+            "  \"holders\" : n      (numeric) The number of addresses holding the token\n"
+            "}\n"
+            "\nExamples:\n"
+            "getntp1tokensupply \"La77KcJTUj991FnvxNKhrCD1ER8S81T3LgECS6\"\n");
+
+    EnsureNTP1IndexEnabled();
+
+    const std::string tokenId = params[0].get_str();
+
+    const CTxDB txdb;
+
+    std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>> entries;
+    if (!txdb.ReadNTP1TokenHolders(tokenId, "", 0, entries)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the NTP1 token index");
+    }
+
+    NTP1Int supply = 0;
+    for (const auto& entry : entries) {
+        supply += entry.second.balance;
+    }
+
+    Object result;
+    result.push_back(Pair("tokenid", tokenId));
+    result.push_back(Pair("supply", supply.convert_to<std::string>()));
+    result.push_back(Pair("holders", static_cast<int64_t>(entries.size())));
+    return result;
+}
+
+Value getntp1tokentransfers(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 5)
+        throw std::runtime_error(
+            "getntp1tokentransfers <tokenid> ( startheight endheight count cursor )\n"
+            "\nReturns the outputs that received the given NTP1 token and the inputs that spent them,\n"
+            "ordered by height. Requires -ntp1index.\n"
+            "\nArguments:\n"
+            "1. tokenid        (string, required) The id of the token\n"
+            "2. startheight    (numeric, optional) The lowest block height to include (default: 0)\n"
+            "3. endheight      (numeric, optional) The highest block height to include (default: the "
+            "tip)\n"
+            "4. count          (numeric, optional) The maximum number of transfers to return "
+            "(default: 100)\n"
+            "5. cursor         (string, optional) The \"next\" value of the previous call, to continue "
+            "from\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"transfers\" : [\n"
+            "    {\n"
+            "      \"txid\" : \"txid\",       (string) The transaction id\n"
+            "      \"height\" : n,          (numeric) The height of the block of the transaction\n"
+            "      \"index\" : n,           (numeric) The output index, or the input index if spending\n"
+            "      \"spending\" : true|false, (boolean) Whether the token left the address\n"
+            "      \"address\" : \"address\", (string) The address that received or spent the token\n"
+            "      \"amount\" : \"n\"         (string) The amount of the token\n"
+            "    }\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"next\" : \"cursor\"        (string) The cursor of the next page; absent on the last "
+            "page\n"
+            "}\n"
+            "\nExamples:\n"
+            "getntp1tokentransfers \"La77KcJTUj991FnvxNKhrCD1ER8S81T3LgECS6\" 100000 110000\n");
+
+    EnsureNTP1IndexEnabled();
+
+    const std::string tokenId = params[0].get_str();
+    int               startHeight = 0;
+    int               endHeight   = std::numeric_limits<int>::max();
+    if (params.size() > 1 && params[1].type() != Value_type::null_type) {
+        startHeight = params[1].get_int();
+    }
+    if (params.size() > 2 && params[2].type() != Value_type::null_type) {
+        endHeight = params[2].get_int();
+    }
+    if (startHeight < 0 || endHeight < startHeight) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+    }
+    const std::size_t count = NTP1IndexCountFromParam(params, 3);
+
+    CNTP1TokenTransferKey keyBegin(tokenId, startHeight, uint256(0), 0, false);
+    CNTP1TokenTransferKey keyEnd(tokenId, 0, uint256(0), 0, false);
+    keyEnd.blockHeight = static_cast<uint32_t>(endHeight) + 1;
+
+    // the cursor is the serialized key where the next page starts
+    if (params.size() > 4 && params[4].type() != Value_type::null_type) {
+        const std::vector<unsigned char> cursor = ParseHex(params[4].get_str());
+        try {
+            CDataStream ss(cursor, SER_DISK, CLIENT_VERSION);
+            ss >> keyBegin;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        if (keyBegin.tokenId != tokenId) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "The cursor is of a different token");
+        }
+    }
+
+    const CTxDB txdb;
+
+    std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>> entries;
+    if (!txdb.ReadNTP1TokenTransfers(keyBegin, keyEnd, count + 1, entries)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the NTP1 token index");
+    }
+
+    Array transfers;
+    for (std::size_t i = 0; i < entries.size() && i < count; i++) {
+        const CNTP1TokenTransferKey&   key   = entries[i].first;
+        const CNTP1TokenTransferValue& value = entries[i].second;
+
+        Object transfer;
+        transfer.push_back(Pair("txid", key.txhash.GetHex()));
+        transfer.push_back(Pair("height", static_cast<int64_t>(key.blockHeight)));
+        transfer.push_back(Pair("index", static_cast<int64_t>(key.index)));
+        transfer.push_back(Pair("spending", key.spending));
+        transfer.push_back(Pair("address", value.address));
+        transfer.push_back(Pair("amount", value.amount.convert_to<std::string>()));
+        transfers.push_back(transfer);
+    }
+
+    Object result;
+    result.push_back(Pair("transfers", transfers));
+    if (entries.size() > count) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << entries.back().first;
+        result.push_back(Pair("next", HexStr(ss.begin(), ss.end())));
+    }
+    return result;
+}
+
+Value getntp1cacheinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+            "getntp1cacheinfo\n"
+            "\nReturns the statistics of the NTP1 token metadata and icon cache since startup.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"directory\" : \"path\",    (string) Where the cache is stored\n"
+            "  \"metadatahits\" : n,      (numeric) Metadata lookups served from the cache\n"
+            "  \"metadatamisses\" : n,    (numeric) Metadata lookups that had to decode the issuance\n"
+            "  \"iconhits\" : n,          (numeric) Icon lookups served from the cache\n"
+            "  \"iconmisses\" : n,        (numeric) Icon lookups that had to download the icon\n"
+            "  \"writes\" : n,            (numeric) Files written to the cache\n"
+            "  \"writefailures\" : n      (numeric) Files that failed to be written\n"
+            "}\n"
+            "\nExamples:\n"
+            "getntp1cacheinfo\n");
+
+    const NTP1MetadataCache::Stats stats = ntp1MetadataCache.getStats();
+
+    Object result;
+    result.push_back(Pair("directory", ntp1MetadataCache.getCacheDir().string()));
+    result.push_back(Pair("metadatahits", static_cast<int64_t>(stats.metadataHits)));
+    result.push_back(Pair("metadatamisses", static_cast<int64_t>(stats.metadataMisses)));
+    result.push_back(Pair("iconhits", static_cast<int64_t>(stats.iconHits)));
+    result.push_back(Pair("iconmisses", static_cast<int64_t>(stats.iconMisses)));
+    result.push_back(Pair("writes", static_cast<int64_t>(stats.writes)));
+    result.push_back(Pair("writefailures", static_cast<int64_t>(stats.writeFailures)));
+    return result;
+}
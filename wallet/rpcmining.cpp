@@ -3,11 +3,13 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "arith_uint256.h"
 #include "bitcoinrpc.h"
 #include "db.h"
 #include "init.h"
 #include "main.h"
 #include "miner.h"
+#include "runtimeconfig.h"
 #include "script.h"
 #include "txdb.h"
 #include "txmempool.h"
@@ -95,7 +97,7 @@ Value getstakinginfo(const Array& params, bool fHelp)
     const std::size_t stakableCoinsCount = [&]() {
         std::vector<COutput> vCoins;
         bool                 fIncludeColdStaking =
-            Params().IsColdStakingEnabled(txdb) && GetBoolArg("-coldstaking", true);
+            Params().IsColdStakingEnabled(txdb) && GetRuntimeConfig().fColdStaking;
         pwalletMain->AvailableCoinsForStaking(txdb, vCoins, GetAdjustedTime(), fIncludeColdStaking,
                                               false);
         return vCoins.size();
@@ -108,7 +110,7 @@ Value getstakinginfo(const Array& params, bool fHelp)
 
     Object obj;
 
-    obj.push_back(Pair("enabled", GetBoolArg("-staking", true)));
+    obj.push_back(Pair("enabled", GetRuntimeConfig().fStaking));
     obj.push_back(Pair("staking", staking));
     obj.push_back(Pair("staking-criteria", stakingCriteria));
     obj.push_back(Pair("errors", GetWarnings("statusbar")));
@@ -197,7 +199,7 @@ Value getworkex(const Array& params, bool fHelp)
         char phash1[64];
         FormatHashBuffers(pblock, pmidstate, pdata, phash1);
 
-        uint256 hashTarget = CBigNum().SetCompact(pblock->nBits).getuint256();
+        uint256 hashTarget = ArithToUint256(arith_uint256().SetCompact(pblock->nBits));
 
         CTransaction         coinbaseTx = pblock->vtx[0];
         std::vector<uint256> merkle     = pblock->GetMerkleBranch(0);
@@ -336,7 +338,7 @@ Value getwork(const Array& params, bool fHelp)
         char phash1[64];
         FormatHashBuffers(pblock, pmidstate, pdata, phash1);
 
-        uint256 hashTarget = CBigNum().SetCompact(pblock->nBits).getuint256();
+        uint256 hashTarget = ArithToUint256(arith_uint256().SetCompact(pblock->nBits));
 
         Object result;
         result.push_back(Pair("midstate", HexStr(BEGIN(pmidstate), END(pmidstate)))); // deprecated
@@ -496,7 +498,7 @@ Value getblocktemplate(const Array& params, bool fHelp)
     Object aux;
     aux.push_back(Pair("flags", HexStr(COINBASE_FLAGS.begin(), COINBASE_FLAGS.end())));
 
-    uint256 hashTarget = CBigNum().SetCompact(pblock->nBits).getuint256();
+    uint256 hashTarget = ArithToUint256(arith_uint256().SetCompact(pblock->nBits));
 
     static Array aMutable;
     if (aMutable.empty()) {
@@ -260,8 +260,6 @@ Value getrawtransaction(const Array& params, bool fHelp)
                             "data from the database. This won't work if the transaction is not in the "
                             "blockchain.");
 
-    LOCK(cs_main);
-
     uint256                      hash            = ParseHashV(params[0], "parameter 1");
     bool                         in_active_chain = true;
     boost::optional<CBlockIndex> blockindex;
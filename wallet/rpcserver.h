@@ -0,0 +1,135 @@
+#ifndef RPCSERVER_H
+#define RPCSERVER_H
+
+#include "json/json_spirit_value.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** Default for -rpcservertimeout, the seconds a client has to send a request */
+static const int DEFAULT_RPC_SERVER_TIMEOUT = 30;
+
+class AcceptedConnection
+{
+public:
+    using ReadableHandler = std::function<void(const boost::system::error_code&)>;
+
+    virtual ~AcceptedConnection() {}
+
+    virtual std::iostream& stream()                       = 0;
+    virtual std::string    peer_address_to_string() const = 0;
+    virtual void           close()                        = 0;
+
+    // Reads from the connection fail once the deadline (in GetTimeMillis() time) passed; 0 means no
+    // deadline
+    virtual void set_read_deadline(int64_t nDeadlineMillis) = 0;
+
+    // Calls handler from the I/O service once the client sent more data (or went away), so that a
+    // connection that has no request yet doesn't hold on to a worker thread. If nothing arrives
+    // within the timeout, the handler gets operation_aborted.
+    virtual void async_wait_readable(int64_t nTimeoutSeconds, ReadableHandler handler) = 0;
+};
+
+/**
+ * Connections that have a request waiting to be served, shared by the RPC worker threads. The queue
+ * is bounded; when it's full, new requests are turned away with 503 instead of piling up.
+ */
+class RPCWorkQueue
+{
+    mutable std::mutex                                mtx;
+    std::condition_variable                           cond;
+    std::deque<boost::shared_ptr<AcceptedConnection>> queue;
+    const std::size_t                                 nMaxDepth;
+    bool                                              fInterrupted = false;
+    uint64_t                                          nRejected    = 0;
+
+public:
+    explicit RPCWorkQueue(std::size_t maxDepth) : nMaxDepth(maxDepth) {}
+
+    bool Enqueue(const boost::shared_ptr<AcceptedConnection>& conn);
+
+    // blocks until there's a connection to serve; returns false when the workers should exit
+    bool Dequeue(boost::shared_ptr<AcceptedConnection>& conn);
+
+    void Interrupt();
+
+    json_spirit::Object ToJSON() const;
+};
+
+/**
+ * Threads that help execute the elements of batch requests in parallel. The thread serving the
+ * batch works through it as well, so a batch never waits for the pool to become free.
+ */
+class RPCBatchPool
+{
+    std::mutex                        mtx;
+    std::condition_variable           cond;
+    std::deque<std::function<void()>> tasks;
+    bool                              fInterrupted = false;
+
+    bool Pop(std::function<void()>& task);
+
+public:
+    void Post(std::function<void()> task);
+
+    void Interrupt();
+
+    static void ThreadRPCBatch(std::shared_ptr<RPCBatchPool> pool);
+};
+
+/** Executes one element of a batch request and returns its reply object */
+json_spirit::Object JSONRPCExecOne(const json_spirit::Value& req);
+
+/** A batch request whose elements are executed by several threads at once */
+struct RPCBatchState
+{
+    const json_spirit::Array&        vReq;
+    std::vector<json_spirit::Object> vResults;
+    std::atomic<size_t>              nNext{0};
+    std::size_t                      nDone = 0;
+    std::mutex                       mtx;
+    std::condition_variable          cond;
+
+    explicit RPCBatchState(const json_spirit::Array& vReqIn) : vReq(vReqIn), vResults(vReqIn.size())
+    {
+    }
+
+    // executes elements of the batch until there are none left to take
+    void Work();
+};
+
+/**
+ * Executes a batch request and returns the serialized array of replies, in the order of the
+ * requests. Batches of read-only calls are spread over nConcurrency threads of the pool.
+ */
+std::string JSONRPCExecBatch(const json_spirit::Array&            vReq,
+                             const std::shared_ptr<RPCBatchPool>& batchPool, int nConcurrency);
+
+/** Sets the credentials that clients have to send, from -rpcuser/-rpcpassword or a cookie */
+bool InitRPCAuthentication();
+
+/**
+ * Reads one request from the connection, executes it and sends the reply.
+ * Returns whether the connection should be kept open for further requests.
+ */
+bool ServeRPCRequest(AcceptedConnection& conn);
+
+/** Hands the connection to the worker threads, or replies 503 and closes it if the queue is full */
+void RPCEnqueueConnection(const std::shared_ptr<RPCWorkQueue>&         workQueue,
+                          const boost::shared_ptr<AcceptedConnection>& conn);
+
+/** Serves the connections of the queue until it's interrupted */
+void ThreadRPCWorker(std::shared_ptr<RPCWorkQueue> workQueue);
+
+#endif // RPCSERVER_H
@@ -1335,29 +1335,22 @@ Value getntp1balances(const Array& params, bool fHelp)
     if (fHelp || params.size() > 1)
         throw runtime_error("getntp1balances [minconf=1]\n");
 
-    boost::shared_ptr<NTP1Wallet> ntp1wallet = boost::make_shared<NTP1Wallet>();
-
     int nMinDepth = 0;
     if (params.size() > 0)
         nMinDepth = params[0].get_int();
 
-    ntp1wallet->setRetrieveFullMetadata(false);
-    ntp1wallet->setMinMaxConfirmations(nMinDepth);
-    ntp1wallet->update();
-
-    int tokenCount = ntp1wallet->getNumberOfTokens();
+    const std::map<std::string, CNTP1TokenBalance> balances =
+        pwalletMain->GetNTP1Balances(CTxDB(), nMinDepth);
 
     json_spirit::Object root;
 
-    for (int i = 0; i < tokenCount; i++) {
-        std::string tokenId   = ntp1wallet->getTokenID(i);
-        std::string tokenName = ntp1wallet->getTokenName(tokenId);
-        NTP1Int     balance   = ntp1wallet->getTokenBalance(tokenId);
+    for (const auto& p : balances) {
+        const std::string& tokenId = p.first;
 
         json_spirit::Object tokenJsonData;
-        tokenJsonData.push_back(json_spirit::Pair("Name", tokenName));
+        tokenJsonData.push_back(json_spirit::Pair("Name", p.second.tokenSymbol));
         tokenJsonData.push_back(json_spirit::Pair("TokenId", tokenId));
-        tokenJsonData.push_back(json_spirit::Pair("Balance", ToString(balance)));
+        tokenJsonData.push_back(json_spirit::Pair("Balance", ToString(p.second.balance)));
 
         root.push_back(json_spirit::Pair(tokenId, tokenJsonData));
     }
@@ -1370,8 +1363,6 @@ Value getntp1balance(const Array& params, bool fHelp)
     if (fHelp || params.size() > 2)
         throw runtime_error("getntp1balance <tokenId/name> [minconf=1]\n");
 
-    boost::shared_ptr<NTP1Wallet> ntp1wallet = boost::make_shared<NTP1Wallet>();
-
     int    nMinDepth = 0;
     string requestedToken;
     string requestedTokenLowerCase;
@@ -1383,25 +1374,20 @@ Value getntp1balance(const Array& params, bool fHelp)
     std::transform(requestedToken.cbegin(), requestedToken.cend(),
                    std::back_inserter(requestedTokenLowerCase), ::tolower);
 
-    ntp1wallet->setRetrieveFullMetadata(false);
-    ntp1wallet->setMinMaxConfirmations(nMinDepth);
-    ntp1wallet->update();
-
-    int tokenCount = ntp1wallet->getNumberOfTokens();
+    const std::map<std::string, CNTP1TokenBalance> balances =
+        pwalletMain->GetNTP1Balances(CTxDB(), nMinDepth);
 
     json_spirit::Object root;
 
-    for (int i = 0; i < tokenCount; i++) {
-        std::string tokenId   = ntp1wallet->getTokenID(i);
-        std::string tokenName = ntp1wallet->getTokenName(tokenId);
+    for (const auto& p : balances) {
+        const std::string& tokenId   = p.first;
+        std::string        tokenName = p.second.tokenSymbol;
         std::transform(tokenName.begin(), tokenName.end(), tokenName.begin(), ::tolower);
         if (tokenId != requestedToken && tokenName != requestedTokenLowerCase) {
             continue;
         }
 
-        NTP1Int balance = ntp1wallet->getTokenBalance(tokenId);
-
-        return json_spirit::Value(ToString(balance));
+        return json_spirit::Value(ToString(p.second.balance));
     }
 
     return json_spirit::Value(root);
@@ -1988,13 +1974,13 @@ Value listtransactions(const Array& params, bool fHelp)
 
     Array ret;
 
-    std::list<CAccountingEntry> acentries;
-    CWallet::TxItems            txOrdered = pwalletMain->OrderedTxItems(acentries, strAccount);
+    const CWallet::TxItems& txOrdered = pwalletMain->wtxOrdered;
 
     const CTxDB txdb;
 
     // iterate backwards until we have nCount items to return:
-    for (CWallet::TxItems::reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it) {
+    for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend();
+         ++it) {
         CWalletTx* const pwtx = (*it).second.first;
         if (pwtx != 0)
             ListTransactions(txdb, *pwtx, strAccount, 0, true, filter, ret);
@@ -2143,12 +2129,10 @@ Value listsinceblock(const Array& params, bool fHelp)
 
     const uint256 bestBlockHash = txdb.GetBestBlockHash();
 
-    for (map<uint256, CWalletTx>::iterator it = pwalletMain->mapWallet.begin();
-         it != pwalletMain->mapWallet.end(); it++) {
-        CWalletTx tx = (*it).second;
-
-        if (depth == -1 || tx.GetDepthInMainChain(txdb, bestBlockHash) < depth)
-            ListTransactions(txdb, tx, "*", 0, true, filter, transactions);
+    for (const CWalletTx* pwtx :
+         pwalletMain->GetWalletTxsSinceHeight(txdb, index ? index->nHeight : -1)) {
+        if (depth == -1 || pwtx->GetDepthInMainChain(txdb, bestBlockHash) < depth)
+            ListTransactions(txdb, *pwtx, "*", 0, true, filter, transactions);
     }
 
     bool includeRemoved = true;
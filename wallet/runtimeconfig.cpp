@@ -0,0 +1,82 @@
+#include "runtimeconfig.h"
+
+#include "blockencodings.h"
+#include "globals.h"
+#include "util.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+static std::atomic<const CRuntimeConfig*> currentRuntimeConfig{nullptr};
+
+// every configuration ever published, so that the references handed out never dangle
+static std::mutex                                         runtimeConfigsMutex;
+static std::vector<std::unique_ptr<const CRuntimeConfig>> runtimeConfigs;
+
+CRuntimeConfig::CRuntimeConfig()
+    : nMaxOrphanTx(DEFAULT_MAX_ORPHAN_TRANSACTIONS), fCompactBlocks(DEFAULT_COMPACT_BLOCKS)
+{
+}
+
+static boost::optional<int64_t> GetOptionalArg(const std::string& strArg)
+{
+    const boost::optional<std::string> value = mapArgs.get(strArg);
+    if (!value)
+        return boost::none;
+    return atoi64(*value);
+}
+
+CRuntimeConfig CRuntimeConfig::FromArgs()
+{
+    CRuntimeConfig result;
+
+    result.nMaxSigCacheSize = GetArg("-maxsigcachesize", result.nMaxSigCacheSize);
+
+    result.nBlockVersion      = GetOptionalArg("-blockversion");
+    result.nBlockMaxSize      = GetOptionalArg("-blockmaxsize");
+    result.nBlockPrioritySize = GetArg("-blockprioritysize", result.nBlockPrioritySize);
+    result.nBlockMinSize      = GetArg("-blockminsize", result.nBlockMinSize);
+
+    result.nBanScore         = GetArg("-banscore", result.nBanScore);
+    result.nBanTime          = GetArg("-bantime", result.nBanTime);
+    result.nMaxConnections   = GetArg("-maxconnections", result.nMaxConnections);
+    result.nMaxReceiveBuffer = GetArg("-maxreceivebuffer", result.nMaxReceiveBuffer);
+    result.nMaxSendBuffer    = GetArg("-maxsendbuffer", result.nMaxSendBuffer);
+
+    result.nLimitFreeRelay = GetArg("-limitfreerelay", result.nLimitFreeRelay);
+    result.nMaxOrphanTx    = GetArg("-maxorphantx", result.nMaxOrphanTx);
+    result.fSyncTime       = GetBoolArg("-synctime", result.fSyncTime);
+    result.fCompactBlocks  = GetBoolArg("-compactblocks", result.fCompactBlocks);
+    result.fTestSafeMode   = GetBoolArg("-testsafemode", result.fTestSafeMode);
+    result.fHeadersFirst   = GetBoolArg("-headersfirst", result.fHeadersFirst);
+
+    result.fDisableSafeMode = GetBoolArg("-disablesafemode", result.fDisableSafeMode);
+
+    result.fStaking            = GetBoolArg("-staking", result.fStaking);
+    result.fColdStaking        = GetBoolArg("-coldstaking", result.fColdStaking);
+    result.fPrintStakeModifier = GetBoolArg("-printstakemodifier", result.fPrintStakeModifier);
+
+    return result;
+}
+
+const CRuntimeConfig& GetRuntimeConfig()
+{
+    const CRuntimeConfig* config = currentRuntimeConfig.load(std::memory_order_acquire);
+    if (config == nullptr) {
+        static const CRuntimeConfig defaults;
+        return defaults;
+    }
+    return *config;
+}
+
+void ReloadRuntimeConfig()
+{
+    std::unique_ptr<const CRuntimeConfig> config =
+        MakeUnique<const CRuntimeConfig>(CRuntimeConfig::FromArgs());
+
+    std::lock_guard<std::mutex> lock(runtimeConfigsMutex);
+    currentRuntimeConfig.store(config.get(), std::memory_order_release);
+    runtimeConfigs.push_back(std::move(config));
+}
@@ -0,0 +1,68 @@
+#ifndef RUNTIMECONFIG_H
+#define RUNTIMECONFIG_H
+
+#include <boost/optional.hpp>
+#include <cstdint>
+
+/**
+ * The options read on hot paths, like the message handlers, the RPC dispatcher, the signature
+ * cache and the miner, parsed from mapArgs once instead of on every use. GetArg() takes the lock of
+ * mapArgs and parses the string every time, which shows up when many threads do it.
+ *
+ * The fields have the values GetArg() and GetBoolArg() would return; any sanitizing of them is left
+ * where they're used, as before.
+ */
+struct CRuntimeConfig
+{
+    // script.cpp
+    int64_t nMaxSigCacheSize = 50000;
+
+    // miner.cpp; the defaults of -blockversion and -blockmaxsize depend on the block
+    boost::optional<int64_t> nBlockVersion;
+    boost::optional<int64_t> nBlockMaxSize;
+    int64_t                  nBlockPrioritySize = 27000;
+    int64_t                  nBlockMinSize      = 0;
+
+    // net.cpp, net.h
+    int64_t nBanScore         = 100;
+    int64_t nBanTime          = 60 * 60 * 24;
+    int64_t nMaxConnections   = 125;
+    int64_t nMaxReceiveBuffer = 5 * 1000;
+    int64_t nMaxSendBuffer    = 1 * 1000;
+
+    // main.cpp
+    int64_t nLimitFreeRelay = 15;
+    int64_t nMaxOrphanTx;
+    bool    fSyncTime = true;
+    bool    fCompactBlocks;
+    bool    fTestSafeMode = false;
+    bool    fHeadersFirst = true;
+
+    // bitcoinrpc.cpp
+    bool fDisableSafeMode = false;
+
+    // staking
+    bool fStaking            = true;
+    bool fColdStaking        = true;
+    bool fPrintStakeModifier = false;
+
+    CRuntimeConfig();
+
+    static CRuntimeConfig FromArgs();
+};
+
+/**
+ * The current configuration. It's read with a single atomic load, and stays valid for the life of
+ * the process, so it can be kept for the length of an operation. Until ReloadRuntimeConfig() is
+ * called, it has the defaults.
+ */
+const CRuntimeConfig& GetRuntimeConfig();
+
+/**
+ * Parses mapArgs and publishes the result to GetRuntimeConfig(). Called once the parameters are
+ * final on startup, and again if mapArgs changes after that. The previous configurations are kept,
+ * as readers may still hold them, which is fine as long as reloads are rare.
+ */
+void ReloadRuntimeConfig();
+
+#endif // RUNTIMECONFIG_H
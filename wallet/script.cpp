@@ -14,6 +14,7 @@ using namespace boost;
 #include "key.h"
 #include "keystore.h"
 #include "main.h"
+#include "runtimeconfig.h"
 #include "script.h"
 #include "sync.h"
 #include "util.h"
@@ -1296,7 +1297,7 @@ public:
         // (~200 bytes per cache entry times 50,000 entries)
         // Since there are a maximum of 20,000 signature operations per block
         // 50,000 is a reasonable default.
-        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
+        const int64_t nMaxCacheSize = GetRuntimeConfig().nMaxSigCacheSize;
         if (nMaxCacheSize <= 0)
             return;
 
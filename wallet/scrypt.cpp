@@ -29,6 +29,8 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <algorithm>
+#include <memory>
 
 #include "scrypt.h"
 #include "pbkdf2.h"
@@ -196,3 +198,252 @@ uint256 scrypt_blockhash(const void* input)
     return scrypt_nosalt(input, 80, scratchpad);
 }
 
+
+/*
+ * Batch hashing of block headers. The batch kernels run one scrypt per SIMD lane: word k of the
+ * state of every lane lives in the same vector, so the salsa20/8 rounds of all the lanes are the
+ * same instructions. The scratchpad interleaves the lanes the same way, word k of iteration i of
+ * lane l is at V[(i * 32 + k) * lanes + l].
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCRYPT_BATCH_X86
+#include <immintrin.h>
+#define SCRYPT_TARGET_SSE2 __attribute__((target("sse2")))
+#define SCRYPT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#define SCRYPT_MAX_LANES 8
+
+/* the scratchpads of the lanes, kept per thread, as they take up to 1 MiB */
+static uint32_t* batch_scratchpad(size_t lanes)
+{
+    static thread_local std::unique_ptr<unsigned char[]> buffer;
+    static thread_local size_t bufferLanes = 0;
+    if (bufferLanes < lanes) {
+        buffer.reset(new unsigned char[lanes * 131072 + 63]);
+        bufferLanes = lanes;
+    }
+    return (uint32_t *)(((uintptr_t)(buffer.get()) + 63) & ~ (uintptr_t)(63));
+}
+
+#ifdef SCRYPT_BATCH_X86
+
+/* the quarter round of salsa20 on the words a, b, c, d of all the lanes */
+#define SALSA_QR(x, a, b, c, d, ADD, XOR, ROTL) \
+    x[b] = XOR(x[b], ROTL(ADD(x[a], x[d]), 7)); \
+    x[c] = XOR(x[c], ROTL(ADD(x[b], x[a]), 9)); \
+    x[d] = XOR(x[d], ROTL(ADD(x[c], x[b]), 13)); \
+    x[a] = XOR(x[a], ROTL(ADD(x[d], x[c]), 18));
+
+/* xor_salsa8() above, on vectors of lanes */
+#define XOR_SALSA8_LANES(VEC, B, Bx, ADD, XOR, ROTL) \
+    { \
+        VEC x[16]; \
+        for (int k = 0; k < 16; k++) \
+            x[k] = B[k] = XOR(B[k], Bx[k]); \
+        for (int i = 0; i < 8; i += 2) { \
+            /* Operate on columns. */ \
+            SALSA_QR(x, 0, 4, 8, 12, ADD, XOR, ROTL) \
+            SALSA_QR(x, 5, 9, 13, 1, ADD, XOR, ROTL) \
+            SALSA_QR(x, 10, 14, 2, 6, ADD, XOR, ROTL) \
+            SALSA_QR(x, 15, 3, 7, 11, ADD, XOR, ROTL) \
+            /* Operate on rows. */ \
+            SALSA_QR(x, 0, 1, 2, 3, ADD, XOR, ROTL) \
+            SALSA_QR(x, 5, 6, 7, 4, ADD, XOR, ROTL) \
+            SALSA_QR(x, 10, 11, 8, 9, ADD, XOR, ROTL) \
+            SALSA_QR(x, 15, 12, 13, 14, ADD, XOR, ROTL) \
+        } \
+        for (int k = 0; k < 16; k++) \
+            B[k] = ADD(B[k], x[k]); \
+    }
+
+#define ROTL_SSE2(a, b) _mm_or_si128(_mm_slli_epi32((a), (b)), _mm_srli_epi32((a), 32 - (b)))
+#define ROTL_AVX2(a, b) _mm256_or_si256(_mm256_slli_epi32((a), (b)), _mm256_srli_epi32((a), 32 - (b)))
+
+SCRYPT_TARGET_SSE2 static inline void xor_salsa8_sse2(__m128i B[16], const __m128i Bx[16])
+{
+    XOR_SALSA8_LANES(__m128i, B, Bx, _mm_add_epi32, _mm_xor_si128, ROTL_SSE2)
+}
+
+SCRYPT_TARGET_AVX2 static inline void xor_salsa8_avx2(__m256i B[16], const __m256i Bx[16])
+{
+    XOR_SALSA8_LANES(__m256i, B, Bx, _mm256_add_epi32, _mm256_xor_si256, ROTL_AVX2)
+}
+
+/* scrypt_core() of 4 lanes */
+SCRYPT_TARGET_SSE2 static void scrypt_core_sse2(uint32_t X[][32], uint32_t *V)
+{
+    __m128i S[32];
+    __m128i *Vv = (__m128i *)V;
+    unsigned int i, k, l;
+
+    for (k = 0; k < 32; k++)
+        S[k] = _mm_set_epi32(X[3][k], X[2][k], X[1][k], X[0][k]);
+
+    for (i = 0; i < 1024; i++) {
+        for (k = 0; k < 32; k++)
+            _mm_store_si128(&Vv[i * 32 + k], S[k]);
+        xor_salsa8_sse2(&S[0], &S[16]);
+        xor_salsa8_sse2(&S[16], &S[0]);
+    }
+    for (i = 0; i < 1024; i++) {
+        uint32_t j[4];
+        _mm_storeu_si128((__m128i *)j, S[16]);
+        for (l = 0; l < 4; l++)
+            j[l] = (j[l] & 1023) * 32 * 4 + l;
+        for (k = 0; k < 32; k++)
+            S[k] = _mm_xor_si128(S[k], _mm_set_epi32(V[j[3] + k * 4], V[j[2] + k * 4],
+                                                     V[j[1] + k * 4], V[j[0] + k * 4]));
+        xor_salsa8_sse2(&S[0], &S[16]);
+        xor_salsa8_sse2(&S[16], &S[0]);
+    }
+
+    for (k = 0; k < 32; k++) {
+        uint32_t w[4];
+        _mm_storeu_si128((__m128i *)w, S[k]);
+        for (l = 0; l < 4; l++)
+            X[l][k] = w[l];
+    }
+}
+
+/* scrypt_core() of 8 lanes; the lanes read the scratchpad at different offsets with a gather */
+SCRYPT_TARGET_AVX2 static void scrypt_core_avx2(uint32_t X[][32], uint32_t *V)
+{
+    __m256i S[32];
+    __m256i *Vv = (__m256i *)V;
+    unsigned int i, k, l;
+
+    for (k = 0; k < 32; k++)
+        S[k] = _mm256_set_epi32(X[7][k], X[6][k], X[5][k], X[4][k], X[3][k], X[2][k], X[1][k], X[0][k]);
+
+    for (i = 0; i < 1024; i++) {
+        for (k = 0; k < 32; k++)
+            _mm256_store_si256(&Vv[i * 32 + k], S[k]);
+        xor_salsa8_avx2(&S[0], &S[16]);
+        xor_salsa8_avx2(&S[16], &S[0]);
+    }
+    const __m256i laneOffsets = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i mask = _mm256_set1_epi32(1023);
+    for (i = 0; i < 1024; i++) {
+        /* (j * 32 + k) * 8 + lane */
+        const __m256i base =
+            _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(S[16], mask), 8), laneOffsets);
+        for (k = 0; k < 32; k++) {
+            const __m256i idx = _mm256_add_epi32(base, _mm256_set1_epi32(k * 8));
+            S[k] = _mm256_xor_si256(S[k], _mm256_i32gather_epi32((const int *)V, idx, 4));
+        }
+        xor_salsa8_avx2(&S[0], &S[16]);
+        xor_salsa8_avx2(&S[16], &S[0]);
+    }
+
+    for (k = 0; k < 32; k++) {
+        uint32_t w[8];
+        _mm256_storeu_si256((__m256i *)w, S[k]);
+        for (l = 0; l < 8; l++)
+            X[l][k] = w[l];
+    }
+}
+
+#endif
+
+bool scrypt_batch_kernel_supported(ScryptBatchKernel kernel)
+{
+    switch (kernel) {
+    case ScryptBatchKernel::Single:
+        return true;
+#ifdef SCRYPT_BATCH_X86
+    case ScryptBatchKernel::SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case ScryptBatchKernel::AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* scrypt_batch_kernel_name(ScryptBatchKernel kernel)
+{
+    switch (kernel) {
+    case ScryptBatchKernel::Single:
+        return "single";
+    case ScryptBatchKernel::SSE2:
+        return "sse2-4way";
+    case ScryptBatchKernel::AVX2:
+        return "avx2-8way";
+    }
+    return "unknown";
+}
+
+ScryptBatchKernel scrypt_best_batch_kernel()
+{
+    static const ScryptBatchKernel best = []() {
+        if (scrypt_batch_kernel_supported(ScryptBatchKernel::AVX2))
+            return ScryptBatchKernel::AVX2;
+        if (scrypt_batch_kernel_supported(ScryptBatchKernel::SSE2))
+            return ScryptBatchKernel::SSE2;
+        return ScryptBatchKernel::Single;
+    }();
+    return best;
+}
+
+/* hashes up to as many headers as the kernel has lanes; the spare lanes repeat the last header */
+static void scrypt_blockhash_lanes(ScryptBatchKernel kernel, const void* const* inputs, uint256* outputs, size_t n)
+{
+    const size_t lanes = static_cast<size_t>(kernel);
+    uint32_t X[SCRYPT_MAX_LANES][32];
+    size_t l;
+
+    for (l = 0; l < n; l++)
+        PBKDF2_SHA256((const uint8_t*)inputs[l], 80, (const uint8_t*)inputs[l], 80, 1, (uint8_t *)X[l], 128);
+    for (; l < lanes; l++)
+        memcpy(X[l], X[n - 1], sizeof(X[l]));
+
+    uint32_t *V = batch_scratchpad(lanes);
+#ifdef SCRYPT_BATCH_X86
+    if (kernel == ScryptBatchKernel::AVX2)
+        scrypt_core_avx2(X, V);
+    else
+        scrypt_core_sse2(X, V);
+#else
+    (void)V;
+    assert(false);
+#endif
+
+    for (l = 0; l < n; l++) {
+        outputs[l] = 0;
+        PBKDF2_SHA256((const uint8_t*)inputs[l], 80, (uint8_t *)X[l], 128, 1, (uint8_t*)&outputs[l], 32);
+    }
+}
+
+void scrypt_blockhash_batch(ScryptBatchKernel kernel, const void* const* inputs, uint256* outputs, size_t n)
+{
+    if (!scrypt_batch_kernel_supported(kernel))
+        kernel = scrypt_best_batch_kernel();
+
+    size_t i = 0;
+    while (i < n) {
+        const size_t left = n - i;
+        // a partly filled kernel still beats hashing the headers one by one, or with narrower kernels
+        if (kernel == ScryptBatchKernel::AVX2 && left > 4) {
+            const size_t count = std::min<size_t>(left, 8);
+            scrypt_blockhash_lanes(ScryptBatchKernel::AVX2, inputs + i, outputs + i, count);
+            i += count;
+        } else if (kernel != ScryptBatchKernel::Single && left > 1) {
+            const size_t count = std::min<size_t>(left, 4);
+            scrypt_blockhash_lanes(ScryptBatchKernel::SSE2, inputs + i, outputs + i, count);
+            i += count;
+        } else {
+            outputs[i] = scrypt_blockhash(inputs[i]);
+            i++;
+        }
+    }
+}
+
+void scrypt_blockhash_batch(const void* const* inputs, uint256* outputs, size_t n)
+{
+    scrypt_blockhash_batch(scrypt_best_batch_kernel(), inputs, outputs, n);
+}
@@ -12,4 +12,22 @@ uint256 scrypt_salted_hash(const void* input, size_t inputlen, const void* salt,
 uint256 scrypt_hash(const void* input, size_t inputlen);
 uint256 scrypt_blockhash(const void* input);
 
+/* the kernels that hash several block headers at once, one header per SIMD lane */
+enum class ScryptBatchKernel
+{
+    Single = 1, // the single-lane scrypt_core
+    SSE2   = 4,
+    AVX2   = 8,
+};
+
+bool        scrypt_batch_kernel_supported(ScryptBatchKernel kernel);
+const char* scrypt_batch_kernel_name(ScryptBatchKernel kernel);
+/* the widest kernel this CPU supports */
+ScryptBatchKernel scrypt_best_batch_kernel();
+
+/* hashes n 80-byte block headers, inputs[i] to outputs[i], with the widest kernel the CPU supports;
+   the scratchpads of the lanes are kept per thread */
+void scrypt_blockhash_batch(const void* const* inputs, uint256* outputs, size_t n);
+void scrypt_blockhash_batch(ScryptBatchKernel kernel, const void* const* inputs, uint256* outputs, size_t n);
+
 #endif // SCRYPT_MINE_H
@@ -390,6 +390,38 @@ public:
 template<typename I>
 CVarInt<I> WrapVarInt(I& n) { return CVarInt<I>(n); }
 
+/**
+ * Serializes a 32-bit unsigned integer in big endian, so that the database, which sorts keys
+ * byte-wise, sorts them by that integer
+ */
+class CBigEndian32
+{
+    uint32_t& n;
+
+public:
+    explicit CBigEndian32(uint32_t& nIn) : n(nIn) {}
+
+    unsigned int GetSerializeSize(int, int = 0) const { return 4; }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int, int = 0) const
+    {
+        const unsigned char buf[4] = {
+            static_cast<unsigned char>(n >> 24), static_cast<unsigned char>(n >> 16),
+            static_cast<unsigned char>(n >> 8), static_cast<unsigned char>(n)};
+        s.write(reinterpret_cast<const char*>(buf), 4);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int, int = 0)
+    {
+        unsigned char buf[4];
+        s.read(reinterpret_cast<char*>(buf), 4);
+        n = (uint32_t(buf[0]) << 24) | (uint32_t(buf[1]) << 16) | (uint32_t(buf[2]) << 8) |
+            uint32_t(buf[3]);
+    }
+};
+
 //
 // Forward declarations
 //
@@ -0,0 +1,539 @@
+#include "sha256.h"
+
+#include <cstring>
+#include <openssl/sha.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SHA256_TARGET_AVX2 __attribute__((target("avx2")))
+#define SHA256_TARGET_SHANI __attribute__((target("sha,sse4.1")))
+#endif
+
+namespace {
+
+uint32_t ReadBE32(const unsigned char* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+void WriteBE32(unsigned char* p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+const uint32_t IV[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+/* the second block of the first hash of a 64-byte blob, which is only padding */
+const unsigned char PaddingD64[64] = {0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                      0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                      0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                      0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0};
+
+namespace generic {
+
+uint32_t Ch(uint32_t x, uint32_t y, uint32_t z) { return z ^ (x & (y ^ z)); }
+uint32_t Maj(uint32_t x, uint32_t y, uint32_t z) { return (x & y) | (z & (x | y)); }
+uint32_t Sigma0(uint32_t x) { return (x >> 2 | x << 30) ^ (x >> 13 | x << 19) ^ (x >> 22 | x << 10); }
+uint32_t Sigma1(uint32_t x) { return (x >> 6 | x << 26) ^ (x >> 11 | x << 21) ^ (x >> 25 | x << 7); }
+uint32_t sigma0(uint32_t x) { return (x >> 7 | x << 25) ^ (x >> 18 | x << 14) ^ (x >> 3); }
+uint32_t sigma1(uint32_t x) { return (x >> 17 | x << 15) ^ (x >> 19 | x << 13) ^ (x >> 10); }
+
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    while (blocks--) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++)
+            w[i] = ReadBE32(chunk + 4 * i);
+        for (int i = 16; i < 64; i++)
+            w[i] = sigma1(w[i - 2]) + w[i - 7] + sigma0(w[i - 15]) + w[i - 16];
+
+        uint32_t a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+        for (int i = 0; i < 64; i++) {
+            const uint32_t t1 = h + Sigma1(e) + Ch(e, f, g) + K[i] + w[i];
+            const uint32_t t2 = Sigma0(a) + Maj(a, b, c);
+            h                 = g;
+            g                 = f;
+            f                 = e;
+            e                 = d + t1;
+            d                 = c;
+            c                 = b;
+            b                 = a;
+            a                 = t1 + t2;
+        }
+        s[0] += a;
+        s[1] += b;
+        s[2] += c;
+        s[3] += d;
+        s[4] += e;
+        s[5] += f;
+        s[6] += g;
+        s[7] += h;
+        chunk += 64;
+    }
+}
+
+} // namespace generic
+
+namespace openssl {
+
+/* only the compression of OpenSSL, which picks the best assembly for the CPU itself */
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    SHA256_CTX ctx;
+    std::memcpy(ctx.h, s, sizeof(ctx.h));
+    while (blocks--) {
+        SHA256_Transform(&ctx, chunk);
+        chunk += 64;
+    }
+    std::memcpy(s, ctx.h, sizeof(ctx.h));
+}
+
+} // namespace openssl
+
+typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
+typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+
+TransformType    Transform         = openssl::Transform;
+TransformD64Type TransformD64_4way = nullptr;
+TransformD64Type TransformD64_8way = nullptr;
+
+/* the double SHA-256 of one 64-byte blob with the selected transform */
+void TransformD64(unsigned char* out, const unsigned char* in)
+{
+    uint32_t s[8];
+    std::memcpy(s, IV, sizeof(s));
+    Transform(s, in, 1);
+    Transform(s, PaddingD64, 1);
+
+    unsigned char buf[64] = {};
+    for (int i = 0; i < 8; i++)
+        WriteBE32(buf + 4 * i, s[i]);
+    buf[32] = 0x80;
+    buf[62] = 1;
+
+    std::memcpy(s, IV, sizeof(s));
+    Transform(s, buf, 1);
+    for (int i = 0; i < 8; i++)
+        WriteBE32(out + 4 * i, s[i]);
+}
+
+#ifdef SHA256_X86
+
+/*
+ * The multi-lane kernels hash one blob per SIMD lane: word i of the state and of the message
+ * schedule of every lane lives in the same vector, so the rounds of all the lanes are the same
+ * instructions. The body is shared through macros, the vector operations V_* being defined for
+ * each instruction set around its kernel.
+ */
+
+#define V_ROTR(x, n) V_OR(V_SHR(x, n), V_SHL(x, 32 - (n)))
+#define V_CH(x, y, z) V_XOR(z, V_AND(x, V_XOR(y, z)))
+#define V_MAJ(x, y, z) V_OR(V_AND(x, y), V_AND(z, V_OR(x, y)))
+#define V_SIGMA0(x) V_XOR(V_XOR(V_ROTR(x, 2), V_ROTR(x, 13)), V_ROTR(x, 22))
+#define V_SIGMA1(x) V_XOR(V_XOR(V_ROTR(x, 6), V_ROTR(x, 11)), V_ROTR(x, 25))
+#define V_sigma0(x) V_XOR(V_XOR(V_ROTR(x, 7), V_ROTR(x, 18)), V_SHR(x, 3))
+#define V_sigma1(x) V_XOR(V_XOR(V_ROTR(x, 17), V_ROTR(x, 19)), V_SHR(x, 10))
+
+/* one compression of the message w[16] into the state s[8] */
+#define SHA256_LANES_TRANSFORM(VEC, s, w) \
+    { \
+        VEC W[64]; \
+        for (int i = 0; i < 16; i++) \
+            W[i] = w[i]; \
+        for (int i = 16; i < 64; i++) \
+            W[i] = V_ADD(V_ADD(V_sigma1(W[i - 2]), W[i - 7]), V_ADD(V_sigma0(W[i - 15]), W[i - 16])); \
+        VEC a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7]; \
+        for (int i = 0; i < 64; i++) { \
+            const VEC t1 = V_ADD(V_ADD(V_ADD(h, V_SIGMA1(e)), V_ADD(V_CH(e, f, g), V_SET1(K[i]))), W[i]); \
+            const VEC t2 = V_ADD(V_SIGMA0(a), V_MAJ(a, b, c)); \
+            h            = g; \
+            g            = f; \
+            f            = e; \
+            e            = V_ADD(d, t1); \
+            d            = c; \
+            c            = b; \
+            b            = a; \
+            a            = V_ADD(t1, t2); \
+        } \
+        s[0] = V_ADD(s[0], a); \
+        s[1] = V_ADD(s[1], b); \
+        s[2] = V_ADD(s[2], c); \
+        s[3] = V_ADD(s[3], d); \
+        s[4] = V_ADD(s[4], e); \
+        s[5] = V_ADD(s[5], f); \
+        s[6] = V_ADD(s[6], g); \
+        s[7] = V_ADD(s[7], h); \
+    }
+
+/* the double SHA-256 of LANES blobs: the blob, its padding block, then the 32-byte first hash */
+#define SHA256_LANES_D64(VEC, LANES, TRANSFORM, out, in) \
+    { \
+        VEC      s[8], w[16]; \
+        uint32_t lane[LANES]; \
+        for (int i = 0; i < 16; i++) { \
+            for (int l = 0; l < LANES; l++) \
+                lane[l] = ReadBE32(in + 64 * l + 4 * i); \
+            w[i] = V_LOAD(lane); \
+        } \
+        for (int i = 0; i < 8; i++) \
+            s[i] = V_SET1(IV[i]); \
+        TRANSFORM(s, w); \
+        w[0] = V_SET1(0x80000000); \
+        for (int i = 1; i < 15; i++) \
+            w[i] = V_SET1(0); \
+        w[15] = V_SET1(512); \
+        TRANSFORM(s, w); \
+        for (int i = 0; i < 8; i++) { \
+            w[i] = s[i]; \
+            s[i] = V_SET1(IV[i]); \
+        } \
+        w[8] = V_SET1(0x80000000); \
+        for (int i = 9; i < 15; i++) \
+            w[i] = V_SET1(0); \
+        w[15] = V_SET1(256); \
+        TRANSFORM(s, w); \
+        for (int i = 0; i < 8; i++) { \
+            V_STORE(lane, s[i]); \
+            for (int l = 0; l < LANES; l++) \
+                WriteBE32(out + 32 * l + 4 * i, lane[l]); \
+        } \
+    }
+
+namespace sse41 {
+
+#define V_ADD(a, b) _mm_add_epi32(a, b)
+#define V_XOR(a, b) _mm_xor_si128(a, b)
+#define V_AND(a, b) _mm_and_si128(a, b)
+#define V_OR(a, b) _mm_or_si128(a, b)
+#define V_SHR(x, n) _mm_srli_epi32(x, n)
+#define V_SHL(x, n) _mm_slli_epi32(x, n)
+#define V_SET1(x) _mm_set1_epi32(x)
+#define V_LOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define V_STORE(p, x) _mm_storeu_si128((__m128i*)(p), x)
+
+SHA256_TARGET_SSE41 inline void Transform(__m128i* s, const __m128i* w)
+{
+    SHA256_LANES_TRANSFORM(__m128i, s, w)
+}
+
+SHA256_TARGET_SSE41 void TransformD64(unsigned char* out, const unsigned char* in)
+{
+    SHA256_LANES_D64(__m128i, 4, Transform, out, in)
+}
+
+#undef V_ADD
+#undef V_XOR
+#undef V_AND
+#undef V_OR
+#undef V_SHR
+#undef V_SHL
+#undef V_SET1
+#undef V_LOAD
+#undef V_STORE
+
+} // namespace sse41
+
+namespace avx2 {
+
+#define V_ADD(a, b) _mm256_add_epi32(a, b)
+#define V_XOR(a, b) _mm256_xor_si256(a, b)
+#define V_AND(a, b) _mm256_and_si256(a, b)
+#define V_OR(a, b) _mm256_or_si256(a, b)
+#define V_SHR(x, n) _mm256_srli_epi32(x, n)
+#define V_SHL(x, n) _mm256_slli_epi32(x, n)
+#define V_SET1(x) _mm256_set1_epi32(x)
+#define V_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define V_STORE(p, x) _mm256_storeu_si256((__m256i*)(p), x)
+
+SHA256_TARGET_AVX2 inline void Transform(__m256i* s, const __m256i* w)
+{
+    SHA256_LANES_TRANSFORM(__m256i, s, w)
+}
+
+SHA256_TARGET_AVX2 void TransformD64(unsigned char* out, const unsigned char* in)
+{
+    SHA256_LANES_D64(__m256i, 8, Transform, out, in)
+}
+
+#undef V_ADD
+#undef V_XOR
+#undef V_AND
+#undef V_OR
+#undef V_SHR
+#undef V_SHL
+#undef V_SET1
+#undef V_LOAD
+#undef V_STORE
+
+} // namespace avx2
+
+namespace shani {
+
+/*
+ * The SHA extensions keep the state as ABEF and CDGH and run 2 rounds per sha256rnds2; message
+ * words 16-63 come 4 at a time from sha256msg1/sha256msg2, in a ring of 4 vectors.
+ */
+SHA256_TARGET_SHANI void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp    = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&s[0]), 0xB1); // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&s[4]), 0x1B); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);                                 // ABEF
+    state1         = _mm_blend_epi16(state1, tmp, 0xF0);                              // CDGH
+
+    while (blocks--) {
+        const __m128i abefSave = state0;
+        const __m128i cdghSave = state1;
+        __m128i       m[4];
+
+        // 4 rounds, for the words 4 * g to 4 * g + 3; unrolled so the ring of messages stays in registers
+#define SHANI_ROUNDS(g) \
+    { \
+        if (g < 4) \
+            m[g % 4] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(chunk + 16 * g)), MASK); \
+        __m128i msg = _mm_add_epi32(m[g % 4], _mm_loadu_si128((const __m128i*)&K[4 * g])); \
+        state1      = _mm_sha256rnds2_epu32(state1, state0, msg); \
+        if (g >= 3 && g <= 14) { \
+            const __m128i next = _mm_add_epi32(m[(g + 1) % 4], _mm_alignr_epi8(m[g % 4], m[(g + 3) % 4], 4)); \
+            m[(g + 1) % 4]     = _mm_sha256msg2_epu32(next, m[g % 4]); \
+        } \
+        msg    = _mm_shuffle_epi32(msg, 0x0E); \
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg); \
+        if (g >= 1 && g <= 12) \
+            m[(g + 3) % 4] = _mm_sha256msg1_epu32(m[(g + 3) % 4], m[g % 4]); \
+    }
+        SHANI_ROUNDS(0)
+        SHANI_ROUNDS(1)
+        SHANI_ROUNDS(2)
+        SHANI_ROUNDS(3)
+        SHANI_ROUNDS(4)
+        SHANI_ROUNDS(5)
+        SHANI_ROUNDS(6)
+        SHANI_ROUNDS(7)
+        SHANI_ROUNDS(8)
+        SHANI_ROUNDS(9)
+        SHANI_ROUNDS(10)
+        SHANI_ROUNDS(11)
+        SHANI_ROUNDS(12)
+        SHANI_ROUNDS(13)
+        SHANI_ROUNDS(14)
+        SHANI_ROUNDS(15)
+#undef SHANI_ROUNDS
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+        chunk += 64;
+    }
+
+    tmp    = _mm_shuffle_epi32(state0, 0x1B);    // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);    // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0); // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);    // ABEF
+    _mm_storeu_si128((__m128i*)&s[0], state0);
+    _mm_storeu_si128((__m128i*)&s[4], state1);
+}
+
+} // namespace shani
+
+bool HaveSHANI()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1))
+        return false;
+    if (__get_cpuid_max(0, nullptr) < 7)
+        return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx >> 29) & 1;
+}
+
+#endif // SHA256_X86
+
+} // namespace
+
+CSHA256::CSHA256() : bytes(0) { Reset(); }
+
+CSHA256& CSHA256::Write(const unsigned char* data, size_t len)
+{
+    const unsigned char* end     = data + len;
+    size_t               bufsize = bytes % 64;
+    if (bufsize && bufsize + len >= 64) {
+        // fill the buffer, and process it
+        std::memcpy(buf + bufsize, data, 64 - bufsize);
+        bytes += 64 - bufsize;
+        data += 64 - bufsize;
+        Transform(s, buf, 1);
+        bufsize = 0;
+    }
+    if (end - data >= 64) {
+        const size_t blocks = (end - data) / 64;
+        Transform(s, data, blocks);
+        data += 64 * blocks;
+        bytes += 64 * blocks;
+    }
+    if (end > data) {
+        // fill the buffer with what remains
+        std::memcpy(buf + bufsize, data, end - data);
+        bytes += end - data;
+    }
+    return *this;
+}
+
+void CSHA256::Finalize(unsigned char hash[OUTPUT_SIZE])
+{
+    static const unsigned char pad[64] = {0x80};
+    unsigned char              sizedesc[8];
+    const uint64_t             bits = bytes << 3;
+    WriteBE32(sizedesc, bits >> 32);
+    WriteBE32(sizedesc + 4, bits);
+    Write(pad, 1 + ((119 - (bytes % 64)) % 64));
+    Write(sizedesc, 8);
+    for (int i = 0; i < 8; i++)
+        WriteBE32(hash + 4 * i, s[i]);
+}
+
+CSHA256& CSHA256::Reset()
+{
+    bytes = 0;
+    std::memcpy(s, IV, sizeof(s));
+    return *this;
+}
+
+const char* Sha256ImplementationName(Sha256Implementation impl)
+{
+    switch (impl) {
+    case Sha256Implementation::Generic:
+        return "generic";
+    case Sha256Implementation::OpenSSL:
+        return "openssl";
+    case Sha256Implementation::SSE41:
+        return "sse4.1(4way)";
+    case Sha256Implementation::AVX2:
+        return "avx2(8way)";
+    case Sha256Implementation::SHANI:
+        return "shani";
+    }
+    return "unknown";
+}
+
+bool SHA256ImplementationSupported(Sha256Implementation impl)
+{
+    switch (impl) {
+    case Sha256Implementation::Generic:
+    case Sha256Implementation::OpenSSL:
+        return true;
+#ifdef SHA256_X86
+    case Sha256Implementation::SSE41:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1");
+    case Sha256Implementation::AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.1");
+    case Sha256Implementation::SHANI:
+        return HaveSHANI();
+#endif
+    default:
+        return false;
+    }
+}
+
+bool SHA256UseImplementation(Sha256Implementation impl)
+{
+    if (!SHA256ImplementationSupported(impl))
+        return false;
+
+    Transform         = generic::Transform;
+    TransformD64_4way = nullptr;
+    TransformD64_8way = nullptr;
+    if (impl == Sha256Implementation::OpenSSL)
+        Transform = openssl::Transform;
+#ifdef SHA256_X86
+    switch (impl) {
+    case Sha256Implementation::Generic:
+    case Sha256Implementation::OpenSSL:
+        break;
+    case Sha256Implementation::AVX2:
+        TransformD64_8way = avx2::TransformD64;
+        TransformD64_4way = sse41::TransformD64;
+        break;
+    case Sha256Implementation::SSE41:
+        TransformD64_4way = sse41::TransformD64;
+        break;
+    case Sha256Implementation::SHANI:
+        Transform = shani::Transform;
+        break;
+    }
+#endif
+    return true;
+}
+
+std::string SHA256AutoDetect()
+{
+    // OpenSSL's assembly is as fast as it gets for a single stream without the SHA extensions
+    SHA256UseImplementation(Sha256Implementation::OpenSSL);
+    std::string result = Sha256ImplementationName(Sha256Implementation::OpenSSL);
+#ifdef SHA256_X86
+    // the lanes still beat the SHA extensions on many blobs at once, so both are used when available
+    if (SHA256ImplementationSupported(Sha256Implementation::SHANI)) {
+        Transform = shani::Transform;
+        result    = Sha256ImplementationName(Sha256Implementation::SHANI);
+    }
+    if (SHA256ImplementationSupported(Sha256Implementation::AVX2)) {
+        TransformD64_8way = avx2::TransformD64;
+        result += std::string(",") + Sha256ImplementationName(Sha256Implementation::AVX2);
+    }
+    if (SHA256ImplementationSupported(Sha256Implementation::SSE41)) {
+        TransformD64_4way = sse41::TransformD64;
+        result += std::string(",") + Sha256ImplementationName(Sha256Implementation::SSE41);
+    }
+#endif
+    return result;
+}
+
+void SHA256TransformBlocks(uint32_t* state, const unsigned char* blocks, size_t n)
+{
+    Transform(state, blocks, n);
+}
+
+void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks)
+{
+    if (TransformD64_8way) {
+        while (blocks >= 8) {
+            TransformD64_8way(output, input);
+            output += 256;
+            input += 512;
+            blocks -= 8;
+        }
+    }
+    if (TransformD64_4way) {
+        while (blocks >= 4) {
+            TransformD64_4way(output, input);
+            output += 128;
+            input += 256;
+            blocks -= 4;
+        }
+    }
+    while (blocks) {
+        TransformD64(output, input);
+        output += 32;
+        input += 64;
+        blocks -= 1;
+    }
+}
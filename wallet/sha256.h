@@ -0,0 +1,55 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/** A hasher class for SHA-256, with the transform chosen by SHA256AutoDetect() */
+class CSHA256
+{
+    uint32_t      s[8];
+    unsigned char buf[64];
+    uint64_t      bytes;
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    CSHA256();
+    CSHA256& Write(const unsigned char* data, size_t len);
+    void     Finalize(unsigned char hash[OUTPUT_SIZE]);
+    CSHA256& Reset();
+};
+
+enum class Sha256Implementation
+{
+    Generic, // portable C++
+    OpenSSL, // the assembly of OpenSSL for a single transform
+    SSE41,   // 4 blobs at a time for SHA256D64(), one per SSE lane
+    AVX2,    // 8 blobs at a time for SHA256D64(), one per AVX2 lane, and 4 with SSE4.1 for the tail
+    SHANI,   // the SHA extensions for a single transform
+};
+
+const char* Sha256ImplementationName(Sha256Implementation impl);
+
+bool SHA256ImplementationSupported(Sha256Implementation impl);
+
+/** selects the fastest implementations the CPU supports and returns a description of them; until
+ * it's called, OpenSSL's transform is used. Not thread-safe, call it on startup. */
+std::string SHA256AutoDetect();
+
+/** makes SHA256D64() and CSHA256 use only the given implementation, for tests and benchmarks;
+ * returns false, changing nothing, if the CPU doesn't support it */
+bool SHA256UseImplementation(Sha256Implementation impl);
+
+/** runs the SHA-256 compression of n 64-byte blocks on a state, without any padding */
+void SHA256TransformBlocks(uint32_t* state, const unsigned char* blocks, size_t n);
+
+/**
+ * Computes the double SHA-256 of many 64-byte blobs at once, like the concatenated pairs of hashes
+ * of a merkle tree level. output is blocks * 32 bytes and input blocks * 64 bytes. Every batch of
+ * blobs is read before its hashes are written, so output may point to input.
+ */
+void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
+
+#endif // SHA256_H
@@ -2,6 +2,7 @@
 
 #include "block.h"
 #include "kernel.h"
+#include "runtimeconfig.h"
 #include "wallet.h"
 #include "work.h"
 
@@ -146,7 +147,7 @@ StakeMaker::CreateCoinStake(const ITxDB& txdb, const CWallet& wallet, const unsi
     // we set the startup time only once
     std::call_once(timeSetterOnceFlag, [&]() { nLastCoinStakeSearchTime = GetAdjustedTime(); });
 
-    const bool fEnableColdStaking = GetBoolArg("-coldstaking", true);
+    const bool fEnableColdStaking = GetRuntimeConfig().fColdStaking;
 
     const uint256 currentBestBlock = txdb.GetBestBlockHash();
 
@@ -291,7 +292,7 @@ boost::optional<CTransaction> StakeMaker::CreateCoinStakeFromSpecificOutput(cons
     CTxIndex     txindex;
     CTransaction outputTx;
     {
-        LOCK(cs_main);
+        LOCK_SHARED(cs_main);
 
         if (!txdb.ReadTxIndex(output.hash, txindex))
             return boost::none;
@@ -8,6 +8,380 @@
 
 #include <boost/foreach.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <tuple>
+
+std::atomic<bool> fLockStats{false};
+
+/** The counters of one lock site in the table of one thread. Only that thread writes them, so a load
+ * and a store do, instead of the lock prefix of an atomic increment; the atomics are for the readers.
+ * Zero-initialized by the value-initialization of ThreadLockStats. */
+struct CLockStatsSlot
+{
+    std::atomic<const CLockSite*>                          site;
+    std::atomic<uint64_t>                                  nAcquisitions;
+    std::atomic<uint64_t>                                  nContended;
+    std::atomic<uint64_t>                                  nTryFailures;
+    std::atomic<uint64_t>                                  nWaitMicros;
+    std::atomic<uint64_t>                                  nMaxWaitMicros;
+    std::atomic<uint64_t>                                  nHoldMicros;
+    std::atomic<uint64_t>                                  nMaxHoldMicros;
+    std::array<std::atomic<uint64_t>, LOCK_STATS_BUCKETS> waitHistogram;
+    std::array<std::atomic<uint64_t>, LOCK_STATS_BUCKETS> holdHistogram;
+};
+
+namespace {
+
+/** the lock sites used by one thread, an open addressing hash table of the addresses of the sites */
+struct ThreadLockStats
+{
+    // there are about 300 sites in the whole code and a thread uses a part of them, so the table
+    // doesn't fill up; if it did, the sites beyond it wouldn't be counted
+    static const std::size_t SLOTS = 512;
+
+    std::atomic<bool>                 fInUse;
+    std::atomic<uint64_t>             nGeneration; // of ResetLockStats()
+    std::array<CLockStatsSlot, SLOTS> slots;
+};
+
+/** frees the table of the thread for another thread when the thread ends */
+struct ThreadLockStatsOwner
+{
+    ThreadLockStats* stats = nullptr;
+
+    ~ThreadLockStatsOwner()
+    {
+        if (stats)
+            stats->fInUse.store(false, std::memory_order_release);
+    }
+};
+
+} // namespace
+
+// the tables of the threads that ended are kept, and reused by new threads, so that their counts stay
+static boost::mutex                                  csThreadLockStats;
+static std::vector<std::unique_ptr<ThreadLockStats>> vThreadLockStats;
+static std::atomic<uint64_t>                         nLockStatsGeneration{0};
+
+static thread_local ThreadLockStatsOwner threadLockStats;
+
+static void Bump(std::atomic<uint64_t>& counter, uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static void BumpMax(std::atomic<uint64_t>& counter, uint64_t n)
+{
+    if (n > counter.load(std::memory_order_relaxed))
+        counter.store(n, std::memory_order_relaxed);
+}
+
+static void ClearSlot(CLockStatsSlot& slot)
+{
+    slot.site.store(nullptr, std::memory_order_relaxed);
+    for (std::atomic<uint64_t>* counter :
+         {&slot.nAcquisitions, &slot.nContended, &slot.nTryFailures, &slot.nWaitMicros,
+          &slot.nMaxWaitMicros, &slot.nHoldMicros, &slot.nMaxHoldMicros}) {
+        counter->store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+        slot.waitHistogram[i].store(0, std::memory_order_relaxed);
+        slot.holdHistogram[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+static ThreadLockStats& GetThreadLockStats()
+{
+    if (!threadLockStats.stats) {
+        boost::lock_guard<boost::mutex> lock(csThreadLockStats);
+        for (const std::unique_ptr<ThreadLockStats>& stats : vThreadLockStats) {
+            if (!stats->fInUse.load(std::memory_order_acquire)) {
+                threadLockStats.stats = stats.get();
+                break;
+            }
+        }
+        if (!threadLockStats.stats) {
+            // the table is large, so it's only allocated when profiling
+            vThreadLockStats.emplace_back(new ThreadLockStats());
+            threadLockStats.stats = vThreadLockStats.back().get();
+        }
+        threadLockStats.stats->fInUse.store(true, std::memory_order_relaxed);
+    }
+
+    ThreadLockStats& stats       = *threadLockStats.stats;
+    const uint64_t   nGeneration = nLockStatsGeneration.load(std::memory_order_relaxed);
+    if (stats.nGeneration.load(std::memory_order_relaxed) != nGeneration) {
+        // a reset since the last lock of this thread; it clears its own table, being the only writer
+        for (CLockStatsSlot& slot : stats.slots)
+            ClearSlot(slot);
+        stats.nGeneration.store(nGeneration, std::memory_order_release);
+    }
+    return stats;
+}
+
+static CLockStatsSlot* FindLockStatsSlot(const CLockSite& site)
+{
+    ThreadLockStats&  stats = GetThreadLockStats();
+    const std::size_t nHash = reinterpret_cast<uintptr_t>(&site) / alignof(CLockSite);
+    for (std::size_t i = 0; i < ThreadLockStats::SLOTS; i++) {
+        CLockStatsSlot& slot  = stats.slots[(nHash + i) % ThreadLockStats::SLOTS];
+        const CLockSite*        owner = slot.site.load(std::memory_order_relaxed);
+        if (owner == &site)
+            return &slot;
+        if (owner == nullptr) {
+            slot.site.store(&site, std::memory_order_release);
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+static int LockStatsBucket(uint64_t nMicros)
+{
+    int nBits = 0;
+    while (nMicros > 0 && nBits < LOCK_STATS_BUCKETS - 1) {
+        nMicros >>= 1;
+        nBits++;
+    }
+    return nBits;
+}
+
+int64_t LockStatsNowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+CLockStatsSlot* RecordLockAcquired(const CLockSite& site, bool fContended, int64_t nWaitMicros)
+{
+    CLockStatsSlot* slot = FindLockStatsSlot(site);
+    if (!slot)
+        return nullptr;
+    const uint64_t nWait = static_cast<uint64_t>(std::max<int64_t>(nWaitMicros, 0));
+    Bump(slot->nAcquisitions, 1);
+    if (fContended)
+        Bump(slot->nContended, 1);
+    Bump(slot->nWaitMicros, nWait);
+    BumpMax(slot->nMaxWaitMicros, nWait);
+    Bump(slot->waitHistogram[LockStatsBucket(nWait)], 1);
+    return slot;
+}
+
+void RecordLockReleased(CLockStatsSlot* slot, const CLockSite& site, int64_t nHoldMicros)
+{
+    // the slot was cleared if the statistics were reset while the lock was held
+    if (!slot || slot->site.load(std::memory_order_relaxed) != &site)
+        return;
+    const uint64_t nHold = static_cast<uint64_t>(std::max<int64_t>(nHoldMicros, 0));
+    Bump(slot->nHoldMicros, nHold);
+    BumpMax(slot->nMaxHoldMicros, nHold);
+    Bump(slot->holdHistogram[LockStatsBucket(nHold)], 1);
+}
+
+void RecordLockTryFailed(const CLockSite& site)
+{
+    CLockStatsSlot* slot = FindLockStatsSlot(site);
+    if (slot)
+        Bump(slot->nTryFailures, 1);
+}
+
+void EnableLockStats(bool fEnable) { fLockStats.store(fEnable, std::memory_order_relaxed); }
+
+std::vector<CLockSiteStats> GetLockStats()
+{
+    // the same site may have a static in every translation unit that inlines it
+    std::map<std::tuple<std::string, int, bool>, CLockSiteStats> mapSites;
+
+    boost::lock_guard<boost::mutex> lock(csThreadLockStats);
+    const uint64_t nGeneration = nLockStatsGeneration.load(std::memory_order_relaxed);
+    for (const std::unique_ptr<ThreadLockStats>& stats : vThreadLockStats) {
+        // not cleared yet since the last reset
+        if (stats->nGeneration.load(std::memory_order_acquire) != nGeneration)
+            continue;
+        for (const CLockStatsSlot& slot : stats->slots) {
+            const CLockSite* site = slot.site.load(std::memory_order_acquire);
+            if (!site)
+                continue;
+            CLockSiteStats& s = mapSites[std::make_tuple(site->pszFile, site->nLine, site->fShared)];
+            if (s.waitHistogram.empty()) {
+                s.name    = site->pszName;
+                s.file    = site->pszFile;
+                s.line    = site->nLine;
+                s.fShared = site->fShared;
+                s.waitHistogram.resize(LOCK_STATS_BUCKETS);
+                s.holdHistogram.resize(LOCK_STATS_BUCKETS);
+            }
+            s.nAcquisitions += slot.nAcquisitions.load(std::memory_order_relaxed);
+            s.nContended += slot.nContended.load(std::memory_order_relaxed);
+            s.nTryFailures += slot.nTryFailures.load(std::memory_order_relaxed);
+            s.nWaitMicros += slot.nWaitMicros.load(std::memory_order_relaxed);
+            s.nMaxWaitMicros =
+                std::max(s.nMaxWaitMicros, slot.nMaxWaitMicros.load(std::memory_order_relaxed));
+            s.nHoldMicros += slot.nHoldMicros.load(std::memory_order_relaxed);
+            s.nMaxHoldMicros =
+                std::max(s.nMaxHoldMicros, slot.nMaxHoldMicros.load(std::memory_order_relaxed));
+            for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+                s.waitHistogram[i] += slot.waitHistogram[i].load(std::memory_order_relaxed);
+                s.holdHistogram[i] += slot.holdHistogram[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::vector<CLockSiteStats> result;
+    result.reserve(mapSites.size());
+    for (auto& p : mapSites)
+        result.push_back(std::move(p.second));
+    std::stable_sort(result.begin(), result.end(), [](const CLockSiteStats& a, const CLockSiteStats& b) {
+        return a.nWaitMicros > b.nWaitMicros;
+    });
+    return result;
+}
+
+void ResetLockStats()
+{
+    // every thread clears its table on its next lock; until then, it's ignored
+    nLockStatsGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LogLockStats(std::size_t nMaxSites)
+{
+    const std::vector<CLockSiteStats> stats = GetLockStats();
+    NLog.write(b_sev::info, "Lock profile, the {} sites with the longest waits of {}:",
+               std::min(nMaxSites, stats.size()), stats.size());
+    for (std::size_t i = 0; i < stats.size() && i < nMaxSites; i++) {
+        const CLockSiteStats& s = stats[i];
+        NLog.write(b_sev::info,
+                   "  {}:{} {}{}: acquired {}, contended {}, wait {} us (max {}), hold {} us (max {})",
+                   s.file, s.line, s.name, s.fShared ? " (shared)" : "", s.nAcquisitions, s.nContended,
+                   s.nWaitMicros, s.nMaxWaitMicros, s.nHoldMicros, s.nMaxHoldMicros);
+    }
+}
+
+namespace {
+/** a CSharedCriticalSection that the thread holds shared */
+struct SharedHold
+{
+    const CSharedCriticalSection* cs;
+    int                           nDepth;
+};
+} // namespace
+
+// a thread rarely holds more than one of them, so a vector is the fastest
+static thread_local std::vector<SharedHold> sharedHolds;
+
+static std::vector<SharedHold>::iterator FindSharedHold(const CSharedCriticalSection* cs)
+{
+    return std::find_if(sharedHolds.begin(), sharedHolds.end(),
+                        [cs](const SharedHold& h) { return h.cs == cs; });
+}
+
+void CSharedCriticalSection::lock()
+{
+    if (IsLockedExclusivelyByThisThread()) {
+        nExclusiveDepth++;
+        return;
+    }
+    if (FindSharedHold(this) != sharedHolds.end()) {
+        std::cerr << "Assertion failed: a thread locked exclusively a CSharedCriticalSection it holds "
+                     "shared"
+                  << std::endl;
+        abort();
+    }
+    mutex.lock();
+    exclusiveOwner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    nExclusiveDepth = 1;
+}
+
+void CSharedCriticalSection::unlock()
+{
+    assert(IsLockedExclusivelyByThisThread());
+    if (--nExclusiveDepth > 0)
+        return;
+    exclusiveOwner.store(std::thread::id(), std::memory_order_relaxed);
+    mutex.unlock();
+}
+
+bool CSharedCriticalSection::try_lock()
+{
+    if (IsLockedExclusivelyByThisThread()) {
+        nExclusiveDepth++;
+        return true;
+    }
+    if (FindSharedHold(this) != sharedHolds.end())
+        return false;
+    if (!mutex.try_lock())
+        return false;
+    exclusiveOwner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    nExclusiveDepth = 1;
+    return true;
+}
+
+void CSharedCriticalSection::lock_shared()
+{
+    if (IsLockedExclusivelyByThisThread()) {
+        nExclusiveDepth++;
+        return;
+    }
+    // the thread must not wait for the mutex again while it has it, or a writer that waits between
+    // the two would deadlock both
+    auto it = FindSharedHold(this);
+    if (it != sharedHolds.end()) {
+        it->nDepth++;
+        return;
+    }
+    mutex.lock_shared();
+    sharedHolds.push_back(SharedHold{this, 1});
+}
+
+void CSharedCriticalSection::unlock_shared()
+{
+    if (IsLockedExclusivelyByThisThread()) {
+        unlock();
+        return;
+    }
+    auto it = FindSharedHold(this);
+    assert(it != sharedHolds.end());
+    if (--it->nDepth > 0)
+        return;
+    sharedHolds.erase(it);
+    mutex.unlock_shared();
+}
+
+bool CSharedCriticalSection::try_lock_shared()
+{
+    if (IsLockedExclusivelyByThisThread()) {
+        nExclusiveDepth++;
+        return true;
+    }
+    auto it = FindSharedHold(this);
+    if (it != sharedHolds.end()) {
+        it->nDepth++;
+        return true;
+    }
+    if (!mutex.try_lock_shared())
+        return false;
+    sharedHolds.push_back(SharedHold{this, 1});
+    return true;
+}
+
+bool CSharedCriticalSection::IsLockedExclusivelyByThisThread() const
+{
+    // only this thread can have stored its own id
+    return exclusiveOwner.load(std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+bool CSharedCriticalSection::IsLockedByThisThread() const
+{
+    return IsLockedExclusivelyByThisThread() || FindSharedHold(this) != sharedHolds.end();
+}
+
 #ifdef DEBUG_LOCKCONTENTION
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 {
@@ -30,16 +404,17 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 
 struct CLockLocation
 {
-    CLockLocation(const char* pszName, const char* pszFile, int nLine)
+    CLockLocation(const char* pszName, const char* pszFile, int nLine, bool fSharedIn)
     {
         mutexName = pszName;
         sourceFile = pszFile;
         sourceLine = nLine;
+        fShared = fSharedIn;
     }
 
     std::string ToString() const
     {
-        return mutexName+"  "+sourceFile+":"+itostr(sourceLine);
+        return mutexName+"  "+sourceFile+":"+itostr(sourceLine)+(fShared ? " (shared)" : "");
     }
 
     std::string MutexName() const { return mutexName; }
@@ -48,6 +423,7 @@ private:
     std::string mutexName;
     std::string sourceFile;
     int sourceLine;
+    bool fShared;
 };
 
 typedef std::vector< std::pair<void*, CLockLocation> > LockStack;
@@ -118,9 +494,12 @@ static void pop_lock()
     dd_mutex.unlock();
 }
 
-void EnterCritical(const char* pszName, const char* pszFile, int nLine, void* cs, bool fTry)
+// A shared lock is ordered like an exclusive one: a reader that waits for a lock held by a writer that
+// waits for the reader's lock deadlocks all the same
+void EnterCritical(const char* pszName, const char* pszFile, int nLine, void* cs, bool fTry,
+                   bool fShared)
 {
-    push_lock(cs, CLockLocation(pszName, pszFile, nLine), fTry);
+    push_lock(cs, CLockLocation(pszName, pszFile, nLine, fShared), fTry);
 }
 
 void LeaveCritical()
@@ -13,8 +13,15 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/atomic.hpp>
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include <boost/optional.hpp>
 
+#include <atomic>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 
 ////////////////////////////////////////////////
 //                                            //
@@ -32,6 +39,9 @@ CCriticalSection mutex;
 LOCK(mutex);
     boost::unique_lock<boost::recursive_mutex> criticalblock(mutex);
 
+LOCK_SHARED(mutex); // only for CSharedCriticalSection
+    boost::shared_lock<boost::shared_mutex> criticalblock(mutex);
+
 LOCK2(mutex1, mutex2);
     boost::unique_lock<boost::recursive_mutex> criticalblock1(mutex1);
     boost::unique_lock<boost::recursive_mutex> criticalblock2(mutex2);
@@ -86,13 +96,161 @@ typedef AnnotatedMixin<boost::recursive_mutex> CCriticalSection;
 /** Wrapped boost mutex: supports waiting but not recursive locking */
 typedef AnnotatedMixin<boost::mutex> CWaitableCriticalSection;
 
+/**
+ * Wrapped boost shared_mutex, for the state that many threads read and few write, like the chain
+ * state of cs_main. Locked exclusively (LOCK, LOCK2, TRY_LOCK...) it's recursive like
+ * CCriticalSection. Locked shared (LOCK_SHARED) it's taken by any number of readers at once, and is
+ * recursive too; when the thread holds it exclusively already, a shared lock is just one more level of
+ * the exclusive one.
+ * A thread that holds it shared must not lock it exclusively: two readers doing that at once would
+ * wait for each other forever, so it's a bug that aborts right away instead. try_lock() fails then.
+ */
+class LOCKABLE CSharedCriticalSection
+{
+    boost::shared_mutex          mutex;
+    std::atomic<std::thread::id> exclusiveOwner{std::thread::id()};
+    int                          nExclusiveDepth = 0;
+
+public:
+    CSharedCriticalSection() = default;
+
+    CSharedCriticalSection(const CSharedCriticalSection&) = delete;
+    CSharedCriticalSection& operator=(const CSharedCriticalSection&) = delete;
+
+    void lock() EXCLUSIVE_LOCK_FUNCTION();
+    void unlock() UNLOCK_FUNCTION();
+    bool try_lock() EXCLUSIVE_TRYLOCK_FUNCTION(true);
+
+    void lock_shared() SHARED_LOCK_FUNCTION();
+    void unlock_shared() UNLOCK_FUNCTION();
+    bool try_lock_shared() SHARED_TRYLOCK_FUNCTION(true);
+
+    bool IsLockedExclusivelyByThisThread() const;
+    /** exclusively or shared */
+    bool IsLockedByThisThread() const;
+};
+
+/////////////////////////////////////////////////
+//                                             //
+// LOCK PROFILING: THE -lockprofile STATISTICS //
+//                                             //
+/////////////////////////////////////////////////
+
+/** A place of the source that takes a lock with one of the macros below; one static instance each */
+struct CLockSite
+{
+    const char* pszName; // the mutexes, as written in the macro
+    const char* pszFile;
+    int         nLine;
+    bool        fShared;
+};
+
+#define _LOCK_SITE(name, fShared)                                                                   \
+    ([]() -> const CLockSite& {                                                                    \
+        static const CLockSite __locksite__ = {name, __FILE__, __LINE__, fShared};                 \
+        return __locksite__;                                                                       \
+    }())
+
+/** the histogram buckets of wait and hold times: bucket 0 is below a microsecond, bucket i counts the
+ * times in [2^(i-1), 2^i) microseconds, and the last one also everything slower */
+static const int LOCK_STATS_BUCKETS = 24;
+
+/** the totals of the acquisitions at one place of the source, since the start or ResetLockStats() */
+struct CLockSiteStats
+{
+    std::string name;
+    std::string file;
+    int         line           = 0;
+    bool        fShared        = false;
+    uint64_t    nAcquisitions  = 0;
+    uint64_t    nContended     = 0; // the acquisitions that had to wait for another thread
+    uint64_t    nTryFailures   = 0; // the TRY_LOCK()s that didn't get the lock
+    uint64_t    nWaitMicros    = 0;
+    uint64_t    nMaxWaitMicros = 0;
+    uint64_t    nHoldMicros    = 0;
+    uint64_t    nMaxHoldMicros = 0;
+    std::vector<uint64_t> waitHistogram;
+    std::vector<uint64_t> holdHistogram;
+};
+
+extern std::atomic<bool> fLockStats;
+
+/** Every thread counts its own acquisitions in a table of its own, without any lock or atomic
+ * read-modify-write, so it's cheap enough to profile a node under load. Disabled, it costs a relaxed
+ * load per lock. */
+void EnableLockStats(bool fEnable);
+inline bool LockStatsEnabled() { return fLockStats.load(std::memory_order_relaxed); }
+/** the totals of all the threads, the sites with the longest total wait first */
+std::vector<CLockSiteStats> GetLockStats();
+void                        ResetLockStats();
+/** writes the sites with the longest total waits to the log */
+void LogLockStats(std::size_t nMaxSites);
+
+int64_t LockStatsNowMicros();
+
+struct CLockStatsSlot;
+CLockStatsSlot* RecordLockAcquired(const CLockSite& site, bool fContended, int64_t nWaitMicros);
+void            RecordLockReleased(CLockStatsSlot* slot, const CLockSite& site, int64_t nHoldMicros);
+void            RecordLockTryFailed(const CLockSite& site);
+
+/** The profiling of one lock taken by the macros: it has to outlive the lock to time the holding */
+class CLockProfileScope
+{
+    const CLockSite& site;
+    CLockStatsSlot*  slot         = nullptr;
+    int64_t          nLockedSince = -1;
+
+public:
+    explicit CLockProfileScope(const CLockSite& siteIn) : site(siteIn) {}
+
+    CLockProfileScope(const CLockProfileScope&) = delete;
+    CLockProfileScope& operator=(const CLockProfileScope&) = delete;
+
+    template <typename TryLockFunc, typename LockFunc>
+    void Lock(TryLockFunc&& tryLockFunc, LockFunc&& lockFunc)
+    {
+        if (!LockStatsEnabled()) {
+            lockFunc();
+            return;
+        }
+        const int64_t nStart      = LockStatsNowMicros();
+        const bool    fContended  = !tryLockFunc();
+        if (fContended)
+            lockFunc();
+        nLockedSince = LockStatsNowMicros();
+        slot         = RecordLockAcquired(site, fContended, nLockedSince - nStart);
+    }
+
+    template <typename TryLockFunc>
+    bool TryLock(TryLockFunc&& tryLockFunc)
+    {
+        const bool fLocked = tryLockFunc();
+        if (LockStatsEnabled()) {
+            if (fLocked) {
+                nLockedSince = LockStatsNowMicros();
+                slot         = RecordLockAcquired(site, false, 0);
+            } else {
+                RecordLockTryFailed(site);
+            }
+        }
+        return fLocked;
+    }
+
+    ~CLockProfileScope()
+    {
+        if (nLockedSince >= 0)
+            RecordLockReleased(slot, site, LockStatsNowMicros() - nLockedSince);
+    }
+};
+
 #ifdef DEBUG_LOCKORDER
-void EnterCritical(const char* pszName, const char* pszFile, int nLine, void* cs, bool fTry = false);
+void EnterCritical(const char* pszName, const char* pszFile, int nLine, void* cs, bool fTry = false,
+                   bool fShared = false);
 void LeaveCritical();
 std::string LocksHeld();
 void AssertLockHeldInternal(const char* pszName, const char* pszFile, int nLine, void *cs);
 #else
-void static inline EnterCritical(const char* /*pszName*/, const char* /*pszFile*/, int /*nLine*/, void* /*cs*/, bool /*fTry*/ = false) {}
+void static inline EnterCritical(const char* /*pszName*/, const char* /*pszFile*/, int /*nLine*/, void* /*cs*/, bool /*fTry*/ = false, bool /*fShared*/ = false) {}
 void static inline LeaveCritical() {}
 void static inline AssertLockHeldInternal(const char* /*pszName*/, const char* /*pszFile*/, int /*nLine*/, void */*cs*/) {}
 #endif
@@ -155,6 +313,56 @@ public:
 
 typedef CMutexLock<CCriticalSection> CCriticalBlock;
 
+/** The scoped lock of LOCK(): boost::lock_guard, plus the place of the lock for DEBUG_LOCKORDER and
+ * -lockprofile */
+template <typename Mutex>
+class SCOPED_LOCKABLE CLockGuard
+{
+    CLockProfileScope profile;
+    Mutex&            mutex;
+
+public:
+    CLockGuard(Mutex& mutexIn, const CLockSite& site) EXCLUSIVE_LOCK_FUNCTION(mutexIn)
+        : profile(site), mutex(mutexIn)
+    {
+        EnterCritical(site.pszName, site.pszFile, site.nLine, (void*)(&mutex));
+        profile.Lock([this]() { return mutex.try_lock(); }, [this]() { mutex.lock(); });
+    }
+
+    CLockGuard(const CLockGuard&) = delete;
+    CLockGuard& operator=(const CLockGuard&) = delete;
+
+    ~CLockGuard() UNLOCK_FUNCTION()
+    {
+        mutex.unlock();
+        LeaveCritical();
+    }
+};
+
+/** The scoped lock of LOCK_SHARED() */
+class SCOPED_LOCKABLE CSharedLockGuard
+{
+    CLockProfileScope       profile;
+    CSharedCriticalSection& mutex;
+
+public:
+    CSharedLockGuard(CSharedCriticalSection& mutexIn, const CLockSite& site) SHARED_LOCK_FUNCTION(mutexIn)
+        : profile(site), mutex(mutexIn)
+    {
+        EnterCritical(site.pszName, site.pszFile, site.nLine, (void*)(&mutex), false, true);
+        profile.Lock([this]() { return mutex.try_lock_shared(); }, [this]() { mutex.lock_shared(); });
+    }
+
+    CSharedLockGuard(const CSharedLockGuard&) = delete;
+    CSharedLockGuard& operator=(const CSharedLockGuard&) = delete;
+
+    ~CSharedLockGuard() UNLOCK_FUNCTION()
+    {
+        mutex.unlock_shared();
+        LeaveCritical();
+    }
+};
+
 //! Substitute for C++14 std::make_unique for this file.
 template <typename T, typename... Args>
 std::unique_ptr<T> __InternalSyncMakeUnique(Args&&... args)
@@ -163,79 +371,99 @@ std::unique_ptr<T> __InternalSyncMakeUnique(Args&&... args)
 }
 
 template <typename M1, typename M2>
-auto _lock2_internal(M1&& m1, M2&& m2) -> std::pair<std::unique_ptr<boost::unique_lock<typename std::decay<decltype(m1)>::type>>, std::unique_ptr<boost::unique_lock<typename std::decay<decltype(m2)>::type>>>
+auto _lock2_internal(M1&& m1, M2&& m2, CLockProfileScope& profile) -> std::pair<std::unique_ptr<boost::unique_lock<typename std::decay<decltype(m1)>::type>>, std::unique_ptr<boost::unique_lock<typename std::decay<decltype(m2)>::type>>>
 {
     auto res =
         std::make_pair(
             __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m1)>::type>>(m1, boost::defer_lock),
             __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m2)>::type>>(m2, boost::defer_lock));
-    boost::lock(*res.first, *res.second);
+    profile.Lock([&res]() { return boost::try_lock(*res.first, *res.second) == -1; },
+                 [&res]() { boost::lock(*res.first, *res.second); });
     return res;
 }
 
 template <typename M>
-auto _trylock_internal(M&& m) -> std::unique_ptr<boost::unique_lock<typename std::decay<decltype(m)>::type>> {
+auto _trylock_internal(M&& m, CLockProfileScope& profile) -> std::unique_ptr<boost::unique_lock<typename std::decay<decltype(m)>::type>> {
     auto lm = __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m)>::type>>(m, boost::defer_lock);
-    if (lm->try_lock()) {
+    if (profile.TryLock([&lm]() { return lm->try_lock(); })) {
         return lm;
     } else {
         return nullptr;
     }
 }
 
+template <typename M1, typename M2>
 using __Lock2ReturnType__ = boost::optional<std::pair<
-            std::unique_ptr<boost::unique_lock<CCriticalSection>>,
-            std::unique_ptr<boost::unique_lock<CCriticalSection>>
+            std::unique_ptr<boost::unique_lock<typename std::decay<M1>::type>>,
+            std::unique_ptr<boost::unique_lock<typename std::decay<M2>::type>>
             >
         >;
 
+// boost::try_lock() returns -1 when it locked all the mutexes, and otherwise the index of the one it
+// couldn't lock, after unlocking the others
 template <typename M1, typename M2>
-auto _trylock2_internal(M1&& m1, M2&& m2) -> __Lock2ReturnType__ {
-    auto res = __Lock2ReturnType__(std::make_pair(
+auto _trylock2_internal(M1&& m1, M2&& m2, CLockProfileScope& profile) -> __Lock2ReturnType__<M1, M2> {
+    auto res = __Lock2ReturnType__<M1, M2>(std::make_pair(
         __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m1)>::type>>(m1, boost::defer_lock),
         __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m2)>::type>>(m2, boost::defer_lock)));
-    if (boost::try_lock(*res->first, *res->second)) {
+    if (profile.TryLock([&res]() { return boost::try_lock(*res->first, *res->second) == -1; })) {
         return res;
     } else {
         return boost::none;
     }
 }
 
+template <typename M1, typename M2, typename M3, typename M4>
 using __Lock4ReturnType__ = boost::optional<std::tuple<
-            std::unique_ptr<boost::unique_lock<CCriticalSection>>,
-            std::unique_ptr<boost::unique_lock<CCriticalSection>>,
-            std::unique_ptr<boost::unique_lock<CCriticalSection>>,
-            std::unique_ptr<boost::unique_lock<CCriticalSection>>
+            std::unique_ptr<boost::unique_lock<typename std::decay<M1>::type>>,
+            std::unique_ptr<boost::unique_lock<typename std::decay<M2>::type>>,
+            std::unique_ptr<boost::unique_lock<typename std::decay<M3>::type>>,
+            std::unique_ptr<boost::unique_lock<typename std::decay<M4>::type>>
             >
         >;
 
 // Unfortunately, no variadic templates gymnastics until C++17...
 // we need std::apply to avoid having a function for every number of locks
 template <typename M1, typename M2, typename M3, typename M4>
-auto _trylock4_internal(M1&& m1, M2&& m2, M3&& m3, M4&& m4) -> __Lock4ReturnType__
+auto _trylock4_internal(M1&& m1, M2&& m2, M3&& m3, M4&& m4, CLockProfileScope& profile) -> __Lock4ReturnType__<M1, M2, M3, M4>
 {
-    auto res = __Lock4ReturnType__(std::make_tuple(
+    auto res = __Lock4ReturnType__<M1, M2, M3, M4>(std::make_tuple(
         __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m1)>::type>>(m1, boost::defer_lock),
         __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m2)>::type>>(m2, boost::defer_lock),
-        __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m2)>::type>>(m3, boost::defer_lock),
-        __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m3)>::type>>(m4, boost::defer_lock)));
-    if (boost::try_lock(*std::get<0>(*res),
-                        *std::get<1>(*res),
-                        *std::get<2>(*res),
-                        *std::get<3>(*res))) {
+        __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m3)>::type>>(m3, boost::defer_lock),
+        __InternalSyncMakeUnique<boost::unique_lock<typename std::decay<decltype(m4)>::type>>(m4, boost::defer_lock)));
+    if (profile.TryLock([&res]() {
+            return boost::try_lock(*std::get<0>(*res),
+                                   *std::get<1>(*res),
+                                   *std::get<2>(*res),
+                                   *std::get<3>(*res)) == -1;
+        })) {
         return res;
     } else {
         return boost::none;
     }
 }
 
-#define LOCK(cs) boost::lock_guard<decltype(cs)> __lockguard__(cs)
-#define LOCKN(cs, name) boost::lock_guard<decltype(cs)> name(cs)
-#define LOCK2(cs1, cs2) auto __lockguard2__ = _lock2_internal(cs1, cs2)
-#define LOCK2N(cs1, cs2, name) auto name = _lock2_internal(cs1, cs2)
-#define TRY_LOCK(cs, name) auto name = _trylock_internal(cs)
-#define TRY_LOCK2(cs1, cs2, name) auto name = _trylock2_internal(cs1, cs2)
-#define TRY_LOCK4(cs1, cs2, cs3, cs4, name) auto name = _trylock4_internal(cs1, cs2, cs3, cs4)
+// The profiling scope of the locks of LOCK2() and TRY_LOCK() is declared before them, so that it ends
+// after them, when it can tell how long they were held
+#define LOCK(cs) CLockGuard<typename std::decay<decltype(cs)>::type> __lockguard__(cs, _LOCK_SITE(#cs, false))
+#define LOCKN(cs, name) CLockGuard<typename std::decay<decltype(cs)>::type> name(cs, _LOCK_SITE(#cs, false))
+#define LOCK_SHARED(cs) CSharedLockGuard __sharedlockguard__(cs, _LOCK_SITE(#cs, true))
+#define LOCK2(cs1, cs2) \
+    CLockProfileScope __lockprofile2__(_LOCK_SITE(#cs1 ", " #cs2, false)); \
+    auto __lockguard2__ = _lock2_internal(cs1, cs2, __lockprofile2__)
+#define LOCK2N(cs1, cs2, name) \
+    CLockProfileScope __lockprofile_##name(_LOCK_SITE(#cs1 ", " #cs2, false)); \
+    auto name = _lock2_internal(cs1, cs2, __lockprofile_##name)
+#define TRY_LOCK(cs, name) \
+    CLockProfileScope __lockprofile_##name(_LOCK_SITE(#cs, false)); \
+    auto name = _trylock_internal(cs, __lockprofile_##name)
+#define TRY_LOCK2(cs1, cs2, name) \
+    CLockProfileScope __lockprofile_##name(_LOCK_SITE(#cs1 ", " #cs2, false)); \
+    auto name = _trylock2_internal(cs1, cs2, __lockprofile_##name)
+#define TRY_LOCK4(cs1, cs2, cs3, cs4, name) \
+    CLockProfileScope __lockprofile_##name(_LOCK_SITE(#cs1 ", " #cs2 ", " #cs3 ", " #cs4, false)); \
+    auto name = _trylock4_internal(cs1, cs2, cs3, cs4, __lockprofile_##name)
 
 #define ENTER_CRITICAL_SECTION(cs) \
     { \
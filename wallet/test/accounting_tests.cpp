@@ -143,4 +143,22 @@ TEST(accounting_tests, acc_orderupgrade)
     EXPECT_TRUE(results[4].strComment.empty());
     EXPECT_TRUE(results[5].nTime == 1333333334);
     EXPECT_TRUE(6 == vpwtx[1]->nOrderPos);
+
+    // the wallet's activity log follows the new order
+    ASSERT_EQ(wallet->wtxOrdered.size(), 7u);
+    int64_t nLastOrderPos = -1;
+    for (const auto& item : wallet->wtxOrdered) {
+        const int64_t nOrderPos =
+            item.second.first ? item.second.first->nOrderPos : item.second.second->nOrderPos;
+        EXPECT_EQ(item.first, nOrderPos);
+        EXPECT_GT(nOrderPos, nLastOrderPos);
+        nLastOrderPos = nOrderPos;
+    }
+
+    const uint256 erasedHash = vpwtx[0]->GetHash();
+    EXPECT_TRUE(wallet->EraseFromWallet(erasedHash));
+    EXPECT_EQ(wallet->wtxOrdered.size(), 6u);
+    for (const auto& item : wallet->wtxOrdered) {
+        EXPECT_TRUE(item.second.first == nullptr || item.second.first->GetHash() != erasedHash);
+    }
 }
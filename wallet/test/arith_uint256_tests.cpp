@@ -0,0 +1,197 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "arith_uint256.h"
+#include "bignum.h"
+#include "blockindex.h"
+#include "kernel.h"
+#include "main.h"
+#include "util.h"
+
+#include <vector>
+
+// arith_uint256 replaced CBigNum in the consensus code, so every result is compared with the one of
+// CBigNum, for the whole range of the inputs the consensus code can see
+
+static const CBigNum Pow256 = CBigNum(1) << 256;
+
+static CBigNum Abs(const CBigNum& bn) { return bn < 0 ? -bn : bn; }
+
+template <unsigned int BITS>
+static CBigNum ToBigNum(const arith_uint<BITS>& a, bool fNegative = false)
+{
+    CBigNum result;
+    result.SetHex(a.GetHex());
+    return fNegative ? -result : result;
+}
+
+static std::vector<unsigned int> CompactSamples()
+{
+    static const uint32_t mantissas[] = {0,       1,        0x7f,     0x80,     0xff,     0x100,
+                                         0x7fff,  0x8000,   0xffff,   0x10000,  0x123456, 0x7fffff,
+                                         0x12,    0x1234,   0x010000, 0x000100, 0x000001, 0x00ffff};
+    std::vector<unsigned int> result;
+    for (unsigned int nSize = 0; nSize <= 80; nSize++) {
+        for (uint32_t mantissa : mantissas) {
+            result.push_back(nSize << 24 | mantissa);
+            result.push_back(nSize << 24 | mantissa | 0x00800000);
+        }
+        for (int i = 0; i < 20; i++) {
+            result.push_back(nSize << 24 | static_cast<uint32_t>(GetRand(0x1000000)));
+        }
+    }
+    for (int i = 0; i < 2000; i++) {
+        result.push_back(static_cast<uint32_t>(GetRand(std::numeric_limits<uint32_t>::max())));
+    }
+    return result;
+}
+
+// a random value with a random number of bits, so that all the sizes are covered
+static arith_uint256 RandomArith()
+{
+    return UintToArith256(GetRandHash()) >> GetRandInt(257);
+}
+
+TEST(arith_uint256_tests, set_compact_matches_bignum)
+{
+    for (unsigned int nCompact : CompactSamples()) {
+        CBigNum bn;
+        bn.SetCompact(nCompact);
+
+        bool          fNegative;
+        bool          fOverflow;
+        arith_uint256 a;
+        a.SetCompact(nCompact, &fNegative, &fOverflow);
+
+        EXPECT_EQ(fNegative, bn < 0) << std::hex << nCompact;
+        EXPECT_EQ(fOverflow, Abs(bn) >= Pow256) << std::hex << nCompact;
+        if (!fOverflow) {
+            EXPECT_EQ(ToBigNum(a, fNegative), bn) << std::hex << nCompact;
+            EXPECT_EQ(a.GetCompact(fNegative), bn.GetCompact()) << std::hex << nCompact;
+        }
+
+        arith_uint512 a512;
+        a512.SetCompact(nCompact, &fNegative, &fOverflow);
+        EXPECT_EQ(fOverflow, Abs(bn) >= (CBigNum(1) << 512)) << std::hex << nCompact;
+        if (!fOverflow) {
+            EXPECT_EQ(ToBigNum(a512, fNegative), bn) << std::hex << nCompact;
+            EXPECT_EQ(a512.GetCompact(fNegative), bn.GetCompact()) << std::hex << nCompact;
+        }
+    }
+}
+
+TEST(arith_uint256_tests, get_compact_matches_bignum)
+{
+    EXPECT_EQ(arith_uint256(0).GetCompact(), CBigNum(0).GetCompact());
+    EXPECT_EQ(arith_uint256(0).GetCompact(true), CBigNum(0).GetCompact());
+    EXPECT_EQ((~arith_uint256(0)).GetCompact(), CBigNum(~uint256(0)).GetCompact());
+
+    for (int i = 0; i < 5000; i++) {
+        const arith_uint256 a = RandomArith();
+        EXPECT_EQ(a.GetCompact(), ToBigNum(a).GetCompact()) << a.GetHex();
+        EXPECT_EQ(a.GetCompact(true), ToBigNum(a, true).GetCompact()) << a.GetHex();
+    }
+}
+
+TEST(arith_uint256_tests, arithmetic_matches_bignum)
+{
+    for (int i = 0; i < 5000; i++) {
+        const arith_uint256 a = RandomArith();
+        const arith_uint256 b = RandomArith();
+        const CBigNum       bnA(ArithToUint256(a));
+        const CBigNum       bnB(ArithToUint256(b));
+
+        EXPECT_EQ(ArithToUint256(a * b), (bnA * bnB).getuint256());
+        EXPECT_EQ(ArithToUint256(a + b), (bnA + bnB).getuint256());
+        EXPECT_EQ(ToBigNum(arith_uint512(a) * arith_uint512(b)), bnA * bnB);
+        if (b != 0) {
+            EXPECT_EQ(ToBigNum(a / b), bnA / bnB);
+        }
+        if (a >= b) {
+            EXPECT_EQ(ToBigNum(a - b), bnA - bnB);
+        }
+        EXPECT_EQ(a < b, bnA < bnB);
+        EXPECT_EQ(a == b, bnA == bnB);
+
+        const unsigned int shift = GetRandInt(300);
+        EXPECT_EQ(ArithToUint256(a << shift), (bnA << shift).getuint256());
+        EXPECT_EQ(ToBigNum(a >> shift), bnA >> shift);
+    }
+}
+
+TEST(arith_uint256_tests, division_by_zero)
+{
+    EXPECT_THROW(arith_uint256(1) / arith_uint256(0), uint_error);
+    EXPECT_THROW(arith_uint512(0) / arith_uint512(0), uint_error);
+}
+
+TEST(arith_uint256_tests, uint256_conversion)
+{
+    for (int i = 0; i < 100; i++) {
+        const uint256 n = GetRandHash();
+        EXPECT_EQ(ArithToUint256(UintToArith256(n)), n);
+        EXPECT_EQ(UintToArith256(n).GetHex(), n.GetHex());
+    }
+}
+
+TEST(arith_uint256_tests, block_trust_matches_bignum)
+{
+    for (unsigned int nCompact : CompactSamples()) {
+        CBigNum bnTarget;
+        bnTarget.SetCompact(nCompact);
+        const uint256 expected = bnTarget <= 0 ? uint256(0) : (Pow256 / (bnTarget + 1)).getuint256();
+
+        CBlockIndex index;
+        index.nBits = nCompact;
+        EXPECT_EQ(index.GetBlockTrust(), expected) << std::hex << nCompact;
+    }
+}
+
+TEST(arith_uint256_tests, retarget_scaling_matches_bignum)
+{
+    static const int64_t factors[] = {1, 2, 30, 7080, 7320, 9450, -1, -30, -7080, -600000};
+    for (unsigned int nCompact : CompactSamples()) {
+        CBigNum bnTarget;
+        bnTarget.SetCompact(nCompact);
+        if (Abs(bnTarget) >= Pow256)
+            continue;
+        for (int64_t nMul : factors) {
+            for (int64_t nDiv : factors) {
+                CBigNum expected = bnTarget;
+                expected *= nMul;
+                expected /= nDiv;
+
+                bool                fNegative;
+                bool                fOverflow;
+                const arith_uint512 result =
+                    ScaleCompactTarget(nCompact, nMul, nDiv, fNegative, fOverflow);
+                EXPECT_FALSE(fOverflow);
+                EXPECT_EQ(ToBigNum(result, fNegative), expected) << std::hex << nCompact;
+                EXPECT_EQ(result.GetCompact(fNegative), expected.GetCompact()) << std::hex << nCompact;
+            }
+        }
+    }
+}
+
+TEST(arith_uint256_tests, stake_kernel_target_matches_bignum)
+{
+    static const int64_t values[]  = {0, 1, COIN, 1000 * COIN, 12345678901234, MAX_MONEY, -COIN};
+    static const int64_t weights[] = {0, 1, 24 * 60 * 60, 90 * 24 * 60 * 60, -1, -24 * 60 * 60};
+    const std::vector<unsigned int> compacts = CompactSamples();
+    for (int i = 0; i < 20000; i++) {
+        const unsigned int nBits       = compacts[GetRandInt(compacts.size())];
+        const int64_t      nValueIn    = values[GetRandInt(sizeof(values) / sizeof(values[0]))];
+        const int64_t      nTimeWeight = weights[GetRandInt(sizeof(weights) / sizeof(weights[0]))];
+        uint256            hash        = ArithToUint256(RandomArith());
+        if (i % 100 == 0)
+            hash = 0;
+
+        CBigNum bnTargetPerCoinDay;
+        bnTargetPerCoinDay.SetCompact(nBits);
+        const CBigNum bnCoinDayWeight = CBigNum(nValueIn) * nTimeWeight / COIN / (24 * 60 * 60);
+        const CBigNum bnTarget        = bnCoinDayWeight * bnTargetPerCoinDay;
+
+        const CStakeKernelTarget target(nBits, nValueIn, nTimeWeight);
+        EXPECT_EQ(target.GetTruncated(), bnTarget.getuint256()) << std::hex << nBits;
+        EXPECT_EQ(target.IsMetBy(hash), !(CBigNum(hash) > bnTarget)) << std::hex << nBits;
+    }
+}
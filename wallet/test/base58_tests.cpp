@@ -7,6 +7,7 @@
 #include "json/json_spirit_writer_template.h"
 
 #include "base58.h"
+#include "bignum.h"
 #include "util.h"
 
 using namespace json_spirit;
@@ -274,3 +275,133 @@ TEST(base58_tests, base58_keys_generation)
         }
     }
 }
+
+// The CBigNum codec that the byte-array one replaced, as the reference of the fuzz tests
+static const char* pszBase58Reference = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+static std::string EncodeBase58Reference(const std::vector<unsigned char>& vch)
+{
+    CAutoBN_CTX pctx;
+    CBigNum     bn58 = 58;
+    CBigNum     bn0  = 0;
+
+    std::vector<unsigned char> vchTmp(vch.size() + 1, 0);
+    reverse_copy(vch.begin(), vch.end(), vchTmp.begin());
+    CBigNum bn;
+    bn.setvch(vchTmp);
+
+    std::string str;
+    CBigNum     dv;
+    CBigNum     rem;
+    while (bn > bn0) {
+        if (!BN_div(dv.get_raw(), rem.get_raw(), bn.get_raw(), bn58.get_raw(), pctx))
+            throw bignum_error("EncodeBase58Reference : BN_div failed");
+        bn = dv;
+        str += pszBase58Reference[rem.getulong()];
+    }
+    for (std::size_t i = 0; i < vch.size() && vch[i] == 0; i++)
+        str += pszBase58Reference[0];
+    reverse(str.begin(), str.end());
+    return str;
+}
+
+static bool DecodeBase58Reference(const char* psz, std::vector<unsigned char>& vchRet)
+{
+    CAutoBN_CTX pctx;
+    vchRet.clear();
+    CBigNum bn58 = 58;
+    CBigNum bn   = 0;
+    CBigNum bnChar;
+    while (isspace(*psz))
+        psz++;
+    for (const char* p = psz; *p; p++) {
+        const char* p1 = strchr(pszBase58Reference, *p);
+        if (p1 == nullptr) {
+            while (isspace(*p))
+                p++;
+            if (*p != '\0')
+                return false;
+            break;
+        }
+        bnChar.setulong(p1 - pszBase58Reference);
+        if (!BN_mul(bn.get_raw(), bn.get_raw(), bn58.get_raw(), pctx))
+            throw bignum_error("DecodeBase58Reference : BN_mul failed");
+        bn += bnChar;
+    }
+    std::vector<unsigned char> vchTmp = bn.getvch();
+    if (vchTmp.size() >= 2 && vchTmp.end()[-1] == 0 && vchTmp.end()[-2] >= 0x80)
+        vchTmp.erase(vchTmp.end() - 1);
+    int nLeadingZeros = 0;
+    for (const char* p = psz; *p == pszBase58Reference[0]; p++)
+        nLeadingZeros++;
+    vchRet.assign(nLeadingZeros + vchTmp.size(), 0);
+    reverse_copy(vchTmp.begin(), vchTmp.end(), vchRet.end() - vchTmp.size());
+    return true;
+}
+
+static std::vector<unsigned char> RandomBytes()
+{
+    // mostly the sizes of addresses and keys, with leading zeroes and beyond the stack buffers
+    const int nSize = GetRandInt(10) == 0 ? GetRandInt(300) : GetRandInt(40);
+    std::vector<unsigned char> vch(nSize);
+    const int nZeroes = GetRandInt(4);
+    for (int i = 0; i < nSize; i++)
+        vch[i] = i < nZeroes ? 0 : static_cast<unsigned char>(GetRandInt(256));
+    return vch;
+}
+
+TEST(base58_tests, base58_encode_fuzz_against_bignum)
+{
+    EXPECT_EQ(EncodeBase58(std::vector<unsigned char>()), EncodeBase58Reference({}));
+    for (int i = 0; i < 20000; i++) {
+        const std::vector<unsigned char> vch = RandomBytes();
+        const std::string                str = EncodeBase58Reference(vch);
+        ASSERT_EQ(EncodeBase58(vch), str) << HexStr(vch);
+        ASSERT_EQ(EncodeBase58(vch.data(), vch.data() + vch.size()), str) << HexStr(vch);
+    }
+}
+
+TEST(base58_tests, base58_decode_fuzz_against_bignum)
+{
+    static const std::string strExtra = " \t\n0OIl+/-\xff";
+    for (int i = 0; i < 20000; i++) {
+        std::string str;
+        if (i % 4 == 0) {
+            // valid encodings, padded with whitespace
+            str = std::string(GetRandInt(3), ' ') + EncodeBase58Reference(RandomBytes()) +
+                  std::string(GetRandInt(3), ' ');
+        } else {
+            const int nSize = GetRandInt(60);
+            for (int j = 0; j < nSize; j++) {
+                const int r = GetRandInt(100);
+                if (r < 2)
+                    str += strExtra[GetRandInt(strExtra.size())];
+                else if (r < 10)
+                    str += pszBase58Reference[0];
+                else
+                    str += pszBase58Reference[GetRandInt(58)];
+            }
+        }
+        std::vector<unsigned char> result{1, 2, 3};
+        std::vector<unsigned char> expected;
+        const bool                 fExpected = DecodeBase58Reference(str.c_str(), expected);
+        ASSERT_EQ(DecodeBase58(str, result), fExpected) << str;
+        ASSERT_EQ(result, expected) << str;
+    }
+}
+
+TEST(base58_tests, base58_check_with_version)
+{
+    for (int i = 0; i < 1000; i++) {
+        const std::vector<unsigned char> vch      = RandomBytes();
+        const unsigned char              nVersion = static_cast<unsigned char>(GetRandInt(256));
+        std::vector<unsigned char>       vchFull(1, nVersion);
+        vchFull.insert(vchFull.end(), vch.begin(), vch.end());
+
+        const std::string str = EncodeBase58Check(nVersion, vch);
+        EXPECT_EQ(str, EncodeBase58Check(vchFull));
+        std::vector<unsigned char> result;
+        EXPECT_TRUE(DecodeBase58Check(str, result));
+        EXPECT_EQ(result, vchFull);
+    }
+}
@@ -0,0 +1,191 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "blockencodings.h"
+#include "script.h"
+#include "txmempool.h"
+#include "version.h"
+
+namespace {
+
+CTransaction MakeTx(unsigned salt)
+{
+    CTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout   = COutPoint(uint256(salt + 1), 0);
+    tx.vin[0].scriptSig = CScript() << static_cast<int64_t>(salt);
+    tx.vout.resize(1);
+    tx.vout[0].nValue       = salt * 100 + 1;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    return tx;
+}
+
+CBlock MakeBlock(unsigned nTxs)
+{
+    CBlock block;
+    block.nVersion      = CBlock::CURRENT_VERSION;
+    block.hashPrevBlock = uint256(0x1234);
+    block.nTime         = 1500000000;
+    block.nBits         = 0x1e0fffff;
+    block.nNonce        = 42;
+
+    CTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << 1000;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue       = 0;
+    coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    block.vtx.push_back(coinbase);
+
+    for (unsigned i = 1; i < nTxs; i++) {
+        block.vtx.push_back(MakeTx(i));
+    }
+    block.hashMerkleRoot = block.GetMerkleRoot();
+    block.vchBlockSig    = {0x01, 0x02, 0x03};
+    return block;
+}
+
+template <typename T>
+T RoundTrip(const T& obj)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << obj;
+    EXPECT_EQ(ss.size(), ::GetSerializeSize(obj, SER_NETWORK, PROTOCOL_VERSION));
+    T result;
+    ss >> result;
+    EXPECT_TRUE(ss.empty());
+    return result;
+}
+
+} // namespace
+
+TEST(blockencodings_tests, serialization)
+{
+    const CBlock block = MakeBlock(5);
+
+    const CBlockHeaderAndShortTxIDs cmpctblock(block);
+    ASSERT_EQ(cmpctblock.prefilledtxn.size(), 1u);
+    ASSERT_EQ(cmpctblock.shorttxids.size(), 4u);
+    EXPECT_EQ(cmpctblock.prefilledtxn[0].index, 0);
+
+    const CBlockHeaderAndShortTxIDs copy = RoundTrip(cmpctblock);
+    EXPECT_EQ(copy.header.GetHash(), block.GetHash());
+    EXPECT_EQ(copy.header.vchBlockSig, block.vchBlockSig);
+    EXPECT_EQ(copy.shorttxids, cmpctblock.shorttxids);
+    ASSERT_EQ(copy.prefilledtxn.size(), 1u);
+    EXPECT_EQ(copy.prefilledtxn[0].tx.GetHash(), block.vtx[0].GetHash());
+
+    // the short ids only fit in 48 bits, and the receiver computes the same ones
+    for (unsigned i = 1; i < block.vtx.size(); i++) {
+        EXPECT_EQ(copy.GetShortID(block.vtx[i].GetHash()), cmpctblock.shorttxids[i - 1]);
+        EXPECT_EQ(cmpctblock.shorttxids[i - 1] >> 48, 0u);
+    }
+
+    BlockTransactionsRequest req;
+    req.blockhash = block.GetHash();
+    req.indexes   = {0, 1, 5, 300, 65535};
+    const BlockTransactionsRequest reqCopy = RoundTrip(req);
+    EXPECT_EQ(reqCopy.blockhash, req.blockhash);
+    EXPECT_EQ(reqCopy.indexes, req.indexes);
+
+    // differentially encoded indexes can't exceed 16 bits
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << req.blockhash;
+    WriteCompactSize(ss, 2);
+    WriteCompactSize(ss, 65535);
+    WriteCompactSize(ss, 0);
+    BlockTransactionsRequest overflow;
+    EXPECT_THROW(ss >> overflow, std::ios_base::failure);
+}
+
+TEST(blockencodings_tests, reconstruct_from_mempool)
+{
+    const CBlock block = MakeBlock(5);
+
+    CTxMemPool pool;
+    for (unsigned i = 1; i < block.vtx.size(); i++) {
+        pool.addUnchecked(block.vtx[i].GetHash(), block.vtx[i]);
+    }
+    // unrelated transactions don't get in the way
+    pool.addUnchecked(MakeTx(100).GetHash(), MakeTx(100));
+
+    const CBlockHeaderAndShortTxIDs cmpctblock = RoundTrip(CBlockHeaderAndShortTxIDs(block));
+
+    PartiallyDownloadedBlock partial;
+    ASSERT_EQ(partial.InitData(cmpctblock, block.GetHash(), pool),
+              PartiallyDownloadedBlock::ReadStatus::OK);
+    EXPECT_EQ(partial.GetPrefilledCount(), 1u);
+    EXPECT_EQ(partial.GetMempoolCount(), 4u);
+    EXPECT_TRUE(partial.GetMissingIndexes().empty());
+
+    CBlock result;
+    ASSERT_EQ(partial.FillBlock(result, {}), PartiallyDownloadedBlock::ReadStatus::OK);
+    EXPECT_EQ(result.GetHash(), block.GetHash());
+    EXPECT_EQ(result.vchBlockSig, block.vchBlockSig);
+    ASSERT_EQ(result.vtx.size(), block.vtx.size());
+    for (unsigned i = 0; i < block.vtx.size(); i++) {
+        EXPECT_EQ(result.vtx[i].GetHash(), block.vtx[i].GetHash());
+    }
+}
+
+TEST(blockencodings_tests, missing_transactions)
+{
+    const CBlock block = MakeBlock(6);
+
+    CTxMemPool pool;
+    pool.addUnchecked(block.vtx[2].GetHash(), block.vtx[2]);
+    pool.addUnchecked(block.vtx[4].GetHash(), block.vtx[4]);
+
+    const CBlockHeaderAndShortTxIDs cmpctblock(block);
+
+    PartiallyDownloadedBlock partial;
+    ASSERT_EQ(partial.InitData(cmpctblock, block.GetHash(), pool),
+              PartiallyDownloadedBlock::ReadStatus::OK);
+    EXPECT_TRUE(partial.IsTxAvailable(0));
+    EXPECT_FALSE(partial.IsTxAvailable(1));
+    EXPECT_TRUE(partial.IsTxAvailable(2));
+
+    const std::vector<uint16_t> missing = partial.GetMissingIndexes();
+    ASSERT_EQ(missing, std::vector<uint16_t>({1, 3, 5}));
+
+    std::vector<CTransaction> vtxMissing;
+    for (uint16_t index : missing) {
+        vtxMissing.push_back(block.vtx[index]);
+    }
+
+    CBlock result;
+    // not enough transactions
+    EXPECT_EQ(partial.FillBlock(result, std::vector<CTransaction>(vtxMissing.begin(), vtxMissing.end() - 1)),
+              PartiallyDownloadedBlock::ReadStatus::INVALID);
+    // the wrong transactions, which could be the result of a short id collision
+    std::vector<CTransaction> vtxWrong = vtxMissing;
+    vtxWrong[1]                        = MakeTx(200);
+    EXPECT_EQ(partial.FillBlock(result, vtxWrong), PartiallyDownloadedBlock::ReadStatus::FAILED);
+
+    ASSERT_EQ(partial.FillBlock(result, vtxMissing), PartiallyDownloadedBlock::ReadStatus::OK);
+    EXPECT_EQ(result.GetHash(), block.GetHash());
+    EXPECT_EQ(result.GetMerkleRoot(), block.hashMerkleRoot);
+}
+
+TEST(blockencodings_tests, invalid_compact_blocks)
+{
+    const CBlock block = MakeBlock(3);
+    CTxMemPool   pool;
+
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock(block);
+        cmpctblock.prefilledtxn[0].index = 10;
+        PartiallyDownloadedBlock partial;
+        EXPECT_EQ(partial.InitData(cmpctblock, block.GetHash(), pool),
+                  PartiallyDownloadedBlock::ReadStatus::INVALID);
+    }
+
+    {
+        // two transactions of the block with the same short id
+        CBlockHeaderAndShortTxIDs cmpctblock(block);
+        cmpctblock.shorttxids[1] = cmpctblock.shorttxids[0];
+        PartiallyDownloadedBlock partial;
+        EXPECT_EQ(partial.InitData(cmpctblock, block.GetHash(), pool),
+                  PartiallyDownloadedBlock::ReadStatus::FAILED);
+    }
+}
@@ -210,6 +210,66 @@ TEST(bloom_tests, bloom_create_insert_key)
     EXPECT_TRUE(std::equal(stream.begin(), stream.end(), expected.begin()));
 }
 
+TEST(bloom_tests, bloom_insert_pointer_and_outpoint)
+{
+    CBloomFilter filterVector(10, 0.001, 5, BLOOM_UPDATE_ALL);
+    CBloomFilter filterPointer(10, 0.001, 5, BLOOM_UPDATE_ALL);
+
+    const vector<unsigned char> vKey = ParseHex("99108ad8ed9bb6274d3980bab5a85c048f0950c8");
+    filterVector.insert(vKey);
+    filterPointer.insert(vKey.data(), vKey.size());
+    EXPECT_TRUE(filterVector == filterPointer);
+    EXPECT_TRUE(filterPointer.contains(vKey.data(), vKey.size()));
+
+    // an outpoint is inserted as its serialization
+    const uint256   txid("0x90c122d70786e899529d71dbeba91ba216982fb6ba58f3bdaab65e73b7e9260b");
+    const COutPoint outpoint(txid, 7);
+    CDataStream     stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << outpoint;
+    filterVector.insert(vector<unsigned char>(stream.begin(), stream.end()));
+    filterPointer.insert(outpoint);
+    EXPECT_TRUE(filterVector == filterPointer);
+    EXPECT_TRUE(filterPointer.contains(outpoint));
+    EXPECT_FALSE(filterPointer.contains(COutPoint(outpoint.hash, 8)));
+
+    const uint256 hash("0xb4749f017444b051c44dfd2720e88f314ff94f3dd6d56d40ef65854fcd7fff6b");
+    filterVector.insert(vector<unsigned char>(hash.begin(), hash.end()));
+    filterPointer.insert(hash);
+    EXPECT_TRUE(filterVector == filterPointer);
+    EXPECT_TRUE(filterPointer.contains(hash));
+}
+
+TEST(bloom_tests, bloom_empty_filter)
+{
+    // a filter without data, as a peer can send it, matches everything instead of dividing by zero
+    CBloomFilter filter(1, 0.5, 0, BLOOM_UPDATE_ALL);
+    CDataStream  stream(ParseHex("0001000000000000000001"), SER_NETWORK, PROTOCOL_VERSION);
+    stream >> filter;
+    const vector<unsigned char> vKey = ParseHex("00");
+    filter.insert(vKey);
+    EXPECT_TRUE(filter.contains(vKey));
+}
+
+TEST(bloom_tests, bloom_add_insertions_of)
+{
+    CBloomFilter filter(10, 0.001, 5, BLOOM_UPDATE_ALL);
+    const vector<unsigned char> vAdded  = ParseHex("01");
+    const vector<unsigned char> vCopied = ParseHex("02");
+
+    CBloomFilter copy = filter;
+    filter.insert(vAdded);
+    copy.insert(vCopied);
+    EXPECT_TRUE(filter.AddInsertionsOf(copy));
+    EXPECT_TRUE(filter.contains(vAdded));
+    EXPECT_TRUE(filter.contains(vCopied));
+
+    // a filter that replaced the copied one isn't changed
+    CBloomFilter replaced(10, 0.001, 6, BLOOM_UPDATE_ALL);
+    const CBloomFilter before = replaced;
+    EXPECT_FALSE(replaced.AddInsertionsOf(copy));
+    EXPECT_TRUE(replaced == before);
+}
+
 TEST(bloom_tests, bloom_match)
 {
     SwitchNetworkTypeTemporarily state_holder(NetworkType::Testnet);
@@ -2,6 +2,8 @@
 
 #include "environment.h"
 
+#include "addressindex.h"
+#include "ntp1tokenindex.h"
 #include "boost/scope_exit.hpp"
 #include "curltools.h"
 #include "db/lmdb/lmdb.h"
@@ -10,6 +12,7 @@
 #include "txdb-lmdb.h"
 #include <boost/algorithm/string.hpp>
 #include <fstream>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -256,6 +259,58 @@ TEST(lmdb_tests, basic_multiple_read_in_tx)
     EXPECT_EQ(outs, std::vector<std::string>({}));
 }
 
+TEST(lmdb_tests, read_snapshot)
+{
+    const boost::filesystem::path p = Environment::GetTestsDataDir() / "test-txdb";
+
+    std::unique_ptr<IDB> db = MakeUnique<LMDB>(&p, true);
+
+    BOOST_SCOPE_EXIT(&db) { db->close(); }
+    BOOST_SCOPE_EXIT_END
+
+    std::string k1 = "key1";
+    std::string k2 = "key2";
+    std::string v1 = "val1";
+    std::string v2 = "val2";
+
+    EXPECT_TRUE(db->write(IDB::Index::DB_MAIN_INDEX, k1, v1));
+
+    {
+        LMDBReadSnapshot snapshot;
+        ASSERT_NE(LMDBReadSnapshot::Current(), nullptr);
+        {
+            // nested snapshots use the outer one
+            LMDBReadSnapshot inner;
+        }
+        ASSERT_NE(LMDBReadSnapshot::Current(), nullptr);
+
+        // changes done by other threads after the snapshot started aren't seen through it
+        std::thread writer([&]() {
+            EXPECT_EQ(LMDBReadSnapshot::Current(), nullptr);
+            EXPECT_TRUE(db->write(IDB::Index::DB_MAIN_INDEX, k1, v2));
+            EXPECT_TRUE(db->write(IDB::Index::DB_MAIN_INDEX, k2, v2));
+            boost::optional<std::string> out;
+            ASSERT_TRUE(out = db->read(IDB::Index::DB_MAIN_INDEX, k1));
+            EXPECT_EQ(*out, v2);
+        });
+        writer.join();
+
+        boost::optional<std::string> out;
+        ASSERT_TRUE(out = db->read(IDB::Index::DB_MAIN_INDEX, k1));
+        EXPECT_EQ(*out, v1);
+        EXPECT_FALSE(db->exists(IDB::Index::DB_MAIN_INDEX, k2));
+        boost::optional<std::map<std::string, std::string>> all;
+        ASSERT_TRUE(all = db->readAllUnique(IDB::Index::DB_MAIN_INDEX));
+        EXPECT_EQ(all->size(), 1u);
+    }
+    EXPECT_EQ(LMDBReadSnapshot::Current(), nullptr);
+
+    boost::optional<std::string> out;
+    ASSERT_TRUE(out = db->read(IDB::Index::DB_MAIN_INDEX, k1));
+    EXPECT_EQ(*out, v2);
+    EXPECT_TRUE(db->exists(IDB::Index::DB_MAIN_INDEX, k2));
+}
+
 TEST(lmdb_tests, basic_multiple_many_inputs)
 {
     const boost::filesystem::path p = Environment::GetTestsDataDir() / "test-txdb";
@@ -370,6 +425,131 @@ static void TestReadWriteUnique(IDB* db, const std::map<std::string, std::string
     EnsureDBIsEmpty(db, IDB::Index::DB_ADDRSVSPUBKEYS_INDEX);
 }
 
+TEST(lmdb_tests, read_range)
+{
+    const boost::filesystem::path p = Environment::GetTestsDataDir() / "test-txdb";
+
+    std::unique_ptr<IDB> db = MakeUnique<LMDB>(&p, true);
+
+    BOOST_SCOPE_EXIT(&db) { db->close(); }
+    BOOST_SCOPE_EXIT_END
+
+    auto serialize = [](const CAddressIndexKey& key) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << key;
+        return ss.str();
+    };
+
+    const CAddressIndexAddress addr1(AddressIndexType::KeyHash, uint160(1));
+    const CAddressIndexAddress addr2(AddressIndexType::ScriptHash, uint160(1));
+
+    // in little endian, 256 would be sorted before 1 and 255
+    const std::vector<int> heights = {70000, 256, 1, 255, 0};
+    for (int h : heights) {
+        EXPECT_TRUE(db->write(IDB::Index::DB_ADDRESSTX_INDEX,
+                              serialize(CAddressIndexKey(addr1, h, uint256(h), 0, false)),
+                              std::to_string(h)));
+        EXPECT_TRUE(db->write(IDB::Index::DB_ADDRESSTX_INDEX,
+                              serialize(CAddressIndexKey(addr2, h, uint256(h), 0, false)), "other"));
+    }
+
+    boost::optional<std::vector<std::pair<std::string, std::string>>> res;
+
+    ASSERT_TRUE(res = db->readRange(IDB::Index::DB_ADDRESSTX_INDEX,
+                                    serialize(CAddressIndexKey(addr1, 1, uint256(0), 0, false)),
+                                    serialize(CAddressIndexKey(addr1, 257, uint256(0), 0, false))));
+    ASSERT_EQ(res->size(), 3u);
+    EXPECT_EQ(res->at(0).second, "1");
+    EXPECT_EQ(res->at(1).second, "255");
+    EXPECT_EQ(res->at(2).second, "256");
+
+    // the whole address, without spilling into the next one
+    ASSERT_TRUE(
+        res = db->readRange(IDB::Index::DB_ADDRESSTX_INDEX,
+                            serialize(CAddressIndexKey(addr1, 0, uint256(0), 0, false)),
+                            serialize(CAddressIndexKey(addr1, 1000000, uint256(0), 0, false))));
+    ASSERT_EQ(res->size(), heights.size());
+    EXPECT_EQ(res->front().second, "0");
+    EXPECT_EQ(res->back().second, "70000");
+
+    ASSERT_TRUE(
+        res = db->readRange(IDB::Index::DB_ADDRESSTX_INDEX,
+                            serialize(CAddressIndexKey(addr1, 0, uint256(0), 0, false)),
+                            serialize(CAddressIndexKey(addr1, 1000000, uint256(0), 0, false)), 2));
+    EXPECT_EQ(res->size(), 2u);
+
+    // an empty range
+    ASSERT_TRUE(res = db->readRange(IDB::Index::DB_ADDRESSTX_INDEX,
+                                    serialize(CAddressIndexKey(addr1, 2, uint256(0), 0, false)),
+                                    serialize(CAddressIndexKey(addr1, 255, uint256(0), 0, false))));
+    EXPECT_TRUE(res->empty());
+
+    // the keys are read back as they were written
+    ASSERT_TRUE(res = db->readRange(IDB::Index::DB_ADDRESSTX_INDEX,
+                                    serialize(CAddressIndexKey(addr1, 256, uint256(0), 0, false)),
+                                    serialize(CAddressIndexKey(addr1, 257, uint256(0), 0, false))));
+    ASSERT_EQ(res->size(), 1u);
+    CAddressIndexKey key;
+    CDataStream      ss(res->front().first.data(), res->front().first.data() + res->front().first.size(),
+                        SER_DISK, CLIENT_VERSION);
+    ss >> key;
+    EXPECT_TRUE(key.address == addr1);
+    EXPECT_EQ(key.blockHeight, 256u);
+    EXPECT_EQ(key.txhash, uint256(256));
+}
+
+TEST(lmdb_tests, read_range_ntp1_token_transfers)
+{
+    const boost::filesystem::path p = Environment::GetTestsDataDir() / "test-txdb";
+
+    std::unique_ptr<IDB> db = MakeUnique<LMDB>(&p, true);
+
+    BOOST_SCOPE_EXIT(&db) { db->close(); }
+    BOOST_SCOPE_EXIT_END
+
+    auto serialize = [](const CNTP1TokenTransferKey& key) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << key;
+        return ss.str();
+    };
+
+    // a token id that's a prefix of another one doesn't get the transfers of the other one, because
+    // the serialized id starts with its length
+    const std::vector<std::string> tokenIds = {"La1", "La12", "La"};
+    for (const std::string& tokenId : tokenIds) {
+        for (int h : {5, 300, 1}) {
+            EXPECT_TRUE(db->write(IDB::Index::DB_NTP1TOKENTRANSFERS_INDEX,
+                                  serialize(CNTP1TokenTransferKey(tokenId, h, uint256(h), 0, false)),
+                                  tokenId));
+        }
+    }
+
+    boost::optional<std::vector<std::pair<std::string, std::string>>> res;
+
+    CNTP1TokenTransferKey keyEnd("La1", 0, uint256(0), 0, false);
+    keyEnd.blockHeight = std::numeric_limits<uint32_t>::max();
+    ASSERT_TRUE(res = db->readRange(IDB::Index::DB_NTP1TOKENTRANSFERS_INDEX,
+                                    serialize(CNTP1TokenTransferKey("La1", 0, uint256(0), 0, false)),
+                                    serialize(keyEnd)));
+    ASSERT_EQ(res->size(), 3u);
+    std::vector<uint32_t> heights;
+    for (const auto& kv : *res) {
+        EXPECT_EQ(kv.second, "La1");
+        CNTP1TokenTransferKey key;
+        CDataStream ss(kv.first.data(), kv.first.data() + kv.first.size(), SER_DISK, CLIENT_VERSION);
+        ss >> key;
+        heights.push_back(key.blockHeight);
+    }
+    EXPECT_EQ(heights, std::vector<uint32_t>({1, 5, 300}));
+
+    // a page of the transfers, as the RPC call reads it
+    ASSERT_TRUE(res = db->readRange(IDB::Index::DB_NTP1TOKENTRANSFERS_INDEX,
+                                    serialize(CNTP1TokenTransferKey("La1", 2, uint256(0), 0, false)),
+                                    serialize(keyEnd), 1));
+    ASSERT_EQ(res->size(), 1u);
+    EXPECT_EQ(res->front().first, serialize(CNTP1TokenTransferKey("La1", 5, uint256(5), 0, false)));
+}
+
 TEST(db_interface_impl_tests, read_write_unique)
 {
     static constexpr int MAX_ENTRIES = 20;
@@ -7,6 +7,7 @@
 #include "base58.h"
 #include "main.h"
 
+#include <limits>
 #include <vector>
 
 #include "googletest/googletest/include/gtest/gtest.h"
@@ -22,7 +23,7 @@ TEST(hash_tests, murmurhash3)
     // source of test data for their MurmurHash3() primitive during
     // development.
     //
-    // The magic number 0xFBA4C795 comes from CBloomFilter::Hash()
+    // The magic number 0xFBA4C795 is the step between the seeds of the hash functions of CBloomFilter
 
     T(0x00000000U, 0x00000000, "");
     T(0x6a396f08U, 0xFBA4C795, "");
@@ -43,3 +44,31 @@ TEST(hash_tests, murmurhash3)
 
 #undef T
 }
+
+TEST(hash_tests, murmurhash3_seeds)
+{
+    // every length of the tail and of the body, and numbers of seeds around the lanes
+    for (unsigned int nLen = 0; nLen <= 70; nLen++) {
+        std::vector<unsigned char> data(nLen);
+        for (unsigned char& c : data)
+            c = static_cast<unsigned char>(GetRandInt(256));
+        for (unsigned int nHashes : {0u, 1u, 3u, 4u, 7u, 8u, 9u, 16u, 17u, 50u}) {
+            const uint32_t nSeed = static_cast<uint32_t>(GetRand(std::numeric_limits<uint32_t>::max()));
+            std::vector<uint32_t> hashes(nHashes + 1, 0x12345678);
+            MurmurHash3Seeds(nSeed, 0xFBA4C795, data.data(), data.size(), hashes.data(), nHashes);
+            for (unsigned int i = 0; i < nHashes; i++) {
+                EXPECT_EQ(hashes[i], MurmurHash3(nSeed + i * 0xFBA4C795, data)) << nLen << " " << i;
+                EXPECT_EQ(hashes[i], MurmurHash3(nSeed + i * 0xFBA4C795, data.data(), data.size()));
+            }
+            // nothing is written past the hashes asked for
+            EXPECT_EQ(hashes[nHashes], 0x12345678u);
+        }
+    }
+}
+
+TEST(hash_tests, siphash_uint256)
+{
+    // reference vector of SipHash-2-4 with the key 00..0f and the message 00..1f
+    const uint256 val("0x1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100");
+    EXPECT_EQ(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, val), 0x7127512f72f27cceULL);
+}
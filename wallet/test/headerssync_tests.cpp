@@ -0,0 +1,317 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "environment.h"
+
+#include "arith_uint256.h"
+#include "block.h"
+#include "blockindex.h"
+#include "headerssync.h"
+#include "mocks/mtxdb.h"
+#include "ntp1/ntp1transaction.h"
+#include "util.h"
+#include <set>
+
+using ::testing::_;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+namespace {
+
+const int TipHeight = 50000000;
+
+struct HeadersSyncTest : public ::testing::Test
+{
+    NiceMock<mTxDB> txdb;
+    CBlockIndex     tip;
+
+    void SetUp() override
+    {
+        tip.blockHash   = uint256(0x1234);
+        tip.nHeight     = TipHeight;
+        tip.nTime       = static_cast<unsigned>(GetAdjustedTime() - 24 * 60 * 60);
+        tip.nChainTrust = 0;
+        tip.nBits       = Params().PoSLimit().GetCompact();
+
+        ON_CALL(txdb, ReadBlockIndex(_)).WillByDefault(Return(boost::none));
+        ON_CALL(txdb, ReadBlockIndex(tip.blockHash))
+            .WillByDefault(Return(boost::make_optional(tip)));
+        ON_CALL(txdb, GetBestChainHeight()).WillByDefault(Return(boost::make_optional(TipHeight)));
+        ON_CALL(txdb, GetBestChainTrust()).WillByDefault(Return(boost::make_optional(uint256(0))));
+    }
+
+    std::vector<CBlock> MakeHeaders(const uint256& prevHash, int64_t startTime, int count,
+                                    unsigned salt = 0,
+                                    unsigned nBits = Params().PoSLimit().GetCompact()) const
+    {
+        std::vector<CBlock> result;
+        uint256             prev = prevHash;
+        for (int i = 0; i < count; i++) {
+            CBlock header;
+            header.nVersion       = CBlock::CURRENT_VERSION;
+            header.hashPrevBlock  = prev;
+            header.hashMerkleRoot = uint256(i + 1 + salt * 100000);
+            header.nTime          = static_cast<uint32_t>(startTime + 60 * (i + 1));
+            header.nBits          = nBits;
+            header.nNonce         = 0;
+            prev                  = header.GetHash();
+            result.push_back(header);
+        }
+        return result;
+    }
+
+    static std::function<bool(const uint256&)> NoOrphans()
+    {
+        return [](const uint256&) { return false; };
+    }
+};
+
+} // namespace
+
+TEST_F(HeadersSyncTest, accept_connected_chain)
+{
+    CHeadersSync sync;
+
+    const std::vector<CBlock> headers = MakeHeaders(tip.blockHash, tip.nTime, 10);
+
+    const CHeadersSync::AcceptHeadersResult res = sync.AcceptHeaders(headers, txdb);
+    EXPECT_EQ(res.nDoS, 0);
+    EXPECT_EQ(res.nNew, 10u);
+    ASSERT_TRUE(res.lastHash);
+    EXPECT_EQ(*res.lastHash, headers.back().GetHash());
+    EXPECT_EQ(sync.GetBestHeaderHeight(), TipHeight + 10);
+    EXPECT_TRUE(sync.IsKnownHeader(headers.front().GetHash()));
+    // none of the blocks of the header chain is validated yet, so getblocks keeps running
+    EXPECT_FALSE(sync.IsSyncing(txdb, GetTime()));
+
+    // the same headers again are not new
+    const CHeadersSync::AcceptHeadersResult res2 = sync.AcceptHeaders(headers, txdb);
+    EXPECT_EQ(res2.nDoS, 0);
+    EXPECT_EQ(res2.nNew, 0u);
+    EXPECT_EQ(sync.GetBestHeaderHeight(), TipHeight + 10);
+}
+
+TEST_F(HeadersSyncTest, reject_invalid_headers)
+{
+    CHeadersSync sync;
+
+    {
+        // doesn't connect to anything, but only the first header, so it's not the peer's fault
+        const std::vector<CBlock> headers = MakeHeaders(uint256(0x5678), tip.nTime, 5);
+        const CHeadersSync::AcceptHeadersResult res = sync.AcceptHeaders(headers, txdb);
+        EXPECT_EQ(res.nDoS, 0);
+        EXPECT_EQ(res.nNew, 0u);
+        EXPECT_FALSE(res.lastHash);
+    }
+
+    {
+        // not a chain
+        std::vector<CBlock> headers = MakeHeaders(tip.blockHash, tip.nTime, 5);
+        headers[3].hashPrevBlock    = uint256(0x5678);
+        const CHeadersSync::AcceptHeadersResult res = sync.AcceptHeaders(headers, txdb);
+        EXPECT_EQ(res.nDoS, 20);
+        EXPECT_EQ(res.nNew, 3u);
+    }
+
+    {
+        // target above the proof-of-stake limit
+        std::vector<CBlock> headers = MakeHeaders(tip.blockHash, tip.nTime, 1, 1);
+        headers[0].nBits            = 0x207fffff;
+        const CHeadersSync::AcceptHeadersResult res = sync.AcceptHeaders(headers, txdb);
+        EXPECT_EQ(res.nDoS, 100);
+        EXPECT_EQ(res.nNew, 0u);
+    }
+
+    {
+        // too far in the future
+        const std::vector<CBlock> headers =
+            MakeHeaders(tip.blockHash, GetAdjustedTime() + 24 * 60 * 60, 1, 2);
+        const CHeadersSync::AcceptHeadersResult res = sync.AcceptHeaders(headers, txdb);
+        EXPECT_EQ(res.nDoS, 0);
+        EXPECT_EQ(res.nNew, 0u);
+    }
+
+    EXPECT_EQ(sync.GetBestHeaderHeight(), TipHeight + 3);
+}
+
+TEST_F(HeadersSyncTest, download_from_multiple_peers)
+{
+    CHeadersSync sync;
+
+    const std::vector<CBlock> headers =
+        MakeHeaders(tip.blockHash, tip.nTime, MAX_BLOCKS_IN_FLIGHT_PER_PEER * 3);
+    ASSERT_EQ(sync.AcceptHeaders(headers, txdb).nNew, headers.size());
+
+    const int64_t now = GetTime();
+
+    // received blocks that can't be connected yet wait in the orphans pool
+    std::set<uint256>                   orphans;
+    std::function<bool(const uint256&)> isOrphan = [&](const uint256& h) {
+        return orphans.count(h) > 0;
+    };
+
+    const std::vector<CInv> peer1 = sync.GetBlocksToDownload(1, TipHeight + 1000, txdb, isOrphan, now);
+    ASSERT_EQ(peer1.size(), static_cast<std::size_t>(MAX_BLOCKS_IN_FLIGHT_PER_PEER));
+    for (unsigned i = 0; i < peer1.size(); i++) {
+        EXPECT_EQ(peer1[i].type, MSG_BLOCK);
+        EXPECT_EQ(peer1[i].hash, headers[i].GetHash());
+    }
+
+    // the second peer gets the following blocks, up to its height
+    const std::vector<CInv> peer2 = sync.GetBlocksToDownload(
+        2, TipHeight + MAX_BLOCKS_IN_FLIGHT_PER_PEER + 5, txdb, isOrphan, now);
+    ASSERT_EQ(peer2.size(), 5u);
+    EXPECT_EQ(peer2.front().hash, headers[MAX_BLOCKS_IN_FLIGHT_PER_PEER].GetHash());
+
+    // nothing more for the first peer until something arrives
+    EXPECT_TRUE(sync.GetBlocksToDownload(1, TipHeight + 1000, txdb, isOrphan, now).empty());
+    sync.BlockReceived(peer1.front().hash, 1);
+    orphans.insert(peer1.front().hash);
+    const std::vector<CInv> peer1More =
+        sync.GetBlocksToDownload(1, TipHeight + 1000, txdb, isOrphan, now);
+    ASSERT_EQ(peer1More.size(), 1u);
+    EXPECT_EQ(peer1More.front().hash, headers[MAX_BLOCKS_IN_FLIGHT_PER_PEER + 5].GetHash());
+
+    // blocks that arrived unrequested are not requested again
+    orphans.insert(headers[MAX_BLOCKS_IN_FLIGHT_PER_PEER + 6].GetHash());
+    const std::vector<CInv> peer3 = sync.GetBlocksToDownload(3, TipHeight + 1000, txdb, isOrphan, now);
+    ASSERT_EQ(peer3.size(), static_cast<std::size_t>(MAX_BLOCKS_IN_FLIGHT_PER_PEER));
+    EXPECT_EQ(peer3.front().hash, headers[MAX_BLOCKS_IN_FLIGHT_PER_PEER + 7].GetHash());
+
+    // a disconnected peer's blocks go to others
+    sync.PeerDisconnected(2);
+    const std::vector<CInv> peer4 = sync.GetBlocksToDownload(4, TipHeight + 1000, txdb, isOrphan, now);
+    ASSERT_EQ(peer4.size(), 5u + headers.size() - (MAX_BLOCKS_IN_FLIGHT_PER_PEER * 2 + 7));
+    EXPECT_EQ(peer4.front().hash, headers[MAX_BLOCKS_IN_FLIGHT_PER_PEER].GetHash());
+}
+
+TEST_F(HeadersSyncTest, timeouts_and_invalid_blocks)
+{
+    CHeadersSync sync;
+
+    const std::vector<CBlock> headers = MakeHeaders(tip.blockHash, tip.nTime, 4);
+    ASSERT_EQ(sync.AcceptHeaders(headers, txdb).nNew, headers.size());
+
+    int64_t now = GetTime();
+    EXPECT_EQ(sync.GetBlocksToDownload(1, TipHeight + 1000, txdb, NoOrphans(), now).size(), 4u);
+    EXPECT_TRUE(sync.GetBlocksToDownload(2, TipHeight + 1000, txdb, NoOrphans(), now).empty());
+
+    // after the timeout, the blocks are requested from another peer
+    now += BLOCK_DOWNLOAD_TIMEOUT + 1;
+    EXPECT_EQ(sync.GetBlocksToDownload(2, TipHeight + 1000, txdb, NoOrphans(), now).size(), 4u);
+
+    // an invalid block takes its descendants with it
+    sync.BlockInvalid(headers[2].GetHash());
+    EXPECT_EQ(sync.GetBestHeaderHeight(), TipHeight + 2);
+    EXPECT_FALSE(sync.IsKnownHeader(headers[3].GetHash()));
+    EXPECT_EQ(sync.GetBlocksInFlightCount(), 2u);
+
+    // nobody delivers the block, so the header is dropped once enough peers failed to
+    for (int i = 0; i < MAX_BLOCK_DOWNLOAD_FAILURES - 1; i++) {
+        EXPECT_EQ(sync.GetBestHeaderHeight(), TipHeight + 2);
+        now += BLOCK_DOWNLOAD_TIMEOUT + 1;
+        sync.GetBlocksToDownload(3 + i, TipHeight + 1000, txdb, NoOrphans(), now);
+    }
+    EXPECT_EQ(sync.GetBestHeaderHeight(), -1);
+    EXPECT_FALSE(sync.IsSyncing(txdb, now));
+}
+
+TEST_F(HeadersSyncTest, slow_peers_get_fewer_blocks)
+{
+    CHeadersSync sync;
+
+    const std::vector<CBlock> headers = MakeHeaders(tip.blockHash, tip.nTime, 40);
+    ASSERT_EQ(sync.AcceptHeaders(headers, txdb).nNew, headers.size());
+
+    int64_t                 now   = GetTime();
+    const std::vector<CInv> slow1 = sync.GetBlocksToDownload(1, TipHeight + 2, txdb, NoOrphans(), now);
+    ASSERT_EQ(slow1.size(), 2u);
+
+    // the blocks go to another peer after the timeout
+    now += BLOCK_DOWNLOAD_TIMEOUT + 1;
+    const std::vector<CInv> peer2 =
+        sync.GetBlocksToDownload(2, TipHeight + 1000, txdb, NoOrphans(), now);
+    ASSERT_EQ(peer2.size(), static_cast<std::size_t>(MAX_BLOCKS_IN_FLIGHT_PER_PEER));
+    EXPECT_EQ(peer2.front().hash, headers[0].GetHash());
+
+    // the slow peer isn't asked for them again, and gets a block less at once for every timeout
+    const std::vector<CInv> slow2 =
+        sync.GetBlocksToDownload(1, TipHeight + 1000, txdb, NoOrphans(), now);
+    ASSERT_EQ(slow2.size(), static_cast<std::size_t>(MAX_BLOCKS_IN_FLIGHT_PER_PEER / 4));
+    EXPECT_EQ(slow2.front().hash, headers[MAX_BLOCKS_IN_FLIGHT_PER_PEER].GetHash());
+
+    // the headers are kept, the peer is slow, not lying
+    EXPECT_TRUE(sync.IsKnownHeader(headers[0].GetHash()));
+    EXPECT_EQ(sync.GetBestHeaderHeight(), TipHeight + 40);
+
+    // once it delivers again, it's back to the full number of blocks
+    sync.BlockReceived(slow2[0].hash, 1);
+    sync.BlockReceived(slow2[1].hash, 1);
+    const std::vector<CInv> slow3 =
+        sync.GetBlocksToDownload(1, TipHeight + 1000, txdb, NoOrphans(), now);
+    EXPECT_EQ(slow3.size(), static_cast<std::size_t>(MAX_BLOCKS_IN_FLIGHT_PER_PEER - 2));
+}
+
+TEST_F(HeadersSyncTest, connected_blocks_are_pruned)
+{
+    CHeadersSync sync;
+
+    const std::vector<CBlock> headers = MakeHeaders(tip.blockHash, tip.nTime, 3);
+    ASSERT_EQ(sync.AcceptHeaders(headers, txdb).nNew, headers.size());
+
+    // the first block got connected
+    CBlockIndex first;
+    first.blockHash = headers[0].GetHash();
+    first.nHeight   = TipHeight + 1;
+    ON_CALL(txdb, ReadBlockIndex(first.blockHash)).WillByDefault(Return(boost::make_optional(first)));
+    ON_CALL(txdb, GetBestChainHeight()).WillByDefault(Return(boost::make_optional(TipHeight + 1)));
+
+    const int64_t           now    = GetTime();
+    const std::vector<CInv> blocks =
+        sync.GetBlocksToDownload(1, TipHeight + 1000, txdb, NoOrphans(), now);
+    ASSERT_EQ(blocks.size(), 2u);
+    EXPECT_EQ(blocks.front().hash, headers[1].GetHash());
+    EXPECT_FALSE(sync.IsKnownHeader(headers[0].GetHash()));
+    EXPECT_TRUE(sync.IsSyncing(txdb, now));
+
+    // when no more blocks get connected, getblocks runs again
+    EXPECT_TRUE(sync.IsSyncing(txdb, now + HEADERS_SYNC_STALL_TIMEOUT));
+    EXPECT_FALSE(sync.IsSyncing(txdb, now + HEADERS_SYNC_STALL_TIMEOUT + 1));
+}
+
+TEST_F(HeadersSyncTest, made_up_proof_of_stake_targets)
+{
+    CHeadersSync sync;
+
+    const arith_uint256 bnLimit = Params().PoSLimit();
+
+    {
+        // much harder than the parent
+        const std::vector<CBlock> headers =
+            MakeHeaders(tip.blockHash, tip.nTime, 1, 1, (bnLimit / 16).GetCompact());
+        const CHeadersSync::AcceptHeadersResult res = sync.AcceptHeaders(headers, txdb);
+        EXPECT_EQ(res.nDoS, 100);
+        EXPECT_EQ(res.nNew, 0u);
+    }
+
+    const std::vector<CBlock> chainA = MakeHeaders(tip.blockHash, tip.nTime, 3, 2);
+    ASSERT_EQ(sync.AcceptHeaders(chainA, txdb).nNew, chainA.size());
+
+    // as hard as the retargeting allows, which would give more trust than chainA if it counted
+    std::vector<CBlock> chainB;
+    uint256             prev     = tip.blockHash;
+    arith_uint256       bnTarget = bnLimit;
+    for (int i = 0; i < 3; i++) {
+        bnTarget = bnTarget * 250 / 255;
+        chainB.push_back(MakeHeaders(prev, tip.nTime + 60 * i, 1, 3 + i, bnTarget.GetCompact()).front());
+        prev = chainB.back().GetHash();
+    }
+    const CHeadersSync::AcceptHeadersResult res = sync.AcceptHeaders(chainB, txdb);
+    EXPECT_EQ(res.nDoS, 0);
+    EXPECT_EQ(res.nNew, chainB.size());
+
+    // but the trust of proof-of-stake headers is capped at the one of the block they start from
+    const std::vector<CInv> blocks =
+        sync.GetBlocksToDownload(1, TipHeight + 1000, txdb, NoOrphans(), GetTime());
+    ASSERT_EQ(blocks.size(), chainA.size());
+    EXPECT_EQ(blocks.front().hash, chainA.front().GetHash());
+}
@@ -1,6 +1,8 @@
 #include "gmock/gmock.h"
 
+#include "addressindex.h"
 #include "itxdb.h"
+#include "ntp1tokenindex.h"
 #include "uint256.h"
 #include <boost/shared_ptr.hpp>
 #include <utility>
@@ -50,6 +52,43 @@ struct mTxDB : public ITxDB
     MOCK_METHOD(boost::optional<bool>, WasStakeSeen, ((const std::pair<COutPoint, unsigned int>& stake)),
                 (const, override));
     MOCK_METHOD(bool, WriteStakeSeen, ((const std::pair<COutPoint, unsigned int>& stake)), (override));
+    MOCK_METHOD(bool, WriteAddressIndex, ((const std::vector<std::pair<CAddressIndexKey, CAmount>>& entries)),
+                (override));
+    MOCK_METHOD(bool, EraseAddressIndex, ((const std::vector<std::pair<CAddressIndexKey, CAmount>>& entries)),
+                (override));
+    MOCK_METHOD(bool, UpdateAddressUnspentIndex,
+                ((const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& entries)),
+                (override));
+    MOCK_METHOD(bool, ReadAddressIndex,
+                (const CAddressIndexAddress& address, int startHeight, int endHeight,
+                 (std::vector<std::pair<CAddressIndexKey, CAmount>> & entries)),
+                (const, override));
+    MOCK_METHOD(bool, ReadAddressUnspentIndex,
+                (const CAddressIndexAddress& address,
+                 (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> & entries)),
+                (const, override));
+    MOCK_METHOD(bool, WriteNTP1TokenTransfers,
+                ((const std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries)),
+                (override));
+    MOCK_METHOD(bool, EraseNTP1TokenTransfers,
+                ((const std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries)),
+                (override));
+    MOCK_METHOD(bool, ReadNTP1TokenTransfers,
+                (const CNTP1TokenTransferKey& keyBegin, const CNTP1TokenTransferKey& keyEnd,
+                 std::size_t limit,
+                 (std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>> & entries)),
+                (const, override));
+    MOCK_METHOD(bool, UpdateNTP1TokenHolderBalances,
+                ((const std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>>& deltas)),
+                (override));
+    MOCK_METHOD(bool, ReadNTP1TokenHolders,
+                (const std::string& tokenId, const std::string& addressBegin, std::size_t limit,
+                 (std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>> & entries)),
+                (const, override));
+    MOCK_METHOD(bool, WriteOrphanBlock, (const uint256& hash, const CBlock& blk), (override));
+    MOCK_METHOD(bool, ReadOrphanBlock, (const uint256& hashPrev, const uint256& hash, CBlock& blk),
+                (const, override));
+    MOCK_METHOD(bool, EraseOrphanBlock, (const uint256& hashPrev, const uint256& hash), (override));
     MOCK_METHOD(bool, ReadBestInvalidTrust, (CBigNum & bnBestInvalidTrust), (const, override));
     MOCK_METHOD(bool, WriteBestInvalidTrust, (const CBigNum& bnBestInvalidTrust), (override));
     MOCK_METHOD((boost::optional<std::map<uint256, CBlockIndex>>), ReadAllBlockIndexEntries, (),
@@ -0,0 +1,110 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "net.h"
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+int RefCount(CNode& node)
+{
+    LOCK(cs_vNodes);
+    return node.GetRefCount();
+}
+
+// what a worker does when it's done with the node
+void Done(CNode* pnode)
+{
+    pnode->fMsgHandlerQueued = false;
+    LOCK(cs_vNodes);
+    pnode->Release();
+}
+
+std::vector<std::unique_ptr<CNode>> MakeNodes(int n)
+{
+    std::vector<std::unique_ptr<CNode>> nodes;
+    for (int i = 0; i < n; i++)
+        nodes.emplace_back(new CNode(i + 1, INVALID_SOCKET, CAddress()));
+    return nodes;
+}
+
+} // namespace
+
+TEST(msghandlerqueue_tests, node_is_queued_once)
+{
+    CMessageHandlerQueue queue;
+    CNode                node(1, INVALID_SOCKET, CAddress());
+
+    EXPECT_TRUE(queue.push(&node));
+    EXPECT_TRUE(node.fMsgHandlerQueued.load());
+    EXPECT_EQ(RefCount(node), 1);
+
+    // more messages from the same peer don't queue it again
+    EXPECT_FALSE(queue.push(&node));
+    EXPECT_EQ(queue.size(), 1u);
+    EXPECT_EQ(RefCount(node), 1);
+
+    // nor while a worker is serving it, so that its messages are processed by one thread in order
+    EXPECT_EQ(queue.pop(0), &node);
+    EXPECT_FALSE(queue.push(&node));
+    EXPECT_EQ(queue.size(), 0u);
+
+    Done(&node);
+    EXPECT_EQ(RefCount(node), 0);
+    EXPECT_TRUE(queue.push(&node));
+    EXPECT_EQ(queue.pop(0), &node);
+    Done(&node);
+}
+
+TEST(msghandlerqueue_tests, peers_are_served_in_order)
+{
+    CMessageHandlerQueue                queue;
+    std::vector<std::unique_ptr<CNode>> nodes = MakeNodes(3);
+
+    for (const auto& node : nodes)
+        EXPECT_TRUE(queue.push(node.get()));
+
+    // a peer that still has work after its turn goes behind the others
+    CNode* first = queue.pop(0);
+    EXPECT_EQ(first, nodes[0].get());
+    first->fMsgHandlerQueued = false;
+    EXPECT_TRUE(queue.push(first));
+    {
+        LOCK(cs_vNodes);
+        first->Release();
+    }
+
+    EXPECT_EQ(queue.pop(0), nodes[1].get());
+    EXPECT_EQ(queue.pop(0), nodes[2].get());
+    EXPECT_EQ(queue.pop(0), nodes[0].get());
+    EXPECT_EQ(queue.pop(0), nullptr);
+
+    for (const auto& node : nodes) {
+        Done(node.get());
+        EXPECT_EQ(RefCount(*node), 0);
+    }
+}
+
+TEST(msghandlerqueue_tests, clear)
+{
+    CMessageHandlerQueue                queue;
+    std::vector<std::unique_ptr<CNode>> nodes = MakeNodes(3);
+
+    for (const auto& node : nodes)
+        EXPECT_TRUE(queue.push(node.get()));
+    EXPECT_EQ(queue.size(), 3u);
+
+    queue.clear();
+    EXPECT_EQ(queue.size(), 0u);
+    EXPECT_EQ(queue.pop(10), nullptr);
+    for (const auto& node : nodes) {
+        EXPECT_FALSE(node->fMsgHandlerQueued.load());
+        EXPECT_EQ(RefCount(*node), 0);
+    }
+
+    // the nodes can be queued again
+    EXPECT_TRUE(queue.push(nodes[0].get()));
+    queue.clear();
+    EXPECT_EQ(RefCount(*nodes[0]), 0);
+}
@@ -7,6 +7,7 @@
 #include "curltools.h"
 #include "mocks/mtxdb.h"
 #include "ntp1/ntp1apicalls.h"
+#include "ntp1/ntp1metadatacache.h"
 #include "ntp1/ntp1script.h"
 #include "ntp1/ntp1script_burn.h"
 #include "ntp1/ntp1script_issuance.h"
@@ -3932,6 +3933,62 @@ TEST(ntp1_tests, ntp1_metadata_parsing_8)
     EXPECT_EQ(metadataObj.getTokenId(), "La37utZFe8P1fPc789szDp2QL7TMC7hyWERxr5");
 }
 
+TEST(ntp1_tests, ntp1_metadata_cache)
+{
+    const boost::filesystem::path cacheDir = Environment::GetTestsDataDir() / "ntp1cache";
+    boost::filesystem::remove_all(cacheDir);
+
+    NTP1MetadataCache cache(cacheDir);
+
+    const uint256 issuanceTxid1(1);
+    const uint256 issuanceTxid2(2);
+
+    json_spirit::Value node;
+    ASSERT_TRUE(json_spirit::read(
+        R"({"data":{"tokenName":"TST","description":"A test token","issuer":"Me","urls":[{"name":)"
+        R"("icon","url":"https://example.com/icon.png","mimeType":"image/png"}],"userData":{"x":1}}})",
+        node));
+
+    NTP1TokenMetaData metadata;
+    metadata.readSomeDataFromStandardJsonFormat(node);
+    metadata.setTokenId("La37utZFe8P1fPc789szDp2QL7TMC7hyWERxr5");
+    metadata.setIssuanceTxId(issuanceTxid1);
+
+    NTP1TokenMetaData  readMetadata;
+    json_spirit::Value readNode;
+    EXPECT_FALSE(cache.readMetadata(issuanceTxid1, readMetadata, readNode));
+
+    cache.writeMetadata(issuanceTxid1, metadata, node);
+    ASSERT_TRUE(cache.readMetadata(issuanceTxid1, readMetadata, readNode));
+    EXPECT_EQ(readMetadata, metadata);
+    EXPECT_EQ(json_spirit::write(readMetadata.exportDatabaseJsonData(true)),
+              json_spirit::write(metadata.exportDatabaseJsonData(true)));
+    EXPECT_EQ(json_spirit::write(readNode), json_spirit::write(node));
+    EXPECT_FALSE(cache.readMetadata(issuanceTxid2, readMetadata, readNode));
+
+    const std::string iconURL = metadata.getIconURL();
+    EXPECT_FALSE(cache.readIcon(issuanceTxid1, iconURL));
+    cache.writeIcon(issuanceTxid1, iconURL, "icon data");
+    cache.writeIcon(issuanceTxid2, iconURL, "icon data");
+    EXPECT_EQ(cache.readIcon(issuanceTxid1, iconURL).value_or(""), "icon data");
+    EXPECT_EQ(cache.readIcon(issuanceTxid2, iconURL).value_or(""), "icon data");
+    // the icon of another URL is a miss
+    EXPECT_FALSE(cache.readIcon(issuanceTxid1, "https://example.com/other.png"));
+
+    // the same icon is stored once, next to a reference per issuance
+    const auto iconFiles = std::distance(boost::filesystem::directory_iterator(cacheDir / "icons"),
+                                         boost::filesystem::directory_iterator());
+    EXPECT_EQ(iconFiles, 3);
+
+    const NTP1MetadataCache::Stats stats = cache.getStats();
+    EXPECT_EQ(stats.metadataHits, 1u);
+    EXPECT_EQ(stats.metadataMisses, 2u);
+    EXPECT_EQ(stats.iconHits, 2u);
+    EXPECT_EQ(stats.iconMisses, 2u);
+    EXPECT_EQ(stats.writes, 4u);
+    EXPECT_EQ(stats.writeFailures, 0u);
+}
+
 // TEST(ntp1_tests, total_fee_calculator)
 //{
 //    std::string txStr =
@@ -0,0 +1,189 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "environment.h"
+
+#include "block.h"
+#include "mocks/mtxdb.h"
+#include "ntp1/ntp1transaction.h"
+#include "orphanblockpool.h"
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::NiceMock;
+using ::testing::Return;
+using ::testing::SetArgReferee;
+
+namespace {
+
+struct OrphanBlockPoolTest : public ::testing::Test
+{
+    NiceMock<mTxDB> txdb;
+
+    static CBlock MakeBlock(const uint256& prevHash, unsigned salt)
+    {
+        CBlock block;
+        block.nVersion       = CBlock::CURRENT_VERSION;
+        block.hashPrevBlock  = prevHash;
+        block.hashMerkleRoot = uint256(salt + 1);
+        block.nTime          = 1500000000 + salt;
+        block.nBits          = Params().PoSLimit().GetCompact();
+        block.nNonce         = 0;
+        return block;
+    }
+
+    static std::size_t BlockSize()
+    {
+        return ::GetSerializeSize(MakeBlock(0, 0), SER_NETWORK, PROTOCOL_VERSION);
+    }
+
+    static COrphanBlockPool::Limits MakeLimits(std::size_t nMaxBlocks, std::size_t nMaxBytes)
+    {
+        COrphanBlockPool::Limits limits;
+        limits.nMaxBlocks       = nMaxBlocks;
+        limits.nMaxBytes        = nMaxBytes;
+        limits.nMaxBytesPerPeer = nMaxBytes;
+        limits.nMaxMemoryBytes  = nMaxBytes;
+        limits.fSpillToDisk     = false;
+        return limits;
+    }
+};
+
+} // namespace
+
+TEST_F(OrphanBlockPoolTest, chain_of_orphans)
+{
+    COrphanBlockPool pool;
+
+    const CBlock b1 = MakeBlock(uint256(0x1234), 1);
+    const CBlock b2 = MakeBlock(b1.GetHash(), 2);
+    const CBlock b3 = MakeBlock(b2.GetHash(), 3);
+
+    EXPECT_TRUE(pool.Add(b3, b3.GetHash(), 1, txdb));
+    EXPECT_TRUE(pool.Add(b1, b1.GetHash(), 1, txdb));
+    EXPECT_TRUE(pool.Add(b2, b2.GetHash(), 2, txdb));
+    EXPECT_FALSE(pool.Add(b2, b2.GetHash(), 2, txdb));
+
+    EXPECT_EQ(pool.Size(), 3u);
+    EXPECT_EQ(pool.Bytes(), 3 * BlockSize());
+    EXPECT_EQ(pool.PeerBytes(1), 2 * BlockSize());
+    EXPECT_EQ(pool.PeerBytes(2), BlockSize());
+
+    EXPECT_EQ(pool.GetRoot(b3.GetHash()), b1.GetHash());
+    EXPECT_EQ(pool.GetWantedBlock(b3.GetHash()), uint256(0x1234));
+    EXPECT_TRUE(pool.HasChildren(b1.GetHash()));
+    EXPECT_FALSE(pool.HasChildren(b3.GetHash()));
+
+    const std::vector<COrphanBlockPool::OrphanBlock> children = pool.TakeChildren(b1.GetHash(), txdb);
+    ASSERT_EQ(children.size(), 1u);
+    EXPECT_EQ(children[0].hash, b2.GetHash());
+    EXPECT_EQ(children[0].block->GetHash(), b2.GetHash());
+    EXPECT_FALSE(pool.Contains(b2.GetHash()));
+    EXPECT_EQ(pool.Size(), 2u);
+    EXPECT_EQ(pool.PeerBytes(2), 0u);
+}
+
+TEST_F(OrphanBlockPoolTest, evicts_the_leaf_of_the_least_recently_used)
+{
+    COrphanBlockPool pool;
+    pool.SetLimits(MakeLimits(3, 100 * BlockSize()));
+
+    const CBlock a1 = MakeBlock(uint256(0x1234), 1);
+    const CBlock a2 = MakeBlock(a1.GetHash(), 2);
+    const CBlock b  = MakeBlock(uint256(0x5678), 3);
+    const CBlock c  = MakeBlock(uint256(0x9abc), 4);
+    const CBlock d  = MakeBlock(uint256(0xdef0), 5);
+
+    ASSERT_TRUE(pool.Add(a1, a1.GetHash(), 1, txdb));
+    ASSERT_TRUE(pool.Add(b, b.GetHash(), 1, txdb));
+    ASSERT_TRUE(pool.Add(a2, a2.GetHash(), 1, txdb));
+
+    // a1 is the least recently used, but its chain is kept whole as long as possible
+    ASSERT_TRUE(pool.Add(c, c.GetHash(), 1, txdb));
+    EXPECT_TRUE(pool.Contains(a1.GetHash()));
+    EXPECT_FALSE(pool.Contains(a2.GetHash()));
+    EXPECT_EQ(pool.Size(), 3u);
+
+    // using an orphan moves it to the back of the queue
+    EXPECT_TRUE(pool.Touch(a1.GetHash()));
+    ASSERT_TRUE(pool.Add(d, d.GetHash(), 1, txdb));
+    EXPECT_TRUE(pool.Contains(a1.GetHash()));
+    EXPECT_FALSE(pool.Contains(b.GetHash()));
+    EXPECT_EQ(pool.Bytes(), 3 * BlockSize());
+}
+
+TEST_F(OrphanBlockPoolTest, byte_and_per_peer_limits)
+{
+    COrphanBlockPool         pool;
+    COrphanBlockPool::Limits limits = MakeLimits(100, 4 * BlockSize());
+    limits.nMaxBytesPerPeer         = 2 * BlockSize();
+    pool.SetLimits(limits);
+
+    std::vector<CBlock> blocks;
+    for (unsigned i = 0; i < 6; i++) {
+        blocks.push_back(MakeBlock(uint256(0x1000 + i), i));
+    }
+
+    // a peer only replaces its own orphans once it filled its share
+    ASSERT_TRUE(pool.Add(blocks[0], blocks[0].GetHash(), 2, txdb));
+    ASSERT_TRUE(pool.Add(blocks[1], blocks[1].GetHash(), 1, txdb));
+    ASSERT_TRUE(pool.Add(blocks[2], blocks[2].GetHash(), 1, txdb));
+    ASSERT_TRUE(pool.Add(blocks[3], blocks[3].GetHash(), 1, txdb));
+    EXPECT_TRUE(pool.Contains(blocks[0].GetHash()));
+    EXPECT_FALSE(pool.Contains(blocks[1].GetHash()));
+    EXPECT_EQ(pool.PeerBytes(1), 2 * BlockSize());
+    EXPECT_EQ(pool.Size(), 3u);
+
+    // when the whole pool is full, the least recently used orphan goes, whoever sent it
+    ASSERT_TRUE(pool.Add(blocks[4], blocks[4].GetHash(), 3, txdb));
+    ASSERT_TRUE(pool.Add(blocks[5], blocks[5].GetHash(), 3, txdb));
+    EXPECT_FALSE(pool.Contains(blocks[0].GetHash()));
+    EXPECT_EQ(pool.Bytes(), 4 * BlockSize());
+    EXPECT_EQ(pool.PeerBytes(2), 0u);
+
+    // a block that doesn't fit at all isn't stored
+    pool.SetLimits(MakeLimits(100, BlockSize() - 1));
+    const CBlock tooBig = MakeBlock(uint256(0x2000), 10);
+    EXPECT_FALSE(pool.Add(tooBig, tooBig.GetHash(), 1, txdb));
+    EXPECT_FALSE(pool.Contains(tooBig.GetHash()));
+}
+
+TEST_F(OrphanBlockPoolTest, spill_to_disk)
+{
+    COrphanBlockPool         pool;
+    COrphanBlockPool::Limits limits = MakeLimits(100, 100 * BlockSize());
+    limits.nMaxMemoryBytes          = BlockSize();
+    limits.fSpillToDisk             = true;
+    pool.SetLimits(limits);
+
+    const uint256 prevHash(0x1234);
+    const CBlock  b1 = MakeBlock(prevHash, 1);
+    const CBlock  b2 = MakeBlock(prevHash, 2);
+
+    EXPECT_CALL(txdb, WriteOrphanBlock(_, _)).Times(0);
+    ASSERT_TRUE(pool.Add(b1, b1.GetHash(), 1, txdb));
+    ::testing::Mock::VerifyAndClearExpectations(&txdb);
+
+    // the least recently used block goes to disk
+    EXPECT_CALL(txdb, WriteOrphanBlock(b1.GetHash(), _)).WillOnce(Return(true));
+    ASSERT_TRUE(pool.Add(b2, b2.GetHash(), 1, txdb));
+    ::testing::Mock::VerifyAndClearExpectations(&txdb);
+
+    EXPECT_EQ(pool.SpilledCount(), 1u);
+    EXPECT_EQ(pool.MemoryBytes(), BlockSize());
+    EXPECT_EQ(pool.Bytes(), 2 * BlockSize());
+    EXPECT_TRUE(pool.Contains(b1.GetHash()));
+
+    // and is read back from there when its previous block arrives
+    EXPECT_CALL(txdb, ReadOrphanBlock(prevHash, b1.GetHash(), _))
+        .WillOnce(DoAll(SetArgReferee<2>(b1), Return(true)));
+    EXPECT_CALL(txdb, EraseOrphanBlock(prevHash, b1.GetHash())).WillOnce(Return(true));
+    const std::vector<COrphanBlockPool::OrphanBlock> children = pool.TakeChildren(prevHash, txdb);
+    ASSERT_EQ(children.size(), 2u);
+    for (const COrphanBlockPool::OrphanBlock& child : children) {
+        EXPECT_EQ(child.block->GetHash(), child.hash);
+    }
+    EXPECT_EQ(pool.Size(), 0u);
+    EXPECT_EQ(pool.Bytes(), 0u);
+    EXPECT_EQ(pool.MemoryBytes(), 0u);
+    EXPECT_EQ(pool.SpilledCount(), 0u);
+}
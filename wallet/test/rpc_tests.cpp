@@ -4,6 +4,16 @@
 #include "base58.h"
 #include "util.h"
 #include "bitcoinrpc.h"
+#include "rpcserver.h"
+#include "script.h"
+
+#include <boost/asio/error.hpp>
+#include <boost/make_shared.hpp>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 using namespace std;
 using namespace json_spirit;
@@ -12,3 +22,421 @@ TEST(rpc_tests, ValueFromAmount)
 {
     EXPECT_EQ(ValueFromAmount(399999999).get_real(), 3.99999999);
 }
+
+TEST(rpc_tests, chunked_reply)
+{
+    // big enough to be split over several chunks
+    Array txs;
+    for (int i = 0; i < 5000; i++) {
+        Object tx;
+        tx.push_back(Pair("txid", uint256(i).GetHex()));
+        tx.push_back(Pair("value", ValueFromAmount(i * 1000)));
+        tx.push_back(Pair("comment", "line\nbreak \"quoted\" \xc3\xa9"));
+        txs.push_back(tx);
+    }
+    Object result;
+    result.push_back(Pair("height", 123));
+    result.push_back(Pair("tx", txs));
+
+    std::stringstream ss;
+    HTTPReplyChunked(ss, result, 7, true);
+    EXPECT_NE(ss.str().find("Transfer-Encoding: chunked\r\n"), std::string::npos);
+    EXPECT_EQ(ss.str().find("Content-Length"), std::string::npos);
+
+    map<string, string> mapHeaders;
+    string              strReply;
+    int                 nProto = 0;
+    EXPECT_EQ(ReadHTTP(ss, mapHeaders, strReply, &nProto), 200);
+    EXPECT_EQ(nProto, 1);
+    EXPECT_EQ(mapHeaders["connection"], "keep-alive");
+
+    // identical to what the buffered path produces
+    Object reply;
+    reply.push_back(Pair("result", result));
+    reply.push_back(Pair("error", Value::null));
+    reply.push_back(Pair("id", 7));
+    EXPECT_EQ(strReply, write_string(Value(reply), false) + "\n");
+    // and nothing is left behind on the connection
+    EXPECT_EQ(ss.peek(), EOF);
+}
+
+TEST(rpc_tests, read_http_chunked)
+{
+    std::stringstream ss("HTTP/1.1 200 OK\r\n"
+                         "Transfer-Encoding: chunked\r\n"
+                         "\r\n"
+                         "4;ext=1\r\n"
+                         "{\"a\"\r\n"
+                         "A\r\n"
+                         ":[1,2,3]}\n\r\n"
+                         "0\r\n"
+                         "Trailer: x\r\n"
+                         "\r\n");
+    map<string, string> mapHeaders;
+    string              strReply;
+    EXPECT_EQ(ReadHTTP(ss, mapHeaders, strReply), 200);
+    EXPECT_EQ(strReply, "{\"a\":[1,2,3]}\n");
+
+    std::stringstream bad("HTTP/1.1 200 OK\r\n"
+                          "Transfer-Encoding: chunked\r\n"
+                          "\r\n"
+                          "zz\r\n");
+    EXPECT_EQ(ReadHTTP(bad, mapHeaders, strReply), 500);
+}
+
+TEST(rpc_tests, getrpcstats)
+{
+    tableRPC.execute("getrpcstats", Array());
+    const Object stats = tableRPC.execute("getrpcstats", Array()).get_obj();
+
+    const Object& methods = find_value(stats, "methods").get_obj();
+    const Value&  self    = find_value(methods, "getrpcstats");
+    ASSERT_EQ(self.type(), obj_type);
+    const int64_t calls = find_value(self.get_obj(), "calls").get_int64();
+    EXPECT_GE(calls, 1);
+
+    // every call is in exactly one bucket
+    int64_t inBuckets = 0;
+    for (const Pair& bucket : find_value(self.get_obj(), "histogram_ms").get_obj())
+        inBuckets += bucket.value_.get_int64();
+    EXPECT_EQ(inBuckets, calls);
+}
+
+TEST(rpc_tests, getlockstats)
+{
+    ResetLockStats();
+    EnableLockStats(true);
+    {
+        CCriticalSection csRpcTest;
+        LOCK(csRpcTest);
+    }
+
+    Array params;
+    params.push_back(int64_t(1000));
+    params.push_back(true);
+    const Object stats = tableRPC.execute("getlockstats", params).get_obj();
+    EXPECT_TRUE(find_value(stats, "enabled").get_bool());
+
+    const Array& sites = find_value(stats, "sites").get_array();
+    auto         it    = std::find_if(sites.begin(), sites.end(), [](const Value& site) {
+        return find_value(site.get_obj(), "lock").get_str() == "csRpcTest";
+    });
+    ASSERT_NE(it, sites.end());
+    EXPECT_EQ(find_value(it->get_obj(), "acquisitions").get_int64(), 1);
+    int64_t inBuckets = 0;
+    for (const Pair& bucket : find_value(it->get_obj(), "hold_histogram_us").get_obj())
+        inBuckets += bucket.value_.get_int64();
+    EXPECT_EQ(inBuckets, 1);
+
+    // reset by the previous call
+    const Object statsAfterReset = tableRPC.execute("getlockstats", Array()).get_obj();
+    const Array& sitesAfterReset = find_value(statsAfterReset, "sites").get_array();
+    EXPECT_TRUE(std::none_of(sitesAfterReset.begin(), sitesAfterReset.end(), [](const Value& site) {
+        return find_value(site.get_obj(), "lock").get_str() == "csRpcTest";
+    }));
+    EnableLockStats(false);
+}
+
+namespace {
+
+// polls the condition for up to 10 seconds
+bool WaitFor(const std::function<bool()>& condition)
+{
+    for (int i = 0; i < 1000; i++) {
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+
+// Reads what the client sent from one buffer and keeps what the server writes in another
+class TestRPCStreamBuf : public std::streambuf
+{
+    std::string        input;
+    std::string        output;
+    mutable std::mutex mtx;
+
+public:
+    explicit TestRPCStreamBuf(const std::string& inputIn) : input(inputIn)
+    {
+        setg(&input[0], &input[0], &input[0] + input.size());
+    }
+
+    std::string written() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return output;
+    }
+
+protected:
+    int overflow(int c) override
+    {
+        if (c != EOF) {
+            std::lock_guard<std::mutex> lock(mtx);
+            output.push_back(static_cast<char>(c));
+        }
+        return c;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        output.append(s, n);
+        return n;
+    }
+};
+
+class TestRPCConnection : public AcceptedConnection
+{
+    TestRPCStreamBuf   buf;
+    std::iostream      _stream;
+    mutable std::mutex mtx;
+    bool               fClosed = false;
+    ReadableHandler    readableHandler;
+
+public:
+    explicit TestRPCConnection(const std::string& input) : buf(input), _stream(&buf) {}
+
+    std::iostream& stream() override { return _stream; }
+    std::string    peer_address_to_string() const override { return "127.0.0.1"; }
+    void           close() override
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fClosed = true;
+    }
+    void set_read_deadline(int64_t) override {}
+    void async_wait_readable(int64_t, ReadableHandler handler) override
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        readableHandler = handler;
+    }
+
+    bool closed() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return fClosed;
+    }
+    bool waitingForRequest() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return static_cast<bool>(readableHandler);
+    }
+    ReadableHandler takeReadableHandler()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ReadableHandler handler;
+        handler.swap(readableHandler);
+        return handler;
+    }
+    std::string written() const { return buf.written(); }
+};
+
+const std::string RPC_TEST_USER     = "rpctestuser";
+const std::string RPC_TEST_PASSWORD = "rpctestpasswordthatislongenough";
+
+// an HTTP/1.1 request, which keeps the connection open since it doesn't ask to close it
+std::string KeepAliveRequest(const std::string& strBody)
+{
+    return "POST / HTTP/1.1\r\n"
+           "Host: 127.0.0.1\r\n"
+           "Authorization: Basic " +
+           EncodeBase64(RPC_TEST_USER + ":" + RPC_TEST_PASSWORD) +
+           "\r\n"
+           "Content-Type: application/json\r\n"
+           "Content-Length: " +
+           std::to_string(strBody.size()) + "\r\n\r\n" + strBody;
+}
+
+// decodescript of OP_n, which is read-only and doesn't need the chain
+Value DecodeSmallIntRequest(int n, int id)
+{
+    Array params;
+    params.push_back(HexStr(CScript() << n));
+    Object req;
+    req.push_back(Pair("method", "decodescript"));
+    req.push_back(Pair("params", params));
+    req.push_back(Pair("id", id));
+    return req;
+}
+
+Value Request(const string& strMethod, int id)
+{
+    Object req;
+    req.push_back(Pair("method", strMethod));
+    req.push_back(Pair("params", Array()));
+    req.push_back(Pair("id", id));
+    return req;
+}
+
+void ExpectDecodedSmallInt(const Value& reply, int n, int id)
+{
+    ASSERT_EQ(reply.type(), obj_type);
+    EXPECT_EQ(find_value(reply.get_obj(), "id").get_int(), id);
+    EXPECT_EQ(find_value(reply.get_obj(), "error").type(), null_type);
+    const Value& result = find_value(reply.get_obj(), "result");
+    ASSERT_EQ(result.type(), obj_type);
+    EXPECT_EQ(find_value(result.get_obj(), "asm").get_str(), std::to_string(n));
+}
+
+} // namespace
+
+TEST(rpc_tests, full_work_queue_replies_503)
+{
+    std::shared_ptr<RPCWorkQueue> workQueue = std::make_shared<RPCWorkQueue>(1);
+
+    boost::shared_ptr<TestRPCConnection> first  = boost::make_shared<TestRPCConnection>("");
+    boost::shared_ptr<TestRPCConnection> second = boost::make_shared<TestRPCConnection>("");
+    RPCEnqueueConnection(workQueue, first);
+    RPCEnqueueConnection(workQueue, second);
+
+    // the first one waits for a worker
+    EXPECT_FALSE(first->closed());
+    EXPECT_EQ(first->written(), "");
+
+    // there's no room for the second one
+    EXPECT_TRUE(second->closed());
+    std::stringstream   reply(second->written());
+    map<string, string> mapHeaders;
+    string              strReply;
+    EXPECT_EQ(ReadHTTP(reply, mapHeaders, strReply), HTTP_SERVICE_UNAVAILABLE);
+    EXPECT_EQ(mapHeaders["connection"], "close");
+    EXPECT_EQ(strReply, "");
+
+    EXPECT_EQ(find_value(workQueue->ToJSON(), "rejected").get_int64(), 1);
+    EXPECT_EQ(find_value(workQueue->ToJSON(), "queue_depth").get_int64(), 1);
+
+    boost::shared_ptr<AcceptedConnection> conn;
+    EXPECT_TRUE(workQueue->Dequeue(conn));
+    EXPECT_EQ(conn, first);
+    workQueue->Interrupt();
+    EXPECT_FALSE(workQueue->Dequeue(conn));
+}
+
+TEST(rpc_tests, keep_alive_connection_is_reused)
+{
+    mapArgs.set("-rpcuser", RPC_TEST_USER);
+    mapArgs.set("-rpcpassword", RPC_TEST_PASSWORD);
+    ASSERT_TRUE(InitRPCAuthentication());
+
+    // the client sends its second request without waiting for the reply to the first one
+    boost::shared_ptr<TestRPCConnection> conn = boost::make_shared<TestRPCConnection>(
+        KeepAliveRequest("{\"method\":\"getrpcstats\",\"params\":[],\"id\":1}") +
+        KeepAliveRequest("{\"method\":\"getrpcstats\",\"params\":[],\"id\":2}"));
+
+    std::shared_ptr<RPCWorkQueue> workQueue = std::make_shared<RPCWorkQueue>(4);
+    RPCEnqueueConnection(workQueue, conn);
+    std::thread worker(ThreadRPCWorker, workQueue);
+
+    // both are served on the same connection, which then waits for the next request without a worker
+    EXPECT_TRUE(WaitFor([&]() { return conn->waitingForRequest(); }));
+    EXPECT_FALSE(conn->closed());
+
+    std::stringstream replies(conn->written());
+    for (int id = 1; id <= 2; id++) {
+        map<string, string> mapHeaders;
+        string              strReply;
+        EXPECT_EQ(ReadHTTP(replies, mapHeaders, strReply), HTTP_OK);
+        EXPECT_EQ(mapHeaders["connection"], "keep-alive");
+        Value reply;
+        ASSERT_TRUE(read_string(strReply, reply));
+        EXPECT_EQ(find_value(reply.get_obj(), "id").get_int(), id);
+        EXPECT_EQ(find_value(reply.get_obj(), "error").type(), null_type);
+    }
+    EXPECT_EQ(replies.peek(), EOF);
+
+    // a client that stays silent past the timeout is let go
+    AcceptedConnection::ReadableHandler onReadable = conn->takeReadableHandler();
+    onReadable(boost::asio::error::operation_aborted);
+    EXPECT_TRUE(conn->closed());
+
+    workQueue->Interrupt();
+    worker.join();
+
+    mapArgs.erase("-rpcuser");
+    mapArgs.erase("-rpcpassword");
+}
+
+TEST(rpc_tests, batch_state_executes_every_element_once)
+{
+    Array batch;
+    for (int i = 0; i < 16; i++)
+        batch.push_back(DecodeSmallIntRequest(i + 1, i));
+
+    RPCBatchState            state(batch);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+        threads.emplace_back([&state]() { state.Work(); });
+    for (std::thread& t : threads)
+        t.join();
+
+    EXPECT_EQ(state.nDone, batch.size());
+    EXPECT_GE(state.nNext.load(), batch.size());
+    // each thread stores its replies at the index of the request
+    for (int i = 0; i < 16; i++)
+        ExpectDecodedSmallInt(state.vResults[i], i + 1, i);
+}
+
+TEST(rpc_tests, read_only_batch_replies_in_order)
+{
+    std::shared_ptr<RPCBatchPool> pool = std::make_shared<RPCBatchPool>();
+    std::vector<std::thread>      threads;
+    for (int i = 0; i < 3; i++)
+        threads.emplace_back(RPCBatchPool::ThreadRPCBatch, pool);
+
+    Array batch;
+    for (int i = 0; i < 16; i++)
+        batch.push_back(DecodeSmallIntRequest(i + 1, 100 + i));
+
+    Value replies;
+    ASSERT_TRUE(read_string(JSONRPCExecBatch(batch, pool, 4), replies));
+    ASSERT_EQ(replies.type(), array_type);
+    ASSERT_EQ(replies.get_array().size(), batch.size());
+    for (int i = 0; i < 16; i++)
+        ExpectDecodedSmallInt(replies.get_array()[i], i + 1, 100 + i);
+
+    pool->Interrupt();
+    for (std::thread& t : threads)
+        t.join();
+}
+
+TEST(rpc_tests, mixed_batch_replies_in_order)
+{
+    std::shared_ptr<RPCBatchPool> pool = std::make_shared<RPCBatchPool>();
+    std::vector<std::thread>      threads;
+    for (int i = 0; i < 3; i++)
+        threads.emplace_back(RPCBatchPool::ThreadRPCBatch, pool);
+
+    // getrpcstats isn't read-only and the unknown method has no entry, so the batch runs in order on
+    // the serving thread
+    Array batch;
+    batch.push_back(DecodeSmallIntRequest(1, 0));
+    batch.push_back(Request("getrpcstats", 1));
+    batch.push_back(DecodeSmallIntRequest(2, 2));
+    batch.push_back(Request("nosuchmethod", 3));
+    batch.push_back(DecodeSmallIntRequest(3, 4));
+
+    Value replies;
+    ASSERT_TRUE(read_string(JSONRPCExecBatch(batch, pool, 4), replies));
+    ASSERT_EQ(replies.type(), array_type);
+    const Array& vReplies = replies.get_array();
+    ASSERT_EQ(vReplies.size(), batch.size());
+
+    ExpectDecodedSmallInt(vReplies[0], 1, 0);
+    ExpectDecodedSmallInt(vReplies[2], 2, 2);
+    ExpectDecodedSmallInt(vReplies[4], 3, 4);
+
+    EXPECT_EQ(find_value(vReplies[1].get_obj(), "id").get_int(), 1);
+    EXPECT_EQ(find_value(vReplies[1].get_obj(), "error").type(), null_type);
+    EXPECT_EQ(find_value(vReplies[1].get_obj(), "result").type(), obj_type);
+
+    // a failed element doesn't fail the rest of the batch
+    EXPECT_EQ(find_value(vReplies[3].get_obj(), "id").get_int(), 3);
+    const Value& error = find_value(vReplies[3].get_obj(), "error");
+    ASSERT_EQ(error.type(), obj_type);
+    EXPECT_EQ(find_value(error.get_obj(), "code").get_int(), RPC_METHOD_NOT_FOUND);
+
+    pool->Interrupt();
+    for (std::thread& t : threads)
+        t.join();
+}
@@ -0,0 +1,64 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "runtimeconfig.h"
+#include "util.h"
+
+TEST(runtimeconfig_tests, defaults_match_args)
+{
+    mapArgs.clear();
+    const CRuntimeConfig config = CRuntimeConfig::FromArgs();
+    const CRuntimeConfig defaults;
+
+    EXPECT_EQ(config.nMaxSigCacheSize, defaults.nMaxSigCacheSize);
+    EXPECT_FALSE(config.nBlockVersion);
+    EXPECT_FALSE(config.nBlockMaxSize);
+    EXPECT_EQ(config.nBlockPrioritySize, 27000);
+    EXPECT_EQ(config.nBanScore, 100);
+    EXPECT_EQ(config.nMaxConnections, 125);
+    EXPECT_EQ(config.nMaxOrphanTx, defaults.nMaxOrphanTx);
+    EXPECT_EQ(config.fCompactBlocks, defaults.fCompactBlocks);
+    EXPECT_TRUE(config.fHeadersFirst);
+    EXPECT_FALSE(config.fDisableSafeMode);
+    EXPECT_TRUE(config.fStaking);
+}
+
+TEST(runtimeconfig_tests, parse_like_getarg)
+{
+    mapArgs.clear();
+    mapArgs.set("-maxsigcachesize", "0");
+    mapArgs.set("-blockmaxsize", "250000");
+    mapArgs.set("-maxconnections", "12abc");
+    mapArgs.set("-disablesafemode", "");
+    mapArgs.set("-headersfirst", "0");
+    mapArgs.set("-staking", "1");
+
+    const CRuntimeConfig config = CRuntimeConfig::FromArgs();
+    EXPECT_EQ(config.nMaxSigCacheSize, GetArg("-maxsigcachesize", 50000));
+    ASSERT_TRUE(config.nBlockMaxSize);
+    EXPECT_EQ(*config.nBlockMaxSize, 250000);
+    EXPECT_FALSE(config.nBlockVersion);
+    EXPECT_EQ(config.nMaxConnections, GetArg("-maxconnections", 125));
+    EXPECT_TRUE(config.fDisableSafeMode);
+    EXPECT_FALSE(config.fHeadersFirst);
+    EXPECT_TRUE(config.fStaking);
+    mapArgs.clear();
+}
+
+TEST(runtimeconfig_tests, reload_publishes)
+{
+    mapArgs.clear();
+    mapArgs.set("-banscore", "7");
+    ReloadRuntimeConfig();
+    const CRuntimeConfig& first = GetRuntimeConfig();
+    EXPECT_EQ(first.nBanScore, 7);
+
+    mapArgs.set("-banscore", "8");
+    ReloadRuntimeConfig();
+    EXPECT_EQ(GetRuntimeConfig().nBanScore, 8);
+    // the previous snapshot stays valid for whoever holds it
+    EXPECT_EQ(first.nBanScore, 7);
+
+    mapArgs.clear();
+    ReloadRuntimeConfig();
+    EXPECT_EQ(GetRuntimeConfig().nBanScore, 100);
+}
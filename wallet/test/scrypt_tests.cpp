@@ -0,0 +1,85 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "environment.h"
+
+#include "block.h"
+#include "chainparams.h"
+#include "main.h"
+#include "scrypt.h"
+
+#include <vector>
+
+static const ScryptBatchKernel AllKernels[] = {ScryptBatchKernel::Single, ScryptBatchKernel::SSE2,
+                                               ScryptBatchKernel::AVX2};
+
+static std::vector<std::vector<unsigned char>> MakeHeaders(unsigned n)
+{
+    std::vector<std::vector<unsigned char>> result(n, std::vector<unsigned char>(80));
+    for (unsigned i = 0; i < n; i++) {
+        for (unsigned j = 0; j < 80; j++) {
+            result[i][j] = static_cast<unsigned char>(i * 131 + j * 7);
+        }
+    }
+    return result;
+}
+
+TEST(scrypt_tests, genesis_block_hash)
+{
+    SwitchNetworkTypeTemporarily state_holder(NetworkType::Mainnet);
+    const CBlock genesis = Params().GenesisBlock();
+    const void*  input   = CVOIDBEGIN(genesis.nVersion);
+    for (ScryptBatchKernel kernel : AllKernels) {
+        if (!scrypt_batch_kernel_supported(kernel))
+            continue;
+        uint256 hash;
+        scrypt_blockhash_batch(kernel, &input, &hash, 1);
+        EXPECT_EQ(hash, uint256("0x7286972be4dbc1463d256049b7471c252e6557e222cab9be73181d359cd28bcc"))
+            << scrypt_batch_kernel_name(kernel);
+    }
+}
+
+TEST(scrypt_tests, batch_matches_single)
+{
+    const unsigned maxCount = 19;
+
+    const std::vector<std::vector<unsigned char>> headers = MakeHeaders(maxCount);
+    std::vector<const void*>                      inputs;
+    std::vector<uint256>                          expected;
+    for (const std::vector<unsigned char>& header : headers) {
+        inputs.push_back(header.data());
+        expected.push_back(scrypt_blockhash(header.data()));
+    }
+
+    for (ScryptBatchKernel kernel : AllKernels) {
+        if (!scrypt_batch_kernel_supported(kernel))
+            continue;
+        // every count covers a different mix of full kernels, partly filled kernels and single hashes
+        for (unsigned n = 0; n <= maxCount; n++) {
+            std::vector<uint256> hashes(maxCount);
+            scrypt_blockhash_batch(kernel, inputs.data(), hashes.data(), n);
+            for (unsigned i = 0; i < n; i++) {
+                EXPECT_EQ(hashes[i], expected[i])
+                    << scrypt_batch_kernel_name(kernel) << " n=" << n << " i=" << i;
+            }
+            for (unsigned i = n; i < maxCount; i++) {
+                EXPECT_EQ(hashes[i], 0);
+            }
+        }
+    }
+}
+
+TEST(scrypt_tests, block_get_hashes)
+{
+    std::vector<CBlock> blocks(11);
+    for (unsigned i = 0; i < blocks.size(); i++) {
+        blocks[i].nVersion = 6;
+        blocks[i].nTime    = 1500000000 + i;
+        blocks[i].nBits    = 0x1e0fffff;
+        blocks[i].nNonce   = i * 7919;
+    }
+    const std::vector<uint256> hashes = CBlock::GetHashes(blocks);
+    ASSERT_EQ(hashes.size(), blocks.size());
+    for (unsigned i = 0; i < blocks.size(); i++) {
+        EXPECT_EQ(hashes[i], blocks[i].GetHash());
+    }
+}
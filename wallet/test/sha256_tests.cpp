@@ -0,0 +1,125 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "hash.h"
+#include "merkle.h"
+#include "sha256.h"
+#include "util.h"
+
+#include <openssl/sha.h>
+#include <vector>
+
+static const Sha256Implementation AllImplementations[] = {
+    Sha256Implementation::Generic, Sha256Implementation::OpenSSL, Sha256Implementation::SSE41,
+    Sha256Implementation::AVX2, Sha256Implementation::SHANI};
+
+static std::vector<unsigned char> MakeData(std::size_t size)
+{
+    std::vector<unsigned char> result(size);
+    for (std::size_t i = 0; i < size; i++) {
+        result[i] = static_cast<unsigned char>((i * 2654435761u) >> 11);
+    }
+    return result;
+}
+
+/** restores the implementations chosen for the CPU when a test ends */
+struct Sha256ImplementationRestorer
+{
+    ~Sha256ImplementationRestorer() { SHA256AutoDetect(); }
+};
+
+TEST(sha256_tests, known_answers)
+{
+    Sha256ImplementationRestorer restorer;
+    for (Sha256Implementation impl : AllImplementations) {
+        if (!SHA256UseImplementation(impl))
+            continue;
+        uint256 hash;
+        CSHA256().Finalize(hash.begin());
+        EXPECT_EQ(HexStr(hash.begin(), hash.end()),
+                  "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855")
+            << Sha256ImplementationName(impl);
+        const std::string abc = "abc";
+        CSHA256().Write((const unsigned char*)abc.data(), abc.size()).Finalize(hash.begin());
+        EXPECT_EQ(HexStr(hash.begin(), hash.end()),
+                  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad")
+            << Sha256ImplementationName(impl);
+    }
+}
+
+TEST(sha256_tests, matches_openssl)
+{
+    Sha256ImplementationRestorer     restorer;
+    const std::vector<unsigned char> data = MakeData(1000);
+    for (Sha256Implementation impl : AllImplementations) {
+        if (!SHA256UseImplementation(impl))
+            continue;
+        for (std::size_t len = 0; len <= data.size(); len += (len < 200 ? 1 : 37)) {
+            unsigned char expected[32];
+            SHA256(data.data(), len, expected);
+
+            // written in uneven pieces, to cover the buffering
+            unsigned char  hash[32];
+            CSHA256        hasher;
+            const unsigned piece = len / 3;
+            hasher.Write(data.data(), piece).Write(data.data() + piece, len - piece).Finalize(hash);
+            EXPECT_EQ(HexStr(hash, hash + 32), HexStr(expected, expected + 32))
+                << Sha256ImplementationName(impl) << " len=" << len;
+        }
+    }
+}
+
+TEST(sha256_tests, d64_matches_double_hash)
+{
+    Sha256ImplementationRestorer     restorer;
+    const unsigned                   maxBlocks = 35;
+    const std::vector<unsigned char> data      = MakeData(64 * maxBlocks);
+    for (Sha256Implementation impl : AllImplementations) {
+        if (!SHA256UseImplementation(impl))
+            continue;
+        // every count covers a different mix of 8-lane, 4-lane and single blobs
+        for (unsigned n = 0; n <= maxBlocks; n++) {
+            std::vector<uint256> hashes(n);
+            SHA256D64(hashes.data()->begin(), data.data(), n);
+            std::vector<unsigned char> inPlace(data.begin(), data.begin() + 64 * n);
+            SHA256D64(inPlace.data(), inPlace.data(), n);
+            for (unsigned i = 0; i < n; i++) {
+                const uint256 expected = Hash(data.begin() + 64 * i, data.begin() + 64 * (i + 1));
+                EXPECT_EQ(hashes[i], expected) << Sha256ImplementationName(impl) << " n=" << n;
+                EXPECT_EQ(uint256(std::vector<unsigned char>(inPlace.begin() + 32 * i,
+                                                             inPlace.begin() + 32 * (i + 1))),
+                          expected)
+                    << Sha256ImplementationName(impl) << " n=" << n;
+            }
+        }
+    }
+}
+
+TEST(sha256_tests, merkle_root_matches_pairwise_hashing)
+{
+    Sha256ImplementationRestorer restorer;
+    for (Sha256Implementation impl : AllImplementations) {
+        if (!SHA256UseImplementation(impl))
+            continue;
+        for (unsigned n = 1; n <= 40; n++) {
+            std::vector<uint256> leaves;
+            for (unsigned i = 0; i < n; i++) {
+                leaves.push_back(Hash(BEGIN(i), END(i)));
+            }
+
+            std::vector<uint256> tree = leaves;
+            std::vector<uint256> level = leaves;
+            while (level.size() > 1) {
+                std::vector<uint256> next;
+                for (unsigned i = 0; i < level.size(); i += 2) {
+                    const uint256& right = level[std::min<std::size_t>(i + 1, level.size() - 1)];
+                    next.push_back(Hash(level[i].begin(), level[i].end(), right.begin(), right.end()));
+                }
+                tree.insert(tree.end(), next.begin(), next.end());
+                level = next;
+            }
+
+            EXPECT_EQ(ComputeMerkleRoot(leaves), level[0]) << Sha256ImplementationName(impl) << " n=" << n;
+            EXPECT_EQ(ConstructMerkleTree(leaves), tree) << Sha256ImplementationName(impl) << " n=" << n;
+        }
+    }
+}
@@ -0,0 +1,272 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "sync.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// whether another thread can take the lock right now, exclusively or shared
+static bool TryLockFromOtherThread(CSharedCriticalSection& cs, bool fShared)
+{
+    bool fLocked = false;
+    std::thread t([&]() {
+        if (fShared) {
+            fLocked = cs.try_lock_shared();
+            if (fLocked)
+                cs.unlock_shared();
+        } else {
+            fLocked = cs.try_lock();
+            if (fLocked)
+                cs.unlock();
+        }
+    });
+    t.join();
+    return fLocked;
+}
+
+TEST(sync_tests, shared_critical_section_exclusive_is_recursive)
+{
+    CSharedCriticalSection cs;
+    {
+        LOCK(cs);
+        EXPECT_TRUE(cs.IsLockedExclusivelyByThisThread());
+        {
+            LOCK(cs);
+            LOCK_SHARED(cs);
+            EXPECT_TRUE(cs.try_lock_shared());
+            cs.unlock_shared();
+            EXPECT_TRUE(cs.try_lock());
+            cs.unlock();
+            EXPECT_FALSE(TryLockFromOtherThread(cs, false));
+            EXPECT_FALSE(TryLockFromOtherThread(cs, true));
+        }
+        EXPECT_TRUE(cs.IsLockedExclusivelyByThisThread());
+        EXPECT_FALSE(TryLockFromOtherThread(cs, true));
+    }
+    EXPECT_FALSE(cs.IsLockedByThisThread());
+    EXPECT_TRUE(TryLockFromOtherThread(cs, false));
+}
+
+TEST(sync_tests, shared_critical_section_shared)
+{
+    CSharedCriticalSection cs;
+    {
+        LOCK_SHARED(cs);
+        EXPECT_TRUE(cs.IsLockedByThisThread());
+        EXPECT_FALSE(cs.IsLockedExclusivelyByThisThread());
+        {
+            LOCK_SHARED(cs);
+            EXPECT_TRUE(cs.try_lock_shared());
+            cs.unlock_shared();
+            EXPECT_TRUE(TryLockFromOtherThread(cs, true));
+            EXPECT_FALSE(TryLockFromOtherThread(cs, false));
+        }
+        EXPECT_TRUE(cs.IsLockedByThisThread());
+        EXPECT_FALSE(TryLockFromOtherThread(cs, false));
+
+        // upgrading would deadlock with another reader doing the same
+        EXPECT_FALSE(cs.try_lock());
+    }
+    EXPECT_FALSE(cs.IsLockedByThisThread());
+    EXPECT_TRUE(TryLockFromOtherThread(cs, false));
+}
+
+TEST(sync_tests, shared_critical_section_readers_run_together)
+{
+    CSharedCriticalSection cs;
+    std::atomic<int>       nReaders{0};
+    std::atomic<int>       nMaxReaders{0};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&]() {
+            LOCK_SHARED(cs);
+            nMaxReaders = std::max(nMaxReaders.load(), ++nReaders);
+            // every reader waits for all the others, which only ends if they hold the lock together
+            while (nMaxReaders.load() < 4)
+                std::this_thread::yield();
+            --nReaders;
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+    EXPECT_EQ(nMaxReaders.load(), 4);
+}
+
+TEST(sync_tests, shared_critical_section_writers_exclude_each_other)
+{
+    CSharedCriticalSection cs;
+    int                    nCounter = 0;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 10000; j++) {
+                if (j % 2 == 0) {
+                    LOCK(cs);
+                    nCounter++;
+                } else {
+                    LOCK2(cs, cs);
+                    nCounter++;
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+    EXPECT_EQ(nCounter, 40000);
+}
+
+TEST(sync_tests, try_lock_macros)
+{
+    CSharedCriticalSection cs1;
+    CCriticalSection       cs2;
+    {
+        TRY_LOCK2(cs1, cs2, lock);
+        EXPECT_TRUE(lock);
+        EXPECT_TRUE(cs1.IsLockedExclusivelyByThisThread());
+    }
+    EXPECT_FALSE(cs1.IsLockedByThisThread());
+    {
+        LOCK_SHARED(cs1);
+        TRY_LOCK(cs1, lock);
+        EXPECT_FALSE(lock);
+    }
+}
+
+static const CLockSiteStats* FindLockSite(const std::vector<CLockSiteStats>& stats,
+                                          const std::string& name, bool fShared)
+{
+    auto it = std::find_if(stats.begin(), stats.end(), [&](const CLockSiteStats& s) {
+        return s.name == name && s.fShared == fShared;
+    });
+    return it == stats.end() ? nullptr : &*it;
+}
+
+static uint64_t Sum(const std::vector<uint64_t>& v)
+{
+    uint64_t result = 0;
+    for (uint64_t n : v)
+        result += n;
+    return result;
+}
+
+TEST(sync_tests, lock_stats_per_site)
+{
+    CSharedCriticalSection  cs;
+    CSharedCriticalSection& csNested = cs;
+    CCriticalSection        cs1;
+    CCriticalSection        cs2;
+    ResetLockStats();
+    EnableLockStats(true);
+
+    for (int i = 0; i < 3; i++) {
+        LOCK_SHARED(cs);
+        {
+            LOCK_SHARED(csNested);
+        }
+    }
+    {
+        LOCK(cs);
+    }
+    {
+        LOCK2(cs1, cs2);
+    }
+    {
+        LOCK_SHARED(cs);
+        TRY_LOCK(cs, lockUpgrade);
+        EXPECT_FALSE(lockUpgrade);
+    }
+    EnableLockStats(false);
+    {
+        LOCK(cs);
+    }
+
+    const std::vector<CLockSiteStats> stats = GetLockStats();
+    EXPECT_EQ(stats.size(), 6u);
+
+    const CLockSiteStats* shared = FindLockSite(stats, "cs", true);
+    ASSERT_NE(shared, nullptr);
+    EXPECT_EQ(shared->file, __FILE__);
+    EXPECT_EQ(shared->nAcquisitions, 3u);
+    EXPECT_EQ(shared->nContended, 0u);
+    EXPECT_EQ(Sum(shared->waitHistogram), 3u);
+    EXPECT_EQ(Sum(shared->holdHistogram), 3u);
+    EXPECT_LE(shared->nMaxHoldMicros, shared->nHoldMicros);
+
+    const CLockSiteStats* nested = FindLockSite(stats, "csNested", true);
+    ASSERT_NE(nested, nullptr);
+    EXPECT_EQ(nested->nAcquisitions, 3u);
+    EXPECT_LE(nested->nHoldMicros, shared->nHoldMicros);
+
+    const CLockSiteStats* lock2 = FindLockSite(stats, "cs1, cs2", false);
+    ASSERT_NE(lock2, nullptr);
+    EXPECT_EQ(lock2->nAcquisitions, 1u);
+
+    const CLockSiteStats* tryLock = FindLockSite(stats, "cs", false);
+    ASSERT_NE(tryLock, nullptr);
+    // the TRY_LOCK() and the LOCK() before it
+    EXPECT_EQ(tryLock->nAcquisitions + tryLock->nTryFailures, 1u);
+
+    ResetLockStats();
+    EXPECT_TRUE(GetLockStats().empty());
+}
+
+TEST(sync_tests, lock_stats_of_all_threads)
+{
+    CCriticalSection cs;
+    ResetLockStats();
+    EnableLockStats(true);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 100; j++) {
+                LOCK(cs);
+            }
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+    EnableLockStats(false);
+
+    const std::vector<CLockSiteStats> stats = GetLockStats();
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].nAcquisitions, 400u);
+    EXPECT_EQ(Sum(stats[0].waitHistogram), 400u);
+    EXPECT_EQ(Sum(stats[0].holdHistogram), 400u);
+    ResetLockStats();
+}
+
+TEST(sync_tests, lock_stats_contention)
+{
+    CSharedCriticalSection cs;
+    ResetLockStats();
+    EnableLockStats(true);
+
+    std::atomic<bool> fLocked{false};
+    std::thread       writer;
+    {
+        LOCK(cs);
+        writer = std::thread([&]() {
+            fLocked = true;
+            LOCK(cs);
+        });
+        while (!fLocked)
+            std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    writer.join();
+    EnableLockStats(false);
+
+    uint64_t nContended = 0;
+    uint64_t nMaxWait   = 0;
+    for (const CLockSiteStats& s : GetLockStats()) {
+        nContended += s.nContended;
+        nMaxWait = std::max(nMaxWait, s.nMaxWaitMicros);
+    }
+    EXPECT_EQ(nContended, 1u);
+    EXPECT_GT(nMaxWait, 0u);
+    ResetLockStats();
+}
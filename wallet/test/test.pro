@@ -38,10 +38,12 @@ SOURCES += \
 SOURCES += \
     accounting_tests.cpp  \
     allocator_tests.cpp   \
+    arith_uint256_tests.cpp \
     base32_tests.cpp      \
     base58_tests.cpp      \
     base64_tests.cpp      \
     bignum_tests.cpp      \
+    blockencodings_tests.cpp \
     bloom_tests.cpp       \
     blockindexlru_tests.cpp \
     canonical_tests.cpp   \
@@ -52,25 +54,34 @@ SOURCES += \
     fixedpoint_tests.cpp  \
     getarg_tests.cpp      \
     hash_tests.cpp        \
+    headerssync_tests.cpp \
     key_tests.cpp         \
     merkle_tests.cpp      \
     miner_tests.cpp       \
+    msghandlerqueue_tests.cpp \
     mruset_tests.cpp      \
     netbase_tests.cpp     \
     ntp1_selection_tests.cpp \
     ntp1_tests.cpp        \
+    orphanblockpool_tests.cpp \
     pmt_tests.cpp         \
     pos_tests.cpp         \
     rpc_tests.cpp         \
+    runtimeconfig_tests.cpp \
     result_tests.cpp      \
     script_tests.cpp      \
+    scrypt_tests.cpp      \
     serialize_tests.cpp   \
+    sha256_tests.cpp      \
     sigopcount_tests.cpp  \
+    sync_tests.cpp        \
     transaction_tests.cpp \
+    txprevalidator_tests.cpp \
     uint160_tests.cpp     \
     uint256_tests.cpp     \
     util_tests.cpp        \
     wallet_tests.cpp      \
+    walletdb_tests.cpp    \
     environment.cpp
 
 DEFINES += BITCOIN_QT_TEST
@@ -0,0 +1,184 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "net.h"
+#include "txprevalidator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace {
+
+// polls the condition for up to 10 seconds
+bool WaitFor(const std::function<bool()>& condition)
+{
+    for (int i = 0; i < 1000; i++) {
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+
+CTransaction MakeTx(const COutPoint& prevout, int64_t nValue)
+{
+    CTransaction tx;
+    tx.vin.push_back(CTxIn(prevout));
+    tx.vout.push_back(CTxOut(nValue, CScript()));
+    return tx;
+}
+
+int RefCount(CNode& node)
+{
+    LOCK(cs_vNodes);
+    return node.GetRefCount();
+}
+
+void StopAndWait(CTxPreValidationQueue& queue)
+{
+    queue.clear();
+    ASSERT_TRUE(WaitFor([&]() { return queue.running() == 0; }));
+}
+
+} // namespace
+
+TEST(txprevalidator_tests, parallel_prevalidation_rejected_in_final_step)
+{
+    const int nWorkers = 4;
+
+    std::atomic<int> nValidating{0};
+    std::atomic<int> nMaxValidating{0};
+
+    // the final step sees the mempool as it is after the transactions finished before
+    std::mutex          mtxMempool;
+    std::set<COutPoint> setSpent;
+    int                 nAccepted = 0;
+    int                 nRejected = 0;
+    std::atomic<int>    nFinished{0};
+
+    CTxPreValidationQueue queue(
+        [&](const CTransaction&) -> Result<void, TxValidationState> {
+            const int n    = ++nValidating;
+            int       nMax = nMaxValidating.load();
+            while (n > nMax && !nMaxValidating.compare_exchange_weak(nMax, n)) {
+            }
+            // hold on until all the workers validate at once
+            WaitFor([&]() { return nMaxValidating.load() >= nWorkers; });
+            --nValidating;
+            return Ok();
+        },
+        [&](CNode*, const CTransaction& tx, const Result<void, TxValidationState>& preValidationRes) {
+            EXPECT_TRUE(preValidationRes.isOk());
+            std::lock_guard<std::mutex> lock(mtxMempool);
+            const bool fConflict = std::any_of(tx.vin.begin(), tx.vin.end(), [&](const CTxIn& txin) {
+                return setSpent.count(txin.prevout) > 0;
+            });
+            if (fConflict) {
+                nRejected++;
+            } else {
+                for (const CTxIn& txin : tx.vin)
+                    setSpent.insert(txin.prevout);
+                nAccepted++;
+            }
+            nFinished++;
+        });
+    queue.start(nWorkers);
+
+    CNode node(1, INVALID_SOCKET, CAddress());
+
+    // the first two spend the same output, so only one of them can reach the mempool
+    const COutPoint doubleSpent(uint256(1), 0);
+    EXPECT_TRUE(queue.push(&node, MakeTx(doubleSpent, 100)));
+    EXPECT_TRUE(queue.push(&node, MakeTx(doubleSpent, 200)));
+    EXPECT_TRUE(queue.push(&node, MakeTx(COutPoint(uint256(2), 0), 100)));
+    EXPECT_TRUE(queue.push(&node, MakeTx(COutPoint(uint256(3), 1), 100)));
+
+    EXPECT_TRUE(WaitFor([&]() { return nFinished.load() == 4; }));
+    EXPECT_EQ(nMaxValidating.load(), nWorkers);
+    {
+        std::lock_guard<std::mutex> lock(mtxMempool);
+        EXPECT_EQ(nAccepted, 3);
+        EXPECT_EQ(nRejected, 1);
+    }
+    EXPECT_TRUE(WaitFor([&]() { return RefCount(node) == 0; }));
+
+    StopAndWait(queue);
+}
+
+TEST(txprevalidator_tests, drain)
+{
+    std::atomic<int> nFinished{0};
+
+    CTxPreValidationQueue queue(
+        [](const CTransaction&) -> Result<void, TxValidationState> { return Ok(); },
+        [&](CNode*, const CTransaction&, const Result<void, TxValidationState>&) { nFinished++; });
+
+    CNode node(1, INVALID_SOCKET, CAddress());
+
+    // without workers the caller validates the transactions itself
+    EXPECT_FALSE(queue.push(&node, MakeTx(COutPoint(uint256(1), 0), 100)));
+    EXPECT_EQ(RefCount(node), 0);
+
+    queue.start(2);
+    EXPECT_EQ(queue.running(), 2);
+
+    const int nTxs = 100;
+    for (int i = 0; i < nTxs; i++) {
+        EXPECT_TRUE(queue.push(&node, MakeTx(COutPoint(uint256(i + 1), 0), 100)));
+    }
+
+    EXPECT_TRUE(WaitFor([&]() { return nFinished.load() == nTxs; }));
+    EXPECT_EQ(queue.size(), 0u);
+    EXPECT_TRUE(WaitFor([&]() { return RefCount(node) == 0; }));
+
+    // the transactions of a disconnected peer are dropped without validation
+    node.fDisconnect = true;
+    EXPECT_TRUE(queue.push(&node, MakeTx(COutPoint(uint256(1), 0), 100)));
+    EXPECT_TRUE(WaitFor([&]() { return queue.size() == 0 && RefCount(node) == 0; }));
+    EXPECT_EQ(nFinished.load(), nTxs);
+
+    StopAndWait(queue);
+    EXPECT_FALSE(queue.push(&node, MakeTx(COutPoint(uint256(1), 0), 100)));
+    EXPECT_EQ(RefCount(node), 0);
+}
+
+TEST(txprevalidator_tests, shutdown_drops_queued_transactions)
+{
+    std::atomic<bool> fRelease{false};
+    std::atomic<int>  nValidating{0};
+    std::atomic<int>  nFinished{0};
+
+    CTxPreValidationQueue queue(
+        [&](const CTransaction&) -> Result<void, TxValidationState> {
+            nValidating++;
+            WaitFor([&]() { return fRelease.load(); });
+            return Ok();
+        },
+        [&](CNode*, const CTransaction&, const Result<void, TxValidationState>&) { nFinished++; });
+    queue.start(1);
+
+    CNode node(1, INVALID_SOCKET, CAddress());
+
+    const int nTxs = 5;
+    for (int i = 0; i < nTxs; i++) {
+        EXPECT_TRUE(queue.push(&node, MakeTx(COutPoint(uint256(i + 1), 0), 100)));
+    }
+    EXPECT_TRUE(WaitFor([&]() { return nValidating.load() == 1; }));
+    EXPECT_EQ(queue.size(), static_cast<std::size_t>(nTxs - 1));
+
+    queue.clear();
+    EXPECT_EQ(queue.size(), 0u);
+    // only the transaction that is being validated still holds the peer
+    EXPECT_EQ(RefCount(node), 1);
+    EXPECT_FALSE(queue.push(&node, MakeTx(COutPoint(uint256(1), 0), 100)));
+
+    fRelease = true;
+    ASSERT_TRUE(WaitFor([&]() { return queue.running() == 0; }));
+    EXPECT_EQ(nValidating.load(), 1);
+    EXPECT_EQ(nFinished.load(), 1);
+    EXPECT_EQ(RefCount(node), 0);
+}
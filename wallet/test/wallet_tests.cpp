@@ -1,8 +1,16 @@
 #include "googletest/googletest/include/gtest/gtest.h"
 
+#include "environment.h"
+
+#include "db/lmdb/lmdbwallet.h"
+#include "init.h"
 #include "main.h"
 #include "mocks/mtxdb.h"
+#include "ntp1/ntp1transaction.h"
 #include "wallet.h"
+#include "walletdb.h"
+#include <boost/filesystem.hpp>
+#include <boost/scope_exit.hpp>
 
 // how many times to run all the tests to have a chance to catch errors that only show up with particular
 // random shuffles
@@ -339,3 +347,189 @@ TEST(wallet_tests, coin_selection_tests)
         empty_wallet();
     }
 }
+
+static const std::string NTP1_TEST_TOKEN_ID = "LaA5grPQMDhwvciWFqxwG1ySDqNHAgms1yLrPp";
+
+static CScript KeyToP2PKH(const CKey& key)
+{
+    CScript result;
+    result.SetDestination(key.GetPubKey().GetID());
+    return result;
+}
+
+static NTP1TxOut MakeNTP1TxOut(const CTxOut& txout, NTP1Int tokenAmount)
+{
+    std::vector<NTP1TokenTxData> tokens;
+    if (tokenAmount > 0) {
+        NTP1TokenTxData token;
+        token.setAggregationPolicy("aggregable");
+        token.setAmount(tokenAmount);
+        token.setDivisibility(7);
+        token.setIssueTxIdHex("66216fa9cc0167568c3e5f8b66e7fe3690072f66a5f41df222327de7af10ff80");
+        token.setLockStatus(true);
+        token.setTokenId(NTP1_TEST_TOKEN_ID);
+        token.setTokenSymbol("NIBBL");
+        tokens.push_back(token);
+    }
+    NTP1TxOut result;
+    result.__manualSet(txout.nValue, HexStr(txout.scriptPubKey), txout.scriptPubKey.ToString(), tokens,
+                       "");
+    return result;
+}
+
+// the NTP1 data that ConnectBlock() stores for the transaction, with the token amounts of its outputs
+static NTP1Transaction MakeNTP1Tx(const CTransaction& tx, const std::vector<NTP1Int>& tokenAmounts)
+{
+    std::vector<NTP1TxOut> vout;
+    for (unsigned i = 0; i < tx.vout.size(); i++)
+        vout.push_back(MakeNTP1TxOut(tx.vout[i], tokenAmounts[i]));
+    NTP1Transaction result;
+    result.__manualSet(1, tx.GetHash(), std::vector<unsigned char>(), std::vector<NTP1TxIn>{}, vout, 0,
+                       tx.nTime, NTP1TxType_TRANSFER);
+    return result;
+}
+
+// the balances as getntp1balances computed them before the index: NTP1Wallet went through all the
+// available coins and read the tokens of each from the NTP1 data of its transaction
+static map<string, NTP1Int> ScanNTP1Balances(const CWallet& w, const ITxDB& txdb, int nMinDepth)
+{
+    const uint256 bestBlockHash = txdb.GetBestBlockHash();
+
+    vector<COutput> vOutputs;
+    w.AvailableCoins(txdb, vOutputs);
+
+    map<string, NTP1Int> result;
+    for (const COutput& output : vOutputs) {
+        if (output.tx->GetDepthInMainChain(txdb, bestBlockHash) < nMinDepth)
+            continue;
+        NTP1Transaction ntp1tx;
+        if (!NTP1Transaction::IsTxNTP1(output.tx) || !txdb.ReadNTP1Tx(output.tx->GetHash(), ntp1tx))
+            continue;
+        const NTP1TxOut& ntp1txout = ntp1tx.getTxOut(output.i);
+        for (unsigned long j = 0; j < ntp1txout.tokenCount(); j++)
+            result[ntp1txout.getToken(j).getTokenId()] += ntp1txout.getToken(j).getAmount();
+    }
+    return result;
+}
+
+static map<string, NTP1Int> IndexedNTP1Balances(const CWallet& w, const ITxDB& txdb, int nMinDepth)
+{
+    map<string, NTP1Int> result;
+    for (const auto& p : w.GetNTP1Balances(txdb, nMinDepth)) {
+        EXPECT_EQ(p.second.tokenSymbol, "NIBBL");
+        result[p.first] = p.second.balance;
+    }
+    return result;
+}
+
+TEST(wallet_tests, ntp1_outputs_index_matches_full_scan)
+{
+    const boost::filesystem::path dir = Environment::GetTestsDataDir() / "walletdb";
+    boost::filesystem::create_directories(dir);
+    const boost::filesystem::path path = dir / "ntp1_outputs_index.dat";
+    for (const char* suffix : {"", "-lock"}) {
+        boost::filesystem::remove(path.string() + suffix);
+    }
+
+    // the cache of the depths of wallet transactions is sized after pwalletMain
+    std::shared_ptr<CWallet> prevWallet = pwalletMain;
+    pwalletMain                         = std::make_shared<CWallet>();
+    fWalletLMDB                         = true;
+    BOOST_SCOPE_EXIT(&prevWallet, &path)
+    {
+        pwalletMain = prevWallet;
+        fWalletLMDB = false;
+        LMDBWalletStorage::Close(path);
+    }
+    BOOST_SCOPE_EXIT_END
+
+    CWallet& w = *pwalletMain;
+    CKey     keyMine, keyOther;
+    keyMine.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    {
+        LOCK(w.cs_wallet);
+        ASSERT_TRUE(w.AddKey(keyMine));
+    }
+
+    const CScript opReturn = CScript() << OP_RETURN << ParseHex("4e5401150020120169895252");
+
+    // 100 tokens are received, next to 50 that go to someone else
+    CTransaction txReceive;
+    txReceive.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    txReceive.vout.push_back(CTxOut(10000, KeyToP2PKH(keyMine)));
+    txReceive.vout.push_back(CTxOut(10000, KeyToP2PKH(keyOther)));
+    txReceive.vout.push_back(CTxOut(0, opReturn));
+
+    // then 30 of them are sent away and the other 70 come back as change
+    CTransaction txSpend;
+    txSpend.vin.push_back(CTxIn(COutPoint(txReceive.GetHash(), 0)));
+    txSpend.vout.push_back(CTxOut(10000, KeyToP2PKH(keyOther)));
+    txSpend.vout.push_back(CTxOut(10000, KeyToP2PKH(keyMine)));
+    txSpend.vout.push_back(CTxOut(0, opReturn));
+
+    const map<uint256, NTP1Transaction> ntp1Txs = {
+        {txReceive.GetHash(), MakeNTP1Tx(txReceive, {100, 50, 0})},
+        {txSpend.GetHash(), MakeNTP1Tx(txSpend, {30, 70, 0})}};
+
+    CBlockIndex blockReceive;
+    blockReceive.blockHash = GetRandHash();
+    blockReceive.hashPrev  = GetRandHash();
+    blockReceive.nHeight   = 100;
+    blockReceive.nTime     = GetAdjustedTime();
+    CBlockIndex blockSpend;
+    blockSpend.blockHash = GetRandHash();
+    blockSpend.hashPrev  = blockReceive.blockHash;
+    blockSpend.nHeight   = 101;
+    blockSpend.nTime     = blockReceive.nTime + 60;
+
+    uint256 bestBlockHash = blockReceive.blockHash;
+
+    testing::NiceMock<mTxDB> txdb;
+    ON_CALL(txdb, GetBestBlockHash()).WillByDefault(testing::Invoke([&]() { return bestBlockHash; }));
+    ON_CALL(txdb, GetBestChainHeight()).WillByDefault(testing::Invoke([&]() {
+        return boost::make_optional<int>(bestBlockHash == blockSpend.blockHash ? 101 : 100);
+    }));
+    ON_CALL(txdb, ReadBlockIndex(testing::_))
+        .WillByDefault(testing::Invoke([&](const uint256& hash) -> boost::optional<CBlockIndex> {
+            if (hash == blockReceive.blockHash)
+                return blockReceive;
+            if (hash == blockSpend.blockHash)
+                return blockSpend;
+            return boost::none;
+        }));
+    ON_CALL(txdb, ReadNTP1Tx(testing::_, testing::_))
+        .WillByDefault(testing::Invoke([&](const uint256& hash, NTP1Transaction& ntp1tx) {
+            const auto it = ntp1Txs.find(hash);
+            if (it == ntp1Txs.end())
+                return false;
+            ntp1tx = it->second;
+            return true;
+        }));
+
+    CWalletDB walletdb(path.string(), "cr+");
+
+    const auto addToWallet = [&](const CTransaction& tx, const CBlockIndex& block) {
+        CWalletTx wtx(&w, tx);
+        wtx.hashBlock = block.blockHash;
+        wtx.nIndex    = 1;
+        LOCK(w.cs_wallet);
+        return w.AddToWallet(txdb, wtx, false, &walletdb, false);
+    };
+
+    ASSERT_TRUE(addToWallet(txReceive, blockReceive));
+    EXPECT_EQ(IndexedNTP1Balances(w, txdb, 1), ScanNTP1Balances(w, txdb, 1));
+    EXPECT_EQ(IndexedNTP1Balances(w, txdb, 1)[NTP1_TEST_TOKEN_ID], 100);
+
+    blockReceive.hashNext = blockSpend.blockHash;
+    bestBlockHash         = blockSpend.blockHash;
+    ASSERT_TRUE(addToWallet(txSpend, blockSpend));
+
+    // the spent output stays in the index, but doesn't count anymore
+    EXPECT_EQ(IndexedNTP1Balances(w, txdb, 1), ScanNTP1Balances(w, txdb, 1));
+    EXPECT_EQ(IndexedNTP1Balances(w, txdb, 1)[NTP1_TEST_TOKEN_ID], 70);
+
+    // the change has a single confirmation
+    EXPECT_EQ(IndexedNTP1Balances(w, txdb, 2), ScanNTP1Balances(w, txdb, 2));
+    EXPECT_TRUE(IndexedNTP1Balances(w, txdb, 2).empty());
+}
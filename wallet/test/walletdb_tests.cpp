@@ -0,0 +1,298 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "environment.h"
+
+#include "db/lmdb/lmdbwallet.h"
+#include "util.h"
+#include "wallet.h"
+#include "walletdb.h"
+#include <boost/filesystem.hpp>
+#include <boost/scope_exit.hpp>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+static boost::filesystem::path CleanWalletTestPath(const std::string& fileName)
+{
+    const boost::filesystem::path dir = Environment::GetTestsDataDir() / "walletdb";
+    boost::filesystem::create_directories(dir);
+    const boost::filesystem::path path = dir / fileName;
+    for (const char* suffix : {"", "-lock", ".migrated", ".compact", ".lmdb-migration"}) {
+        boost::filesystem::remove(path.string() + suffix);
+    }
+    return path;
+}
+
+TEST(lmdb_wallet_tests, read_write_erase)
+{
+    const boost::filesystem::path path = CleanWalletTestPath("rw.lmdb");
+
+    {
+        LMDBWalletStorage storage(path);
+        EXPECT_TRUE(storage.write("\x04name1", "abc"));
+        EXPECT_TRUE(storage.write("\x04name2", "def"));
+        EXPECT_TRUE(storage.write("\x02tx1", "ghi"));
+        EXPECT_FALSE(storage.write("\x02tx1", "xyz", false));
+        EXPECT_TRUE(storage.exists("\x04name1"));
+        EXPECT_FALSE(storage.exists("\x04name3"));
+
+        std::string value;
+        EXPECT_TRUE(storage.read("\x02tx1", value));
+        EXPECT_EQ(value, "ghi");
+        EXPECT_FALSE(storage.read("\x04name3", value));
+
+        EXPECT_TRUE(storage.erase("\x04name2"));
+        EXPECT_TRUE(storage.erase("\x04name2"));
+        EXPECT_FALSE(storage.exists("\x04name2"));
+        EXPECT_EQ(storage.getRecordCount(), 2u);
+    }
+
+    EXPECT_TRUE(LMDBWalletStorage::IsLMDBFile(path));
+
+    // reopened, and scanned from a key on, as in BerkeleyDB
+    LMDBWalletStorage        storage(path);
+    std::vector<std::string> keys;
+    EXPECT_TRUE(storage.forEach("\x04", [&](const std::string& k, const std::string&) {
+        keys.push_back(k);
+        return true;
+    }));
+    ASSERT_EQ(keys.size(), 1u);
+    EXPECT_EQ(keys[0], "\x04name1");
+
+    keys.clear();
+    EXPECT_TRUE(storage.forEach("", [&](const std::string& k, const std::string&) {
+        keys.push_back(k);
+        return true;
+    }));
+    EXPECT_EQ(keys, std::vector<std::string>({"\x02tx1", "\x04name1"}));
+}
+
+TEST(lmdb_wallet_tests, batches)
+{
+    const boost::filesystem::path path = CleanWalletTestPath("batch.lmdb");
+
+    LMDBWalletStorage storage(path);
+    ASSERT_TRUE(storage.beginBatch());
+    EXPECT_TRUE(storage.isBatchOwnedByThisThread());
+    EXPECT_TRUE(storage.write("a", "1"));
+
+    // the batch is seen only by this thread until it's committed
+    std::string value;
+    EXPECT_TRUE(storage.read("a", value));
+    bool fSeenByOtherThread = true;
+    std::thread([&]() {
+        fSeenByOtherThread = storage.exists("a");
+        EXPECT_FALSE(storage.isBatchOwnedByThisThread());
+    }).join();
+    EXPECT_FALSE(fSeenByOtherThread);
+
+    // an aborted inner batch doesn't affect the outer one
+    ASSERT_TRUE(storage.beginBatch());
+    EXPECT_TRUE(storage.write("b", "2"));
+    EXPECT_TRUE(storage.abortBatch());
+    ASSERT_TRUE(storage.beginBatch());
+    EXPECT_TRUE(storage.write("c", "3"));
+    EXPECT_TRUE(storage.commitBatch());
+
+    EXPECT_TRUE(storage.commitBatch());
+    EXPECT_FALSE(storage.isBatchOwnedByThisThread());
+    EXPECT_FALSE(storage.commitBatch());
+
+    std::thread([&]() {
+        EXPECT_TRUE(storage.exists("a"));
+        EXPECT_FALSE(storage.exists("b"));
+        EXPECT_TRUE(storage.exists("c"));
+    }).join();
+
+    // writes of another thread wait for the batch
+    ASSERT_TRUE(storage.beginBatch());
+    std::thread writer([&]() { EXPECT_TRUE(storage.write("d", "4")); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_FALSE(storage.exists("d"));
+    EXPECT_TRUE(storage.abortBatch());
+    writer.join();
+    EXPECT_TRUE(storage.exists("d"));
+}
+
+TEST(lmdb_wallet_tests, map_growth_and_compaction)
+{
+    const boost::filesystem::path path = CleanWalletTestPath("grow.lmdb");
+
+    const std::string bigValue(1 << 16, 'x');
+    {
+        std::shared_ptr<LMDBWalletStorage> storage  = LMDBWalletStorage::Get(path);
+        const uint64_t                     initSize = storage->getMapSize();
+        // more than the initial map, written in and out of batches
+        for (int i = 0; i < 2000; i++) {
+            if (i % 500 == 0) {
+                ASSERT_TRUE(storage->beginBatch());
+            }
+            ASSERT_TRUE(storage->write("key" + std::to_string(i), bigValue));
+            if (i % 500 == 99) {
+                ASSERT_TRUE(storage->commitBatch());
+            }
+        }
+        EXPECT_GT(storage->getMapSize(), initSize);
+        for (int i = 0; i < 1900; i++) {
+            ASSERT_TRUE(storage->erase("key" + std::to_string(i)));
+        }
+        EXPECT_TRUE(LMDBWalletStorage::IsInUse(path));
+        EXPECT_FALSE(LMDBWalletStorage::Compact(path));
+    }
+
+    EXPECT_FALSE(LMDBWalletStorage::IsInUse(path));
+    const uintmax_t sizeBefore = boost::filesystem::file_size(path);
+    EXPECT_TRUE(LMDBWalletStorage::Compact(path));
+    EXPECT_LT(boost::filesystem::file_size(path), sizeBefore);
+
+    std::shared_ptr<LMDBWalletStorage> storage = LMDBWalletStorage::Get(path);
+    EXPECT_EQ(storage->getRecordCount(), 100u);
+    std::string value;
+    EXPECT_TRUE(storage->read("key1999", value));
+    EXPECT_EQ(value, bigValue);
+    storage.reset();
+    LMDBWalletStorage::Close(path);
+}
+
+TEST(lmdb_wallet_tests, migrate_from_berkeleydb)
+{
+    const boost::filesystem::path path = CleanWalletTestPath("migrated_wallet.dat");
+
+    BOOST_SCOPE_EXIT(void) { fWalletLMDB = false; }
+    BOOST_SCOPE_EXIT_END
+
+    fWalletLMDB = false;
+    {
+        CWalletDB walletdb(path.string(), "cr+");
+        EXPECT_TRUE(walletdb.WriteName("address1", "name1"));
+        EXPECT_TRUE(walletdb.WriteName("address2", "name2"));
+        CAccount account;
+        account.vchPubKey = CPubKey(ParseHex(
+            "0279be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f81798"));
+        EXPECT_TRUE(walletdb.WriteAccount("account1", account));
+    }
+    EXPECT_FALSE(LMDBWalletStorage::IsLMDBFile(path));
+    EXPECT_EQ(GetLMDBWalletStorage(path.string()), nullptr);
+
+    fWalletLMDB = true;
+    ASSERT_TRUE(CWalletDB::MigrateToLMDB(path.string()));
+    EXPECT_TRUE(LMDBWalletStorage::IsLMDBFile(path));
+    EXPECT_TRUE(boost::filesystem::exists(path.string() + ".migrated"));
+
+    // the file is opened in the format it has, whatever the option
+    fWalletLMDB = false;
+    {
+        CWalletDB walletdb(path.string(), "r+");
+        EXPECT_NE(GetLMDBWalletStorage(path.string()), nullptr);
+
+        int nVersion = 0;
+        EXPECT_TRUE(walletdb.ReadVersion(nVersion));
+        EXPECT_EQ(nVersion, CLIENT_VERSION);
+
+        std::vector<std::string> names;
+        CDataStream              ssStart(SER_DISK, CLIENT_VERSION);
+        ssStart << std::string("name");
+        EXPECT_TRUE(walletdb.ForEachRecord(
+            [&](CDataStream& ssKey, CDataStream& ssValue) {
+                std::string strType, strAddress, strName;
+                ssKey >> strType;
+                if (strType != "name")
+                    return false;
+                ssKey >> strAddress;
+                ssValue >> strName;
+                names.push_back(strAddress + ":" + strName);
+                return true;
+            },
+            &ssStart));
+        EXPECT_EQ(names, std::vector<std::string>({"address1:name1", "address2:name2"}));
+
+        CAccount account;
+        EXPECT_TRUE(walletdb.ReadAccount("account1", account));
+        EXPECT_EQ(HexStr(account.vchPubKey.Raw()),
+                  "0279be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f81798");
+
+        // a transaction of the wallet is a batch of the storage
+        EXPECT_TRUE(walletdb.TxnBegin());
+        EXPECT_TRUE(walletdb.WriteAccount("account2", account));
+        EXPECT_TRUE(walletdb.TxnAbort());
+        EXPECT_FALSE(walletdb.ReadAccount("account2", account));
+        EXPECT_TRUE(walletdb.TxnBegin());
+        EXPECT_TRUE(walletdb.WriteAccount("account2", account));
+        EXPECT_TRUE(walletdb.TxnCommit());
+        EXPECT_TRUE(walletdb.ReadAccount("account2", account));
+    }
+    LMDBWalletStorage::Close(path);
+}
+
+// A benchmark of the storage part of loading a wallet (reading and deserializing every record) with
+// 500k transactions in both backends; run with --gtest_also_run_disabled_tests
+TEST(lmdb_wallet_tests, DISABLED_load_time_500k_transactions)
+{
+    static const int TX_COUNT = 500000;
+
+    BOOST_SCOPE_EXIT(void) { fWalletLMDB = false; }
+    BOOST_SCOPE_EXIT_END
+
+    CWalletTx wtxTemplate;
+    wtxTemplate.vin.resize(2);
+    wtxTemplate.vout.resize(2);
+    wtxTemplate.vout[0].scriptPubKey << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1)
+                                     << OP_EQUALVERIFY << OP_CHECKSIG;
+    wtxTemplate.vout[1].scriptPubKey = wtxTemplate.vout[0].scriptPubKey;
+    wtxTemplate.mapValue["comment"]  = "benchmark";
+
+    for (bool fLMDB : {false, true}) {
+        const boost::filesystem::path path =
+            CleanWalletTestPath(fLMDB ? "bench_wallet.lmdb" : "bench_wallet.dat");
+        fWalletLMDB = fLMDB;
+
+        const auto writeStart = std::chrono::steady_clock::now();
+        {
+            CWalletDB walletdb(path.string(), "cr+");
+            for (int i = 0; i < TX_COUNT; i++) {
+                if (i % 10000 == 0) {
+                    ASSERT_TRUE(walletdb.TxnBegin());
+                }
+                CWalletTx wtx      = wtxTemplate;
+                wtx.nLockTime      = i;
+                wtx.nOrderPos      = i;
+                wtx.vout[0].nValue = i;
+                ASSERT_TRUE(walletdb.WriteTx(wtx.GetHash(), wtx));
+                if (i % 10000 == 9999) {
+                    ASSERT_TRUE(walletdb.TxnCommit());
+                }
+            }
+        }
+        const auto writeEnd = std::chrono::steady_clock::now();
+
+        int nRead = 0;
+        {
+            CWalletDB walletdb(path.string(), "r");
+            EXPECT_TRUE(walletdb.ForEachRecord([&](CDataStream& ssKey, CDataStream& ssValue) {
+                std::string strType;
+                ssKey >> strType;
+                if (strType == "tx") {
+                    uint256   hash;
+                    CWalletTx wtx;
+                    ssKey >> hash;
+                    ssValue >> wtx;
+                    nRead++;
+                }
+                return true;
+            }));
+        }
+        const auto readEnd = std::chrono::steady_clock::now();
+        EXPECT_EQ(nRead, TX_COUNT);
+
+        using std::chrono::duration_cast;
+        using std::chrono::milliseconds;
+        std::cout << (fLMDB ? "LMDB" : "BerkeleyDB") << ": writing " << TX_COUNT << " transactions took "
+                  << duration_cast<milliseconds>(writeEnd - writeStart).count()
+                  << " ms, loading them took " << duration_cast<milliseconds>(readEnd - writeEnd).count()
+                  << " ms, file size " << boost::filesystem::file_size(path) / (1 << 20) << " MB"
+                  << std::endl;
+        if (fLMDB) {
+            LMDBWalletStorage::Close(path);
+        }
+    }
+}
@@ -489,7 +489,7 @@ Result<void, TxValidationState>
 CTransaction::ConnectInputs(const ITxDB& txdb, MapPrevTx inputs,
                             std::map<uint256, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx,
                             const boost::optional<CBlockIndex>& pindexBlock, bool fBlock, bool fMiner,
-                            CBlock* sourceBlockPtr) const
+                            CBlock* sourceBlockPtr, bool fScriptsChecked) const
 {
     // Take over previous transactions' spent pointers
     // fBlock is true when this is called from AcceptBlock when a new best-block is added to the
@@ -600,7 +600,10 @@ CTransaction::ConnectInputs(const ITxDB& txdb, MapPrevTx inputs,
             // Skip ECDSA signature verification when connecting blocks (fBlock=true)
             // before the last blockchain checkpoint. This is safe because block merkle hashes are
             // still computed and checked, and any change will be caught at the next checkpoint.
-            if (!(fBlock &&
+            // The result of a script check only depends on the transactions, so a check made before,
+            // against the same inputs, holds.
+            if (!fScriptsChecked &&
+                !(fBlock &&
                   (txdb.GetBestChainHeight().value_or(0) < Checkpoints::GetTotalBlocksEstimate()))) {
                 // Verify signature
                 bool       fStrictPayToScriptHash = true;
@@ -170,12 +170,14 @@ public:
         @param[in] pindexBlock
         @param[in] fBlock	true if called from ConnectBlock
         @param[in] fMiner	true if called from CreateNewBlock
+        @param[in] fScriptsChecked	true if the scripts were already verified against the same inputs
         @return Returns true if all checks succeed
         */
     Result<void, TxValidationState>
     ConnectInputs(const ITxDB& txdb, MapPrevTx inputs, std::map<uint256, CTxIndex>& mapTestPool,
                   const CDiskTxPos& posThisTx, const boost::optional<CBlockIndex>& pindexBlock,
-                  bool fBlock, bool fMiner, CBlock* sourceBlockPtr = nullptr) const;
+                  bool fBlock, bool fMiner, CBlock* sourceBlockPtr = nullptr,
+                  bool fScriptsChecked = false) const;
     Result<void, TxValidationState> CheckTransaction(const ITxDB& txdb,
                                                      CBlock*      sourceBlock = nullptr) const;
     bool GetCoinAge(const ITxDB& txdb, uint64_t& nCoinAge) const; // ppcoin: get transaction coin age
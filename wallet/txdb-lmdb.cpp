@@ -12,12 +12,15 @@
 #include <boost/thread/future.hpp>
 #include <boost/version.hpp>
 #include <future>
+#include <limits>
 #include <random>
 
+#include "addressindex.h"
 #include "blockmetadata.h"
 #include "globals.h"
 #include "kernel.h"
 #include "main.h"
+#include "ntp1tokenindex.h"
 #include "stringmanip.h"
 #include "txdb.h"
 #include "util.h"
@@ -255,6 +258,11 @@ bool ShouldQuickSyncBeDone(const filesystem::path& dbdir)
         return false;
     }
 
+    // quicksync databases don't have the address index or the NTP1 token index
+    if (fAddressIndex || fNTP1Index) {
+        return false;
+    }
+
     return (!filesystem::exists(dbdir) || !filesystem::exists(dbdir / "data.mdb") ||
             !filesystem::exists(dbdir / "lock.mdb")) &&
            Params().NetType() == NetworkType::Mainnet;
@@ -272,6 +280,20 @@ void CTxDB::resyncIfNecessary(bool forceClearDB)
         forceClearDB = true;
     }
 
+    // the address index is only complete if it was maintained since the genesis block
+    uint256 hashBestChainInDb = 0;
+    if (fAddressIndex && !ReadAddressIndexFlag().value_or(false) &&
+        ReadHashBestChain(hashBestChainInDb)) {
+        NLog.write(b_sev::warn, "The address index was enabled, removing old database to build it");
+
+        forceClearDB = true;
+    }
+    if (fNTP1Index && !ReadNTP1IndexFlag().value_or(false) && ReadHashBestChain(hashBestChainInDb)) {
+        NLog.write(b_sev::warn, "The NTP1 token index was enabled, removing old database to build it");
+
+        forceClearDB = true;
+    }
+
     NLog.write(b_sev::info, "Opened LMDB successfully");
 
     // check if the database has to be wiped
@@ -326,6 +348,14 @@ void CTxDB::resyncIfNecessary(bool forceClearDB)
         throw std::runtime_error(
             "Failed to persist database schema version number after clearing the database.");
     }
+
+    // disabling the index keeps the stale entries, but enabling it again will resync
+    if (!WriteAddressIndexFlag(fAddressIndex)) {
+        throw std::runtime_error("Failed to persist whether the address index is enabled.");
+    }
+    if (!WriteNTP1IndexFlag(fNTP1Index)) {
+        throw std::runtime_error("Failed to persist whether the NTP1 token index is enabled.");
+    }
 }
 
 // CDB subclasses are created and destroyed VERY OFTEN. That's why
@@ -625,6 +655,186 @@ boost::optional<bool> CTxDB::WasStakeSeen(const std::pair<COutPoint, unsigned in
     }
 }
 
+bool CTxDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& entries)
+{
+    for (const auto& entry : entries) {
+        if (!Write(entry.first, entry.second, IDB::Index::DB_ADDRESSTX_INDEX)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CTxDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& entries)
+{
+    for (const auto& entry : entries) {
+        if (Exists(entry.first, IDB::Index::DB_ADDRESSTX_INDEX) &&
+            !Erase(entry.first, IDB::Index::DB_ADDRESSTX_INDEX)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CTxDB::UpdateAddressUnspentIndex(
+    const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& entries)
+{
+    // the order matters, as an output can be created and spent in the same block
+    for (const auto& entry : entries) {
+        if (entry.second.IsNull()) {
+            if (Exists(entry.first, IDB::Index::DB_ADDRESSUNSPENT_INDEX) &&
+                !Erase(entry.first, IDB::Index::DB_ADDRESSUNSPENT_INDEX)) {
+                return false;
+            }
+        } else if (!Write(entry.first, entry.second, IDB::Index::DB_ADDRESSUNSPENT_INDEX)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CTxDB::ReadAddressIndex(const CAddressIndexAddress& address, int startHeight, int endHeight,
+                             std::vector<std::pair<CAddressIndexKey, CAmount>>& entries) const
+{
+    // heights are big endian in the keys, so the entries of the range are next to each other
+    const CAddressIndexKey keyBegin(address, std::max(startHeight, 0), uint256(0), 0, false);
+    CAddressIndexKey       keyEnd(address, 0, uint256(0), 0, false);
+    keyEnd.blockHeight = static_cast<uint32_t>(endHeight) + 1;
+    return ReadRange(keyBegin, keyEnd, entries, IDB::Index::DB_ADDRESSTX_INDEX);
+}
+
+bool CTxDB::ReadAddressUnspentIndex(
+    const CAddressIndexAddress&                                       address,
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& entries) const
+{
+    const CAddressUnspentKey keyBegin(address, uint256(0), 0);
+    const CAddressUnspentKey keyEnd(address, ~uint256(0), std::numeric_limits<uint32_t>::max());
+    return ReadRange(keyBegin, keyEnd, entries, IDB::Index::DB_ADDRESSUNSPENT_INDEX);
+}
+
+boost::optional<bool> CTxDB::ReadAddressIndexFlag() const
+{
+    bool fEnabled = false;
+    return Read(std::string("addressindex"), fEnabled, IDB::Index::DB_MAIN_INDEX)
+               ? boost::make_optional(fEnabled)
+               : boost::none;
+}
+
+bool CTxDB::WriteAddressIndexFlag(bool fEnabled)
+{
+    return Write(std::string("addressindex"), fEnabled, IDB::Index::DB_MAIN_INDEX);
+}
+
+bool CTxDB::WriteNTP1TokenTransfers(
+    const std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries)
+{
+    for (const auto& entry : entries) {
+        if (!Write(entry.first, entry.second, IDB::Index::DB_NTP1TOKENTRANSFERS_INDEX)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CTxDB::EraseNTP1TokenTransfers(
+    const std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries)
+{
+    for (const auto& entry : entries) {
+        if (Exists(entry.first, IDB::Index::DB_NTP1TOKENTRANSFERS_INDEX) &&
+            !Erase(entry.first, IDB::Index::DB_NTP1TOKENTRANSFERS_INDEX)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CTxDB::ReadNTP1TokenTransfers(
+    const CNTP1TokenTransferKey& keyBegin, const CNTP1TokenTransferKey& keyEnd, std::size_t limit,
+    std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries) const
+{
+    return ReadRange(keyBegin, keyEnd, entries, IDB::Index::DB_NTP1TOKENTRANSFERS_INDEX, limit);
+}
+
+bool CTxDB::UpdateNTP1TokenHolderBalances(
+    const std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>>& deltas)
+{
+    for (const auto& delta : deltas) {
+        CNTP1TokenHolderValue value;
+        if (!Read(delta.first, value, IDB::Index::DB_NTP1TOKENHOLDERS_INDEX)) {
+            value.balance = 0;
+        }
+        value.balance += delta.second.balance;
+
+        // addresses that don't hold the token anymore are dropped, so that the table has only holders
+        if (value.balance <= 0) {
+            if (Exists(delta.first, IDB::Index::DB_NTP1TOKENHOLDERS_INDEX) &&
+                !Erase(delta.first, IDB::Index::DB_NTP1TOKENHOLDERS_INDEX)) {
+                return false;
+            }
+        } else if (!Write(delta.first, value, IDB::Index::DB_NTP1TOKENHOLDERS_INDEX)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CTxDB::ReadNTP1TokenHolders(
+    const std::string& tokenId, const std::string& addressBegin, std::size_t limit,
+    std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>>& entries) const
+{
+    const boost::optional<std::string> ssKeyBegin =
+        SerializeSimple(CNTP1TokenHolderKey(tokenId, addressBegin));
+    boost::optional<std::string> ssKeyEnd = SerializeSimple(tokenId);
+    if (!ssKeyBegin || !ssKeyEnd) {
+        entries.clear();
+        return false;
+    }
+
+    // all the keys of the token start with the serialized token id, so the range ends at the first
+    // string that's greater than all the strings with that prefix
+    while (!ssKeyEnd->empty() && static_cast<unsigned char>(ssKeyEnd->back()) == 0xff) {
+        ssKeyEnd->pop_back();
+    }
+    if (ssKeyEnd->empty()) {
+        entries.clear();
+        return false;
+    }
+    ssKeyEnd->back() = static_cast<char>(static_cast<unsigned char>(ssKeyEnd->back()) + 1);
+
+    return ReadSerializedRange(*ssKeyBegin, *ssKeyEnd, entries, IDB::Index::DB_NTP1TOKENHOLDERS_INDEX,
+                               limit);
+}
+
+boost::optional<bool> CTxDB::ReadNTP1IndexFlag() const
+{
+    bool fEnabled = false;
+    return Read(std::string("ntp1index"), fEnabled, IDB::Index::DB_MAIN_INDEX)
+               ? boost::make_optional(fEnabled)
+               : boost::none;
+}
+
+bool CTxDB::WriteNTP1IndexFlag(bool fEnabled)
+{
+    return Write(std::string("ntp1index"), fEnabled, IDB::Index::DB_MAIN_INDEX);
+}
+
+bool CTxDB::WriteOrphanBlock(const uint256& hash, const CBlock& blk)
+{
+    // keyed by the previous block first, so that the orphans of a block are next to each other
+    return Write(std::make_pair(blk.hashPrevBlock, hash), blk, IDB::Index::DB_ORPHANBLOCKS_INDEX);
+}
+
+bool CTxDB::ReadOrphanBlock(const uint256& hashPrev, const uint256& hash, CBlock& blk) const
+{
+    blk.SetNull();
+    return Read(std::make_pair(hashPrev, hash), blk, IDB::Index::DB_ORPHANBLOCKS_INDEX);
+}
+
+bool CTxDB::EraseOrphanBlock(const uint256& hashPrev, const uint256& hash)
+{
+    return Erase(std::make_pair(hashPrev, hash), IDB::Index::DB_ORPHANBLOCKS_INDEX);
+}
+
 std::string LmdbValToString(const MDB_val& val)
 {
     return std::string((const char*)val.mv_data, val.mv_size);
@@ -249,6 +249,58 @@ protected:
         return db->exists(dbindex, *ssKey);
     }
 
+    /**
+     * ReadRange reads the key/value pairs with keys in [keyBegin, keyEnd), in the order of their
+     * serialized keys, at most limit of them if it's not 0
+     */
+    template <typename K, typename T>
+    bool ReadRange(const K& keyBegin, const K& keyEnd, std::vector<std::pair<K, T>>& values,
+                   IDB::Index dbindex, std::size_t limit = 0) const
+    {
+        const boost::optional<std::string> ssKeyBegin = SerializeSimple(keyBegin);
+        const boost::optional<std::string> ssKeyEnd   = SerializeSimple(keyEnd);
+        if (!ssKeyBegin || !ssKeyEnd) {
+            values.clear();
+            return false;
+        }
+        return ReadSerializedRange(*ssKeyBegin, *ssKeyEnd, values, dbindex, limit);
+    }
+
+    template <typename K, typename T>
+    bool ReadSerializedRange(const std::string& ssKeyBegin, const std::string& ssKeyEnd,
+                             std::vector<std::pair<K, T>>& values, IDB::Index dbindex,
+                             std::size_t limit = 0) const
+    {
+        values.clear();
+
+        const boost::optional<std::vector<std::pair<std::string, std::string>>> res =
+            db->readRange(dbindex, ssKeyBegin, ssKeyEnd, limit);
+        if (!res) {
+            return false;
+        }
+        values.reserve(res->size());
+        for (const auto& kv : *res) {
+            try {
+                K key;
+                T value;
+
+                CDataStream ssKey(kv.first.c_str(), kv.first.c_str() + kv.first.size(), SER_DISK,
+                                  CLIENT_VERSION);
+                ssKey >> key;
+                CDataStream ssValue(kv.second.c_str(), kv.second.c_str() + kv.second.size(), SER_DISK,
+                                    CLIENT_VERSION);
+                ssValue >> value;
+                values.emplace_back(std::move(key), std::move(value));
+            } catch (const std::exception& e) {
+                unsigned int sz = static_cast<unsigned int>(values.size());
+                NLog.write(b_sev::err, "Failed to deserialized element number {} in lmdb ReadRange() data",
+                           sz);
+                return false;
+            }
+        }
+        return true;
+    }
+
 public:
     bool TxnBegin(std::size_t required_size = 0);
     bool TxnCommit();
@@ -290,6 +342,34 @@ public:
     boost::optional<std::map<uint256, CBlockIndex>> ReadAllBlockIndexEntries() const override;
     bool                  WriteStakeSeen(const std::pair<COutPoint, unsigned int>& stake) override;
     boost::optional<bool> WasStakeSeen(const std::pair<COutPoint, unsigned int>& stake) const override;
+    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& entries) override;
+    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& entries) override;
+    bool UpdateAddressUnspentIndex(
+        const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& entries) override;
+    bool ReadAddressIndex(const CAddressIndexAddress& address, int startHeight, int endHeight,
+                          std::vector<std::pair<CAddressIndexKey, CAmount>>& entries) const override;
+    bool ReadAddressUnspentIndex(
+        const CAddressIndexAddress&                                       address,
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& entries) const override;
+    boost::optional<bool> ReadAddressIndexFlag() const;
+    bool                  WriteAddressIndexFlag(bool fEnabled);
+    bool WriteNTP1TokenTransfers(
+        const std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries) override;
+    bool EraseNTP1TokenTransfers(
+        const std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries) override;
+    bool ReadNTP1TokenTransfers(
+        const CNTP1TokenTransferKey& keyBegin, const CNTP1TokenTransferKey& keyEnd, std::size_t limit,
+        std::vector<std::pair<CNTP1TokenTransferKey, CNTP1TokenTransferValue>>& entries) const override;
+    bool UpdateNTP1TokenHolderBalances(
+        const std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>>& deltas) override;
+    bool ReadNTP1TokenHolders(
+        const std::string& tokenId, const std::string& addressBegin, std::size_t limit,
+        std::vector<std::pair<CNTP1TokenHolderKey, CNTP1TokenHolderValue>>& entries) const override;
+    boost::optional<bool> ReadNTP1IndexFlag() const;
+    bool                  WriteNTP1IndexFlag(bool fEnabled);
+    bool WriteOrphanBlock(const uint256& hash, const CBlock& blk) override;
+    bool ReadOrphanBlock(const uint256& hashPrev, const uint256& hash, CBlock& blk) const override;
+    bool EraseOrphanBlock(const uint256& hashPrev, const uint256& hash) override;
     bool                  LoadBlockIndex() override;
     boost::optional<int>  GetBestChainHeight() const override;
     boost::optional<uint256>     GetBestChainTrust() const override;
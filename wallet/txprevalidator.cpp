@@ -0,0 +1,176 @@
+#include "txprevalidator.h"
+
+#include "db/lmdb/lmdb.h"
+#include "main.h"
+#include "net.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <chrono>
+
+CTxPreValidationQueue txPreValidationQueue;
+
+static Result<void, TxValidationState> PreValidateWithSnapshot(const CTransaction& tx)
+{
+    // the snapshot ends before cs_main is taken, so that it doesn't hold back a resize of the db
+    LMDBReadSnapshot snapshot;
+    const CTxDB      txdb;
+    return PreValidateTransaction(tx, txdb);
+}
+
+static void ProcessPreValidated(CNode* pfrom, const CTransaction& tx,
+                                const Result<void, TxValidationState>& preValidationRes)
+{
+    LOCK(cs_main);
+    ProcessRelayedTransaction(pfrom, tx, preValidationRes);
+}
+
+CTxPreValidationQueue::CTxPreValidationQueue()
+    : CTxPreValidationQueue(PreValidateWithSnapshot, ProcessPreValidated)
+{
+}
+
+CTxPreValidationQueue::CTxPreValidationQueue(PreValidateFunc preValidateIn, FinishFunc finishIn)
+    : preValidate(std::move(preValidateIn)), finish(std::move(finishIn))
+{
+}
+
+void CTxPreValidationQueue::start(int nThreadsIn)
+{
+    const int n = std::max(0, std::min(nThreadsIn, MAX_TXVALIDATION_THREADS));
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fStopped = false;
+    }
+    int nStarted = 0;
+    for (int i = 0; i < n; i++) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            nRunning++;
+        }
+        if (!NewThread([this](int workerIndex) { ThreadTxPreValidation(workerIndex); }, i)) {
+            NLog.write(b_sev::err, "Error: NewThread(ThreadTxPreValidation) failed");
+            std::lock_guard<std::mutex> lock(mtx);
+            nRunning--;
+            continue;
+        }
+        nStarted++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        nThreads = nStarted;
+    }
+    NLog.write(b_sev::info, "Validating relayed transactions with {} worker threads", nStarted);
+}
+
+bool CTxPreValidationQueue::push(CNode* pfrom, const CTransaction& tx)
+{
+    const std::size_t nSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (nThreads == 0 || fStopped || fShutdown ||
+            nQueuedBytes + nSize > MAX_TXVALIDATION_QUEUE_BYTES) {
+            return false;
+        }
+        {
+            LOCK(cs_vNodes);
+            pfrom->AddRef();
+        }
+        queue.push_back(Job{pfrom, tx, nSize});
+        nQueuedBytes += nSize;
+    }
+    cond.notify_one();
+    return true;
+}
+
+bool CTxPreValidationQueue::IsStopping() const { return fStopped || fShutdown; }
+
+bool CTxPreValidationQueue::pop(Job& job, int64_t timeoutMillis)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    if (queue.empty() && !IsStopping()) {
+        cond.wait_for(lock, std::chrono::milliseconds(timeoutMillis));
+    }
+    if (queue.empty() || IsStopping()) {
+        return false;
+    }
+    job = std::move(queue.front());
+    queue.pop_front();
+    nQueuedBytes -= job.nSize;
+    return true;
+}
+
+void CTxPreValidationQueue::clear()
+{
+    std::deque<Job> queueCopy;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queueCopy.swap(queue);
+        nQueuedBytes = 0;
+        nThreads     = 0;
+        fStopped     = true;
+    }
+    cond.notify_all();
+    LOCK(cs_vNodes);
+    for (Job& job : queueCopy) {
+        job.pfrom->Release();
+    }
+}
+
+std::size_t CTxPreValidationQueue::size() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return queue.size();
+}
+
+int CTxPreValidationQueue::running() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return nRunning;
+}
+
+void CTxPreValidationQueue::ThreadTxPreValidation(int workerIndex)
+{
+    RenameThread(("neblio-txval" + std::to_string(workerIndex)).c_str());
+
+    vnThreadsRunning[THREAD_TXPREVALIDATION]++;
+    try {
+        SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
+        Job job;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (IsStopping())
+                    break;
+            }
+            // Reduce vnThreadsRunning so StopNode has permission to exit while
+            // we're waiting, but we must always check fShutdown after doing this.
+            vnThreadsRunning[THREAD_TXPREVALIDATION]--;
+            const bool fGotJob = pop(job, 100);
+            vnThreadsRunning[THREAD_TXPREVALIDATION]++;
+            if (!fGotJob)
+                continue;
+            try {
+                if (!job.pfrom->fDisconnect) {
+                    const Result<void, TxValidationState> preValidationRes = preValidate(job.tx);
+                    finish(job.pfrom, job.tx, preValidationRes);
+                }
+            } catch (std::exception& e) {
+                PrintExceptionContinue(&e, "ThreadTxPreValidation()");
+            } catch (...) {
+                PrintExceptionContinue(nullptr, "ThreadTxPreValidation()");
+            }
+            LOCK(cs_vNodes);
+            job.pfrom->Release();
+        }
+    } catch (std::exception& e) {
+        PrintException(&e, "ThreadTxPreValidation()");
+    } catch (...) {
+        PrintException(nullptr, "ThreadTxPreValidation()");
+    }
+    vnThreadsRunning[THREAD_TXPREVALIDATION]--;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    nRunning--;
+    cond.notify_all();
+}
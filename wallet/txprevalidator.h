@@ -0,0 +1,93 @@
+#ifndef TXPREVALIDATOR_H
+#define TXPREVALIDATOR_H
+
+#include "result.h"
+#include "transaction.h"
+#include "validation.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+class CNode;
+
+/** Default for -txvalidationthreads; 0 validates relayed transactions in the message handler */
+static const int DEFAULT_TXVALIDATION_THREADS = 4;
+static const int MAX_TXVALIDATION_THREADS     = 16;
+/** The total serialized size of the relayed transactions waiting for validation */
+static const std::size_t MAX_TXVALIDATION_QUEUE_BYTES = 32 * 1024 * 1024;
+
+/**
+ * The transactions relayed by peers, waiting to be validated by a pool of worker threads.
+ *
+ * A worker runs PreValidateTransaction() against a read snapshot of the chain, so that the
+ * expensive part of the validation, reading the inputs and checking the scripts, happens without
+ * cs_main, and many transactions are checked at once. Only then it takes cs_main, to check the
+ * transaction against the mempool and add it there, with ProcessRelayedTransaction().
+ *
+ * The queue holds a reference to the peer of every transaction in it.
+ */
+class CTxPreValidationQueue
+{
+public:
+    /** the part of the validation that runs in parallel */
+    using PreValidateFunc = std::function<Result<void, TxValidationState>(const CTransaction& tx)>;
+    /** the final step, with the result of preValidate; the default one takes cs_main */
+    using FinishFunc = std::function<void(CNode* pfrom, const CTransaction& tx,
+                                          const Result<void, TxValidationState>& preValidationRes)>;
+
+private:
+    struct Job
+    {
+        CNode*       pfrom;
+        CTransaction tx;
+        std::size_t  nSize;
+    };
+
+    const PreValidateFunc preValidate;
+    const FinishFunc      finish;
+
+    mutable std::mutex      mtx;
+    std::condition_variable cond;
+    std::deque<Job>         queue;
+    std::size_t             nQueuedBytes = 0;
+    int                     nThreads     = 0;
+    int                     nRunning     = 0;
+    bool                    fStopped     = false;
+
+    /** returns false on timeout or shutdown */
+    bool pop(Job& job, int64_t timeoutMillis);
+
+    bool IsStopping() const;
+
+    void ThreadTxPreValidation(int workerIndex);
+
+public:
+    /** validates with PreValidateTransaction() and ProcessRelayedTransaction() */
+    CTxPreValidationQueue();
+    CTxPreValidationQueue(PreValidateFunc preValidateIn, FinishFunc finishIn);
+
+    CTxPreValidationQueue(const CTxPreValidationQueue&) = delete;
+    CTxPreValidationQueue& operator=(const CTxPreValidationQueue&) = delete;
+
+    void start(int nThreadsIn);
+
+    /** queues the transaction for validation; returns false if there are no workers or the queue is
+     * full, then the caller validates the transaction itself */
+    bool push(CNode* pfrom, const CTransaction& tx);
+
+    /** stops the workers and drops the queued transactions; a transaction that is being validated
+     * is finished first */
+    void clear();
+
+    std::size_t size() const;
+
+    /** the number of workers that haven't exited yet */
+    int running() const;
+};
+
+extern CTxPreValidationQueue txPreValidationQueue;
+
+#endif // TXPREVALIDATOR_H
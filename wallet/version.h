@@ -32,7 +32,7 @@ static const int DATABASE_VERSION = 70517;
 // network protocol versioning
 //
 
-static const int PROTOCOL_VERSION = 60340;
+static const int PROTOCOL_VERSION = 60341;
 
 // intial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -51,4 +51,7 @@ static const int BIP0031_VERSION = 60000;
 // "mempool" command, enhanced "getdata" behavior starts with this version:
 static const int MEMPOOL_GD_VERSION = 60002;
 
+// compact block relay ("sendcmpct", "cmpctblock", "getblocktxn" and "blocktxn") starts with this version
+static const int COMPACT_BLOCKS_VERSION = 60341;
+
 #endif
@@ -418,27 +418,109 @@ int64_t CWallet::IncOrderPosNext(CWalletDB* pwalletdb)
     return nRet;
 }
 
-CWallet::TxItems CWallet::OrderedTxItems(std::list<CAccountingEntry>& acentries, std::string strAccount)
+void CWallet::RebuildOrderedTxItems(std::list<CAccountingEntry>& acentries)
 {
     AssertLockHeld(cs_wallet); // mapWallet
-    CWalletDB walletdb(strWalletFile);
-
-    // First: get all CWalletTx and CAccountingEntry into a sorted-by-order multimap.
-    TxItems txOrdered;
 
-    // Note: maintaining indices in the database of (account,time) --> txid and (account, time) -->
-    // acentry would make this much faster for applications that do this a lot.
+    laccentries.swap(acentries);
+    wtxOrdered.clear();
     for (map<uint256, CWalletTx>::iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
         CWalletTx* wtx = &((*it).second);
-        txOrdered.insert(make_pair(wtx->nOrderPos, TxPair(wtx, (CAccountingEntry*)0)));
+        wtxOrdered.insert(make_pair(wtx->nOrderPos, TxPair(wtx, (CAccountingEntry*)0)));
+    }
+    for (CAccountingEntry& entry : laccentries) {
+        wtxOrdered.insert(make_pair(entry.nOrderPos, TxPair((CWalletTx*)0, &entry)));
+    }
+}
+
+void CWallet::LoadAccountingEntry(const CAccountingEntry& acentry)
+{
+    AssertLockHeld(cs_wallet);
+
+    laccentries.push_back(acentry);
+    CAccountingEntry& entry = laccentries.back();
+    wtxOrdered.insert(std::make_pair(entry.nOrderPos, TxPair((CWalletTx*)0, &entry)));
+}
+
+void CWallet::UpdateTxHeight(const ITxDB& txdb, const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+
+    int nHeight = -1;
+    if (!wtx.hashUnset()) {
+        const auto bi = txdb.ReadBlockIndex(wtx.hashBlock);
+        if (bi)
+            nHeight = bi->nHeight;
+    }
+
+    const uint256 hash = wtx.GetHash();
+    const auto    it   = mapTxHeight.find(hash);
+    if (it != mapTxHeight.end()) {
+        if (it->second == nHeight)
+            return;
+        setTxsByHeight.erase(std::make_pair(it->second, hash));
+    }
+    mapTxHeight[hash] = nHeight;
+    setTxsByHeight.insert(std::make_pair(nHeight, hash));
+}
+
+void CWallet::EraseTxHeight(const uint256& hash)
+{
+    AssertLockHeld(cs_wallet);
+
+    const auto it = mapTxHeight.find(hash);
+    if (it != mapTxHeight.end()) {
+        setTxsByHeight.erase(std::make_pair(it->second, hash));
+        mapTxHeight.erase(it);
+    }
+}
+
+std::vector<const CWalletTx*> CWallet::GetWalletTxsSinceHeight(const ITxDB& txdb, int nHeight) const
+{
+    AssertLockHeld(cs_wallet);
+
+    std::vector<const CWalletTx*> result;
+    const auto                    add = [this, &result](const uint256& hash) {
+        const auto it = mapWallet.find(hash);
+        if (it != mapWallet.end())
+            result.push_back(&it->second);
+    };
+
+    if (nHeight < 0) {
+        result.reserve(setTxsByHeight.size());
+        for (const auto& p : setTxsByHeight)
+            add(p.second);
+        return result;
     }
-    acentries.clear();
-    walletdb.ListAccountCreditDebit(strAccount, acentries);
-    for (CAccountingEntry& entry : acentries) {
-        txOrdered.insert(make_pair(entry.nOrderPos, TxPair((CWalletTx*)0, &entry)));
+
+    const auto itSince = setTxsByHeight.lower_bound(std::make_pair(nHeight + 1, uint256(0)));
+
+    // the transactions that aren't in a block have no confirmations
+    auto it = setTxsByHeight.begin();
+    for (; it != itSince && it->first < 0; ++it)
+        add(it->second);
+
+    // in blocks up to nHeight, only the ones that aren't in the main chain (anymore) or are conflicted
+    // have fewer confirmations; that's checked once per height
+    int                      nCheckedHeight = -1;
+    boost::optional<uint256> mainChainHash;
+    for (; it != itSince; ++it) {
+        const auto wit = mapWallet.find(it->second);
+        if (wit == mapWallet.end())
+            continue;
+        if (it->first != nCheckedHeight) {
+            nCheckedHeight = it->first;
+            mainChainHash  = txdb.ReadBlockHashOfHeight(nCheckedHeight);
+        }
+        if (!mainChainHash || *mainChainHash != wit->second.hashBlock || wit->second.nIndex == -1)
+            result.push_back(&wit->second);
     }
 
-    return txOrdered;
+    // all the ones in later blocks have fewer confirmations, whether these are in the main chain or not
+    for (; it != setTxsByHeight.end(); ++it)
+        add(it->second);
+
+    return result;
 }
 
 void CWallet::MarkDirty()
@@ -464,8 +546,9 @@ unsigned int CWallet::ComputeTimeSmart(const ITxDB& txdb, const CWalletTx& wtx)
                 // Tolerate times up to the last timestamp in the wallet not more than 5 minutes into the
                 // future
                 int64_t latestTolerated = latestNow + 300;
-                TxItems txOrdered       = wtxOrdered;
-                for (TxItems::reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it) {
+                const TxItems& txOrdered = wtxOrdered;
+                for (TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend();
+                     ++it) {
                     CWalletTx* const pwtx = (*it).second.first;
                     if (pwtx == &wtx)
                         continue;
@@ -594,6 +677,7 @@ void CWallet::MarkConflicted(const ITxDB& txdb, const uint256& hashBlock, const
             wtx.hashBlock = hashBlock;
             wtx.MarkDirty();
             wtx.WriteToDisk(&walletdb);
+            UpdateTxHeight(txdb, wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them
             // conflicted too
             auto                     txSpends = mapTxSpends.get();
@@ -655,6 +739,7 @@ bool CWallet::AddToWallet(const ITxDB& txdb, const CWalletTx& wtxIn, bool fFromL
         wtx.BindWallet(this);
         wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
         AddToSpends(hash);
+        UpdateTxHeight(txdb, wtx);
     } else {
 
         LOCK(cs_wallet);
@@ -713,6 +798,12 @@ bool CWallet::AddToWallet(const ITxDB& txdb, const CWalletTx& wtxIn, bool fFromL
             if (!wtx.WriteToDisk(pwalletdb))
                 return false;
 
+        if (fInsertedNew || fUpdated)
+            UpdateTxHeight(txdb, wtx);
+
+        if (fInsertedNew || fUpdated || setNTP1OutputsPending.count(hash))
+            IndexNTP1Outputs(txdb, wtx, pwalletdb);
+
         // since AddToWallet is called directly for self-originating transactions, check for
         // consumption of own coins
         //        WalletUpdateSpent(wtx, (wtxIn.hashBlock != 0));
@@ -791,12 +882,176 @@ bool CWallet::EraseFromWallet(uint256 hash)
         return false;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
-            CWalletDB(strWalletFile).EraseTx(hash);
+        const auto wit = mapWallet.find(hash);
+        if (wit != mapWallet.end()) {
+            const auto range = wtxOrdered.equal_range(wit->second.nOrderPos);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second.first == &wit->second) {
+                    wtxOrdered.erase(it);
+                    break;
+                }
+            }
+            EraseTxHeight(hash);
+            mapWallet.erase(wit);
+
+            CWalletDB walletdb(strWalletFile);
+            walletdb.EraseTx(hash);
+
+            setNTP1OutputsPending.erase(hash);
+            auto it = mapNTP1Outputs.lower_bound(COutPoint(hash, 0));
+            while (it != mapNTP1Outputs.end() && it->first.hash == hash) {
+                walletdb.EraseNTP1Output(it->first);
+                it = mapNTP1Outputs.erase(it);
+            }
+        }
     }
     return true;
 }
 
+void CWallet::IndexNTP1Outputs(const ITxDB& txdb, const CWalletTx& wtx, CWalletDB* pwalletdb)
+{
+    AssertLockHeld(cs_wallet);
+
+    const uint256 hash = wtx.GetHash();
+    setNTP1OutputsPending.erase(hash);
+
+    if (!NTP1Transaction::IsTxNTP1(&wtx))
+        return;
+
+    std::vector<unsigned int> vMine;
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        const isminetype mine = IsMine(wtx.vout[i]);
+        if (mine != ISMINE_NO && !IsMineCheck(mine, ISMINE_WATCH_ONLY))
+            vMine.push_back(i);
+    }
+    if (vMine.empty())
+        return;
+
+    // the NTP1 data of confirmed transactions was written by ConnectBlock, only unconfirmed ones have
+    // to be read from their inputs
+    NTP1Transaction ntp1tx;
+    if (!txdb.ReadNTP1Tx(hash, ntp1tx)) {
+        try {
+            std::vector<std::pair<CTransaction, NTP1Transaction>> prevTxs =
+                NTP1Transaction::GetAllNTP1InputsOfTx(wtx, txdb, true);
+            ntp1tx.readNTP1DataFromTx(txdb, wtx, prevTxs);
+        } catch (std::exception& ex) {
+            NLog.write(b_sev::warn,
+                       "Unable to read the NTP1 data of wallet transaction {}; will retry when it's "
+                       "updated. Error says: {}",
+                       hash.ToString(), ex.what());
+            setNTP1OutputsPending.insert(hash);
+            return;
+        }
+    }
+
+    std::unique_ptr<CWalletDB> pwalletdbLocal;
+    if (fFileBacked && !pwalletdb) {
+        pwalletdbLocal.reset(new CWalletDB(strWalletFile));
+        pwalletdb = pwalletdbLocal.get();
+    }
+
+    for (unsigned int i : vMine) {
+        if (i >= ntp1tx.getTxOutCount())
+            break;
+        const NTP1TxOut&             ntp1txout = ntp1tx.getTxOut(i);
+        std::vector<NTP1TokenTxData> tokens;
+        tokens.reserve(ntp1txout.tokenCount());
+        for (unsigned long j = 0; j < ntp1txout.tokenCount(); j++) {
+            tokens.push_back(ntp1txout.getToken(j));
+        }
+
+        const COutPoint outpoint(hash, i);
+        const auto      it = mapNTP1Outputs.find(outpoint);
+        if (tokens.empty()) {
+            if (it != mapNTP1Outputs.end()) {
+                mapNTP1Outputs.erase(it);
+                if (pwalletdb)
+                    pwalletdb->EraseNTP1Output(outpoint);
+            }
+            continue;
+        }
+        if (it != mapNTP1Outputs.end() && it->second == tokens)
+            continue;
+        mapNTP1Outputs[outpoint] = tokens;
+        if (pwalletdb && !pwalletdb->WriteNTP1Output(outpoint, tokens)) {
+            NLog.write(b_sev::err, "Failed to write the NTP1 output {}:{} to the wallet database",
+                       hash.ToString(), i);
+        }
+    }
+}
+
+void CWallet::LoadNTP1Output(const COutPoint& outpoint, const std::vector<NTP1TokenTxData>& tokens)
+{
+    AssertLockHeld(cs_wallet);
+    mapNTP1Outputs[outpoint] = tokens;
+}
+
+bool CWallet::ReindexNTP1Outputs(const ITxDB& txdb, CWalletDB& walletdb)
+{
+    LOCK(cs_wallet);
+
+    const int64_t nStart = GetTimeMillis();
+    for (const auto& p : mapNTP1Outputs) {
+        walletdb.EraseNTP1Output(p.first);
+    }
+    mapNTP1Outputs.clear();
+    setNTP1OutputsPending.clear();
+
+    for (const auto& p : mapWallet) {
+        IndexNTP1Outputs(txdb, p.second, &walletdb);
+    }
+
+    NLog.write(b_sev::info, "Indexed {} NTP1 outputs of the wallet in {} ms", mapNTP1Outputs.size(),
+               GetTimeMillis() - nStart);
+    return walletdb.WriteNTP1OutputsIndexVersion();
+}
+
+std::map<std::string, CNTP1TokenBalance> CWallet::GetNTP1Balances(const ITxDB& txdb,
+                                                                  int          nMinDepth) const
+{
+    std::map<std::string, CNTP1TokenBalance> result;
+
+    const uint256 bestBlockHash = txdb.GetBestBlockHash();
+
+    LOCK(cs_wallet);
+    // the same outputs as AvailableCoins(), without having to look at the outputs without tokens
+    for (const auto& p : mapNTP1Outputs) {
+        const COutPoint& outpoint = p.first;
+
+        const auto wit = mapWallet.find(outpoint.hash);
+        if (wit == mapWallet.end())
+            continue;
+        const CWalletTx& wtx = wit->second;
+
+        if (outpoint.n >= wtx.vout.size())
+            continue;
+        if (!IsFinalTx(wtx, txdb) || !wtx.IsTrusted(txdb, bestBlockHash))
+            continue;
+        if ((wtx.IsCoinBase() || wtx.IsCoinStake()) && wtx.GetBlocksToMaturity(txdb, bestBlockHash) > 0)
+            continue;
+
+        const int nDepth = wtx.GetDepthInMainChain(txdb, bestBlockHash);
+        if (nDepth < nMinDepth || (nDepth == 0 && !wtx.InMempool()))
+            continue;
+
+        const isminetype mine = IsMine(wtx.vout[outpoint.n]);
+        if (mine == ISMINE_NO || IsMineCheck(mine, ISMINE_WATCH_ONLY))
+            continue;
+        if (wtx.vout[outpoint.n].nValue < nMinimumInputValue)
+            continue;
+        if (IsSpent(outpoint.hash, outpoint.n, txdb, bestBlockHash))
+            continue;
+
+        for (const NTP1TokenTxData& token : p.second) {
+            CNTP1TokenBalance& balance = result[token.getTokenId()];
+            balance.tokenSymbol        = token.getTokenSymbol();
+            balance.balance += token.getAmount();
+        }
+    }
+    return result;
+}
+
 isminetype CWallet::IsMine(const CTxIn& txin) const
 {
     {
@@ -1240,7 +1495,10 @@ CAmount CWallet::GetBalance(const ITxDB& txdb) const
     CAmount       nTotal        = 0;
     const uint256 bestBlockHash = txdb.GetBestBlockHash();
     {
-        LOCK2(cs_main, cs_wallet);
+        // the chain is only read here, so cs_main is shared with the other readers; the credit
+        // caches of the wallet txs are written under cs_wallet
+        LOCK_SHARED(cs_main);
+        LOCK(cs_wallet);
         for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
              ++it) {
             const CWalletTx* pcoin = &(*it).second;
@@ -1257,7 +1515,8 @@ CAmount CWallet::GetColdStakingBalance(const ITxDB& txdb) const
 {
     CAmount nTotal = 0;
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK_SHARED(cs_main);
+        LOCK(cs_wallet);
         const uint256 bestBlockHash = txdb.GetBestBlockHash();
         for (const auto& p : mapWallet) {
             const CWalletTx& pcoin = p.second;
@@ -1280,7 +1539,8 @@ CAmount CWallet::GetDelegatedBalance(const ITxDB& txdb) const
     CAmount       nTotal        = 0;
     const uint256 bestBlockHash = txdb.GetBestBlockHash();
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK_SHARED(cs_main);
+        LOCK(cs_wallet);
         for (const auto& p : mapWallet) {
             const CWalletTx& pcoin = p.second;
             if (pcoin.HasP2CSOutputs() && pcoin.IsTrusted(txdb, bestBlockHash))
@@ -1295,7 +1555,8 @@ CAmount CWallet::GetUnconfirmedBalance(const ITxDB& txdb) const
     CAmount       nTotal        = 0;
     const uint256 bestBlockHash = txdb.GetBestBlockHash();
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK_SHARED(cs_main);
+        LOCK(cs_wallet);
         for (const auto& p : mapWallet) {
             const CWalletTx& pcoin = p.second;
             if (!pcoin.IsTrusted(txdb, bestBlockHash) &&
@@ -1311,7 +1572,8 @@ CAmount CWallet::GetImmatureColdStakingBalance(const ITxDB& txdb) const
     CAmount       nTotal        = 0;
     const uint256 bestBlockHash = txdb.GetBestBlockHash();
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK_SHARED(cs_main);
+        LOCK(cs_wallet);
         for (const auto& p : mapWallet) {
             const CWalletTx& pcoin = p.second;
             nTotal += pcoin.GetImmatureCredit(bestBlockHash, txdb, false, ISMINE_COLD);
@@ -1325,7 +1587,8 @@ CAmount CWallet::GetImmatureDelegatedBalance(const ITxDB& txdb) const
     CAmount       nTotal        = 0;
     const uint256 bestBlockHash = txdb.GetBestBlockHash();
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK_SHARED(cs_main);
+        LOCK(cs_wallet);
         for (const auto& p : mapWallet) {
             const CWalletTx& pcoin = p.second;
             nTotal += pcoin.GetImmatureCredit(bestBlockHash, txdb, false, ISMINE_SPENDABLE_DELEGATED);
@@ -1339,7 +1602,8 @@ CAmount CWallet::GetImmatureBalance(const ITxDB& txdb) const
     CAmount       nTotal        = 0;
     const uint256 bestBlockHash = txdb.GetBestBlockHash();
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK_SHARED(cs_main);
+        LOCK(cs_wallet);
         for (const auto& p : mapWallet) {
             const CWalletTx& pcoin = p.second;
             if (pcoin.IsCoinBase() && pcoin.GetBlocksToMaturity(txdb, bestBlockHash) > 0 &&
@@ -1360,7 +1624,8 @@ void CWallet::AvailableCoins(const ITxDB& txdb, vector<COutput>& vCoins, bool fO
     vCoins.clear();
     {
         const uint256 bestBlockHash = txdb.GetBestBlockHash();
-        LOCK2(cs_main, cs_wallet);
+        LOCK_SHARED(cs_main);
+        LOCK(cs_wallet);
         for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
              ++it) {
             const CWalletTx* pcoin = &(*it).second;
@@ -1607,7 +1872,8 @@ CAmount CWallet::GetStake(const ITxDB& txdb) const
 {
     CAmount       nTotal        = 0;
     const uint256 bestBlockHash = txdb.GetBestBlockHash();
-    LOCK2(cs_main, cs_wallet);
+    LOCK_SHARED(cs_main);
+    LOCK(cs_wallet);
     for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
         const CWalletTx* pcoin = &(*it).second;
         if (pcoin->IsCoinStake() && pcoin->GetBlocksToMaturity(txdb, bestBlockHash) > 0 &&
@@ -1621,7 +1887,8 @@ CAmount CWallet::GetNewMint(const ITxDB& txdb) const
 {
     CAmount       nTotal        = 0;
     const uint256 bestBlockHash = txdb.GetBestBlockHash();
-    LOCK2(cs_main, cs_wallet);
+    LOCK_SHARED(cs_main);
+    LOCK(cs_wallet);
     for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
         const CWalletTx* pcoin = &(*it).second;
         if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity(txdb, bestBlockHash) > 0 &&
@@ -3268,6 +3535,7 @@ bool CWallet::AbandonTransaction(const ITxDB& txdb, const uint256& hashTx)
             wtx.setAbandoned();
             wtx.MarkDirty();
             wtx.WriteToDisk(&walletdb);
+            UpdateTxHeight(txdb, wtx);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them
             // abandoned too
@@ -3466,7 +3734,7 @@ CAmount CWalletTx::GetChange(const ITxDB& txdb) const
 CAmount CWalletTx::GetImmatureCredit(const uint256& bestBlockHash, const ITxDB& txdb, bool fUseCache,
                                      const isminefilter& filter) const
 {
-    LOCK(cs_main);
+    LOCK_SHARED(cs_main);
     if ((IsCoinBase() || IsCoinStake()) && GetBlocksToMaturity(txdb, bestBlockHash) > 0 &&
         IsInMainChain(txdb, bestBlockHash)) {
         if (fUseCache && c_ImmatureCreditCached && filter == ISMINE_SPENDABLE_ALL)
@@ -16,6 +16,7 @@
 #include "keystore.h"
 #include "merkletx.h"
 #include "ntp1/ntp1sendtxdata.h"
+#include "ntp1/ntp1tokentxdata.h"
 #include "script.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -57,6 +58,13 @@ public:
     virtual void     setReferenceBlockHeight() {}
 };
 
+/** The balance of a token held by the wallet, as returned by CWallet::GetNTP1Balances() */
+struct CNTP1TokenBalance
+{
+    std::string tokenSymbol;
+    NTP1Int     balance = 0;
+};
+
 /** A key pool entry */
 class CKeyPool
 {
@@ -115,6 +123,28 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * The NTP1 tokens in the outputs of wallet transactions that are ours, kept up to date as
+     * transactions are added to the wallet and persisted as "ntp1out" records, so that token
+     * balances don't require reading the NTP1 data of every output again. Spent outputs stay in the
+     * map; they're filtered with mapTxSpends, which handles abandoned and conflicted spends.
+     */
+    std::map<COutPoint, std::vector<NTP1TokenTxData>> mapNTP1Outputs;
+    // NTP1 transactions whose NTP1 data couldn't be read yet, e.g. because their inputs are unknown
+    std::set<uint256> setNTP1OutputsPending;
+
+    /**
+     * The wallet transactions by the height of the block they're in, -1 for those that aren't in a
+     * known block, so that listsinceblock doesn't have to look at the whole wallet
+     */
+    std::set<std::pair<int, uint256>> setTxsByHeight;
+    std::map<uint256, int>            mapTxHeight;
+
+    void UpdateTxHeight(const ITxDB& txdb, const CWalletTx& wtx);
+    void EraseTxHeight(const uint256& hash);
+
+    void IndexNTP1Outputs(const ITxDB& txdb, const CWalletTx& wtx, CWalletDB* pwalletdb);
+
 public:
     /// Main wallet lock.
     /// This lock protects all the fields added by CWallet
@@ -244,13 +274,14 @@ public:
     typedef std::pair<CWalletTx*, CAccountingEntry*> TxPair;
     typedef std::multimap<int64_t, TxPair>           TxItems;
 
+    /** The wallet's activity log: all the wallet transactions and the accounting entries of
+        laccentries by nOrderPos, kept up to date as they're added and erased
+     */
     TxItems wtxOrdered;
 
-    /** Get the wallet's activity log
-        @return multimap of ordered transactions and accounting entries
-        @warning Returned pointers are *only* valid within the scope of passed acentries
-     */
-    TxItems OrderedTxItems(std::list<CAccountingEntry>& acentries, std::string strAccount = "");
+    /** Replaces laccentries and rebuilds wtxOrdered, for when the order positions were changed */
+    void RebuildOrderedTxItems(std::list<CAccountingEntry>& acentries);
+    void LoadAccountingEntry(const CAccountingEntry& acentry);
 
     void         MarkDirty();
     unsigned int ComputeTimeSmart(const ITxDB& txdb, const CWalletTx& wtx) const;
@@ -259,6 +290,14 @@ public:
     bool AddToWalletIfInvolvingMe(const ITxDB& txdb, const CTransaction& tx, const CBlock* pblock,
                                   bool fUpdate, bool walletRescan);
     bool EraseFromWallet(uint256 hash);
+    void LoadNTP1Output(const COutPoint& outpoint, const std::vector<NTP1TokenTxData>& tokens);
+    // rebuilds mapNTP1Outputs from the wallet transactions, for wallets that don't have it yet
+    bool ReindexNTP1Outputs(const ITxDB& txdb, CWalletDB& walletdb);
+    // the wallet transactions that have fewer confirmations than a block at nHeight in the main
+    // chain, ordered by height; all of them if nHeight is negative
+    std::vector<const CWalletTx*> GetWalletTxsSinceHeight(const ITxDB& txdb, int nHeight) const;
+    // token id vs balance of the unspent token outputs with at least nMinDepth confirmations
+    std::map<std::string, CNTP1TokenBalance> GetNTP1Balances(const ITxDB& txdb, int nMinDepth) const;
     //    void    WalletUpdateSpent(const CTransaction& prevout, bool fBlock = false);
     int     ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
     void    ReacceptWalletTransactions(const ITxDB& txdb, bool fFirstLoad = false);
@@ -62,6 +62,7 @@ HEADERS += qt/bitcoingui.h \
     qt/transactionview.h \
     qt/walletmodel.h \
     bitcoinrpc.h \
+    rpcserver.h \
     qt/overviewpage.h \
     qt/ui_overviewpage.h \
     qt/ui_qrcodedialog.h \
@@ -107,6 +108,7 @@ HEADERS += qt/bitcoingui.h \
     qt/ntp1/ntp1tokenlistmodel.h \
     qt/ntp1/ntp1tokenlistfilterproxy.h \
     ntp1/ntp1tokenmetadata.h \
+    ntp1/ntp1metadatacache.h \
     ntp1/ntp1wallet.h \
     qt/ntp1/ntp1tokenlistitemdelegate.h \
     ThreadSafeHashMap.h \
@@ -170,13 +172,24 @@ HEADERS += qt/bitcoingui.h \
     db/idb.h                         \
     db/lmdb/lmdb.h                   \
     db/lmdb/lmdbtransaction.h        \
+    db/lmdb/lmdbwallet.h             \
     stringmanip.h                    \
     logging/defaultlogger.h          \
     logging/logger.h                 \
     blockreject.h                    \
     blockmetadata.h                  \
     blockindexlrucache.h             \
-    proposal.h
+    proposal.h                       \
+    eventnotifier.h                  \
+    headerssync.h                    \
+    orphanblockpool.h                \
+    blockencodings.h                 \
+    addressindex.h                   \
+    ntp1tokenindex.h                 \
+    txprevalidator.h                 \
+    sha256.h                         \
+    arith_uint256.h                  \
+    runtimeconfig.h
 
 
 
@@ -281,6 +294,7 @@ SOURCES += qt/bitcoin.cpp \
     qt/ntp1/ntp1tokenlistmodel.cpp \
     qt/ntp1/ntp1tokenlistfilterproxy.cpp \
     ntp1/ntp1tokenmetadata.cpp \
+    ntp1/ntp1metadatacache.cpp \
     ntp1/ntp1wallet.cpp \
     qt/ntp1/ntp1tokenlistitemdelegate.cpp \
     ThreadSafeHashMap.cpp \
@@ -343,13 +357,25 @@ SOURCES += qt/bitcoin.cpp \
     coldstakinglistfilterproxy.cpp      \
     db/lmdb/lmdb.cpp                    \
     db/lmdb/lmdbtransaction.cpp         \
+    db/lmdb/lmdbwallet.cpp              \
     stringmanip.cpp                     \
     logging/defaultlogger.cpp           \
     logging/logger.cpp                  \
     blockreject.cpp                     \
     blockmetadata.cpp                   \
     blockindexlrucache.cpp              \
-    proposal.cpp
+    proposal.cpp                        \
+    eventnotifier.cpp                   \
+    headerssync.cpp                     \
+    orphanblockpool.cpp                 \
+    blockencodings.cpp                  \
+    addressindex.cpp                    \
+    ntp1tokenindex.cpp                  \
+    txprevalidator.cpp                  \
+    sha256.cpp                          \
+    arith_uint256.cpp                   \
+    base58.cpp                          \
+    runtimeconfig.cpp
 
 
 
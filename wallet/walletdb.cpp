@@ -4,6 +4,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "walletdb.h"
+#include "db/lmdb/lmdbwallet.h"
+#include "ntp1/ntp1tokentxdata.h"
 #include "txdb.h"
 #include "wallet.h"
 #include <boost/filesystem.hpp>
@@ -13,6 +15,9 @@ using namespace std;
 using namespace boost;
 
 static uint64_t nAccountingEntryNumber = 0;
+
+// the wallet's NTP1 outputs index is rebuilt on load when its version is older than this
+static const int NTP1_OUTPUTS_INDEX_VERSION = 1;
 extern bool     fWalletUnlockStakingOnly;
 
 //
@@ -50,6 +55,25 @@ bool CWalletDB::EraseTx(uint256 hash)
     return Erase(std::make_pair(std::string("tx"), hash));
 }
 
+bool CWalletDB::WriteNTP1Output(const COutPoint&                    outpoint,
+                                const std::vector<NTP1TokenTxData>& tokens)
+{
+    nWalletDBUpdated++;
+    return Write(std::make_pair(std::string("ntp1out"), outpoint), tokens);
+}
+
+bool CWalletDB::EraseNTP1Output(const COutPoint& outpoint)
+{
+    nWalletDBUpdated++;
+    return Erase(std::make_pair(std::string("ntp1out"), outpoint));
+}
+
+bool CWalletDB::WriteNTP1OutputsIndexVersion()
+{
+    nWalletDBUpdated++;
+    return Write(std::string("ntp1outversion"), NTP1_OUTPUTS_INDEX_VERSION);
+}
+
 bool CWalletDB::WriteKey(const CPubKey& vchPubKey, const CPrivKey& vchPrivKey,
                          const CKeyMetadata& keyMeta)
 {
@@ -170,42 +194,29 @@ void CWalletDB::ListAccountCreditDebit(const string& strAccount, list<CAccountin
 {
     bool fAllAccounts = (strAccount == "*");
 
-    Dbc* pcursor = GetCursor();
-    if (!pcursor)
-        throw runtime_error("CWalletDB::ListAccountCreditDebit() : cannot create DB cursor");
-    unsigned int fFlags = DB_SET_RANGE;
-    while (true) {
-        // Read next record
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        if (fFlags == DB_SET_RANGE)
-            ssKey << boost::make_tuple(string("acentry"), (fAllAccounts ? string("") : strAccount),
-                                       uint64_t(0));
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        int         ret = ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
-        fFlags          = DB_NEXT;
-        if (ret == DB_NOTFOUND)
-            break;
-        else if (ret != 0) {
-            pcursor->close();
-            throw runtime_error("CWalletDB::ListAccountCreditDebit() : error scanning DB");
-        }
-
-        // Unserialize
-        string strType;
-        ssKey >> strType;
-        if (strType != "acentry")
-            break;
-        CAccountingEntry acentry;
-        ssKey >> acentry.strAccount;
-        if (!fAllAccounts && acentry.strAccount != strAccount)
-            break;
-
-        ssValue >> acentry;
-        ssKey >> acentry.nEntryNo;
-        entries.push_back(acentry);
-    }
+    CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
+    ssStartKey << boost::make_tuple(string("acentry"), (fAllAccounts ? string("") : strAccount),
+                                    uint64_t(0));
+    bool fSuccess = ForEachRecord(
+        [&](CDataStream& ssKey, CDataStream& ssValue) {
+            // Unserialize
+            string strType;
+            ssKey >> strType;
+            if (strType != "acentry")
+                return false;
+            CAccountingEntry acentry;
+            ssKey >> acentry.strAccount;
+            if (!fAllAccounts && acentry.strAccount != strAccount)
+                return false;
 
-    pcursor->close();
+            ssValue >> acentry;
+            ssKey >> acentry.nEntryNo;
+            entries.push_back(acentry);
+            return true;
+        },
+        &ssStartKey);
+    if (!fSuccess)
+        throw runtime_error("CWalletDB::ListAccountCreditDebit() : error scanning DB");
 }
 
 DBErrors CWalletDB::ReorderTransactions(CWallet* pwallet)
@@ -267,6 +278,11 @@ DBErrors CWalletDB::ReorderTransactions(CWallet* pwallet)
         }
     }
 
+    // the order positions changed, and the accounting entries in memory are outdated
+    list<CAccountingEntry> acentriesAll;
+    ListAccountCreditDebit("*", acentriesAll);
+    pwallet->RebuildOrderedTxItems(acentriesAll);
+
     return DB_LOAD_OK;
 }
 
@@ -279,6 +295,7 @@ public:
     bool            fIsEncrypted;
     bool            fAnyUnordered;
     int             nFileVersion;
+    int             nNTP1OutputsIndexVersion;
     vector<uint256> vWalletUpgrade;
 
     CWalletScanState()
@@ -287,6 +304,7 @@ public:
         fIsEncrypted              = false;
         fAnyUnordered             = false;
         nFileVersion              = 0;
+        nNTP1OutputsIndexVersion  = 0;
     }
 };
 
@@ -362,12 +380,13 @@ bool ReadKeyValue(const ITxDB& txdb, CWallet* pwallet, CDataStream& ssKey, CData
             if (nNumber > nAccountingEntryNumber)
                 nAccountingEntryNumber = nNumber;
 
-            if (!wss.fAnyUnordered) {
-                CAccountingEntry acentry;
-                ssValue >> acentry;
-                if (acentry.nOrderPos == -1)
-                    wss.fAnyUnordered = true;
-            }
+            CAccountingEntry acentry;
+            ssValue >> acentry;
+            acentry.strAccount = strAccount;
+            acentry.nEntryNo   = nNumber;
+            if (acentry.nOrderPos == -1)
+                wss.fAnyUnordered = true;
+            pwallet->LoadAccountingEntry(acentry);
         } else if (strType == "key" || strType == "wkey") {
             vector<unsigned char> vchPubKey;
             ssKey >> vchPubKey;
@@ -483,6 +502,14 @@ bool ReadKeyValue(const ITxDB& txdb, CWallet* pwallet, CDataStream& ssKey, CData
             }
         } else if (strType == "orderposnext") {
             ssValue >> pwallet->nOrderPosNext;
+        } else if (strType == "ntp1out") {
+            COutPoint outpoint;
+            ssKey >> outpoint;
+            std::vector<NTP1TokenTxData> tokens;
+            ssValue >> tokens;
+            pwallet->LoadNTP1Output(outpoint, tokens);
+        } else if (strType == "ntp1outversion") {
+            ssValue >> wss.nNTP1OutputsIndexVersion;
         }
     } catch (...) {
         return false;
@@ -512,25 +539,7 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             pwallet->LoadMinVersion(nMinVersion);
         }
 
-        // Get cursor
-        Dbc* pcursor = GetCursor();
-        if (!pcursor) {
-            NLog.write(b_sev::err, "Error getting wallet database cursor");
-            return DB_CORRUPT;
-        }
-
-        while (true) {
-            // Read next record
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int         ret = ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0) {
-                NLog.write(b_sev::err, "Error reading next record from wallet database");
-                return DB_CORRUPT;
-            }
-
+        bool fReadOK = ForEachRecord([&](CDataStream& ssKey, CDataStream& ssValue) {
             // Try to be tolerant of single corrupt records:
             string strType, strErr;
             if (!ReadKeyValue(txdb, pwallet, ssKey, ssValue, wss, strType, strErr)) {
@@ -548,8 +557,12 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             }
             if (!strErr.empty())
                 NLog.write(b_sev::info, "{}", strErr);
+            return true;
+        });
+        if (!fReadOK) {
+            NLog.write(b_sev::err, "Error reading next record from wallet database");
+            return DB_CORRUPT;
         }
-        pcursor->close();
     } catch (...) {
         result = DB_CORRUPT;
     }
@@ -584,6 +597,12 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
     if (wss.fAnyUnordered)
         result = ReorderTransactions(pwallet);
 
+    if (wss.nNTP1OutputsIndexVersion < NTP1_OUTPUTS_INDEX_VERSION) {
+        NLog.write(b_sev::info, "Building the NTP1 outputs index of the wallet");
+        if (!pwallet->ReindexNTP1Outputs(txdb, *this))
+            NLog.write(b_sev::err, "Failed to write the NTP1 outputs index of the wallet");
+    }
+
     return result;
 }
 
@@ -619,6 +638,17 @@ void FlushWalletDB_unsafe(const std::string& strFile, unsigned int* nLastFlushed
 
 void FlushWalletDB(bool forceLockAndFlush, const std::string& strFile, unsigned int* nLastFlushedPtr)
 {
+    if (std::shared_ptr<LMDBWalletStorage> storage =
+            LMDBWalletStorage::GetIfOpen(GetWalletFilePath(strFile))) {
+        // LMDB has no log to checkpoint, only the last commits to sync
+        if (nLastFlushedPtr) {
+            *nLastFlushedPtr = nWalletDBUpdated;
+        }
+        if (!storage->sync())
+            NLog.write(b_sev::err, "Failed to flush the wallet database {}", strFile);
+        return;
+    }
+
     if (!forceLockAndFlush) {
         TRY_LOCK(bitdb.cs_db, lockDb);
         if (lockDb) {
@@ -663,6 +693,16 @@ bool BackupWallet(const CWallet& wallet, const string& strDest)
 {
     if (!wallet.fFileBacked)
         return false;
+    if (std::shared_ptr<LMDBWalletStorage> storage = GetLMDBWalletStorage(wallet.strWalletFile)) {
+        // a consistent copy can be made while the wallet is in use
+        filesystem::path pathDest(strDest);
+        if (filesystem::is_directory(pathDest))
+            pathDest /= wallet.strWalletFile;
+        if (!storage->backupTo(pathDest))
+            return false;
+        NLog.write(b_sev::info, "copied {} to {}", wallet.strWalletFile, pathDest.string());
+        return true;
+    }
     while (!fShutdown) {
         {
             LOCK(bitdb.cs_db);
@@ -780,6 +820,72 @@ bool CWalletDB::Recover(CDBEnv& dbenv, std::string filename)
     return CWalletDB::Recover(dbenv, filename, false);
 }
 
+bool CWalletDB::MigrateToLMDB(const std::string& strFile)
+{
+    const filesystem::path walletPath   = GetWalletFilePath(strFile);
+    const filesystem::path newPath      = walletPath.string() + ".lmdb-migration";
+    const filesystem::path migratedPath = walletPath.string() + ".migrated";
+
+    NLog.write(b_sev::info, "Migrating {} from BerkeleyDB to LMDB...", walletPath.string());
+    const int64_t nStart = GetTimeMillis();
+
+    // leftovers of an interrupted migration
+    filesystem::remove(newPath);
+    filesystem::remove(newPath.string() + "-lock");
+
+    uint64_t nRecords = 0;
+    try {
+        LMDBWalletStorage storage(newPath);
+        CWalletDB         walletdb(strFile, "r");
+        // the records take about as much space as in BerkeleyDB
+        if (!storage.beginBatch(filesystem::file_size(walletPath) * 2))
+            return false;
+        bool fWriteOK = true;
+        bool fReadOK  = walletdb.ForEachRecord([&](CDataStream& ssKey, CDataStream& ssValue) {
+            fWriteOK = storage.write(std::string(ssKey.begin(), ssKey.end()),
+                                     std::string(ssValue.begin(), ssValue.end()), false);
+            nRecords++;
+            return fWriteOK;
+        });
+        if (!fReadOK || !fWriteOK) {
+            storage.abortBatch();
+            return NLog.error("Failed to copy the records of {} to LMDB", strFile);
+        }
+        if (!storage.commitBatch() || storage.getRecordCount() != nRecords)
+            return NLog.error("Failed to commit the records of {} to LMDB", strFile);
+    } catch (std::exception& ex) {
+        return NLog.error("Failed to migrate {} to LMDB: {}", strFile, ex.what());
+    }
+
+    {
+        // make wallet.dat self contained before moving it away
+        LOCK(bitdb.cs_db);
+        bitdb.CloseDb(strFile);
+        bitdb.CheckpointLSN(strFile);
+        bitdb.mapFileUseCount.erase(strFile);
+    }
+
+    try {
+        filesystem::rename(walletPath, migratedPath);
+    } catch (const filesystem::filesystem_error& ex) {
+        return NLog.error("Failed to move {} away for the migration: {}", strFile, ex.what());
+    }
+    try {
+        filesystem::rename(newPath, walletPath);
+        filesystem::remove(newPath.string() + "-lock");
+    } catch (const filesystem::filesystem_error& ex) {
+        NLog.write(b_sev::err, "Failed to move the migrated wallet into place: {}", ex.what());
+        // put the BerkeleyDB wallet back, so that the wallet isn't gone
+        filesystem::rename(migratedPath, walletPath);
+        return false;
+    }
+
+    NLog.write(b_sev::info,
+               "Migrated {} records of {} to LMDB in {} ms; the BerkeleyDB file was kept as {}",
+               nRecords, strFile, GetTimeMillis() - nStart, migratedPath.string());
+    return true;
+}
+
 CKeyMetadata::CKeyMetadata() { SetNull(); }
 
 CKeyMetadata::CKeyMetadata(int64_t nCreateTime_)
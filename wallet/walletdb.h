@@ -11,6 +11,8 @@
 class CKeyPool;
 class CAccount;
 class CAccountingEntry;
+class COutPoint;
+class NTP1TokenTxData;
 
 /** Error statuses for the wallet database */
 enum DBErrors
@@ -60,6 +62,12 @@ public:
 
     bool EraseTx(uint256 hash);
 
+    bool WriteNTP1Output(const COutPoint& outpoint, const std::vector<NTP1TokenTxData>& tokens);
+
+    bool EraseNTP1Output(const COutPoint& outpoint);
+
+    bool WriteNTP1OutputsIndexVersion();
+
     bool WriteKey(const CPubKey& vchPubKey, const CPrivKey& vchPrivKey, const CKeyMetadata& keyMeta);
 
     bool WriteCryptedKey(const CPubKey& vchPubKey, const std::vector<unsigned char>& vchCryptedSecret,
@@ -101,6 +109,12 @@ public:
     DBErrors    LoadWallet(CWallet* pwallet);
     static bool Recover(CDBEnv& dbenv, std::string filename, bool fOnlyKeys);
     static bool Recover(CDBEnv& dbenv, std::string filename);
+
+    /**
+     * Copies all the records of a BerkeleyDB wallet file to a new LMDB file, in one transaction, which
+     * then takes the name of the wallet file. The old file is kept as <file>.migrated.
+     */
+    static bool MigrateToLMDB(const std::string& strFile);
 };
 
 #endif // BITCOIN_WALLETDB_H